@@ -3,12 +3,18 @@
 #include <QJsonDocument>
 #include <QRandomGenerator>
 #include <QDateTime>
+#include <QUuid>
 
 namespace {
 constexpr char kMessageDelimiter = '\n';
 constexpr int kReconnectIntervalMs = 5000;  // 5 seconds
 constexpr int kMinSendIntervalMs = 10;      // 0.01 seconds
 constexpr int kMaxSendIntervalMs = 100;     // 0.1 seconds
+constexpr int kMaxRedirects = 3;
+// Образцы уходят в сокет, пока в его буфере меньше этого; остальные ждут
+// в очереди клиента
+constexpr qint64 kMaxSocketBacklog = 64 * 1024;
+constexpr int kStatsIntervalMs = 10000;
 
 // Log message templates for variety
 const QStringList kLogMessages = {
@@ -29,30 +35,76 @@ const QStringList kSeverities = {"INFO", "WARNING", "ERROR", "DEBUG"};
 
 Client::Client(QObject *parent)
     : QObject(parent),
-      socket_(new QTcpSocket(this)),
+      tcp_socket_(new QTcpSocket(this)),
+      local_socket_(new QLocalSocket(this)),
+      ring_socket_(new ShmRingSocket(this)),
+      socket_(tcp_socket_),
       reconnect_timer_(new QTimer(this)),
       send_timer_(new QTimer(this)),
+      stats_timer_(new QTimer(this)),
+      seed_port_(12345),
       port_(12345),
+      device_id_(QUuid::createUuid().toString(QUuid::WithoutBraces)),
+      compression_(false),
+      plain_bytes_(0),
+      wire_bytes_(0),
+      delta_encoding_(false),
+      queue_capacity_(1000),
+      queue_policy_(QueuePolicy::DropOldest),
+      generation_blocked_(false),
+      peak_depth_(0),
+      dropped_(0),
+      coalesced_(0),
+      blocked_ticks_(0),
+      redirect_count_(0),
       client_id_(-1),
       state_(ClientState::Disconnected),
       uptime_(0),
       message_counter_(0)
 {
     // Socket connections
-    connect(socket_, &QTcpSocket::connected,
+    connect(tcp_socket_, &QTcpSocket::connected,
             this, &Client::onConnected);
-    connect(socket_, &QTcpSocket::disconnected,
+    connect(tcp_socket_, &QTcpSocket::disconnected,
             this, &Client::onDisconnected);
-    connect(socket_, &QTcpSocket::readyRead,
+    connect(tcp_socket_, &QTcpSocket::readyRead,
             this, &Client::onReadyRead);
-    connect(socket_, &QTcpSocket::errorOccurred,
+    connect(tcp_socket_, &QTcpSocket::errorOccurred,
             this, &Client::onSocketError);
 
+    connect(local_socket_, &QLocalSocket::connected,
+            this, &Client::onConnected);
+    connect(local_socket_, &QLocalSocket::disconnected,
+            this, &Client::onDisconnected);
+    connect(local_socket_, &QLocalSocket::readyRead,
+            this, &Client::onReadyRead);
+    connect(local_socket_, &QLocalSocket::errorOccurred,
+            this, &Client::onSocketError);
+
+    connect(ring_socket_, &ShmRingSocket::connected,
+            this, &Client::onConnected);
+    connect(ring_socket_, &ShmRingSocket::disconnected,
+            this, &Client::onDisconnected);
+    connect(ring_socket_, &ShmRingSocket::readyRead,
+            this, &Client::onReadyRead);
+    connect(ring_socket_, &ShmRingSocket::errorOccurred,
+            this, &Client::onSocketError);
+
+    // Освободившийся буфер сокета забирает образцы из очереди
+    connect(tcp_socket_, &QTcpSocket::bytesWritten,
+            this, &Client::flushQueue);
+    connect(local_socket_, &QLocalSocket::bytesWritten,
+            this, &Client::flushQueue);
+    connect(ring_socket_, &ShmRingSocket::bytesWritten,
+            this, &Client::flushQueue);
+
     // Timer connections
     connect(reconnect_timer_, &QTimer::timeout,
             this, &Client::onReconnectTimer);
     connect(send_timer_, &QTimer::timeout,
             this, &Client::onSendDataTimer);
+    connect(stats_timer_, &QTimer::timeout,
+            this, &Client::onStatsTimer);
 
     reconnect_timer_->setSingleShot(true);
     send_timer_->setSingleShot(true);
@@ -64,26 +116,126 @@ Client::~Client()
 }
 
 void Client::connectToServer(const QString &host, quint16 port)
+{
+    seed_host_ = host;
+    seed_port_ = port;
+    local_name_.clear();
+    ring_name_.clear();
+    redirect_count_ = 0;
+    connectToHost(host, port);
+}
+
+void Client::connectToLocalServer(const QString &name)
+{
+    local_name_ = name;
+    ring_name_.clear();
+    redirect_count_ = 0;
+    connectToLocal(name);
+}
+
+void Client::connectToRingServer(const QString &name)
+{
+    ring_name_ = name;
+    local_name_.clear();
+    redirect_count_ = 0;
+    connectToRing(name);
+}
+
+void Client::connectToHost(const QString &host, quint16 port)
 {
     host_ = host;
     port_ = port;
 
-    if (socket_->state() != QAbstractSocket::UnconnectedState) {
-        socket_->abort();
+    if (!isSocketIdle()) {
+        abortSocket();
     }
+    // abort() мог запланировать переподключение через onDisconnected
+    reconnect_timer_->stop();
 
+    socket_ = tcp_socket_;
     setState(ClientState::Connecting);
     emit logMessage(QString("Connecting to %1:%2...").arg(host_).arg(port_));
-    socket_->connectToHost(host_, port_);
+    tcp_socket_->connectToHost(host_, port_);
+}
+
+void Client::connectToLocal(const QString &name)
+{
+    if (!isSocketIdle()) {
+        abortSocket();
+    }
+    reconnect_timer_->stop();
+
+    socket_ = local_socket_;
+    setState(ClientState::Connecting);
+    emit logMessage(QString("Connecting to local socket %1...").arg(name));
+    local_socket_->connectToServer(name);
+}
+
+void Client::connectToRing(const QString &name)
+{
+    if (!isSocketIdle()) {
+        abortSocket();
+    }
+    reconnect_timer_->stop();
+
+    socket_ = ring_socket_;
+    setState(ClientState::Connecting);
+    emit logMessage(QString("Connecting to shared-memory ring %1...").arg(name));
+    ring_socket_->connectToServer(name);
+}
+
+bool Client::isSocketConnected() const
+{
+    if (socket_ == ring_socket_) {
+        return ring_socket_->state() == QLocalSocket::ConnectedState;
+    }
+    if (socket_ == local_socket_) {
+        return local_socket_->state() == QLocalSocket::ConnectedState;
+    }
+    return tcp_socket_->state() == QAbstractSocket::ConnectedState;
+}
+
+bool Client::isSocketIdle() const
+{
+    if (socket_ == ring_socket_) {
+        return ring_socket_->state() == QLocalSocket::UnconnectedState;
+    }
+    if (socket_ == local_socket_) {
+        return local_socket_->state() == QLocalSocket::UnconnectedState;
+    }
+    return tcp_socket_->state() == QAbstractSocket::UnconnectedState;
+}
+
+void Client::closeSocket()
+{
+    if (socket_ == ring_socket_) {
+        ring_socket_->disconnectFromServer();
+    } else if (socket_ == local_socket_) {
+        local_socket_->disconnectFromServer();
+    } else {
+        tcp_socket_->disconnectFromHost();
+    }
+}
+
+void Client::abortSocket()
+{
+    if (socket_ == ring_socket_) {
+        ring_socket_->abort();
+    } else if (socket_ == local_socket_) {
+        local_socket_->abort();
+    } else {
+        tcp_socket_->abort();
+    }
 }
 
 void Client::disconnect()
 {
     reconnect_timer_->stop();
     send_timer_->stop();
+    stats_timer_->stop();
 
-    if (socket_->state() != QAbstractSocket::UnconnectedState) {
-        socket_->disconnectFromHost();
+    if (!isSocketIdle()) {
+        closeSocket();
     }
 
     setState(ClientState::Disconnected);
@@ -99,10 +251,50 @@ int Client::clientId() const
     return client_id_;
 }
 
+void Client::setDeviceId(const QString &device_id)
+{
+    device_id_ = device_id;
+}
+
+QString Client::deviceId() const
+{
+    return device_id_;
+}
+
+void Client::setCompression(bool enabled)
+{
+    compression_ = enabled;
+}
+
+void Client::setDeltaEncoding(bool enabled)
+{
+    delta_encoding_ = enabled;
+}
+
+void Client::setOutboundQueue(int capacity, QueuePolicy policy)
+{
+    queue_capacity_ = qMax(1, capacity);
+    queue_policy_ = policy;
+}
+
 void Client::onConnected()
 {
+    // Сжатие и разности согласуются заново на каждом соединении
+    deflater_.reset();
+    delta_encoder_.reset();
+    plain_bytes_ = 0;
+    wire_bytes_ = 0;
+
     emit logMessage("Connected to server, waiting for confirmation...");
     setState(ClientState::WaitingConfirmation);
+    stats_timer_->start(kStatsIntervalMs);
+
+    // Идентичность устройства: узел кластера решает, принять ли его
+    QJsonObject hello;
+    hello["type"] = "Hello";
+    hello["device_id"] = device_id_;
+    sendMessage(hello);
+
     emit connected();
 }
 
@@ -110,7 +302,18 @@ void Client::onDisconnected()
 {
     emit logMessage("Disconnected from server");
     send_timer_->stop();
+    stats_timer_->stop();
     client_id_ = -1;
+    // Образцы старого соединения устарели; разности нового начнутся с нуля
+    dropped_ += quint64(outbound_.size());
+    outbound_.clear();
+    generation_blocked_ = false;
+    if (deflater_ && wire_bytes_ > 0) {
+        emit logMessage(QString("Compressed %1 bytes to %2 (ratio %3)")
+                        .arg(plain_bytes_).arg(wire_bytes_)
+                        .arg(double(plain_bytes_) / wire_bytes_, 0, 'f', 2));
+    }
+    deflater_.reset();
 
     if (state_ != ClientState::Disconnected) {
         // Auto-reconnect
@@ -137,10 +340,8 @@ void Client::onReadyRead()
     }
 }
 
-void Client::onSocketError(QAbstractSocket::SocketError error)
+void Client::onSocketError()
 {
-    Q_UNUSED(error);
-
     if (state_ == ClientState::Connecting) {
         emit logMessage(QString("Connection failed: %1").arg(socket_->errorString()));
         emit logMessage(QString("Retrying in %1 seconds...")
@@ -153,8 +354,17 @@ void Client::onSocketError(QAbstractSocket::SocketError error)
 
 void Client::onReconnectTimer()
 {
-    if (state_ != ClientState::Disconnected) {
-        connectToServer(host_, port_);
+    // Переподключение всегда через исходный узел: размещение могло измениться
+    if (state_ == ClientState::Disconnected) {
+        return;
+    }
+    redirect_count_ = 0;
+    if (!ring_name_.isEmpty()) {
+        connectToRing(ring_name_);
+    } else if (!local_name_.isEmpty()) {
+        connectToLocal(local_name_);
+    } else {
+        connectToHost(seed_host_, seed_port_);
     }
 }
 
@@ -164,6 +374,13 @@ void Client::onSendDataTimer()
         return;
     }
 
+    // Генерация продолжится из flushQueue, когда очередь освободится
+    if (queue_policy_ == QueuePolicy::Block && outbound_.size() >= queue_capacity_) {
+        generation_blocked_ = true;
+        ++blocked_ticks_;
+        return;
+    }
+
     // Rotate through data types
     QJsonObject data;
     int data_type = message_counter_ % 3;
@@ -181,7 +398,7 @@ void Client::onSendDataTimer()
             break;
     }
 
-    sendMessage(data);
+    enqueueSample(data);
 
     // Schedule next send with random delay
     scheduleNextSend();
@@ -189,16 +406,106 @@ void Client::onSendDataTimer()
 
 void Client::sendMessage(const QJsonObject &message)
 {
-    if (socket_->state() != QAbstractSocket::ConnectedState) {
+    if (!isSocketConnected()) {
         return;
     }
 
-    QJsonDocument doc(message);
-    QByteArray data = doc.toJson(QJsonDocument::Compact);
-    data.append(kMessageDelimiter);
+    // Кадр уже с разделителем; сокет копирует его, и буфер построителя
+    // освобождается для следующего сообщения
+    QByteArray data = frame_builder_.build(message);
+    if (deflater_) {
+        // Сброс после каждого сообщения: сервер разбирает его сразу
+        plain_bytes_ += data.size();
+        data = deflater_->compress(data);
+        wire_bytes_ += data.size();
+    }
     socket_->write(data);
 }
 
+void Client::enqueueSample(const QJsonObject &sample)
+{
+    const QString type = sample["type"].toString();
+
+    // Журналы — события, их не заменяют; метрики и состояние — да
+    if (queue_policy_ == QueuePolicy::CoalesceLatest && type != "Log") {
+        for (int i = 0; i < outbound_.size(); ++i) {
+            if (outbound_[i]["type"].toString() == type) {
+                outbound_.removeAt(i);
+                ++coalesced_;
+                break;
+            }
+        }
+    }
+
+    if (outbound_.size() >= queue_capacity_) {
+        if (queue_policy_ == QueuePolicy::DropByPriority) {
+            // Самый старый из наименее важных; если новый еще менее
+            // важен, отбрасывается он сам
+            int victim = 0;
+            for (int i = 1; i < outbound_.size(); ++i) {
+                if (priorityOf(outbound_[i]) < priorityOf(outbound_[victim])) {
+                    victim = i;
+                }
+            }
+            ++dropped_;
+            if (priorityOf(sample) < priorityOf(outbound_[victim])) {
+                return;
+            }
+            outbound_.removeAt(victim);
+        } else {
+            outbound_.removeFirst();
+            ++dropped_;
+        }
+    }
+
+    outbound_.append(sample);
+    peak_depth_ = qMax(peak_depth_, int(outbound_.size()));
+    flushQueue();
+}
+
+int Client::priorityOf(const QJsonObject &sample)
+{
+    if (sample["type"].toString() != "Log") {
+        return 1;
+    }
+    const QString severity = sample["severity"].toString();
+    if (severity == "ERROR") {
+        return 3;
+    }
+    return severity == "WARNING" ? 2 : 0;
+}
+
+void Client::flushQueue()
+{
+    while (!outbound_.isEmpty() && isSocketConnected()
+           && socket_->bytesToWrite() < kMaxSocketBacklog) {
+        QJsonObject sample = outbound_.takeFirst();
+        // Отправленный образец — база следующего: TCP доставит его по порядку
+        if (delta_encoder_) {
+            const QJsonObject delta = delta_encoder_->encode(sample);
+            if (!delta.isEmpty()) {
+                sample = delta;
+            }
+        }
+        sendMessage(sample);
+    }
+
+    if (generation_blocked_ && outbound_.size() < queue_capacity_) {
+        generation_blocked_ = false;
+        scheduleNextSend();
+    }
+}
+
+void Client::onStatsTimer()
+{
+    emit logMessage(QString("Outbound: queue %1/%2 (peak %3), socket buffer %4 bytes, "
+                            "dropped %5, coalesced %6, blocked %7")
+                    .arg(outbound_.size()).arg(queue_capacity_).arg(peak_depth_)
+                    .arg(socket_->bytesToWrite())
+                    .arg(dropped_).arg(coalesced_).arg(blocked_ticks_));
+    peak_depth_ = int(outbound_.size());
+}
+
 void Client::processServerMessage(const QByteArray &data)
 {
     QJsonParseError parse_error;
@@ -212,11 +519,37 @@ void Client::processServerMessage(const QByteArray &data)
     QJsonObject obj = doc.object();
     QString type = obj["type"].toString();
 
-    if (type == "ConnectionConfirm") {
+    if (type == "ConnectionConfirm" && obj["status"].toString() == "redirect") {
+        const QString host = obj["host"].toString();
+        const quint16 port = static_cast<quint16>(obj["port"].toInt());
+        if (++redirect_count_ > kMaxRedirects) {
+            emit logMessage("Too many redirects, check the cluster configuration");
+            closeSocket();
+            return;
+        }
+        emit logMessage(QString("Redirected to node %1 at %2:%3")
+                        .arg(obj["node"].toString(), host).arg(port));
+        // Из обработчика readyRead сокет не переподключаем
+        QMetaObject::invokeMethod(this, [this, host, port] {
+            connectToHost(host, port);
+        }, Qt::QueuedConnection);
+    } else if (type == "ConnectionConfirm") {
+        redirect_count_ = 0;
         client_id_ = obj["client_id"].toInt();
         QString status = obj["status"].toString();
         emit logMessage(QString("Connection confirmed. Client ID: %1, Status: %2")
                         .arg(client_id_).arg(status));
+        if (compression_ && !deflater_
+            && obj["compression"].toString() == StreamCodec::kDeflate) {
+            // Строка Compress уходит несжатой, все после нее — поток deflate
+            sendMessage(QJsonObject{{"type", "Compress"}, {"codec", StreamCodec::kDeflate}});
+            deflater_ = std::make_unique<StreamCodec::Deflater>();
+            emit logMessage("Uplink compression: deflate");
+        }
+        if (delta_encoding_ && obj["delta"].toBool()) {
+            delta_encoder_ = std::make_unique<DeltaCodec::Encoder>();
+            emit logMessage("Delta encoding of samples enabled");
+        }
         setState(ClientState::WaitingStart);
     } else if (type == "Command") {
         QString command = obj["command"].toString();
@@ -1,10 +1,19 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include <QLocalSocket>
 #include <QObject>
 #include <QTcpSocket>
 #include <QTimer>
 #include <QJsonObject>
+#include <QList>
+
+#include <memory>
+
+#include "deltacodec.h"
+#include "framebuilder.h"
+#include "shmringsocket.h"
+#include "streamcodec.h"
 
 // Client states
 enum class ClientState {
@@ -16,6 +25,14 @@ enum class ClientState {
     Stopped
 };
 
+// What the bounded outbound queue does when it is full
+enum class QueuePolicy {
+    DropOldest,      // Отбросить самый старый образец
+    DropByPriority,  // Отбросить наименее важный (INFO/DEBUG журналы первыми)
+    CoalesceLatest,  // Метрики и состояние: в очереди только последний образец типа
+    Block            // Остановить генерацию, пока очередь не освободится
+};
+
 class Client : public QObject
 {
     Q_OBJECT
@@ -24,10 +41,27 @@ public:
     explicit Client(QObject *parent = nullptr);
     ~Client();
 
-    // Connection control
+    // Connection control. host:port is the seed node; after a redirect
+    // the client reconnects through it, so placement changes are picked up
     void connectToServer(const QString &host = "localhost", quint16 port = 12345);
+    // Local socket of a server on this host (ServerApp --local NAME);
+    // the protocol is the same as over TCP
+    void connectToLocalServer(const QString &name);
+    // Shared-memory ring of a server on this host (ServerApp --ring NAME)
+    void connectToRingServer(const QString &name);
     void disconnect();
 
+    // Stable device identity sent in Hello (default: random per process)
+    void setDeviceId(const QString &device_id);
+    QString deviceId() const;
+
+    // Compress the uplink when the server offers it in ConnectionConfirm
+    void setCompression(bool enabled);
+    // Send samples as deltas of changed fields when the server supports it
+    void setDeltaEncoding(bool enabled);
+    // Samples waiting for a socket with a full send buffer
+    void setOutboundQueue(int capacity, QueuePolicy policy);
+
     // State
     ClientState state() const;
     int clientId() const;
@@ -42,13 +76,30 @@ private slots:
     void onConnected();
     void onDisconnected();
     void onReadyRead();
-    void onSocketError(QAbstractSocket::SocketError error);
+    void onSocketError();
     void onReconnectTimer();
     void onSendDataTimer();
+    void onStatsTimer();
+    // Move queued samples to the socket while its buffer is short
+    void flushQueue();
 
 private:
+    // Connect to a node without changing the seed
+    void connectToHost(const QString &host, quint16 port);
+    void connectToLocal(const QString &name);
+    void connectToRing(const QString &name);
+
+    // Транспорт: активен один из сокетов, протокол поверх них одинаков
+    bool isSocketConnected() const;
+    bool isSocketIdle() const;
+    void closeSocket();
+    void abortSocket();
+
     // Send JSON message to server
     void sendMessage(const QJsonObject &message);
+    // Queue a sample by the policy, then flush
+    void enqueueSample(const QJsonObject &sample);
+    static int priorityOf(const QJsonObject &sample);
 
     // Process received message from server
     void processServerMessage(const QByteArray &data);
@@ -64,13 +115,41 @@ private:
     void setState(ClientState state);
     void scheduleNextSend();
 
-    QTcpSocket *socket_;
+    QTcpSocket *tcp_socket_;
+    QLocalSocket *local_socket_;
+    ShmRingSocket *ring_socket_;
+    QIODevice *socket_;     // Активный сокет
     QTimer *reconnect_timer_;
     QTimer *send_timer_;
+    QTimer *stats_timer_;
     QByteArray receive_buffer_;
 
+    QString seed_host_;
+    quint16 seed_port_;
     QString host_;
     quint16 port_;
+    QString local_name_;    // Не пусто — подключение через локальный сокет
+    QString ring_name_;     // Не пусто — подключение через кольцо в общей памяти
+    QString device_id_;
+    bool compression_;
+    FrameBuilder frame_builder_;
+    std::unique_ptr<StreamCodec::Deflater> deflater_;   // Сжатие согласовано
+    qint64 plain_bytes_;    // Отправлено после согласования сжатия: до и после
+    qint64 wire_bytes_;
+    bool delta_encoding_;
+    std::unique_ptr<DeltaCodec::Encoder> delta_encoder_;    // Сервер поддерживает
+
+    // Образцы копятся здесь, а не в буфере сокета: так их можно отбросить
+    // или заменить более свежими, а разности кодируются только при отправке
+    QList<QJsonObject> outbound_;
+    int queue_capacity_;
+    QueuePolicy queue_policy_;
+    bool generation_blocked_;
+    int peak_depth_;            // За период статистики
+    quint64 dropped_;
+    quint64 coalesced_;
+    quint64 blocked_ticks_;     // Пропущенные из-за Block отправки
+    int redirect_count_;    // Перенаправлений подряд, защита от зацикливания
     int client_id_;
     ClientState state_;
 
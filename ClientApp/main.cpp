@@ -2,6 +2,102 @@
 #include <QTextStream>
 
 #include "client.h"
+#include "transportbenchmark.h"
+
+namespace {
+bool parseQueuePolicy(const QString &name, QueuePolicy *policy)
+{
+    if (name == "drop-oldest") {
+        *policy = QueuePolicy::DropOldest;
+    } else if (name == "drop-priority") {
+        *policy = QueuePolicy::DropByPriority;
+    } else if (name == "coalesce") {
+        *policy = QueuePolicy::CoalesceLatest;
+    } else if (name == "block") {
+        *policy = QueuePolicy::Block;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Замер транспортов на работающем сервере; печатает таблицу результатов
+int runBenchmark(QTextStream &out, const QString &host, quint16 port,
+                 const QString &local_name, const QString &ring_name, int messages, int pings,
+                 quint16 metrics_port, bool compress)
+{
+    TransportBenchmark benchmark(messages, pings);
+    if (metrics_port != 0) {
+        benchmark.setMetricsEndpoint(host, metrics_port);
+    }
+    benchmark.setCompression(compress);
+    QVector<BenchmarkResult> results;
+
+    BenchmarkResult result;
+    QString error;
+    if (!benchmark.runTcp(host, port, &result, &error)) {
+        out << "Benchmark failed: " << error << "\n";
+        return 1;
+    }
+    results.append(result);
+
+    if (!local_name.isEmpty()) {
+        result = BenchmarkResult();
+        if (!benchmark.runLocal(local_name, &result, &error)) {
+            out << "Benchmark failed: " << error << "\n";
+            return 1;
+        }
+        results.append(result);
+    }
+
+    if (!ring_name.isEmpty()) {
+        result = BenchmarkResult();
+        if (!benchmark.runRing(ring_name, &result, &error)) {
+            out << "Benchmark failed: " << error << "\n";
+            return 1;
+        }
+        results.append(result);
+    }
+
+    out << QString("%1 messages, %2 pings per transport\n").arg(messages).arg(pings);
+    out << QString("%1 %2 %3 %4 %5")
+               .arg("transport", -10).arg("msg/s", 12)
+               .arg("mean us", 10).arg("p50 us", 10).arg("p99 us", 10);
+    if (metrics_port != 0) {
+        out << QString(" %1 %2").arg("sys/msg", 10).arg("cpu us/msg", 11);
+    }
+    if (compress) {
+        out << QString(" %1 %2 %3").arg("ratio", 7).arg("defl us/MB", 11).arg("infl us/MB", 11);
+    }
+    out << "\n";
+
+    // Значение метрики сервера или "-", если его нет (например, вызовы бэкенда Qt)
+    auto serverValue = [](double value, int width, int precision) {
+        return value < 0 ? QString("-").rightJustified(width)
+                         : QString("%1").arg(value, width, 'f', precision);
+    };
+    for (const BenchmarkResult &r : std::as_const(results)) {
+        out << QString("%1 %2 %3 %4 %5")
+                   .arg(r.transport, -10)
+                   .arg(r.messages_per_sec, 12, 'f', 0)
+                   .arg(r.latency_mean_us, 10, 'f', 1)
+                   .arg(r.latency_p50_us, 10, 'f', 1)
+                   .arg(r.latency_p99_us, 10, 'f', 1);
+        if (metrics_port != 0) {
+            out << " " << serverValue(r.syscalls_per_message, 10, 3)
+                << " " << serverValue(r.cpu_us_per_message, 11, 2);
+        }
+        // Сервер без --compression сжатие не предлагает: "-"
+        if (compress) {
+            out << " " << serverValue(r.compression_ratio, 7, 2)
+                << " " << serverValue(r.deflate_us_per_mb, 11, 0)
+                << " " << serverValue(r.inflate_us_per_mb, 11, 0);
+        }
+        out << "\n";
+    }
+    return 0;
+}
+}  // namespace
 
 int main(int argc, char *argv[])
 {
@@ -12,6 +108,16 @@ int main(int argc, char *argv[])
     // Parse command line arguments for host and port
     QString host = "localhost";
     quint16 port = 12345;
+    QString device_id;
+    QString local_name;
+    QString ring_name;
+    int bench_messages = 0;
+    int bench_pings = 1000;
+    quint16 metrics_port = 0;
+    bool compress = false;
+    bool delta = false;
+    int queue_capacity = 1000;
+    QueuePolicy queue_policy = QueuePolicy::DropOldest;
 
     QStringList args = a.arguments();
     for (int i = 1; i < args.size(); ++i) {
@@ -23,19 +129,87 @@ int main(int argc, char *argv[])
             if (i + 1 < args.size()) {
                 port = args[++i].toUShort();
             }
+        } else if (args[i] == "--device-id") {
+            if (i + 1 < args.size()) {
+                device_id = args[++i];
+            }
+        } else if (args[i] == "--local") {
+            if (i + 1 < args.size()) {
+                local_name = args[++i];
+            }
+        } else if (args[i] == "--ring") {
+            if (i + 1 < args.size()) {
+                ring_name = args[++i];
+            }
+        } else if (args[i] == "--bench") {
+            if (i + 1 < args.size()) {
+                bench_messages = qMax(1, args[++i].toInt());
+            }
+        } else if (args[i] == "--pings") {
+            if (i + 1 < args.size()) {
+                bench_pings = qMax(1, args[++i].toInt());
+            }
+        } else if (args[i] == "--metrics-port") {
+            if (i + 1 < args.size()) {
+                metrics_port = args[++i].toUShort();
+            }
+        } else if (args[i] == "--compress") {
+            compress = true;
+        } else if (args[i] == "--delta") {
+            delta = true;
+        } else if (args[i] == "--queue") {
+            if (i + 1 < args.size()) {
+                queue_capacity = qMax(1, args[++i].toInt());
+            }
+        } else if (args[i] == "--queue-policy") {
+            if (i + 1 < args.size() && !parseQueuePolicy(args[++i], &queue_policy)) {
+                out << "Unknown queue policy: " << args[i] << "\n";
+                return 1;
+            }
         } else if (args[i] == "--help") {
-            out << "Usage: ClientApp [-h|--host HOST] [-p|--port PORT]\n";
+            out << "Usage: ClientApp [-h|--host HOST] [-p|--port PORT] [--device-id ID]\n";
             out << "  -h, --host HOST    Server host (default: localhost)\n";
             out << "  -p, --port PORT    Server port (default: 12345)\n";
+            out << "  --device-id ID     Device identity for cluster placement (default: random)\n";
+            out << "  --local NAME       Connect through the server's local socket instead of TCP\n";
+            out << "  --ring NAME        Write frames into the server's shared-memory ring\n";
+            out << "  --bench N          Send N messages over TCP (and --local/--ring, if given),\n";
+            out << "                     print messages/s and ping latency, then exit\n";
+            out << "  --pings N          Pings for the latency part of --bench (default: 1000)\n";
+            out << "  --metrics-port P   Server HTTP API port: --bench also reports server\n";
+            out << "                     syscalls and CPU per message (compare --backend runs)\n";
+            out << "  --compress         Deflate the uplink if the server offers it (--compression);\n";
+            out << "                     --bench also reports ratio and CPU per MB\n";
+            out << "  --delta            Send NetworkMetrics/DeviceStatus as deltas of changed fields\n";
+            out << "  --queue N          Samples kept while the server is slow (default: 1000)\n";
+            out << "  --queue-policy P   When the queue is full: drop-oldest (default), drop-priority,\n";
+            out << "                     coalesce (latest sample per type) or block (pause sampling)\n";
             return 0;
         }
     }
 
+    if (bench_messages > 0) {
+        return runBenchmark(out, host, port, local_name, ring_name, bench_messages, bench_pings,
+                            metrics_port, compress);
+    }
+
     out << "Client application starting...\n";
-    out << QString("Target server: %1:%2\n").arg(host).arg(port);
+    if (!ring_name.isEmpty()) {
+        out << QString("Target server: shared-memory ring %1\n").arg(ring_name);
+    } else if (!local_name.isEmpty()) {
+        out << QString("Target server: local socket %1\n").arg(local_name);
+    } else {
+        out << QString("Target server: %1:%2\n").arg(host).arg(port);
+    }
     out.flush();
 
     Client client;
+    if (!device_id.isEmpty()) {
+        client.setDeviceId(device_id);
+    }
+    client.setCompression(compress);
+    client.setDeltaEncoding(delta);
+    client.setOutboundQueue(queue_capacity, queue_policy);
 
     // Connect log messages to console output
     QObject::connect(&client, &Client::logMessage, [&out](const QString &message) {
@@ -44,7 +218,13 @@ int main(int argc, char *argv[])
     });
 
     // Connect to server
-    client.connectToServer(host, port);
+    if (!ring_name.isEmpty()) {
+        client.connectToRingServer(ring_name);
+    } else if (!local_name.isEmpty()) {
+        client.connectToLocalServer(local_name);
+    } else {
+        client.connectToServer(host, port);
+    }
 
     return a.exec();
 }
@@ -0,0 +1,220 @@
+#include "shmringsocket.h"
+
+#include <QDeadlineTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+namespace {
+constexpr int kRetryIntervalMs = 1;     // Кольцо заполнено: повторная попытка записи
+constexpr char kDoorbell = '\n';
+}  // namespace
+
+ShmRingSocket::ShmRingSocket(QObject *parent)
+    : QIODevice(parent),
+      control_(new QLocalSocket(this)),
+      attached_(false),
+      retry_timer_(new QTimer(this))
+{
+    connect(control_, &QLocalSocket::readyRead,
+            this, &ShmRingSocket::onControlReadyRead);
+    connect(control_, &QLocalSocket::disconnected,
+            this, &ShmRingSocket::onControlDisconnected);
+    connect(control_, &QLocalSocket::errorOccurred,
+            this, &ShmRingSocket::onControlError);
+
+    retry_timer_->setSingleShot(true);
+    connect(retry_timer_, &QTimer::timeout,
+            this, &ShmRingSocket::flushPending);
+}
+
+void ShmRingSocket::connectToServer(const QString &name)
+{
+    abort();
+    control_->connectToServer(name);
+}
+
+void ShmRingSocket::disconnectFromServer()
+{
+    // Остаток дописывается, пока кольцо принимает
+    flushPending();
+    control_->disconnectFromServer();
+}
+
+void ShmRingSocket::abort()
+{
+    retry_timer_->stop();
+    pending_.clear();
+    control_->abort();
+    if (attached_) {
+        attached_ = false;
+        memory_.detach();
+        close();
+    }
+}
+
+QLocalSocket::LocalSocketState ShmRingSocket::state() const
+{
+    const QLocalSocket::LocalSocketState control_state = control_->state();
+    if (control_state == QLocalSocket::ConnectedState && !attached_) {
+        return QLocalSocket::ConnectingState;
+    }
+    return control_state;
+}
+
+bool ShmRingSocket::isSequential() const
+{
+    return true;
+}
+
+qint64 ShmRingSocket::bytesAvailable() const
+{
+    return control_->bytesAvailable() + QIODevice::bytesAvailable();
+}
+
+qint64 ShmRingSocket::bytesToWrite() const
+{
+    return pending_.size();
+}
+
+bool ShmRingSocket::canReadLine() const
+{
+    return control_->canReadLine() || QIODevice::canReadLine();
+}
+
+bool ShmRingSocket::waitForConnected(int msecs)
+{
+    QDeadlineTimer deadline(msecs);
+    if (!control_->waitForConnected(msecs)) {
+        return false;
+    }
+    while (!attached_) {
+        if (!control_->waitForReadyRead(int(deadline.remainingTime()))) {
+            return false;
+        }
+        onControlReadyRead();
+    }
+    return true;
+}
+
+bool ShmRingSocket::waitForReadyRead(int msecs)
+{
+    if (control_->bytesAvailable() > 0) {
+        return true;
+    }
+    return control_->waitForReadyRead(msecs);
+}
+
+bool ShmRingSocket::waitForBytesWritten(int msecs)
+{
+    QDeadlineTimer deadline(msecs);
+    while (!pending_.isEmpty()) {
+        flushPending();
+        if (pending_.isEmpty()) {
+            break;
+        }
+        if (deadline.hasExpired() || state() != QLocalSocket::ConnectedState) {
+            return false;
+        }
+        QThread::usleep(50);
+    }
+    return true;
+}
+
+qint64 ShmRingSocket::readData(char *data, qint64 max_length)
+{
+    return control_->read(data, max_length);
+}
+
+qint64 ShmRingSocket::writeData(const char *data, qint64 length)
+{
+    if (!attached_) {
+        setErrorString("ring is not attached");
+        return -1;
+    }
+    // Порядок байтов сохраняется: пока есть хвост, новые данные за ним
+    pending_.append(data, int(length));
+    flushPending();
+    return length;
+}
+
+void ShmRingSocket::onControlReadyRead()
+{
+    if (!attached_) {
+        if (!control_->canReadLine()) {
+            return;
+        }
+        if (!attachRing(control_->readLine().trimmed())) {
+            emit errorOccurred();
+            control_->abort();
+            return;
+        }
+        emit connected();
+        if (control_->bytesAvailable() == 0) {
+            return;
+        }
+    }
+    emit readyRead();
+}
+
+void ShmRingSocket::onControlDisconnected()
+{
+    retry_timer_->stop();
+    pending_.clear();
+    if (attached_) {
+        attached_ = false;
+        memory_.detach();
+        close();
+    }
+    emit disconnected();
+}
+
+void ShmRingSocket::onControlError()
+{
+    setErrorString(control_->errorString());
+    emit errorOccurred();
+}
+
+void ShmRingSocket::flushPending()
+{
+    if (!attached_ || pending_.isEmpty()) {
+        return;
+    }
+
+    bool wake = false;
+    const quint64 written = ring_.write(pending_.constData(), quint64(pending_.size()), &wake);
+    pending_.remove(0, int(written));
+    if (wake) {
+        control_->write(&kDoorbell, 1);
+    }
+    if (written > 0) {
+        emit bytesWritten(qint64(written));
+    }
+    if (!pending_.isEmpty() && !retry_timer_->isActive()) {
+        retry_timer_->start(kRetryIntervalMs);
+    }
+}
+
+bool ShmRingSocket::attachRing(const QByteArray &line)
+{
+    const QJsonObject message = QJsonDocument::fromJson(line).object();
+    if (message["type"].toString() != "ShmRing") {
+        setErrorString("server did not offer a ring");
+        return false;
+    }
+
+    memory_.setKey(message["key"].toString());
+    if (!memory_.attach()) {
+        setErrorString(QString("cannot attach ring: %1").arg(memory_.errorString()));
+        return false;
+    }
+    if (!ring_.attach(memory_.data(), quint64(memory_.size()))) {
+        memory_.detach();
+        setErrorString("unsupported ring format");
+        return false;
+    }
+
+    attached_ = true;
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef SHMRINGSOCKET_H
+#define SHMRINGSOCKET_H
+
+#include <QIODevice>
+#include <QLocalSocket>
+#include <QSharedMemory>
+#include <QTimer>
+
+#include "shmring.h"
+
+// Device end of the server's shared-memory ring transport (ServerApp
+// --ring NAME).
+//
+// Кадры пишутся прямо в кольцо сервера; то, что сейчас не помещается,
+// ждет в pending_ и дописывается по таймеру. Ответы сервера и «звонки»
+// идут через управляющий локальный сокет.
+class ShmRingSocket : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit ShmRingSocket(QObject *parent = nullptr);
+
+    void connectToServer(const QString &name);
+    void disconnectFromServer();
+    void abort();
+
+    // Connected only after the ring is attached
+    QLocalSocket::LocalSocketState state() const;
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    bool canReadLine() const override;
+    bool waitForConnected(int msecs);
+    bool waitForReadyRead(int msecs) override;
+    bool waitForBytesWritten(int msecs) override;
+
+signals:
+    void connected();
+    void disconnected();
+    void errorOccurred();
+
+protected:
+    qint64 readData(char *data, qint64 max_length) override;
+    qint64 writeData(const char *data, qint64 length) override;
+
+private slots:
+    void onControlReadyRead();
+    void onControlDisconnected();
+    void onControlError();
+    void flushPending();
+
+private:
+    // First line of the control socket: key of the ring
+    bool attachRing(const QByteArray &line);
+
+    QLocalSocket *control_;
+    QSharedMemory memory_;
+    ShmRing::Producer ring_;
+    bool attached_;
+    QByteArray pending_;
+    QTimer *retry_timer_;
+};
+
+#endif // SHMRINGSOCKET_H
@@ -0,0 +1,349 @@
+#include "transportbenchmark.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QTcpSocket>
+
+#include "shmringsocket.h"
+
+#include <algorithm>
+
+namespace {
+constexpr char kMessageDelimiter = '\n';
+constexpr int kTimeoutMs = 10000;
+constexpr int kMessagesPerWrite = 256;   // Кадров в одном write()
+// Разных пачек: повтор одной и той же пачки сжимался бы нереально хорошо,
+// 16 пачек заведомо больше окна deflate (32 KB)
+constexpr int kChunkVariants = 16;
+constexpr double kBytesPerMb = 1024.0 * 1024.0;
+
+QByteArray encodeLine(const QJsonObject &message)
+{
+    return QJsonDocument(message).toJson(QJsonDocument::Compact) + kMessageDelimiter;
+}
+
+QByteArray pingLine(int seq)
+{
+    return encodeLine(QJsonObject{{"type", "Ping"}, {"seq", seq}});
+}
+
+// Кадры как у эмулятора устройства: метрики, состояние и журнал со
+// случайным хвостом до 200 символов. Генератор с фиксированным зерном,
+// чтобы прогоны были сравнимы
+QByteArray framesChunk(QRandomGenerator *random)
+{
+    static const char kChars[] = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+    QByteArray chunk;
+    for (int i = 0; i < kMessagesPerWrite; ++i) {
+        QJsonObject frame;
+        switch (i % 3) {
+        case 0:
+            frame["type"] = "NetworkMetrics";
+            frame["bandwidth"] = 50.0 + random->generateDouble() * 100.0;
+            frame["latency"] = 1.0 + random->generateDouble() * 199.0;
+            frame["packet_loss"] = random->generateDouble() * 10.0;
+            break;
+        case 1:
+            frame["type"] = "DeviceStatus";
+            frame["uptime"] = int(random->bounded(1000000));
+            frame["cpu_usage"] = int(random->bounded(100));
+            frame["memory_usage"] = int(random->bounded(20, 95));
+            break;
+        default: {
+            QByteArray extra(int(random->bounded(201)), Qt::Uninitialized);
+            for (char &c : extra) {
+                c = kChars[random->bounded(int(sizeof(kChars)) - 1)];
+            }
+            frame["type"] = "Log";
+            frame["message"] = "Routing table updated"
+                               + (extra.isEmpty() ? QString() : " - " + QString::fromLatin1(extra));
+            frame["severity"] = "INFO";
+            break;
+        }
+        }
+        chunk += encodeLine(frame);
+    }
+    return chunk;
+}
+}  // namespace
+
+TransportBenchmark::TransportBenchmark(int messages, int pings)
+    : messages_(messages),
+      pings_(pings),
+      metrics_port_(0),
+      compression_(false),
+      plain_bytes_(0),
+      wire_bytes_(0),
+      deflate_ns_(0)
+{
+}
+
+void TransportBenchmark::setCompression(bool enabled)
+{
+    compression_ = enabled;
+}
+
+void TransportBenchmark::setMetricsEndpoint(const QString &host, quint16 port)
+{
+    metrics_host_ = host;
+    metrics_port_ = port;
+}
+
+bool TransportBenchmark::runTcp(const QString &host, quint16 port, BenchmarkResult *result,
+                                QString *error)
+{
+    QTcpSocket socket;
+    socket.connectToHost(host, port);
+    if (!socket.waitForConnected(kTimeoutMs)) {
+        *error = QString("tcp %1:%2: %3").arg(host).arg(port).arg(socket.errorString());
+        return false;
+    }
+
+    result->transport = "tcp";
+    const bool ok = run(&socket, result, error);
+    socket.disconnectFromHost();
+    return ok;
+}
+
+bool TransportBenchmark::runLocal(const QString &name, BenchmarkResult *result, QString *error)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(kTimeoutMs)) {
+        *error = QString("local %1: %2").arg(name, socket.errorString());
+        return false;
+    }
+
+    result->transport = "local";
+    const bool ok = run(&socket, result, error);
+    socket.disconnectFromServer();
+    return ok;
+}
+
+bool TransportBenchmark::runRing(const QString &name, BenchmarkResult *result, QString *error)
+{
+    ShmRingSocket socket;
+    socket.connectToServer(name);
+    if (!socket.waitForConnected(kTimeoutMs)) {
+        *error = QString("ring %1: %2").arg(name, socket.errorString());
+        return false;
+    }
+
+    result->transport = "ring";
+    const bool ok = run(&socket, result, error);
+    socket.disconnectFromServer();
+    return ok;
+}
+
+bool TransportBenchmark::run(QIODevice *socket, BenchmarkResult *result, QString *error)
+{
+    const QString transport = result->transport;
+    deflater_.reset();
+    plain_bytes_ = 0;
+    wire_bytes_ = 0;
+    deflate_ns_ = 0;
+
+    if (!writeAll(socket, encodeLine(QJsonObject{{"type", "Hello"},
+                                                 {"device_id", "benchmark-" + transport}}))) {
+        *error = transport + ": write failed";
+        return false;
+    }
+
+    QByteArray line;
+    while (readLine(socket, &line)) {
+        const QJsonObject reply = QJsonDocument::fromJson(line).object();
+        if (reply["type"].toString() != "ConnectionConfirm") {
+            continue;
+        }
+        if (reply["status"].toString() != "connected") {
+            // В кластере замер надо запускать на узле-владельце
+            *error = QString("%1: server answered %2 (node %3)")
+                         .arg(transport, reply["status"].toString(), reply["node"].toString());
+            return false;
+        }
+        if (compression_ && reply["compression"].toString() == StreamCodec::kDeflate) {
+            if (!writeAll(socket, encodeLine(QJsonObject{{"type", "Compress"},
+                                                         {"codec", StreamCodec::kDeflate}}))) {
+                *error = transport + ": write failed";
+                return false;
+            }
+            deflater_ = std::make_unique<StreamCodec::Deflater>();
+        }
+        break;
+    }
+    if (line.isEmpty()) {
+        *error = transport + ": no ConnectionConfirm from the server";
+        return false;
+    }
+
+    // Задержка: по одному Ping в полете
+    QVector<qint64> latencies_ns;
+    latencies_ns.reserve(pings_);
+    QElapsedTimer timer;
+    for (int seq = 0; seq < pings_; ++seq) {
+        timer.start();
+        if (!sendFrames(socket, pingLine(seq)) || !waitForPong(socket, seq)) {
+            *error = QString("%1: no Pong for ping %2").arg(transport).arg(seq);
+            return false;
+        }
+        latencies_ns.append(timer.nsecsElapsed());
+    }
+
+    if (!latencies_ns.isEmpty()) {
+        std::sort(latencies_ns.begin(), latencies_ns.end());
+        qint64 total_ns = 0;
+        for (qint64 latency : std::as_const(latencies_ns)) {
+            total_ns += latency;
+        }
+        result->latency_mean_us = total_ns / 1000.0 / latencies_ns.size();
+        result->latency_p50_us = latencies_ns[latencies_ns.size() / 2] / 1000.0;
+        result->latency_p99_us = latencies_ns[(latencies_ns.size() * 99) / 100] / 1000.0;
+    }
+
+    // Пропускная способность: кадры пачками, в конце Ping
+    QRandomGenerator random(1);
+    QVector<QByteArray> chunks;
+    for (int i = 0; i < kChunkVariants; ++i) {
+        chunks.append(framesChunk(&random));
+    }
+
+    ServerSample before;
+    const bool sampled = sampleServer(&before);
+
+    timer.start();
+    int sent = 0;
+    for (int batch = 0; sent < messages_; ++batch) {
+        const int count = qMin(kMessagesPerWrite, messages_ - sent);
+        QByteArray data = chunks[batch % kChunkVariants];
+        if (count < kMessagesPerWrite) {
+            // Первые count строк пачки
+            int length = 0;
+            for (int i = 0; i < count; ++i) {
+                length = data.indexOf(kMessageDelimiter, length) + 1;
+            }
+            data.truncate(length);
+        }
+        if (!sendFrames(socket, data)) {
+            *error = QString("%1: write failed after %2 messages").arg(transport).arg(sent);
+            return false;
+        }
+        sent += count;
+    }
+    if (!sendFrames(socket, pingLine(pings_)) || !waitForPong(socket, pings_)) {
+        *error = transport + ": server did not acknowledge the batch";
+        return false;
+    }
+
+    const double seconds = timer.nsecsElapsed() / 1e9;
+    result->messages = sent;
+    result->messages_per_sec = seconds > 0 ? sent / seconds : 0;
+
+    // Бэкенд Qt свои вызовы не считает: счетчик не растет
+    ServerSample after;
+    if (sampled && sampleServer(&after)) {
+        if (after.syscalls > before.syscalls) {
+            result->syscalls_per_message = (after.syscalls - before.syscalls) / sent;
+        }
+        result->cpu_us_per_message = (after.cpu_seconds - before.cpu_seconds) * 1e6 / sent;
+        if (deflater_ && after.inflated_bytes > before.inflated_bytes) {
+            result->inflate_us_per_mb = (after.inflate_us - before.inflate_us)
+                                        / ((after.inflated_bytes - before.inflated_bytes) / kBytesPerMb);
+        }
+    }
+    if (deflater_ && wire_bytes_ > 0) {
+        result->compression_ratio = double(plain_bytes_) / wire_bytes_;
+        result->deflate_us_per_mb = deflate_ns_ / 1000.0 / (plain_bytes_ / kBytesPerMb);
+    }
+    return true;
+}
+
+bool TransportBenchmark::sampleServer(ServerSample *sample) const
+{
+    if (metrics_port_ == 0) {
+        return false;
+    }
+
+    QTcpSocket socket;
+    socket.connectToHost(metrics_host_, metrics_port_);
+    if (!socket.waitForConnected(kTimeoutMs)) {
+        return false;
+    }
+    socket.write("GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+
+    // Сервер закрывает соединение после ответа
+    QByteArray response;
+    while (socket.state() == QAbstractSocket::ConnectedState && socket.waitForReadyRead(kTimeoutMs)) {
+        response += socket.readAll();
+    }
+    response += socket.readAll();
+
+    bool found = false;
+    for (const QByteArray &line : response.split('\n')) {
+        if (line.startsWith("clientserver_ingest_syscalls_total ")) {
+            sample->syscalls = line.mid(line.indexOf(' ') + 1).toDouble();
+        } else if (line.startsWith("clientserver_inflated_bytes_total ")) {
+            sample->inflated_bytes = line.mid(line.indexOf(' ') + 1).toDouble();
+        } else if (line.startsWith("clientserver_inflate_microseconds_total ")) {
+            sample->inflate_us = line.mid(line.indexOf(' ') + 1).toDouble();
+        } else if (line.startsWith("process_cpu_seconds_total ")) {
+            sample->cpu_seconds = line.mid(line.indexOf(' ') + 1).toDouble();
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool TransportBenchmark::readLine(QIODevice *socket, QByteArray *line)
+{
+    while (!socket->canReadLine()) {
+        if (!socket->waitForReadyRead(kTimeoutMs)) {
+            line->clear();
+            return false;
+        }
+    }
+    *line = socket->readLine().trimmed();
+    return true;
+}
+
+bool TransportBenchmark::waitForPong(QIODevice *socket, int seq)
+{
+    QByteArray line;
+    while (readLine(socket, &line)) {
+        const QJsonObject reply = QJsonDocument::fromJson(line).object();
+        if (reply["type"].toString() == "Pong" && reply["seq"].toInt() == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TransportBenchmark::sendFrames(QIODevice *socket, const QByteArray &data)
+{
+    if (!deflater_) {
+        return writeAll(socket, data);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray compressed = deflater_->compress(data);
+    deflate_ns_ += timer.nsecsElapsed();
+    plain_bytes_ += data.size();
+    wire_bytes_ += compressed.size();
+    return writeAll(socket, compressed);
+}
+
+bool TransportBenchmark::writeAll(QIODevice *socket, const QByteArray &data)
+{
+    if (socket->write(data) != data.size()) {
+        return false;
+    }
+    // Буфер сокета отправляется сразу: иначе замер включает ожидание
+    while (socket->bytesToWrite() > 0) {
+        if (!socket->waitForBytesWritten(kTimeoutMs)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef TRANSPORTBENCHMARK_H
+#define TRANSPORTBENCHMARK_H
+
+#include <QIODevice>
+#include <QString>
+
+#include <memory>
+
+#include "streamcodec.h"
+
+// Result of one transport run
+struct BenchmarkResult {
+    QString transport;
+    int messages = 0;
+    double messages_per_sec = 0;
+    double latency_mean_us = 0;     // Ping -> Pong, полный круг
+    double latency_p50_us = 0;
+    double latency_p99_us = 0;
+    // По /metrics сервера за фазу пропускной способности; < 0 — нет данных
+    double syscalls_per_message = -1;
+    double cpu_us_per_message = -1;
+    // Сжатие потока (--compress): исходные байты к переданным и CPU на
+    // мегабайт исходных данных у устройства и у сервера; < 0 — не было
+    double compression_ratio = -1;
+    double deflate_us_per_mb = -1;
+    double inflate_us_per_mb = -1;
+};
+
+// Compares transports against a running server (ServerApp).
+//
+// Замер идет через обычное подключение устройства: Hello, затем Ping для
+// задержки (сервер отвечает Pong из потока приема, минуя конвейер) и
+// поток кадров эмулятора для пропускной способности — пачка считается
+// принятой, когда приходит Pong на Ping, отправленный после нее.
+// Соединение синхронное (waitFor*), без цикла событий. С адресом HTTP API
+// сервера (--http-port) до и после потока кадров читается /metrics, чтобы
+// сравнить бэкенды приема по системным вызовам и CPU на сообщение.
+// Со сжатием кадры идут потоком deflate, каждая пачка — один сброс.
+class TransportBenchmark
+{
+public:
+    TransportBenchmark(int messages, int pings);
+
+    void setMetricsEndpoint(const QString &host, quint16 port);
+    // Negotiate deflate compression when the server offers it
+    void setCompression(bool enabled);
+
+    bool runTcp(const QString &host, quint16 port, BenchmarkResult *result, QString *error);
+    bool runLocal(const QString &name, BenchmarkResult *result, QString *error);
+    bool runRing(const QString &name, BenchmarkResult *result, QString *error);
+
+private:
+    struct ServerSample {
+        double syscalls = 0;
+        double cpu_seconds = 0;
+        double inflated_bytes = 0;
+        double inflate_us = 0;
+    };
+
+    bool run(QIODevice *socket, BenchmarkResult *result, QString *error);
+    // GET /metrics; false if the endpoint is not set or unreachable
+    bool sampleServer(ServerSample *sample) const;
+
+    // Next line from the server; false on timeout or disconnect
+    bool readLine(QIODevice *socket, QByteArray *line);
+    // Wait for the Pong with this sequence number (other lines are skipped)
+    bool waitForPong(QIODevice *socket, int seq);
+    bool writeAll(QIODevice *socket, const QByteArray &data);
+    // Through the deflater once compression is negotiated
+    bool sendFrames(QIODevice *socket, const QByteArray &data);
+
+    const int messages_;
+    const int pings_;
+    QString metrics_host_;
+    quint16 metrics_port_;
+    bool compression_;
+
+    // Текущий прогон
+    std::unique_ptr<StreamCodec::Deflater> deflater_;
+    qint64 plain_bytes_;
+    qint64 wire_bytes_;
+    qint64 deflate_ns_;
+};
+
+#endif // TRANSPORTBENCHMARK_H
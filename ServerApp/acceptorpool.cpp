@@ -0,0 +1,175 @@
+#include "acceptorpool.h"
+
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QThread>
+
+#if defined(Q_OS_LINUX)
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include "servermetrics.h"
+
+// Слушающий сокет одного потока-приемщика
+class AcceptorPool::Acceptor : public QTcpServer
+{
+public:
+    explicit Acceptor(AcceptorPool *pool)
+        : pool_(pool)
+    {
+    }
+
+protected:
+    void incomingConnection(qintptr descriptor) override
+    {
+        pool_->acceptInThread(descriptor);
+    }
+
+private:
+    AcceptorPool *pool_;
+};
+
+AcceptorPool::AcceptorPool(TcpServer *server, int acceptors)
+    : QObject(server),
+      server_(server),
+      size_(qMax(1, acceptors))
+{
+}
+
+AcceptorPool::~AcceptorPool()
+{
+    close();
+}
+
+bool AcceptorPool::isSupported()
+{
+#if defined(Q_OS_LINUX)
+    return true;
+#else
+    return false;
+#endif
+}
+
+int AcceptorPool::size() const
+{
+    return size_;
+}
+
+bool AcceptorPool::listen(quint16 port, QString *error)
+{
+#if defined(Q_OS_LINUX)
+    for (int i = 0; i < size_; ++i) {
+        const int fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            *error = QString("socket: %1").arg(strerror(errno));
+            close();
+            return false;
+        }
+        // Двойной стек, как QTcpServer на QHostAddress::Any; SO_REUSEPORT
+        // на всех сокетах группы, иначе второй bind не пройдет
+        const int off = 0;
+        const int on = 1;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+        sockaddr_in6 address {};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr = in6addr_any;
+        address.sin6_port = htons(port);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+            || ::listen(fd, SOMAXCONN) < 0) {
+            *error = QString("port %1: %2").arg(port).arg(strerror(errno));
+            ::close(fd);
+            close();
+            return false;
+        }
+
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("acceptor-%1").arg(i));
+        Acceptor *acceptor = new Acceptor(this);
+        acceptor->moveToThread(thread);
+        connect(thread, &QThread::finished, acceptor, &QObject::deleteLater);
+        threads_.append(thread);
+        thread->start();
+
+        // Уведомитель сокета должен принадлежать потоку приемщика
+        bool adopted = false;
+        QMetaObject::invokeMethod(acceptor, [acceptor, fd, &adopted]() {
+            adopted = acceptor->setSocketDescriptor(fd);
+        }, Qt::BlockingQueuedConnection);
+        if (!adopted) {
+            *error = QString("acceptor %1: %2").arg(i).arg(acceptor->errorString());
+            ::close(fd);
+            close();
+            return false;
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(port);
+    *error = "SO_REUSEPORT acceptors are only available on Linux";
+    return false;
+#endif
+}
+
+bool AcceptorPool::isListening() const
+{
+    return !threads_.isEmpty();
+}
+
+void AcceptorPool::close()
+{
+    // Приемщики удаляются вместе с завершением своих потоков и закрывают
+    // слушающие сокеты
+    for (QThread *thread : std::as_const(threads_)) {
+        thread->quit();
+        thread->wait();
+        delete thread;
+    }
+    threads_.clear();
+}
+
+void AcceptorPool::closeDescriptor(qintptr descriptor)
+{
+#if defined(Q_OS_LINUX)
+    ::close(int(descriptor));
+#else
+    Q_UNUSED(descriptor);
+#endif
+}
+
+void AcceptorPool::acceptInThread(qintptr descriptor)
+{
+    ClientInfo info;
+
+#if defined(Q_OS_LINUX)
+    if (!server_->cluster_) {
+        sockaddr_in6 peer {};
+        socklen_t length = sizeof(peer);
+        getpeername(int(descriptor), reinterpret_cast<sockaddr*>(&peer), &length);
+        const QHostAddress address(reinterpret_cast<const sockaddr*>(&peer));
+        bool is_ipv4 = false;
+        const quint32 ipv4 = address.toIPv4Address(&is_ipv4);
+
+        info = server_->createClient(is_ipv4 ? QHostAddress(ipv4).toString() : address.toString(),
+                                     ntohs(peer.sin6_port));
+
+        // Новый сокет пуст, короткий ответ целиком помещается в его буфер;
+        // при ошибке соединение закроет поток сервера, увидев ее на чтении
+        const QByteArray reply = TcpServer::encodeMessage(server_->confirmation(info.id));
+        const ssize_t sent = ::send(int(descriptor), reply.constData(), size_t(reply.size()),
+                                    MSG_NOSIGNAL);
+        if (sent > 0) {
+            ServerMetrics::increment(Counter::BytesOut, quint64(sent));
+        }
+    }
+#endif
+
+    emit accepted(descriptor, info);
+}
@@ -0,0 +1,54 @@
+#ifndef ACCEPTORPOOL_H
+#define ACCEPTORPOOL_H
+
+#include <QObject>
+#include <QVector>
+
+#include "tcpserver.h"
+
+class QThread;
+
+// Several listening sockets on one port with SO_REUSEPORT, each accepted
+// in its own thread (Linux), for connect storms on the Qt backend.
+//
+// Ядро само распределяет новые соединения между сокетами, поэтому очередь
+// accept одного потока не переполняется. Поток-приемщик принимает
+// соединение, регистрирует клиента (createClient потокобезопасен) и сам
+// отправляет ConnectionConfirm; в поток сервера передается уже готовый
+// дескриптор, где он оборачивается в QTcpSocket. В кластере подтверждение
+// ждет Hello и выполняется потоком сервера, как обычно.
+class AcceptorPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    AcceptorPool(TcpServer *server, int acceptors);
+    ~AcceptorPool();
+
+    static bool isSupported();
+
+    int size() const;
+    bool listen(quint16 port, QString *error);
+    bool isListening() const;
+    // Stop the accept threads; connections already handed over stay open
+    void close();
+
+    // For a descriptor the server could not take over
+    static void closeDescriptor(qintptr descriptor);
+
+signals:
+    // Accepted in an acceptor thread; info.id is 0 if not confirmed yet
+    void accepted(qintptr descriptor, const ClientInfo &info);
+
+private:
+    class Acceptor;
+
+    // Confirm and register in the calling acceptor thread
+    void acceptInThread(qintptr descriptor);
+
+    TcpServer *server_;
+    const int size_;
+    QVector<QThread*> threads_;
+};
+
+#endif // ACCEPTORPOOL_H
@@ -0,0 +1,163 @@
+#include "builtinsinks.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QLocalSocket>
+
+#include "segmentstore.h"
+#include "servermetrics.h"
+#include "sqlitesink.h"
+
+namespace {
+constexpr int kConnectTimeoutMs = 100;
+constexpr int kWriteTimeoutMs = 1000;
+constexpr int kMaxRetryDelayMs = 5000;
+}  // namespace
+
+QByteArray encodeRecordLine(const ClientData &data)
+{
+    QJsonObject record;
+    record["client_id"] = data.client_id;
+    record["timestamp"] = data.timestamp.toMSecsSinceEpoch();
+    record["type"] = data.data_type;
+    record["data"] = data.content;
+    return QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n';
+}
+
+FileSink::FileSink(const QString &name, const QString &path)
+    : name_(name), file_(path)
+{
+}
+
+QString FileSink::name() const
+{
+    return name_;
+}
+
+bool FileSink::open(QString *error)
+{
+    QDir().mkpath(QFileInfo(file_).absolutePath());
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        *error = QString("cannot open %1: %2").arg(file_.fileName(), file_.errorString());
+        return false;
+    }
+    return true;
+}
+
+void FileSink::writeBatch(const QVector<ClientData> &batch)
+{
+    QByteArray chunk;
+    for (const ClientData &data : batch) {
+        chunk += encodeRecordLine(data);
+    }
+    file_.write(chunk);
+    file_.flush();
+}
+
+void FileSink::close()
+{
+    file_.close();
+}
+
+LocalSocketSink::LocalSocketSink(const QString &name, const QString &server_name)
+    : name_(name), server_name_(server_name), retry_delay_ms_(0)
+{
+}
+
+LocalSocketSink::~LocalSocketSink() = default;
+
+QString LocalSocketSink::name() const
+{
+    return name_;
+}
+
+bool LocalSocketSink::open(QString *error)
+{
+    Q_UNUSED(error);
+
+    // Сокет создается в потоке приемника, где и будет использоваться
+    socket_ = std::make_unique<QLocalSocket>();
+    ensureConnected();
+    return true;
+}
+
+void LocalSocketSink::writeBatch(const QVector<ClientData> &batch)
+{
+    if (!ensureConnected()) {
+        ServerMetrics::increment(Counter::SinkDropped, batch.size());
+        return;
+    }
+
+    QByteArray chunk;
+    for (const ClientData &data : batch) {
+        chunk += encodeRecordLine(data);
+    }
+
+    socket_->write(chunk);
+    while (socket_->bytesToWrite() > 0) {
+        if (!socket_->waitForBytesWritten(kWriteTimeoutMs)) {
+            socket_->abort();
+            break;
+        }
+    }
+}
+
+void LocalSocketSink::close()
+{
+    if (socket_) {
+        socket_->disconnectFromServer();
+        socket_.reset();
+    }
+}
+
+bool LocalSocketSink::ensureConnected()
+{
+    if (socket_->state() == QLocalSocket::ConnectedState) {
+        return true;
+    }
+
+    if (retry_timer_.isValid() && retry_timer_.elapsed() < retry_delay_ms_) {
+        return false;
+    }
+
+    socket_->abort();
+    socket_->connectToServer(server_name_);
+    if (socket_->waitForConnected(kConnectTimeoutMs)) {
+        retry_delay_ms_ = 0;
+        retry_timer_.invalidate();
+        return true;
+    }
+
+    retry_delay_ms_ = qBound(100, retry_delay_ms_ * 2, kMaxRetryDelayMs);
+    retry_timer_.start();
+    return false;
+}
+
+std::unique_ptr<RecordSink> createRecordSink(const QString &spec, const QString &name,
+                                             QString *error)
+{
+    const QString type = spec.section(':', 0, 0);
+    const QString target = spec.section(':', 1);
+
+    if (target.isEmpty()) {
+        *error = QString("sink '%1' has no target").arg(spec);
+        return nullptr;
+    }
+
+    if (type == "file") {
+        return std::make_unique<FileSink>(name, target);
+    }
+    if (type == "sqlite") {
+        return std::make_unique<SqliteSink>(name, target);
+    }
+    if (type == "segments") {
+        return std::make_unique<SegmentFileSink>(name, target);
+    }
+    if (type == "socket") {
+        return std::make_unique<LocalSocketSink>(name, target);
+    }
+
+    *error = QString("unknown sink type '%1'").arg(type);
+    return nullptr;
+}
@@ -0,0 +1,63 @@
+#ifndef BUILTINSINKS_H
+#define BUILTINSINKS_H
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <memory>
+
+#include "recordsink.h"
+
+class QLocalSocket;
+
+// JSON lines file: {"client_id", "timestamp", "type", "data"} per record,
+// flushed after every batch
+class FileSink : public RecordSink
+{
+public:
+    FileSink(const QString &name, const QString &path);
+
+    QString name() const override;
+    bool open(QString *error) override;
+    void writeBatch(const QVector<ClientData> &batch) override;
+    void close() override;
+
+private:
+    QString name_;
+    QFile file_;
+};
+
+// Forwards JSON lines to a QLocalServer (local socket or named pipe).
+//
+// Сокет используется в блокирующем режиме из потока приемника. Пока
+// соединения нет, пачки отбрасываются, а переподключение выполняется с
+// экспоненциально растущей паузой (до 5 с).
+class LocalSocketSink : public RecordSink
+{
+public:
+    LocalSocketSink(const QString &name, const QString &server_name);
+    ~LocalSocketSink();
+
+    QString name() const override;
+    bool open(QString *error) override;
+    void writeBatch(const QVector<ClientData> &batch) override;
+    void close() override;
+
+private:
+    bool ensureConnected();
+
+    QString name_;
+    QString server_name_;
+    std::unique_ptr<QLocalSocket> socket_;
+    QElapsedTimer retry_timer_;
+    int retry_delay_ms_;
+};
+
+// Encodes one record as a JSON line (shared by the text sinks)
+QByteArray encodeRecordLine(const ClientData &data);
+
+// Creates a sink from "file:PATH", "segments:DIR", "sqlite:PATH" or "socket:NAME"
+std::unique_ptr<RecordSink> createRecordSink(const QString &spec, const QString &name,
+                                             QString *error);
+
+#endif // BUILTINSINKS_H
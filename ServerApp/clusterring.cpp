@@ -0,0 +1,120 @@
+#include "clusterring.h"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+
+#include <algorithm>
+
+bool ClusterRing::load(const QString &path, const QString &self_name, QString *error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *error = QString("cannot open %1: %2").arg(path, file.errorString());
+        return false;
+    }
+
+    QVector<Node> nodes;
+    QTextStream in(&file);
+    int line_number = 0;
+    while (!in.atEnd()) {
+        const QString line = in.readLine().section('#', 0, 0).trimmed();
+        ++line_number;
+        if (line.isEmpty()) {
+            continue;
+        }
+
+        const QStringList fields = line.split(QRegularExpression("\\s+"));
+        const QString address = fields.value(1);
+        bool port_ok = false;
+        const quint16 port = address.section(':', -1).toUShort(&port_ok);
+        if (fields.size() != 2 || !address.contains(':') || !port_ok) {
+            *error = QString("%1:%2: expected \"name host:port\"").arg(path).arg(line_number);
+            return false;
+        }
+        for (const Node &node : std::as_const(nodes)) {
+            if (node.name == fields[0]) {
+                *error = QString("%1:%2: duplicate node %3").arg(path).arg(line_number).arg(node.name);
+                return false;
+            }
+        }
+        nodes.append({fields[0], address.section(':', 0, -2), port});
+    }
+
+    int self = -1;
+    for (int i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].name == self_name) {
+            self = i;
+        }
+    }
+    if (self < 0) {
+        *error = QString("node '%1' is not listed in %2").arg(self_name, path);
+        return false;
+    }
+
+    QVector<QPair<quint64, int>> ring;
+    ring.reserve(nodes.size() * kVirtualNodes);
+    for (int i = 0; i < nodes.size(); ++i) {
+        for (int v = 0; v < kVirtualNodes; ++v) {
+            ring.append(qMakePair(hash(QString("%1#%2").arg(nodes[i].name).arg(v).toUtf8()), i));
+        }
+    }
+    std::sort(ring.begin(), ring.end());
+
+    nodes_ = nodes;
+    ring_ = ring;
+    self_ = self;
+    return true;
+}
+
+bool ClusterRing::isEmpty() const
+{
+    return nodes_.isEmpty();
+}
+
+const QVector<ClusterRing::Node> &ClusterRing::nodes() const
+{
+    return nodes_;
+}
+
+const ClusterRing::Node &ClusterRing::self() const
+{
+    return nodes_[self_];
+}
+
+const ClusterRing::Node &ClusterRing::owner(const QString &device_id) const
+{
+    return nodes_[ownerIndex(device_id)];
+}
+
+bool ClusterRing::isLocal(const QString &device_id) const
+{
+    return ownerIndex(device_id) == self_;
+}
+
+int ClusterRing::ownerIndex(const QString &device_id) const
+{
+    const quint64 point = hash(device_id.toUtf8());
+    auto it = std::lower_bound(ring_.cbegin(), ring_.cend(), qMakePair(point, 0));
+    if (it == ring_.cend()) {
+        it = ring_.cbegin();    // Кольцо замыкается
+    }
+    return it->second;
+}
+
+quint64 ClusterRing::hash(const QByteArray &key)
+{
+    // FNV-1a и финальное перемешивание splitmix64: у коротких ключей
+    // вида "node#12" биты FNV распределены неравномерно
+    quint64 h = 14695981039346656037ULL;
+    for (char c : key) {
+        h ^= static_cast<uchar>(c);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
@@ -0,0 +1,55 @@
+#ifndef CLUSTERRING_H
+#define CLUSTERRING_H
+
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Static cluster membership with consistent-hash placement of devices.
+//
+// Файл конфигурации — по узлу на строку, "имя хост:порт"; пустые строки и
+// строки с '#' пропускаются:
+//
+//   # name  address
+//   node-a  127.0.0.1:12345
+//   node-b  127.0.0.1:12346
+//
+// Каждый узел занимает kVirtualNodes точек на кольце (хеш "имя#i"), а
+// устройство принадлежит первой точке по часовой стрелке от хеша его
+// идентификатора. Точки зависят только от имени узла, поэтому при
+// добавлении N-го узла переезжает примерно 1/N устройств, а одинаковый
+// файл на всех узлах дает одинаковое размещение.
+class ClusterRing
+{
+public:
+    struct Node {
+        QString name;
+        QString host;
+        quint16 port;
+    };
+
+    // Load membership and select the local node by name
+    bool load(const QString &path, const QString &self_name, QString *error);
+
+    bool isEmpty() const;
+    const QVector<Node> &nodes() const;
+    const Node &self() const;
+
+    // Node that owns the device
+    const Node &owner(const QString &device_id) const;
+    bool isLocal(const QString &device_id) const;
+
+    // Стабильный между процессами хеш (qHash рандомизирован)
+    static quint64 hash(const QByteArray &key);
+
+private:
+    int ownerIndex(const QString &device_id) const;
+
+    static constexpr int kVirtualNodes = 160;
+
+    QVector<Node> nodes_;
+    QVector<QPair<quint64, int>> ring_;     // Точка кольца -> индекс узла
+    int self_ = -1;
+};
+
+#endif // CLUSTERRING_H
@@ -0,0 +1,122 @@
+#ifndef DELTACODEC_H
+#define DELTACODEC_H
+
+#include <QJsonObject>
+#include <QtGlobal>
+
+#include <cmath>
+
+// Delta encoding of periodic device samples (NetworkMetrics, DeviceStatus).
+//
+// Формат общий для ServerApp и ClientApp (ClientApp подключает этот
+// заголовок напрямую). Сервер объявляет поддержку полем "delta" в
+// ConnectionConfirm. Устройство, включившее режим, вместо полного кадра
+// шлет {"_":"N","b":-120,"p":3}: тег типа и только изменившиеся поля, как
+// разность квантованных значений с прошлым отправленным образцом того же
+// типа. TCP доставляет кадры соединения по порядку и без потерь, поэтому
+// отправленный образец уже «подтвержден»: обе стороны начинают с нулей при
+// каждом подключении и держат одинаковые квантованные значения, ошибка
+// округления не накапливается. Сервер восстанавливает полный кадр до
+// журнала и конвейера. Прочие кадры (Log, Ping) идут как есть.
+namespace DeltaCodec {
+// QJsonObject пишет ключи по порядку, "_" раньше любого ключа поля
+constexpr char kPrefix[] = "{\"_\":";
+constexpr int kFieldCount = 3;
+
+struct Field {
+    const char *name;
+    const char *key;    // Короткий ключ в кадре разностей
+    double scale;       // Квант 1/scale
+};
+
+struct Schema {
+    const char *type;
+    const char *tag;
+    Field fields[kFieldCount];
+};
+
+constexpr int kSchemaCount = 2;
+constexpr Schema kSchemas[kSchemaCount] = {
+    {"NetworkMetrics", "N", {{"bandwidth", "b", 100}, {"latency", "l", 100},
+                             {"packet_loss", "p", 100}}},
+    {"DeviceStatus", "S", {{"uptime", "u", 1}, {"cpu_usage", "c", 1},
+                           {"memory_usage", "m", 1}}},
+};
+
+// Последние квантованные значения одной стороны соединения
+class State
+{
+protected:
+    qint64 values_[kSchemaCount][kFieldCount] = {};
+};
+
+// Device side
+class Encoder : public State
+{
+public:
+    // Delta frame for a sample; empty if the sample is not delta-encoded
+    QJsonObject encode(const QJsonObject &sample)
+    {
+        const QString type = sample["type"].toString();
+        for (int s = 0; s < kSchemaCount; ++s) {
+            const Schema &schema = kSchemas[s];
+            if (type != QLatin1String(schema.type)) {
+                continue;
+            }
+            // Поля вне схемы потерялись бы: такой кадр идет целиком
+            if (sample.size() != kFieldCount + 1) {
+                return QJsonObject();
+            }
+            qint64 quantized[kFieldCount];
+            for (int f = 0; f < kFieldCount; ++f) {
+                const QJsonValue value = sample[QLatin1String(schema.fields[f].name)];
+                if (!value.isDouble()) {
+                    return QJsonObject();
+                }
+                quantized[f] = std::llround(value.toDouble() * schema.fields[f].scale);
+            }
+
+            QJsonObject delta;
+            delta["_"] = QLatin1String(schema.tag);
+            for (int f = 0; f < kFieldCount; ++f) {
+                if (quantized[f] != values_[s][f]) {
+                    delta[QLatin1String(schema.fields[f].key)] = quantized[f] - values_[s][f];
+                    values_[s][f] = quantized[f];
+                }
+            }
+            return delta;
+        }
+        return QJsonObject();
+    }
+};
+
+// Server side, one per client
+class Decoder : public State
+{
+public:
+    // Full sample of a delta frame; empty on an unknown tag
+    QJsonObject decode(const QJsonObject &delta)
+    {
+        const QString tag = delta["_"].toString();
+        for (int s = 0; s < kSchemaCount; ++s) {
+            const Schema &schema = kSchemas[s];
+            if (tag != QLatin1String(schema.tag)) {
+                continue;
+            }
+            QJsonObject sample;
+            sample["type"] = QLatin1String(schema.type);
+            for (int f = 0; f < kFieldCount; ++f) {
+                const Field &field = schema.fields[f];
+                values_[s][f] += delta[QLatin1String(field.key)].toInteger();
+                sample[QLatin1String(field.name)] = field.scale == 1
+                    ? QJsonValue(values_[s][f])
+                    : QJsonValue(values_[s][f] / field.scale);
+            }
+            return sample;
+        }
+        return QJsonObject();
+    }
+};
+}  // namespace DeltaCodec
+
+#endif // DELTACODEC_H
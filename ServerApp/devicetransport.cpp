@@ -0,0 +1,372 @@
+#include "devicetransport.h"
+
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+DeviceTransport *DeviceTransport::of(QIODevice *connection)
+{
+    return qobject_cast<DeviceTransport*>(connection->parent());
+}
+
+TcpTransport::TcpTransport(QObject *parent)
+    : DeviceTransport(parent),
+      server_(new QTcpServer(this))
+{
+    connect(server_, &QTcpServer::newConnection,
+            this, &TcpTransport::onNewConnection);
+}
+
+bool TcpTransport::listen(quint16 port)
+{
+    return server_->listen(QHostAddress::Any, port);
+}
+
+QString TcpTransport::name() const
+{
+    return "tcp";
+}
+
+bool TcpTransport::isListening() const
+{
+    return server_->isListening();
+}
+
+void TcpTransport::close()
+{
+    server_->close();
+}
+
+QString TcpTransport::errorString() const
+{
+    return server_->errorString();
+}
+
+QString TcpTransport::peerAddress(QIODevice *connection) const
+{
+    return static_cast<QTcpSocket*>(connection)->peerAddress().toString();
+}
+
+quint16 TcpTransport::peerPort(QIODevice *connection) const
+{
+    return static_cast<QTcpSocket*>(connection)->peerPort();
+}
+
+bool TcpTransport::isConnected(QIODevice *connection) const
+{
+    return static_cast<QTcpSocket*>(connection)->state() == QAbstractSocket::ConnectedState;
+}
+
+void TcpTransport::disconnectConnection(QIODevice *connection)
+{
+    static_cast<QTcpSocket*>(connection)->disconnectFromHost();
+}
+
+void TcpTransport::abortConnection(QIODevice *connection)
+{
+    static_cast<QTcpSocket*>(connection)->abort();
+}
+
+void TcpTransport::onNewConnection()
+{
+    while (server_->hasPendingConnections()) {
+        QTcpSocket *socket = server_->nextPendingConnection();
+        watchSocket(socket);
+        emit newConnection(socket);
+    }
+}
+
+QIODevice *TcpTransport::adoptConnection(qintptr descriptor)
+{
+    QTcpSocket *socket = new QTcpSocket();
+    if (!socket->setSocketDescriptor(descriptor)) {
+        delete socket;
+        return nullptr;
+    }
+    watchSocket(socket);
+    return socket;
+}
+
+void TcpTransport::watchSocket(QTcpSocket *socket)
+{
+    socket->setParent(this);
+
+    connect(socket, &QTcpSocket::disconnected, this, [this, socket] {
+        emit connectionClosed(socket);
+    });
+    connect(socket, &QTcpSocket::errorOccurred, this, [this, socket] {
+        emit connectionError(socket, socket->errorString());
+    });
+}
+
+LocalTransport::LocalTransport(QObject *parent)
+    : DeviceTransport(parent),
+      server_(new QLocalServer(this))
+{
+    connect(server_, &QLocalServer::newConnection,
+            this, &LocalTransport::onNewConnection);
+}
+
+bool LocalTransport::listen(const QString &name)
+{
+    // Имя мог оставить процесс, завершившийся аварийно
+    QLocalServer::removeServer(name);
+    return server_->listen(name);
+}
+
+QString LocalTransport::fullServerName() const
+{
+    return server_->fullServerName();
+}
+
+QString LocalTransport::name() const
+{
+    return "local";
+}
+
+bool LocalTransport::isListening() const
+{
+    return server_->isListening();
+}
+
+void LocalTransport::close()
+{
+    server_->close();
+}
+
+QString LocalTransport::errorString() const
+{
+    return server_->errorString();
+}
+
+QString LocalTransport::peerAddress(QIODevice *connection) const
+{
+    Q_UNUSED(connection);
+    // У локального сокета нет адреса собеседника
+    return "local:" + server_->serverName();
+}
+
+quint16 LocalTransport::peerPort(QIODevice *connection) const
+{
+    Q_UNUSED(connection);
+    return 0;
+}
+
+bool LocalTransport::isConnected(QIODevice *connection) const
+{
+    return static_cast<QLocalSocket*>(connection)->state() == QLocalSocket::ConnectedState;
+}
+
+void LocalTransport::disconnectConnection(QIODevice *connection)
+{
+    static_cast<QLocalSocket*>(connection)->disconnectFromServer();
+}
+
+void LocalTransport::abortConnection(QIODevice *connection)
+{
+    static_cast<QLocalSocket*>(connection)->abort();
+}
+
+void LocalTransport::onNewConnection()
+{
+    while (server_->hasPendingConnections()) {
+        QLocalSocket *socket = server_->nextPendingConnection();
+        socket->setParent(this);
+
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket] {
+            emit connectionClosed(socket);
+        });
+        connect(socket, &QLocalSocket::errorOccurred, this, [this, socket] {
+            emit connectionError(socket, socket->errorString());
+        });
+        emit newConnection(socket);
+    }
+}
+
+ShmConnection::ShmConnection(QLocalSocket *control, const QString &key, QObject *parent)
+    : QIODevice(parent),
+      control_(control),
+      memory_(key),
+      notify_queued_(false)
+{
+    control_->setParent(this);
+    connect(control_, &QLocalSocket::readyRead,
+            this, &ShmConnection::onDoorbell);
+}
+
+bool ShmConnection::create(quint32 capacity, QString *error)
+{
+    if (!memory_.create(qint64(ShmRing::segmentSize(capacity)))) {
+        *error = QString("cannot create ring %1: %2").arg(memory_.key(), memory_.errorString());
+        return false;
+    }
+    ShmRing::initialize(memory_.data(), capacity);
+    ring_.attach(memory_.data());
+    open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+
+    // Первая строка управляющего сокета — где лежит кольцо
+    QJsonObject ring;
+    ring["type"] = "ShmRing";
+    ring["key"] = memory_.key();
+    ring["capacity"] = static_cast<qint64>(capacity);
+    control_->write(QJsonDocument(ring).toJson(QJsonDocument::Compact) + '\n');
+    return true;
+}
+
+QLocalSocket *ShmConnection::control() const
+{
+    return control_;
+}
+
+bool ShmConnection::isSequential() const
+{
+    return true;
+}
+
+qint64 ShmConnection::bytesAvailable() const
+{
+    return qint64(ring_.available()) + QIODevice::bytesAvailable();
+}
+
+qint64 ShmConnection::bytesToWrite() const
+{
+    return control_->bytesToWrite();
+}
+
+qint64 ShmConnection::readData(char *data, qint64 max_length)
+{
+    const qint64 count = qint64(ring_.read(data, quint64(max_length)));
+    // Читатель не обязан читать до нуля (TcpServer берет ровно
+    // bytesAvailable()), поэтому звонок заказывается, как только кольцо
+    // опустело. Если в кольце что-то осталось или пришло, пока выставлялся
+    // флаг, звонка не будет — readyRead ставится в очередь здесь
+    if ((ring_.available() > 0 || !ring_.prepareWait()) && !notify_queued_) {
+        notify_queued_ = true;
+        QMetaObject::invokeMethod(this, &ShmConnection::notifyPending, Qt::QueuedConnection);
+    }
+    return count;
+}
+
+qint64 ShmConnection::writeData(const char *data, qint64 length)
+{
+    // Ответы сервера редкие (подтверждение, команды): через сокет
+    return control_->write(data, length);
+}
+
+void ShmConnection::notifyPending()
+{
+    notify_queued_ = false;
+    if (ring_.available() > 0) {
+        emit readyRead();
+    }
+}
+
+void ShmConnection::onDoorbell()
+{
+    // Содержимое не важно: любой байт от устройства — звонок
+    control_->readAll();
+    if (ring_.available() > 0) {
+        emit readyRead();
+    }
+}
+
+ShmTransport::ShmTransport(quint32 ring_capacity, QObject *parent)
+    : DeviceTransport(parent),
+      server_(new QLocalServer(this)),
+      ring_capacity_(ring_capacity),
+      next_ring_(1)
+{
+    connect(server_, &QLocalServer::newConnection,
+            this, &ShmTransport::onNewConnection);
+}
+
+bool ShmTransport::listen(const QString &name)
+{
+    QLocalServer::removeServer(name);
+    return server_->listen(name);
+}
+
+QString ShmTransport::fullServerName() const
+{
+    return server_->fullServerName();
+}
+
+QString ShmTransport::name() const
+{
+    return "shm";
+}
+
+bool ShmTransport::isListening() const
+{
+    return server_->isListening();
+}
+
+void ShmTransport::close()
+{
+    server_->close();
+}
+
+QString ShmTransport::errorString() const
+{
+    return server_->errorString();
+}
+
+QString ShmTransport::peerAddress(QIODevice *connection) const
+{
+    Q_UNUSED(connection);
+    return "shm:" + server_->serverName();
+}
+
+quint16 ShmTransport::peerPort(QIODevice *connection) const
+{
+    Q_UNUSED(connection);
+    return 0;
+}
+
+bool ShmTransport::isConnected(QIODevice *connection) const
+{
+    return static_cast<ShmConnection*>(connection)->control()->state()
+           == QLocalSocket::ConnectedState;
+}
+
+void ShmTransport::disconnectConnection(QIODevice *connection)
+{
+    static_cast<ShmConnection*>(connection)->control()->disconnectFromServer();
+}
+
+void ShmTransport::abortConnection(QIODevice *connection)
+{
+    static_cast<ShmConnection*>(connection)->control()->abort();
+}
+
+void ShmTransport::onNewConnection()
+{
+    while (server_->hasPendingConnections()) {
+        QLocalSocket *socket = server_->nextPendingConnection();
+
+        // Ключ уникален в пределах процесса сервера
+        const QString key = QString("%1-%2-%3").arg(server_->serverName())
+                                .arg(QCoreApplication::applicationPid())
+                                .arg(next_ring_++);
+        ShmConnection *connection = new ShmConnection(socket, key, this);
+        QString error;
+        if (!connection->create(ring_capacity_, &error)) {
+            emit connectionError(connection, error);
+            socket->abort();
+            connection->deleteLater();
+            continue;
+        }
+
+        connect(socket, &QLocalSocket::disconnected, this, [this, connection] {
+            emit connectionClosed(connection);
+        });
+        connect(socket, &QLocalSocket::errorOccurred, this, [this, connection, socket] {
+            emit connectionError(connection, socket->errorString());
+        });
+        emit newConnection(connection);
+    }
+}
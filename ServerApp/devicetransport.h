@@ -0,0 +1,179 @@
+#ifndef DEVICETRANSPORT_H
+#define DEVICETRANSPORT_H
+
+#include <QIODevice>
+#include <QObject>
+#include <QSharedMemory>
+
+#include "shmring.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QTcpServer;
+class QTcpSocket;
+
+// Listener of device connections.
+//
+// Протокол (строки JSON, разделенные '\n') одинаков для всех транспортов:
+// TcpServer читает и пишет соединения как QIODevice, а то, что зависит от
+// транспорта (адрес собеседника, закрытие), делегирует его слушателю.
+// Соединения принадлежат своему слушателю (parent).
+class DeviceTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+    // Transport that accepted the connection
+    static DeviceTransport *of(QIODevice *connection);
+
+    virtual QString name() const = 0;
+    virtual bool isListening() const = 0;
+    virtual void close() = 0;
+    virtual QString errorString() const = 0;
+
+    // Адрес собеседника для ClientInfo и размещения в кластере
+    virtual QString peerAddress(QIODevice *connection) const = 0;
+    virtual quint16 peerPort(QIODevice *connection) const = 0;
+
+    virtual bool isConnected(QIODevice *connection) const = 0;
+    // Закрыть после отправки буфера
+    virtual void disconnectConnection(QIODevice *connection) = 0;
+    // Закрыть немедленно, без отправки буфера
+    virtual void abortConnection(QIODevice *connection) = 0;
+
+signals:
+    void newConnection(QIODevice *connection);
+    void connectionClosed(QIODevice *connection);
+    void connectionError(QIODevice *connection, const QString &message);
+};
+
+// TCP listener (devices on the network)
+class TcpTransport : public DeviceTransport
+{
+    Q_OBJECT
+
+public:
+    explicit TcpTransport(QObject *parent = nullptr);
+
+    bool listen(quint16 port);
+    // Connection accepted elsewhere (see acceptorpool.h); newConnection is
+    // not emitted, nullptr if the descriptor is unusable
+    QIODevice *adoptConnection(qintptr descriptor);
+
+    QString name() const override;
+    bool isListening() const override;
+    void close() override;
+    QString errorString() const override;
+    QString peerAddress(QIODevice *connection) const override;
+    quint16 peerPort(QIODevice *connection) const override;
+    bool isConnected(QIODevice *connection) const override;
+    void disconnectConnection(QIODevice *connection) override;
+    void abortConnection(QIODevice *connection) override;
+
+private slots:
+    void onNewConnection();
+
+private:
+    void watchSocket(QTcpSocket *socket);
+
+    QTcpServer *server_;
+};
+
+// Unix domain socket / named pipe listener for emulators and agents on
+// the server host: no TCP/IP stack on the path
+class LocalTransport : public DeviceTransport
+{
+    Q_OBJECT
+
+public:
+    explicit LocalTransport(QObject *parent = nullptr);
+
+    bool listen(const QString &name);
+    QString fullServerName() const;
+
+    QString name() const override;
+    bool isListening() const override;
+    void close() override;
+    QString errorString() const override;
+    QString peerAddress(QIODevice *connection) const override;
+    quint16 peerPort(QIODevice *connection) const override;
+    bool isConnected(QIODevice *connection) const override;
+    void disconnectConnection(QIODevice *connection) override;
+    void abortConnection(QIODevice *connection) override;
+
+private slots:
+    void onNewConnection();
+
+private:
+    QLocalServer *server_;
+};
+
+// Connection whose device-to-server stream goes through a shared-memory
+// ring (see shmring.h); replies and wake-ups use the control local socket
+class ShmConnection : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    ShmConnection(QLocalSocket *control, const QString &key, QObject *parent = nullptr);
+
+    // Create the segment and send its key to the device
+    bool create(quint32 capacity, QString *error);
+
+    QLocalSocket *control() const;
+
+    bool isSequential() const override;
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+
+protected:
+    qint64 readData(char *data, qint64 max_length) override;
+    qint64 writeData(const char *data, qint64 length) override;
+
+private slots:
+    void onDoorbell();
+    void notifyPending();
+
+private:
+    QLocalSocket *control_;
+    QSharedMemory memory_;
+    mutable ShmRing::Consumer ring_;
+    bool notify_queued_;    // notifyPending() уже в очереди
+};
+
+// Shared-memory ring listener for same-host emulators: the device writes
+// frames straight into memory the server parses from, bypassing the
+// kernel network stack. Подключение начинается через локальный сокет
+// NAME, по нему же идут ответы сервера и «звонки»
+class ShmTransport : public DeviceTransport
+{
+    Q_OBJECT
+
+public:
+    explicit ShmTransport(quint32 ring_capacity, QObject *parent = nullptr);
+
+    bool listen(const QString &name);
+    QString fullServerName() const;
+
+    QString name() const override;
+    bool isListening() const override;
+    void close() override;
+    QString errorString() const override;
+    QString peerAddress(QIODevice *connection) const override;
+    quint16 peerPort(QIODevice *connection) const override;
+    bool isConnected(QIODevice *connection) const override;
+    void disconnectConnection(QIODevice *connection) override;
+    void abortConnection(QIODevice *connection) override;
+
+private slots:
+    void onNewConnection();
+
+private:
+    QLocalServer *server_;
+    const quint32 ring_capacity_;
+    quint64 next_ring_;
+};
+
+#endif // DEVICETRANSPORT_H
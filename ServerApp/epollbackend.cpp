@@ -0,0 +1,294 @@
+#include "epollbackend.h"
+
+#include <QSocketNotifier>
+
+#if defined(Q_OS_LINUX)
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+#include "servermetrics.h"
+#include "tcpserver.h"
+
+namespace {
+constexpr int kReadBufferSize = 64 * 1024;
+constexpr int kEventsPerWait = 256;
+}  // namespace
+
+EpollBackend::EpollBackend(TcpServer *server)
+    : NativeBackend(server),
+      epoll_fd_(-1),
+      listen_fd_(-1),
+      notifier_(nullptr)
+{
+}
+
+EpollBackend::~EpollBackend()
+{
+    close();
+}
+
+QString EpollBackend::name() const
+{
+    return "epoll";
+}
+
+#if defined(Q_OS_LINUX)
+
+bool EpollBackend::isSupported()
+{
+    return true;
+}
+
+bool EpollBackend::listen(quint16 port, QString *error)
+{
+    listen_fd_ = openListener(port, error);
+    if (listen_fd_ < 0) {
+        return false;
+    }
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event {};
+    event.events = EPOLLIN | EPOLLET;
+    event.data.fd = listen_fd_;
+    if (epoll_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) < 0) {
+        *error = QString("epoll: %1").arg(strerror(errno));
+        close();
+        return false;
+    }
+
+    read_buffer_.resize(kReadBufferSize);
+
+    // Дескриптор epoll читаем, пока в нем есть события: один notifier
+    // на все соединения
+    notifier_ = new QSocketNotifier(epoll_fd_, QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated,
+            this, &EpollBackend::onActivated);
+    return true;
+}
+
+bool EpollBackend::isListening() const
+{
+    return listen_fd_ >= 0;
+}
+
+void EpollBackend::close()
+{
+    delete notifier_;
+    notifier_ = nullptr;
+
+    for (auto it = connections_.cbegin(); it != connections_.cend(); ++it) {
+        ::close(it.key());
+    }
+    forgetAll();
+
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    read_buffer_.clear();
+    read_buffer_.squeeze();
+}
+
+void EpollBackend::onActivated()
+{
+    epoll_event events[kEventsPerWait];
+    const int count = epoll_wait(epoll_fd_, events, kEventsPerWait, 0);
+    ServerMetrics::increment(Counter::IngestSyscalls);
+
+    for (int i = 0; i < count; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == listen_fd_) {
+            acceptConnections();
+            continue;
+        }
+        // Соединение могло закрыться раньше в этой же пачке
+        if (!connections_.contains(fd)) {
+            continue;
+        }
+
+        // Edge-triggered: каждое событие дочитывается/дописывается до EAGAIN
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            readConnection(fd);
+        }
+        if ((events[i].events & EPOLLOUT) && connections_.contains(fd)) {
+            flushConnection(fd);
+        }
+    }
+}
+
+void EpollBackend::acceptConnections()
+{
+    for (;;) {
+        sockaddr_in6 peer {};
+        socklen_t length = sizeof(peer);
+        const int fd = accept4(listen_fd_, reinterpret_cast<sockaddr*>(&peer), &length,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+        ServerMetrics::increment(Counter::IngestSyscalls);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                emit server_->logMessage(QString("Accept failed: %1").arg(strerror(errno)));
+            }
+            return;
+        }
+
+        epoll_event event {};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = fd;
+        ServerMetrics::increment(Counter::IngestSyscalls);
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            continue;
+        }
+
+        accepted(fd, peer.sin6_addr.s6_addr, ntohs(peer.sin6_port));
+    }
+}
+
+void EpollBackend::readConnection(int fd)
+{
+    for (;;) {
+        const ssize_t received = ::recv(fd, read_buffer_.data(), size_t(read_buffer_.size()), 0);
+        ServerMetrics::increment(Counter::IngestSyscalls);
+        if (received > 0) {
+            ServerMetrics::increment(Counter::BytesIn, quint64(received));
+            if (!handleFrames(fd, read_buffer_.constData(), received)) {
+                return;
+            }
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        // 0 — собеседник закрыл соединение, иначе ошибка
+        closeConnection(fd);
+        return;
+    }
+}
+
+void EpollBackend::flushConnection(int fd)
+{
+    auto connection = connections_.find(fd);
+    while (!connection->outbound.isEmpty()) {
+        const ssize_t sent = ::send(fd, connection->outbound.constData(),
+                                    size_t(connection->outbound.size()), MSG_NOSIGNAL);
+        ServerMetrics::increment(Counter::IngestSyscalls);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;     // Дождемся следующего EPOLLOUT
+            }
+            closeConnection(fd);
+            return;
+        }
+        ServerMetrics::increment(Counter::BytesOut, quint64(sent));
+        connection->outbound.remove(0, int(sent));
+    }
+
+    connection->outbound.squeeze();
+    if (connection->closing) {
+        closeConnection(fd);
+    }
+}
+
+bool EpollBackend::writeTo(int fd, const QByteArray &data)
+{
+    auto connection = connections_.find(fd);
+    if (connection == connections_.end()) {
+        return false;
+    }
+    if (!connection->outbound.isEmpty()) {
+        // Порядок сохраняется: новые данные за неотправленным хвостом
+        connection->outbound.append(data);
+        return true;
+    }
+
+    ssize_t sent = ::send(fd, data.constData(), size_t(data.size()), MSG_NOSIGNAL);
+    ServerMetrics::increment(Counter::IngestSyscalls);
+    if (sent < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            closeConnection(fd);
+            return false;
+        }
+        sent = 0;
+    }
+    ServerMetrics::increment(Counter::BytesOut, quint64(sent));
+    if (sent < data.size()) {
+        connection->outbound = data.mid(int(sent));
+        return true;
+    }
+    if (connection->closing) {
+        closeConnection(fd);
+        return false;
+    }
+    return true;
+}
+
+void EpollBackend::closeConnection(int fd)
+{
+    if (!connections_.contains(fd)) {
+        return;
+    }
+    // close() сам убирает дескриптор из набора epoll
+    ::close(fd);
+    ServerMetrics::increment(Counter::IngestSyscalls);
+    forgetConnection(fd);
+}
+
+#else
+
+bool EpollBackend::isSupported()
+{
+    return false;
+}
+
+bool EpollBackend::listen(quint16 port, QString *error)
+{
+    Q_UNUSED(port);
+    *error = "epoll is only available on Linux";
+    return false;
+}
+
+bool EpollBackend::isListening() const
+{
+    return false;
+}
+
+void EpollBackend::close()
+{
+}
+
+bool EpollBackend::writeTo(int fd, const QByteArray &data)
+{
+    Q_UNUSED(fd);
+    Q_UNUSED(data);
+    return false;
+}
+
+void EpollBackend::closeConnection(int fd)
+{
+    Q_UNUSED(fd);
+}
+
+void EpollBackend::onActivated()
+{
+}
+
+#endif
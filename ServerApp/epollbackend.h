@@ -0,0 +1,46 @@
+#ifndef EPOLLBACKEND_H
+#define EPOLLBACKEND_H
+
+#include "nativebackend.h"
+
+class QSocketNotifier;
+
+// Device listener on edge-triggered epoll (Linux).
+//
+// Чтение идет в один общий буфер бэкенда, поэтому у простаивающего
+// соединения своих буферов нет вовсе. epoll встроен в цикл событий потока
+// сервера через один QSocketNotifier.
+class EpollBackend : public NativeBackend
+{
+    Q_OBJECT
+
+public:
+    explicit EpollBackend(TcpServer *server);
+    ~EpollBackend();
+
+    static bool isSupported();
+
+    QString name() const override;
+    bool listen(quint16 port, QString *error) override;
+    bool isListening() const override;
+    void close() override;
+
+protected:
+    bool writeTo(int fd, const QByteArray &data) override;
+    void closeConnection(int fd) override;
+
+private slots:
+    void onActivated();
+
+private:
+    void acceptConnections();
+    void readConnection(int fd);
+    void flushConnection(int fd);
+
+    int epoll_fd_;
+    int listen_fd_;
+    QSocketNotifier *notifier_;
+    QByteArray read_buffer_;                 // Общий для всех соединений
+};
+
+#endif // EPOLLBACKEND_H
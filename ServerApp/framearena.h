@@ -0,0 +1,158 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <QByteArray>
+
+#include <atomic>
+#include <cstring>
+#include <new>
+
+// Arena for frames handed from the network stage to the parse stage.
+//
+// Поток приема копирует кадры подряд в блоки по kBlockSize байт вместо
+// отдельного QByteArray на каждый кадр. Кадр держит ссылку на свой блок;
+// блок освобождается целиком, когда арена перешла к следующему блоку и
+// разобран последний его кадр, — одно выделение и одно освобождение на
+// пачку кадров. Кадр больше блока получает собственный блок.
+// Копирует в арену один поток, освобождать кадры может любой.
+class FrameRef
+{
+public:
+    FrameRef() = default;
+    FrameRef(FrameRef &&other) noexcept
+        : block_(other.block_), data_(other.data_), size_(other.size_)
+    {
+        other.block_ = nullptr;
+        other.size_ = 0;
+    }
+    FrameRef &operator=(FrameRef &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            block_ = other.block_;
+            data_ = other.data_;
+            size_ = other.size_;
+            other.block_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+    FrameRef(const FrameRef &) = delete;
+    FrameRef &operator=(const FrameRef &) = delete;
+
+    ~FrameRef()
+    {
+        reset();
+    }
+
+    // Frame bytes without a copy, valid while this reference is held
+    QByteArray view() const
+    {
+        return QByteArray::fromRawData(data_, size_);
+    }
+
+    qsizetype size() const
+    {
+        return size_;
+    }
+
+    void reset()
+    {
+        if (block_) {
+            release(block_);
+            block_ = nullptr;
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+private:
+    friend class FrameArena;
+
+    struct Block {
+        std::atomic<int> refs;
+        qsizetype capacity;
+
+        char *bytes() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    FrameRef(Block *block, const char *data, qsizetype size)
+        : block_(block), data_(data), size_(size)
+    {
+        block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void release(Block *block)
+    {
+        if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            block->~Block();
+            ::operator delete(block);
+        }
+    }
+
+    Block *block_ = nullptr;
+    const char *data_ = nullptr;
+    qsizetype size_ = 0;
+};
+
+class FrameArena
+{
+public:
+    static constexpr qsizetype kBlockSize = 64 * 1024;
+
+    FrameArena() = default;
+
+    ~FrameArena()
+    {
+        retire();
+    }
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // Copy of a frame; *allocated is set when it took a new block
+    FrameRef copy(const char *data, qsizetype size, bool *allocated = nullptr)
+    {
+        if (allocated) {
+            *allocated = false;
+        }
+        if (!current_ || current_->capacity - used_ < size) {
+            retire();
+            current_ = allocate(qMax(size, kBlockSize));
+            if (allocated) {
+                *allocated = true;
+            }
+        }
+        char *target = current_->bytes() + used_;
+        std::memcpy(target, data, size_t(size));
+        used_ += size;
+        return FrameRef(current_, target, size);
+    }
+
+private:
+    using Block = FrameRef::Block;
+
+    static Block *allocate(qsizetype capacity)
+    {
+        // Ссылка самой арены снимается в retire()
+        void *memory = ::operator new(sizeof(Block) + size_t(capacity));
+        Block *block = new (memory) Block;
+        block->refs.store(1, std::memory_order_relaxed);
+        block->capacity = capacity;
+        return block;
+    }
+
+    void retire()
+    {
+        if (current_) {
+            FrameRef::release(current_);
+            current_ = nullptr;
+        }
+        used_ = 0;
+    }
+
+    Block *current_ = nullptr;
+    qsizetype used_ = 0;
+};
+
+#endif // FRAMEARENA_H
@@ -0,0 +1,204 @@
+#ifndef FRAMEBUILDER_H
+#define FRAMEBUILDER_H
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QStringView>
+#include <QtGlobal>
+
+#include <charconv>
+#include <cmath>
+
+// Serializer of outbound frames: compact JSON followed by the delimiter.
+//
+// Общий для ServerApp и ClientApp (ClientApp подключает этот заголовок
+// напрямую). В отличие от QJsonDocument::toJson() и последующего
+// append('\n'), кадр пишется сразу в буфер построителя, включая
+// разделитель. Результат разделяет буфер (QByteArray считает ссылки):
+// один кадр без копий уходит в любое число сокетов, а построитель
+// переиспользует буфер, как только все копии отпущены. QTcpSocket
+// копирует данные в свой буфер записи сразу, поэтому в установившемся
+// режиме буфер один и новых выделений на кадр нет. Вывод совместим с
+// QJsonDocument::fromJson(); порядок ключей — как в QJsonObject.
+class FrameBuilder
+{
+public:
+    explicit FrameBuilder(char delimiter = '\n')
+        : delimiter_(delimiter)
+    {
+    }
+
+    QByteArray build(const QJsonObject &message)
+    {
+        // Буфер еще у сокета или в очереди отправки: берем новый того же
+        // размера, старый освободит последний владелец
+        if (!buffer_.isDetached()) {
+            QByteArray fresh;
+            fresh.reserve(qMax<qsizetype>(buffer_.capacity(), kInitialCapacity));
+            buffer_.swap(fresh);
+        }
+        buffer_.resize(0);
+        writeObject(message);
+        buffer_.append(delimiter_);
+        return buffer_;
+    }
+
+private:
+    static constexpr qsizetype kInitialCapacity = 256;
+
+    void writeObject(const QJsonObject &object)
+    {
+        buffer_.append('{');
+        bool first = true;
+        for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+            if (!first) {
+                buffer_.append(',');
+            }
+            first = false;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 10, 0)
+            // Ключ без временной QString
+            it.keyView().visit([this](auto key) { writeString(key); });
+#else
+            writeString(QStringView(it.key()));
+#endif
+            buffer_.append(':');
+            writeValue(it.value());
+        }
+        buffer_.append('}');
+    }
+
+    void writeArray(const QJsonArray &array)
+    {
+        buffer_.append('[');
+        for (qsizetype i = 0; i < array.size(); ++i) {
+            if (i > 0) {
+                buffer_.append(',');
+            }
+            writeValue(array.at(i));
+        }
+        buffer_.append(']');
+    }
+
+    void writeValue(const QJsonValue &value)
+    {
+        switch (value.type()) {
+        case QJsonValue::Bool:
+            buffer_.append(value.toBool() ? "true" : "false");
+            break;
+        case QJsonValue::Double:
+            writeNumber(value);
+            break;
+        case QJsonValue::String:
+            writeString(QStringView(value.toString()));
+            break;
+        case QJsonValue::Array:
+            writeArray(value.toArray());
+            break;
+        case QJsonValue::Object:
+            writeObject(value.toObject());
+            break;
+        default:
+            buffer_.append("null");
+            break;
+        }
+    }
+
+    void writeNumber(const QJsonValue &value)
+    {
+        // Как QJsonDocument: целые без дробной части, прочие — кратчайшей
+        // записью, не числа — null. toInteger() отдает значение по
+        // умолчанию, только если число не целое
+        char digits[32];
+        std::to_chars_result result;
+        if (value.toInteger(0) == value.toInteger(1)) {
+            result = std::to_chars(digits, digits + sizeof(digits), value.toInteger());
+        } else {
+            const double number = value.toDouble();
+            if (!std::isfinite(number)) {
+                buffer_.append("null");
+                return;
+            }
+            result = std::to_chars(digits, digits + sizeof(digits), number);
+        }
+        buffer_.append(digits, qsizetype(result.ptr - digits));
+    }
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 10, 0)
+    void writeString(QLatin1StringView text)
+    {
+        buffer_.append('"');
+        for (const char c : text) {
+            writeCodePoint(uchar(c));
+        }
+        buffer_.append('"');
+    }
+
+    void writeString(QUtf8StringView text)
+    {
+        buffer_.append('"');
+        for (const char c : text) {
+            // Многобайтные последовательности уже в UTF-8
+            if (uchar(c) >= 0x80) {
+                buffer_.append(c);
+            } else {
+                writeCodePoint(uchar(c));
+            }
+        }
+        buffer_.append('"');
+    }
+#endif
+
+    void writeString(QStringView text)
+    {
+        buffer_.append('"');
+        for (qsizetype i = 0; i < text.size(); ++i) {
+            char32_t code = text[i].unicode();
+            if (QChar::isHighSurrogate(code) && i + 1 < text.size()
+                && text[i + 1].isLowSurrogate()) {
+                code = QChar::surrogateToUcs4(char16_t(code), text[++i].unicode());
+            }
+            writeCodePoint(code);
+        }
+        buffer_.append('"');
+    }
+
+    void writeCodePoint(char32_t code)
+    {
+        static constexpr char kHex[] = "0123456789abcdef";
+        switch (code) {
+        case '"':  buffer_.append("\\\""); return;
+        case '\\': buffer_.append("\\\\"); return;
+        case '\b': buffer_.append("\\b"); return;
+        case '\f': buffer_.append("\\f"); return;
+        case '\n': buffer_.append("\\n"); return;
+        case '\r': buffer_.append("\\r"); return;
+        case '\t': buffer_.append("\\t"); return;
+        default:
+            break;
+        }
+        if (code < 0x20) {
+            const char escaped[] = {'\\', 'u', '0', '0', kHex[code >> 4], kHex[code & 0xF]};
+            buffer_.append(escaped, sizeof(escaped));
+        } else if (code < 0x80) {
+            buffer_.append(char(code));
+        } else if (code < 0x800) {
+            const char bytes[] = {char(0xC0 | (code >> 6)), char(0x80 | (code & 0x3F))};
+            buffer_.append(bytes, sizeof(bytes));
+        } else if (code < 0x10000) {
+            const char bytes[] = {char(0xE0 | (code >> 12)), char(0x80 | ((code >> 6) & 0x3F)),
+                                  char(0x80 | (code & 0x3F))};
+            buffer_.append(bytes, sizeof(bytes));
+        } else {
+            const char bytes[] = {char(0xF0 | (code >> 18)), char(0x80 | ((code >> 12) & 0x3F)),
+                                  char(0x80 | ((code >> 6) & 0x3F)), char(0x80 | (code & 0x3F))};
+            buffer_.append(bytes, sizeof(bytes));
+        }
+    }
+
+    QByteArray buffer_;
+    char delimiter_;
+};
+
+#endif // FRAMEBUILDER_H
@@ -0,0 +1,162 @@
+// Allocations per record on the ingest hop, with and without the frame arena.
+//
+// Кадры проходят IngestPipeline::submit(), разбор и оценку без приемников;
+// считаются все operator new/new[], а на glibc — и malloc/calloc/realloc,
+// через которые выделяют память контейнеры Qt. Прогон без арены копирует
+// каждый кадр в собственный QByteArray, как было до FrameArena.
+//
+// Арена убирает только выделение на копию кадра между приемом и
+// разбором; разбор JSON и оценка выделяют память на каждую запись в обоих
+// режимах, поэтому разница — около одного выделения на запись.
+//
+// Usage: IngestAllocBench [frames]   (default: 100000)
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QThread>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "ingestpipeline.h"
+#include "servermetrics.h"
+
+namespace {
+std::atomic<quint64> g_allocations{0};
+
+void *allocate(std::size_t size)
+{
+#if !defined(__GLIBC__)
+    // На glibc выделение уже посчитал malloc() ниже
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+    return std::malloc(size ? size : 1);
+}
+
+void *allocateOrThrow(std::size_t size)
+{
+    if (void *memory = allocate(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *memory, size_t size);
+void __libc_free(void *memory);
+
+void *malloc(size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *memory, size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(memory, size);
+}
+
+void free(void *memory) noexcept
+{
+    __libc_free(memory);
+}
+}
+#endif
+
+void *operator new(std::size_t size) { return allocateOrThrow(size); }
+void *operator new[](std::size_t size) { return allocateOrThrow(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocate(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { std::free(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { std::free(memory); }
+
+namespace {
+constexpr int kClients = 64;
+constexpr int kWarmupFrames = 1000;
+
+// Ждет, пока стадия оценки пропустит count записей сверх before
+void waitEvaluated(quint64 before, int count)
+{
+    const ServerMetrics &metrics = ServerMetrics::instance();
+    while (metrics.counterValue(Counter::StageEvaluated) - before < quint64(count)) {
+        QThread::msleep(1);
+    }
+}
+
+void submitAll(IngestPipeline &pipeline, const QVector<QByteArray> &frames, int count)
+{
+    const quint64 before = ServerMetrics::instance().counterValue(Counter::StageEvaluated);
+    for (int i = 0; i < count; ++i) {
+        pipeline.submit(i % kClients + 1, 0, frames[i % frames.size()]);
+    }
+    waitEvaluated(before, count);
+}
+
+double allocationsPerRecord(bool frame_arena, const QVector<QByteArray> &frames)
+{
+    PipelineConfig config;
+    config.frame_arena = frame_arena;
+
+    IngestPipeline pipeline;
+    pipeline.setConfig(config);
+    pipeline.start();
+
+    // Первые кадры заводят счетчики потоков и прочие однократные буферы
+    submitAll(pipeline, frames, kWarmupFrames);
+
+    const quint64 before = g_allocations.load();
+    submitAll(pipeline, frames, int(frames.size()));
+    const quint64 allocations = g_allocations.load() - before;
+
+    pipeline.stop();
+    return double(allocations) / double(frames.size());
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int count = 100000;
+    if (argc > 1) {
+        count = qMax(1, atoi(argv[1]));
+    }
+
+    // Значения ниже порогов по умолчанию: без предупреждений в логе
+    QVector<QByteArray> frames;
+    frames.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        frames.append(QByteArray("{\"type\":\"NetworkMetrics\",\"bandwidth\":")
+                      + QByteArray::number(100 + i % 900)
+                      + ",\"latency\":" + QByteArray::number(1 + i % 50)
+                      + ",\"packet_loss\":" + QByteArray::number((i % 10) / 10.0)
+                      + "}");
+    }
+
+    const double with_arena = allocationsPerRecord(true, frames);
+    const double without_arena = allocationsPerRecord(false, frames);
+
+    std::printf("frame arena:      %.2f allocations per record (%d records)\n", with_arena, count);
+    std::printf("per-frame buffer: %.2f allocations per record (%d records)\n", without_arena, count);
+#if !defined(__GLIBC__)
+    std::printf("(operator new only; Qt containers allocating through malloc are not counted)\n");
+#endif
+    return 0;
+}
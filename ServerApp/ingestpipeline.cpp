@@ -0,0 +1,464 @@
+#include "ingestpipeline.h"
+
+#include <QJsonDocument>
+#include <QMutexLocker>
+
+#include <utility>
+
+#if defined(Q_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "servermetrics.h"
+#include "sinkrunner.h"
+
+namespace {
+// Максимальное время сна стадии без уведомления
+constexpr std::chrono::milliseconds kIdleWait(5);
+
+// Записей, забираемых стадией оценки из одной очереди подряд
+constexpr int kEvaluateBatch = 64;
+
+// Известные типы: общая статическая строка вместо новой на каждую запись
+// и сравнение без преобразования значения в QString
+struct MessageType {
+    QString name;
+    Counter counter;
+    QJsonValue value;
+};
+
+const MessageType &messageType(const QJsonValue &type)
+{
+    static const MessageType kTypes[] = {
+        {QStringLiteral("NetworkMetrics"), Counter::MessagesNetworkMetrics,
+         QJsonValue(QStringLiteral("NetworkMetrics"))},
+        {QStringLiteral("DeviceStatus"), Counter::MessagesDeviceStatus,
+         QJsonValue(QStringLiteral("DeviceStatus"))},
+        {QStringLiteral("Log"), Counter::MessagesLog, QJsonValue(QStringLiteral("Log"))},
+    };
+    static thread_local MessageType other{QString(), Counter::MessagesOther, QJsonValue()};
+
+    for (const MessageType &known : kTypes) {
+        if (type == known.value) {
+            return known;
+        }
+    }
+    other.name = type.toString();
+    return other;
+}
+
+// Очередь следующей стадии заполнена: ждем ее, данные не теряются
+template <typename T>
+void pushBlocking(SpscQueue<T> &queue, T &&value)
+{
+    while (!queue.tryPush(std::move(value))) {
+        ServerMetrics::increment(Counter::PipelineStalls);
+        QThread::yieldCurrentThread();
+    }
+}
+}  // namespace
+
+const QString IngestPipeline::kDeviceEventType = QStringLiteral("DeviceEvent");
+
+IngestPipeline::IngestPipeline(QObject *parent)
+    : QObject(parent),
+      running_(false),
+      device_event_sinks_(false),
+      evaluate_thread_(nullptr),
+      parse_stopping_(false),
+      evaluate_stopping_(false)
+{
+}
+
+IngestPipeline::~IngestPipeline()
+{
+    stop();
+}
+
+void IngestPipeline::setConfig(const PipelineConfig &config)
+{
+    config_ = config;
+}
+
+void IngestPipeline::addSink(std::unique_ptr<RecordSink> sink, const SinkOptions &options)
+{
+    SinkRunner *runner = new SinkRunner(std::move(sink), options, this);
+
+    // Сигналы приходят из потоков конвейера, пересылаются напрямую
+    connect(runner, &SinkRunner::logMessage,
+            this, &IngestPipeline::logMessage, Qt::DirectConnection);
+    connect(runner, &SinkRunner::backpressureChanged, this,
+            [this](const QString &sink_name, bool active) {
+        emit logMessage(QString("Sink %1 %2").arg(sink_name,
+            active ? "is falling behind (queue above 75%)" : "caught up"));
+        emit sinkBackpressureChanged(sink_name, active);
+    }, Qt::DirectConnection);
+
+    sinks_.append(runner);
+    device_event_sinks_ = device_event_sinks_ || runner->wantsDeviceEvents();
+}
+
+void IngestPipeline::start()
+{
+    if (running_) {
+        return;
+    }
+
+    parse_stopping_ = false;
+    evaluate_stopping_ = false;
+
+    for (int i = 0; i < qMax(1, config_.parse_threads); ++i) {
+        parse_workers_.push_back(std::make_unique<ParseWorker>(config_.queue_capacity));
+    }
+
+    // Потребители запускаются раньше производителей
+    for (int i = 0; i < sinks_.size(); ++i) {
+        sinks_[i]->start([this, i]() { pinCurrentThread("sink", i); });
+    }
+
+    evaluate_thread_ = QThread::create([this]() { evaluateLoop(); });
+    evaluate_thread_->setObjectName("evaluate");
+    evaluate_thread_->start();
+
+    for (size_t i = 0; i < parse_workers_.size(); ++i) {
+        ParseWorker *worker = parse_workers_[i].get();
+        worker->thread = QThread::create([this, worker, i]() { parseLoop(worker, int(i)); });
+        worker->thread->setObjectName(QString("parse-%1").arg(i));
+        worker->thread->start();
+    }
+
+    running_ = true;
+}
+
+void IngestPipeline::stop()
+{
+    if (!running_) {
+        return;
+    }
+
+    // Стадии останавливаются по порядку, каждая дочитывает свой вход
+    parse_stopping_ = true;
+    for (auto &worker : parse_workers_) {
+        worker->waiter.notify();
+        worker->thread->wait();
+        delete worker->thread;
+    }
+
+    evaluate_stopping_ = true;
+    evaluate_waiter_.notify();
+    evaluate_thread_->wait();
+    delete evaluate_thread_;
+    evaluate_thread_ = nullptr;
+
+    for (SinkRunner *runner : std::as_const(sinks_)) {
+        runner->stop();
+    }
+
+    parse_workers_.clear();
+    running_ = false;
+}
+
+bool IngestPipeline::isRunning() const
+{
+    return running_;
+}
+
+void IngestPipeline::submit(int client_id, qint64 received_ms, const QByteArray &frame)
+{
+    if (!running_) {
+        return;
+    }
+
+    ParseWorker &worker = *parse_workers_[static_cast<unsigned>(client_id) % parse_workers_.size()];
+    RawFrame raw;
+    raw.client_id = client_id;
+    raw.received_ms = received_ms;
+    if (config_.frame_arena) {
+        bool allocated = false;
+        raw.data = arena_.copy(frame.constData(), frame.size(), &allocated);
+        if (allocated) {
+            ServerMetrics::increment(Counter::FrameArenaBlocks);
+        }
+    } else {
+        raw.copy = QByteArray(frame.constData(), frame.size());
+    }
+
+    // Разбор не успевает: поток приема ждет, и TCP сам притормозит клиентов
+    pushBlocking(worker.input, std::move(raw));
+    worker.waiter.notify();
+}
+
+void IngestPipeline::submitDecoded(int client_id, qint64 received_ms, const QJsonObject &content)
+{
+    if (!running_) {
+        return;
+    }
+
+    ParseWorker &worker = *parse_workers_[static_cast<unsigned>(client_id) % parse_workers_.size()];
+    RawFrame raw;
+    raw.client_id = client_id;
+    raw.received_ms = received_ms;
+    raw.decoded = content;
+
+    pushBlocking(worker.input, std::move(raw));
+    worker.waiter.notify();
+}
+
+void IngestPipeline::submitDeviceEvent(int client_id, bool connected,
+                                       const QString &address, quint16 port)
+{
+    if (!device_event_sinks_) {
+        return;
+    }
+
+    // Тот же путь, что у кадров устройства: поток разбора выбирается по
+    // client_id, поэтому событие не обгонит его записи
+    QJsonObject event;
+    event["type"] = kDeviceEventType;
+    event["event"] = connected ? "connected" : "disconnected";
+    if (connected) {
+        event["address"] = address;
+        event["port"] = port;
+    }
+    submit(client_id, QDateTime::currentMSecsSinceEpoch(),
+           QJsonDocument(event).toJson(QJsonDocument::Compact));
+}
+
+void IngestPipeline::setThresholds(const ThresholdConfig &config)
+{
+    QMutexLocker locker(&thresholds_mutex_);
+    thresholds_ = config;
+}
+
+ThresholdConfig IngestPipeline::thresholds() const
+{
+    QMutexLocker locker(&thresholds_mutex_);
+    return thresholds_;
+}
+
+void IngestPipeline::publishGauges() const
+{
+    qint64 parse_depth = 0;
+    qint64 evaluate_depth = 0;
+    for (const auto &worker : parse_workers_) {
+        parse_depth += worker->input.sizeApprox();
+        evaluate_depth += worker->output.sizeApprox();
+    }
+
+    qint64 sink_depth = 0;
+    qint64 backpressured = 0;
+    for (const SinkRunner *runner : sinks_) {
+        sink_depth += runner->queueDepth();
+        backpressured += runner->isBackpressured() ? 1 : 0;
+    }
+
+    ServerMetrics::setGauge(Gauge::ParseQueueDepth, parse_depth);
+    ServerMetrics::setGauge(Gauge::EvaluateQueueDepth, evaluate_depth);
+    ServerMetrics::setGauge(Gauge::SinkQueueDepth, sink_depth);
+    ServerMetrics::setGauge(Gauge::SinksBackpressured, backpressured);
+}
+
+void IngestPipeline::pinCurrentThread(const QString &stage, int worker_index)
+{
+    const QList<int> cpus = config_.cpu_affinity.value(stage);
+    if (cpus.isEmpty()) {
+        return;
+    }
+
+#if defined(Q_OS_LINUX)
+    // Потоки стадии распределяются по списку CPU по кругу
+    const int cpu = cpus[worker_index % cpus.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        emit logMessage(QString("Failed to pin %1 thread to CPU %2").arg(stage).arg(cpu));
+    }
+#else
+    Q_UNUSED(worker_index);
+#endif
+}
+
+void IngestPipeline::parseLoop(ParseWorker *worker, int index)
+{
+    pinCurrentThread("parse", index);
+
+    RawFrame frame;
+    forever {
+        if (worker->input.tryPop(frame)) {
+            ClientData data;
+            if (parseFrame(frame, &data)) {
+                pushBlocking(worker->output, std::move(data));
+                evaluate_waiter_.notify();
+            }
+            // Блок арены освобождается, как только разобран его последний кадр
+            frame.data.reset();
+            frame.copy = QByteArray();
+            frame.decoded = QJsonObject();
+            ServerMetrics::increment(Counter::StageParsed);
+            continue;
+        }
+
+        // Флаг виден после всех submit(), поэтому пустой вход — окончательно
+        if (parse_stopping_.load()) {
+            if (worker->input.emptyApprox()) {
+                return;
+            }
+            continue;
+        }
+
+        worker->waiter.wait([this, worker]() {
+            return !worker->input.emptyApprox() || parse_stopping_.load();
+        }, kIdleWait);
+    }
+}
+
+void IngestPipeline::evaluateLoop()
+{
+    pinCurrentThread("evaluate");
+
+    auto hasInput = [this]() {
+        for (const auto &worker : parse_workers_) {
+            if (!worker->output.emptyApprox()) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    ClientData data;
+    forever {
+        bool idle = true;
+
+        // Очереди разбора обслуживаются по кругу ограниченными пачками
+        for (auto &worker : parse_workers_) {
+            for (int n = 0; n < kEvaluateBatch && worker->output.tryPop(data); ++n) {
+                idle = false;
+                const bool device_event = data.data_type == kDeviceEventType;
+                if (!device_event) {
+                    checkThresholds(data);
+                }
+
+                // Приемник с политикой Block может задержать эту стадию
+                for (int i = 0; i < sinks_.size(); ++i) {
+                    if (device_event && !sinks_[i]->wantsDeviceEvents()) {
+                        continue;
+                    }
+                    ClientData copy = (i + 1 < sinks_.size()) ? data : std::move(data);
+                    sinks_[i]->offer(std::move(copy));
+                }
+                ServerMetrics::increment(Counter::StageEvaluated);
+            }
+        }
+
+        if (!idle) {
+            continue;
+        }
+
+        if (evaluate_stopping_.load()) {
+            if (!hasInput()) {
+                return;
+            }
+            continue;
+        }
+
+        evaluate_waiter_.wait([this, &hasInput]() {
+            return hasInput() || evaluate_stopping_.load();
+        }, kIdleWait);
+    }
+}
+
+bool IngestPipeline::parseFrame(const RawFrame &frame, ClientData *data)
+{
+    if (!frame.decoded.isEmpty()) {
+        // Дельта уже восстановлена потоком приема. Исходных байтов нет:
+        // ClientData::frame остается пустым, ретранслятор закодирует сам
+        data->client_id = frame.client_id;
+        data->content = frame.decoded;
+        const MessageType &type = messageType(frame.decoded.value(QLatin1String("type")));
+        data->data_type = type.name;
+        data->timestamp = QDateTime::fromMSecsSinceEpoch(frame.received_ms);
+        ServerMetrics::increment(type.counter);
+        return true;
+    }
+
+    QJsonParseError parse_error;
+    const QByteArray bytes = config_.frame_arena ? frame.data.view() : frame.copy;
+    QJsonDocument doc = QJsonDocument::fromJson(bytes, &parse_error);
+
+    if (parse_error.error != QJsonParseError::NoError) {
+        ServerMetrics::increment(Counter::ParseErrors);
+        emit logMessage(QString("JSON parse error from client %1: %2")
+                        .arg(frame.client_id)
+                        .arg(parse_error.errorString()));
+        return false;
+    }
+
+    if (!doc.isObject()) {
+        ServerMetrics::increment(Counter::ParseErrors);
+        emit logMessage(QString("Invalid JSON from client %1: not an object")
+                        .arg(frame.client_id));
+        return false;
+    }
+
+    // Только константный доступ: неконстантный operator[] отделил бы
+    // копию объекта от документа
+    data->client_id = frame.client_id;
+    data->content = doc.object();
+    const MessageType &type = messageType(std::as_const(data->content).value(QLatin1String("type")));
+    data->data_type = type.name;
+    data->timestamp = QDateTime::fromMSecsSinceEpoch(frame.received_ms);
+    if (config_.keep_frames) {
+        // Арена освобождается после разбора: нужна своя копия
+        data->frame = QByteArray(bytes.constData(), bytes.size());
+    }
+    ServerMetrics::increment(type.counter);
+    return true;
+}
+
+void IngestPipeline::checkThresholds(const ClientData &data)
+{
+    // Получаем копию настроек потокобезопасно
+    ThresholdConfig config = thresholds();
+
+    const QJsonObject &content = data.content;
+    QStringList warnings;
+
+    if (data.data_type == "NetworkMetrics") {
+        if (content.contains("latency")) {
+            double latency = content["latency"].toDouble();
+            if (latency > config.max_latency) {
+                warnings << QString("High latency: %1ms").arg(latency);
+            }
+        }
+        if (content.contains("packet_loss")) {
+            double packet_loss = content["packet_loss"].toDouble();
+            if (packet_loss > config.max_packet_loss) {
+                warnings << QString("High packet loss: %1%").arg(packet_loss);
+            }
+        }
+    } else if (data.data_type == "DeviceStatus") {
+        if (content.contains("cpu_usage")) {
+            int cpu_usage = content["cpu_usage"].toInt();
+            if (cpu_usage > config.max_cpu_usage) {
+                warnings << QString("High CPU usage: %1%").arg(cpu_usage);
+            }
+        }
+        if (content.contains("memory_usage")) {
+            int memory_usage = content["memory_usage"].toInt();
+            if (memory_usage > config.max_memory_usage) {
+                warnings << QString("High memory usage: %1%").arg(memory_usage);
+            }
+        }
+    }
+
+    // Логируем предупреждения
+    if (!warnings.isEmpty()) {
+        ServerMetrics::increment(Counter::Alerts, warnings.size());
+    }
+    for (const QString &warning : warnings) {
+        emit logMessage(QString("WARNING [Client %1]: %2")
+                        .arg(data.client_id).arg(warning));
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef INGESTPIPELINE_H
+#define INGESTPIPELINE_H
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "framearena.h"
+#include "recordsink.h"
+#include "spscqueue.h"
+#include "tcpserver.h"
+
+class SinkRunner;
+
+// Framed message handed from the network stage to the parse stage
+struct RawFrame {
+    int client_id = 0;
+    qint64 received_ms = 0;
+    FrameRef data;        // Байты в арене потока приема
+    QByteArray copy;      // Вместо арены, если PipelineConfig::frame_arena выключен
+    QJsonObject decoded;  // Уже разобранный кадр (восстановленная дельта), без байтов
+};
+
+// Параметры конвейера обработки
+struct PipelineConfig {
+    int parse_threads = 2;
+    int queue_capacity = 8192;              // Емкость каждой очереди между стадиями
+    QMap<QString, QList<int>> cpu_affinity; // Стадия -> список CPU для привязки потоков
+    bool frame_arena = true;                // false — QByteArray на каждый кадр (для сравнения)
+    bool keep_frames = false;               // Копия кадра в ClientData::frame (ретранслятор)
+};
+
+// Staged ingest pipeline:
+//
+//   network (TcpServer thread) -> parse x N -> evaluate -> sink x M
+//
+// Стадии соединены ограниченными SPSC-очередями без блокировок. Кадры
+// распределяются по потокам разбора по client_id, поэтому порядок
+// сообщений одного клиента сохраняется. Каждый приемник (RecordSink)
+// работает в своем потоке со своей очередью и получает записи пачками;
+// поведение при медленном приемнике задается SinkOptions::policy.
+//
+// Имена стадий для привязки к CPU: network, parse, evaluate, sink.
+class IngestPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IngestPipeline(QObject *parent = nullptr);
+    ~IngestPipeline();
+
+    // Configuration, call while the pipeline is stopped
+    void setConfig(const PipelineConfig &config);
+    void addSink(std::unique_ptr<RecordSink> sink, const SinkOptions &options = SinkOptions());
+
+    void start();
+    // Drain all stages in order and join their threads
+    void stop();
+    bool isRunning() const;
+
+    // Network stage entry point; only the ingest thread may call it.
+    // The frame is copied, so it may be a view of a receive buffer
+    void submit(int client_id, qint64 received_ms, const QByteArray &frame);
+    // Same path for a frame the ingest thread already decoded (delta
+    // frames): the parse stage takes the object as is. Must not be empty
+    void submitDecoded(int client_id, qint64 received_ms, const QJsonObject &content);
+
+    // Device connect/disconnect marker: passes the stages after the
+    // device's earlier frames and reaches only sinks that want device
+    // events. Ingest thread only; no-op without such sinks
+    static const QString kDeviceEventType;
+    void submitDeviceEvent(int client_id, bool connected,
+                           const QString &address = QString(), quint16 port = 0);
+
+    // Настройки (потокобезопасные)
+    void setThresholds(const ThresholdConfig &config);
+    ThresholdConfig thresholds() const;
+
+    // Update queue depth gauges of ServerMetrics
+    void publishGauges() const;
+
+    // Pin calling thread to the CPUs configured for stage (Linux only)
+    void pinCurrentThread(const QString &stage, int worker_index = 0);
+
+signals:
+    void logMessage(const QString &message);
+    void sinkBackpressureChanged(const QString &sink, bool active);
+
+private:
+    struct ParseWorker {
+        explicit ParseWorker(int capacity) : input(capacity), output(capacity) {}
+
+        SpscQueue<RawFrame> input;       // network -> parse
+        SpscQueue<ClientData> output;    // parse -> evaluate
+        StageWaiter waiter;
+        QThread *thread = nullptr;
+    };
+
+    void parseLoop(ParseWorker *worker, int index);
+    void evaluateLoop();
+
+    bool parseFrame(const RawFrame &frame, ClientData *data);
+    void checkThresholds(const ClientData &data);
+
+    PipelineConfig config_;
+    bool running_;
+
+    std::vector<std::unique_ptr<ParseWorker>> parse_workers_;
+    FrameArena arena_;                   // Только поток приема (submit)
+    QVector<SinkRunner*> sinks_;         // Дочерние объекты, живут дольше запусков
+    bool device_event_sinks_;            // Есть приемник событий устройств
+
+    StageWaiter evaluate_waiter_;
+    QThread *evaluate_thread_;
+
+    // Флаги остановки по стадиям: стадия дренирует вход после остановки
+    // всех предыдущих
+    std::atomic<bool> parse_stopping_;
+    std::atomic<bool> evaluate_stopping_;
+
+    mutable QMutex thresholds_mutex_;
+    ThresholdConfig thresholds_;
+};
+
+#endif // INGESTPIPELINE_H
@@ -0,0 +1,228 @@
+#include "localhttpserver.h"
+
+#include <QUrl>
+
+#include <utility>
+
+namespace {
+const QByteArray kHeadTerminator = "\r\n\r\n";
+
+QByteArray reasonPhrase(int status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Error";
+    }
+}
+
+QByteArray statusHead(int status, const QByteArray &content_type)
+{
+    return "HTTP/1.1 " + QByteArray::number(status) + ' ' + reasonPhrase(status) + "\r\n"
+           "Content-Type: " + content_type + "\r\n"
+           "Connection: close\r\n";
+}
+}  // namespace
+
+HttpResponseStream::HttpResponseStream(LocalHttpServer *server, quint64 connection_id)
+    : server_(server),
+      connection_id_(connection_id)
+{
+}
+
+void HttpResponseStream::begin(int status, const QByteArray &content_type)
+{
+    server_->post(connection_id_,
+                  statusHead(status, content_type) + "Transfer-Encoding: chunked\r\n\r\n",
+                  false);
+}
+
+void HttpResponseStream::write(const QByteArray &chunk)
+{
+    // Пустой фрагмент в chunked-кодировании означает конец тела
+    if (chunk.isEmpty()) {
+        return;
+    }
+    server_->post(connection_id_,
+                  QByteArray::number(chunk.size(), 16) + "\r\n" + chunk + "\r\n",
+                  false);
+}
+
+void HttpResponseStream::end()
+{
+    server_->post(connection_id_, "0\r\n\r\n", true);
+}
+
+void HttpResponseStream::send(int status, const QByteArray &content_type, const QByteArray &body)
+{
+    server_->post(connection_id_,
+                  statusHead(status, content_type)
+                      + "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n"
+                      + body,
+                  true);
+}
+
+LocalHttpServer::LocalHttpServer(int worker_threads, QObject *parent)
+    : QObject(parent),
+      listener_(new QTcpServer(this)),
+      next_connection_id_(1)
+{
+    pool_.setMaxThreadCount(worker_threads);
+
+    connect(listener_, &QTcpServer::newConnection,
+            this, &LocalHttpServer::onNewConnection);
+}
+
+LocalHttpServer::~LocalHttpServer()
+{
+    stopListening();
+}
+
+void LocalHttpServer::addRoute(const QString &path, HttpHandler handler)
+{
+    routes_.insert(path, std::move(handler));
+}
+
+bool LocalHttpServer::startListening(quint16 port)
+{
+    // Только loopback: эндпоинты предназначены для локальных инструментов
+    if (!listener_->listen(QHostAddress::LocalHost, port)) {
+        emit logMessage(QString("Failed to start HTTP endpoint: %1")
+                        .arg(listener_->errorString()));
+        return false;
+    }
+
+    emit logMessage(QString("HTTP endpoint listening on 127.0.0.1:%1").arg(port));
+    return true;
+}
+
+void LocalHttpServer::stopListening()
+{
+    listener_->close();
+
+    // Дожидаемся обработчиков, они обращаются к этому объекту
+    pool_.waitForDone();
+
+    for (QTcpSocket *socket : std::as_const(connections_)) {
+        socket->abort();
+        socket->deleteLater();
+    }
+    connections_.clear();
+    connection_ids_.clear();
+    request_buffers_.clear();
+}
+
+void LocalHttpServer::onNewConnection()
+{
+    while (listener_->hasPendingConnections()) {
+        QTcpSocket *socket = listener_->nextPendingConnection();
+
+        connect(socket, &QTcpSocket::readyRead,
+                this, &LocalHttpServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected,
+                this, &LocalHttpServer::onDisconnected);
+
+        quint64 connection_id = next_connection_id_++;
+        connections_[connection_id] = socket;
+        connection_ids_[socket] = connection_id;
+        request_buffers_[socket] = QByteArray();
+    }
+}
+
+void LocalHttpServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !request_buffers_.contains(socket)) {
+        return;
+    }
+
+    QByteArray &buffer = request_buffers_[socket];
+    buffer.append(socket->readAll());
+
+    int head_end = buffer.indexOf(kHeadTerminator);
+    if (head_end < 0) {
+        if (buffer.size() > kMaxRequestHeadSize) {
+            HttpResponseStream(this, connection_ids_[socket])
+                .send(413, "text/plain", "Request head too large\n");
+            request_buffers_.remove(socket);
+        }
+        return;
+    }
+
+    // Одно соединение — один запрос: дальнейшие данные игнорируются
+    QByteArray head = buffer.left(head_end);
+    request_buffers_.remove(socket);
+    dispatch(connection_ids_[socket], head);
+}
+
+void LocalHttpServer::onDisconnected()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !connection_ids_.contains(socket)) {
+        return;
+    }
+
+    connections_.remove(connection_ids_.take(socket));
+    request_buffers_.remove(socket);
+    socket->deleteLater();
+}
+
+void LocalHttpServer::post(quint64 connection_id, const QByteArray &data, bool close)
+{
+    QMetaObject::invokeMethod(this, [this, connection_id, data, close]() {
+        writeToConnection(connection_id, data, close);
+    }, Qt::QueuedConnection);
+}
+
+void LocalHttpServer::writeToConnection(quint64 connection_id, const QByteArray &data, bool close)
+{
+    // Клиент мог отключиться, пока обработчик формировал ответ
+    QTcpSocket *socket = connections_.value(connection_id, nullptr);
+    if (!socket) {
+        return;
+    }
+
+    socket->write(data);
+    if (close) {
+        socket->disconnectFromHost();
+    }
+}
+
+void LocalHttpServer::dispatch(quint64 connection_id, const QByteArray &head)
+{
+    HttpResponseStream response(this, connection_id);
+
+    // Request line: METHOD SP request-target SP HTTP-version
+    const QByteArray request_line = head.left(head.indexOf("\r\n"));
+    const QList<QByteArray> parts = request_line.split(' ');
+    if (parts.size() != 3 || !parts[2].startsWith("HTTP/1.")) {
+        response.send(400, "text/plain", "Malformed request line\n");
+        return;
+    }
+
+    HttpRequest request;
+    request.method = parts[0];
+    QUrl url(QString::fromLatin1(parts[1]));
+    request.path = url.path();
+    request.query = QUrlQuery(url);
+
+    if (request.method != "GET") {
+        response.send(405, "text/plain", "Only GET is supported\n");
+        return;
+    }
+
+    auto route = routes_.constFind(request.path);
+    if (route == routes_.constEnd()) {
+        response.send(404, "text/plain", "Unknown endpoint\n");
+        return;
+    }
+
+    HttpHandler handler = route.value();
+    pool_.start([handler, request, response]() mutable {
+        handler(request, response);
+    });
+}
@@ -0,0 +1,94 @@
+#ifndef LOCALHTTPSERVER_H
+#define LOCALHTTPSERVER_H
+
+#include <QHash>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThreadPool>
+#include <QUrlQuery>
+
+#include <functional>
+
+class LocalHttpServer;
+
+// Parsed HTTP request line (headers are not needed by local endpoints)
+struct HttpRequest {
+    QByteArray method;
+    QString path;
+    QUrlQuery query;
+};
+
+// Ответ с передачей по частям (chunked). Методы можно вызывать из потока
+// пула обработчиков: данные передаются в поток сервера через очередь событий.
+class HttpResponseStream
+{
+public:
+    HttpResponseStream(LocalHttpServer *server, quint64 connection_id);
+
+    // Send status line and headers, body follows with write()
+    void begin(int status, const QByteArray &content_type);
+    void write(const QByteArray &chunk);
+    // Terminate the body and close the connection
+    void end();
+
+    // Send a complete short response (errors, small documents)
+    void send(int status, const QByteArray &content_type, const QByteArray &body);
+
+private:
+    LocalHttpServer *server_;
+    quint64 connection_id_;
+};
+
+using HttpHandler = std::function<void(const HttpRequest &request,
+                                       HttpResponseStream &response)>;
+
+// Minimal HTTP/1.1 listener bound to loopback for local tools (query API,
+// metrics). Обработчики выполняются в собственном пуле потоков, поэтому
+// медленный запрос не задерживает ни этот объект, ни поток приема данных.
+class LocalHttpServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LocalHttpServer(int worker_threads = 2, QObject *parent = nullptr);
+    ~LocalHttpServer();
+
+    // Register handler for exact path; call before startListening()
+    void addRoute(const QString &path, HttpHandler handler);
+
+public slots:
+    bool startListening(quint16 port);
+    void stopListening();
+
+signals:
+    void logMessage(const QString &message);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    friend class HttpResponseStream;
+
+    // Thread-safe: queue data for the connection from any thread
+    void post(quint64 connection_id, const QByteArray &data, bool close);
+
+    // Runs in the server thread
+    void writeToConnection(quint64 connection_id, const QByteArray &data, bool close);
+    void dispatch(quint64 connection_id, const QByteArray &head);
+
+    QTcpServer *listener_;
+    QThreadPool pool_;
+    QHash<QString, HttpHandler> routes_;
+    QHash<quint64, QTcpSocket*> connections_;
+    QHash<QTcpSocket*, quint64> connection_ids_;
+    QHash<QTcpSocket*, QByteArray> request_buffers_;
+    quint64 next_connection_id_;
+
+    // Ограничение размера заголовков запроса
+    static constexpr int kMaxRequestHeadSize = 16 * 1024;
+};
+
+#endif // LOCALHTTPSERVER_H
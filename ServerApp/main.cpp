@@ -1,11 +1,248 @@
 #include "serverwindow.h"
 
 #include <QApplication>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QTextStream>
+
+#include "serverhost.h"
+#include "sharedstate.h"
+#include "tcpserver.h"
+
+namespace {
+void printUsage(QTextStream &out)
+{
+    out << "Usage: ServerApp [options]\n";
+    out << "  -p, --port PORT        Device listener port (default: 12345)\n";
+    out << "  --local NAME           Also accept devices on a local socket (same protocol)\n";
+    out << "  --ring NAME            Also accept emulators through shared-memory rings\n";
+    out << "  --backend B            Device listener: qt (default), epoll (Linux, idle fleets)\n";
+    out << "                         or uring (experimental io_uring; falls back to epoll)\n";
+    out << "  --acceptors N          SO_REUSEPORT listeners accepting in parallel threads\n";
+    out << "                         (qt backend, Linux; default: 1)\n";
+    out << "  --compression          Offer devices deflate stream compression of uplink\n";
+    out << "  --rx-memory-mb N       Limit on receive buffers of all connections (default: 256)\n";
+    out << "  --headless             Run without GUI, start listening immediately\n";
+    out << "  --http-port PORT       Local HTTP API (/query, /metrics) on 127.0.0.1\n";
+    out << "  --http-threads N       Query worker threads (default: 2)\n";
+    out << "  --wal-dir DIR          Write-ahead log of received frames (default: off)\n";
+    out << "  --wal-segments N       Segment files in the WAL ring (default: 8)\n";
+    out << "  --wal-segment-mb N     Preallocated size of a segment (default: 64)\n";
+    out << "  --wal-sync-ms N        Group commit interval (default: 10)\n";
+    out << "  --wal-sync-kb N        Group commit size threshold (default: 1024)\n";
+    out << "  --parse-threads N      Parse stage threads (default: 2)\n";
+    out << "  --queue-capacity N     Capacity of each pipeline queue (default: 8192)\n";
+    out << "  --pin STAGE=CPUS       Pin stage threads to CPUs, e.g. parse=2,3\n";
+    out << "                         (stages: network, parse, evaluate, sink)\n";
+    out << "  --sink TYPE:TARGET     Extra record sink, repeatable:\n";
+    out << "                         file:PATH, segments:DIR, sqlite:PATH, socket:NAME\n";
+    out << "  --sink-policy P        Full sink queue: drop (default), block, spill\n";
+    out << "  --sink-batch N         Records per sink batch (default: 512)\n";
+    out << "  --sink-batch-ms N      Max wait for a partial batch (default: 50)\n";
+    out << "  --spill-dir DIR        Spill files for --sink-policy spill (default: temp)\n";
+    out << "  --spill-max-mb N       Size cap of a spill file, records beyond are dropped\n";
+    out << "                         (default: 256)\n";
+    out << "  --record FILE          Record a capture session (.cssession) from startup\n";
+    out << "  --rollup-minutes N     Retention of 1-minute rollups (default: 1440)\n";
+    out << "  --rollup-hours N       Retention of 1-hour rollups (default: 720)\n";
+    out << "  --retention TYPE=H     Keep segments of TYPE for H hours (default: 168);\n";
+    out << "                         TYPE: NetworkMetrics, DeviceStatus, Log, other\n";
+    out << "  --cold-hours N         Compress segments older than N hours (default: 24)\n";
+    out << "  --compact-interval S   Seconds between compaction passes (default: 300)\n";
+    out << "  --compact-io-mb N      Compaction I/O limit, MB/s (default: 8)\n";
+    out << "  --snapshot FILE        Restore state from FILE and snapshot it periodically\n";
+    out << "  --snapshot-interval S  Seconds between snapshots (default: 60)\n";
+    out << "  --relay HOST:PORT      Relay mode: forward records to a central server\n";
+    out << "  --relay-links N        Connections to the central server (default: 2)\n";
+    out << "  --cluster FILE         Cluster members, one \"name host:port\" per line\n";
+    out << "  --node NAME            Name of this server in the cluster file\n";
+    out << "  --pubsub NAME          Stream filtered records to local socket subscribers\n";
+    out << "  --pubsub-max-kb N      Backlog after which a subscriber is dropped (default: 8192)\n";
+    out << "  --shm NAME             Publish server state in shared memory for detached windows\n";
+    out << "  --attach NAME          Run only the window, showing a server started with --shm NAME\n";
+}
+
+// Returns false if arguments are invalid or help was requested
+bool parseArguments(const QStringList &args, ServerOptions *options, QTextStream &out)
+{
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+        const bool has_value = i + 1 < args.size();
+
+        if ((arg == "-p" || arg == "--port") && has_value) {
+            options->port = args[++i].toUShort();
+        } else if (arg == "--local" && has_value) {
+            options->local_name = args[++i];
+        } else if (arg == "--ring" && has_value) {
+            options->ring_name = args[++i];
+        } else if (arg == "--backend" && has_value) {
+            options->backend = args[++i];
+        } else if (arg == "--compression") {
+            options->compression = true;
+        } else if (arg == "--rx-memory-mb" && has_value) {
+            options->receive_memory_mb = qMax(1, args[++i].toInt());
+        } else if (arg == "--acceptors" && has_value) {
+            options->acceptors = qMax(1, args[++i].toInt());
+        } else if (arg == "--headless") {
+            options->headless = true;
+        } else if (arg == "--http-port" && has_value) {
+            options->http_port = args[++i].toUShort();
+        } else if (arg == "--http-threads" && has_value) {
+            options->http_threads = qMax(1, args[++i].toInt());
+        } else if (arg == "--wal-dir" && has_value) {
+            options->wal.directory = args[++i];
+        } else if (arg == "--wal-segments" && has_value) {
+            options->wal.segment_count = qMax(2, args[++i].toInt());
+        } else if (arg == "--wal-segment-mb" && has_value) {
+            options->wal.segment_size = qMax(1, args[++i].toInt()) * qint64(1024 * 1024);
+        } else if (arg == "--wal-sync-ms" && has_value) {
+            options->wal.sync_interval_ms = qMax(0, args[++i].toInt());
+        } else if (arg == "--wal-sync-kb" && has_value) {
+            options->wal.sync_bytes = qMax(1, args[++i].toInt()) * qint64(1024);
+        } else if (arg == "--parse-threads" && has_value) {
+            options->pipeline.parse_threads = qMax(1, args[++i].toInt());
+        } else if (arg == "--queue-capacity" && has_value) {
+            options->pipeline.queue_capacity = qMax(16, args[++i].toInt());
+        } else if (arg == "--pin" && has_value && args[i + 1].contains('=')) {
+            const QString spec = args[++i];
+            const QString stage = spec.section('=', 0, 0);
+            QList<int> cpus;
+            for (const QString &cpu : spec.section('=', 1).split(',', Qt::SkipEmptyParts)) {
+                cpus << cpu.toInt();
+            }
+            options->pipeline.cpu_affinity[stage] = cpus;
+        } else if (arg == "--sink" && has_value) {
+            options->sinks << args[++i];
+        } else if (arg == "--sink-policy" && has_value) {
+            const QString policy = args[++i];
+            if (policy == "block") {
+                options->sink_options.policy = SlowSinkPolicy::Block;
+            } else if (policy == "spill") {
+                options->sink_options.policy = SlowSinkPolicy::Spill;
+            } else {
+                options->sink_options.policy = SlowSinkPolicy::Drop;
+            }
+        } else if (arg == "--sink-batch" && has_value) {
+            options->sink_options.max_batch_size = qMax(1, args[++i].toInt());
+        } else if (arg == "--sink-batch-ms" && has_value) {
+            options->sink_options.max_batch_delay_ms = qMax(0, args[++i].toInt());
+        } else if (arg == "--spill-dir" && has_value) {
+            options->sink_options.spill_directory = args[++i];
+        } else if (arg == "--spill-max-mb" && has_value) {
+            options->sink_options.spill_max_bytes = qint64(qMax(1, args[++i].toInt())) * 1024 * 1024;
+        } else if (arg == "--record" && has_value) {
+            options->record_path = args[++i];
+        } else if (arg == "--rollup-minutes" && has_value) {
+            options->rollup_minutes = qMax(1, args[++i].toInt());
+        } else if (arg == "--rollup-hours" && has_value) {
+            options->rollup_hours = qMax(1, args[++i].toInt());
+        } else if (arg == "--retention" && has_value && args[i + 1].contains('=')) {
+            const QString spec = args[++i];
+            options->compaction.retention_hours[spec.section('=', 0, 0)] =
+                qMax(1, spec.section('=', 1).toInt());
+        } else if (arg == "--cold-hours" && has_value) {
+            options->compaction.cold_after_hours = qMax(1, args[++i].toInt());
+        } else if (arg == "--compact-interval" && has_value) {
+            options->compaction.interval_seconds = qMax(1, args[++i].toInt());
+        } else if (arg == "--compact-io-mb" && has_value) {
+            options->compaction.io_bytes_per_second = qMax(1, args[++i].toInt()) * qint64(1024 * 1024);
+        } else if (arg == "--snapshot" && has_value) {
+            options->snapshot_path = args[++i];
+        } else if (arg == "--snapshot-interval" && has_value) {
+            options->snapshot_interval = qMax(1, args[++i].toInt());
+        } else if (arg == "--relay" && has_value && args[i + 1].contains(':')) {
+            const QString upstream = args[++i];
+            options->relay_host = upstream.section(':', 0, -2);
+            options->relay_port = static_cast<quint16>(upstream.section(':', -1).toUInt());
+        } else if (arg == "--relay-links" && has_value) {
+            options->relay_links = qBound(1, args[++i].toInt(), 64);
+        } else if (arg == "--cluster" && has_value) {
+            options->cluster_file = args[++i];
+        } else if (arg == "--node" && has_value) {
+            options->node_name = args[++i];
+        } else if (arg == "--pubsub" && has_value) {
+            options->pubsub_name = args[++i];
+        } else if (arg == "--pubsub-max-kb" && has_value) {
+            options->pubsub_max_pending_kb = qMax(64, args[++i].toInt());
+        } else if (arg == "--shm" && has_value) {
+            options->shm_name = args[++i];
+        } else if (arg == "--attach" && has_value) {
+            options->attach_name = args[++i];
+        } else {
+            printUsage(out);
+            return false;
+        }
+    }
+    return true;
+}
+
+int runHeadless(int argc, char *argv[], const ServerOptions &options, QTextStream &out)
+{
+    QCoreApplication a(argc, argv);
+
+    ServerHost host(options);
+
+    // Лог сервера выводится в консоль (в главном потоке)
+    auto print = [&out](const QString &message) {
+        out << "[" << QDateTime::currentDateTime().toString("hh:mm:ss") << "] "
+            << message << "\n";
+        out.flush();
+    };
+    QObject::connect(host.server(), &TcpServer::logMessage, &a, print);
+    QObject::connect(&host, &ServerHost::logMessage, &a, print);
+
+    host.start();
+    QMetaObject::invokeMethod(host.server(), "startServer",
+                              Qt::QueuedConnection,
+                              Q_ARG(quint16, options.port));
+
+    return a.exec();
+}
+
+// Окно в отдельном процессе: сервер работает без GUI и не ждет окно
+int runAttached(int argc, char *argv[], const ServerOptions &options, QTextStream &out)
+{
+    QApplication a(argc, argv);
+
+    SharedStateReader reader(options.attach_name);
+    QString error;
+    if (!reader.attach(&error)) {
+        out << error << "\n";
+        return 1;
+    }
+
+    ServerWindow s(&reader);
+    s.show();
+    return a.exec();
+}
+}  // namespace
 
 int main(int argc, char *argv[])
 {
+    QTextStream out(stdout);
+
+    QStringList args;
+    for (int i = 0; i < argc; ++i) {
+        args << QString::fromLocal8Bit(argv[i]);
+    }
+
+    ServerOptions options;
+    if (!parseArguments(args, &options, out)) {
+        return args.contains("--help") ? 0 : 1;
+    }
+
+    if (!options.attach_name.isEmpty()) {
+        return runAttached(argc, argv, options, out);
+    }
+
+    if (options.headless) {
+        return runHeadless(argc, argv, options, out);
+    }
+
     QApplication a(argc, argv);
-    ServerWindow s;
+    ServerHost host(options);
+    ServerWindow s(&host);
+    host.start();
     s.show();
     return a.exec();
 }
@@ -0,0 +1,314 @@
+#include "nativebackend.h"
+
+#include <QDateTime>
+#include <QHostAddress>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstring>
+
+#if defined(Q_OS_LINUX)
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include "servermetrics.h"
+#include "streamcodec.h"
+#include "tcpserver.h"
+
+namespace {
+constexpr char kMessageDelimiter = '\n';
+}  // namespace
+
+NativeBackend::NativeBackend(TcpServer *server)
+    : QObject(server),
+      server_(server)
+{
+}
+
+int NativeBackend::openListener(quint16 port, QString *error)
+{
+#if defined(Q_OS_LINUX)
+    // Сотни тысяч соединений упираются в мягкий лимит дескрипторов
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    const int fd = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        *error = QString("socket: %1").arg(strerror(errno));
+        return -1;
+    }
+    const int off = 0;
+    const int on = 1;
+    setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in6 address {};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(port);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::listen(fd, SOMAXCONN) < 0) {
+        *error = QString("port %1: %2").arg(port).arg(strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    Q_UNUSED(port);
+    *error = "native backends are only available on Linux";
+    return -1;
+#endif
+}
+
+bool NativeBackend::send(int client_id, const QByteArray &data)
+{
+    const int fd = fds_.value(client_id, -1);
+    if (fd < 0) {
+        return false;
+    }
+    reply(fd, data);
+    return true;
+}
+
+qint64 NativeBackend::bufferedBytes() const
+{
+    qint64 bytes = 0;
+    for (const Connection &connection : connections_) {
+        bytes += connection.partial.size();
+    }
+    return bytes;
+}
+
+qint64 NativeBackend::queuedBytes() const
+{
+    qint64 bytes = 0;
+    for (const Connection &connection : connections_) {
+        bytes += connection.outbound.size();
+    }
+    return bytes;
+}
+
+void NativeBackend::accepted(int fd, const quint8 *address, quint16 port, quint32 generation)
+{
+    Connection &connection = connections_[fd];
+    std::memcpy(connection.address, address, sizeof(connection.address));
+    connection.port = port;
+    connection.generation = generation;
+
+    // В кластере клиент подтверждается только после Hello
+    if (!server_->cluster_) {
+        confirm(fd, QString());
+    }
+}
+
+bool NativeBackend::handleFrames(int fd, const char *data, qint64 size)
+{
+    // После перенаправления ждем только отправки ответа
+    auto connection = connections_.find(fd);
+    if (connection->closing) {
+        return true;
+    }
+
+    if (!connection->inflater) {
+        return splitFrames(fd, data, size);
+    }
+    // Разжатое ограничено тем же пределом, что и хвост кадра
+    QByteArray plain;
+    const StreamCodec::Inflater::Status status =
+        TcpServer::inflate(connection->inflater.data(), data, size, &plain,
+                           TcpServer::kMaxBufferSize - connection->partial.size());
+    if (status != StreamCodec::Inflater::Ok) {
+        emit server_->logMessage(QString(status == StreamCodec::Inflater::TooLarge
+                                             ? "Client %1: buffer overflow, disconnecting"
+                                             : "Client %1: corrupt compressed stream, disconnecting")
+                                 .arg(connection->client_id));
+        closeConnection(fd);
+        return false;
+    }
+    return splitFrames(fd, plain.constData(), plain.size());
+}
+
+bool NativeBackend::splitFrames(int fd, const char *data, qint64 size)
+{
+    auto connection = connections_.find(fd);
+    const bool compressed = !connection->inflater.isNull();
+    const char *begin = data;
+    const char *const end = data + size;
+
+    // Хвост прошлого чтения дополняется до конца кадра
+    if (!connection->partial.isEmpty()) {
+        const char *newline = static_cast<const char*>(std::memchr(begin, kMessageDelimiter,
+                                                                   size_t(end - begin)));
+        if (newline) {
+            QByteArray message;
+            message.swap(connection->partial);
+            message.append(begin, int(newline - begin));
+            begin = newline + 1;
+            if (!message.isEmpty() && !handleMessage(fd, message)) {
+                return false;
+            }
+            // Остаток чтения — уже начало сжатого потока
+            if (!compressed && connections_.find(fd)->inflater) {
+                return handleFrames(fd, begin, end - begin);
+            }
+        }
+    }
+
+    if (connections_.find(fd)->partial.isEmpty()) {
+        while (begin < end) {
+            const char *newline = static_cast<const char*>(
+                std::memchr(begin, kMessageDelimiter, size_t(end - begin)));
+            if (!newline) {
+                break;
+            }
+            // Кадр без копии: буфер чтения живет до конца разбора
+            if (newline > begin
+                && !handleMessage(fd, QByteArray::fromRawData(begin, newline - begin))) {
+                return false;
+            }
+            begin = newline + 1;
+            if (!compressed && connections_.find(fd)->inflater) {
+                return handleFrames(fd, begin, end - begin);
+            }
+        }
+    }
+
+    if (begin == end) {
+        return true;
+    }
+
+    connection = connections_.find(fd);
+    connection->partial.append(begin, int(end - begin));
+    if (connection->partial.size() > TcpServer::kMaxBufferSize) {
+        ServerMetrics::increment(Counter::BufferOverflows);
+        emit server_->logMessage(QString("Client %1: buffer overflow, disconnecting")
+                                 .arg(connection->client_id));
+        closeConnection(fd);
+        return false;
+    }
+    return true;
+}
+
+bool NativeBackend::handleMessage(int fd, const QByteArray &message)
+{
+    auto connection = connections_.find(fd);
+    if (connection->awaiting_hello) {
+        connection->awaiting_hello = false;
+
+        if (TcpServer::isRelayHello(message)) {
+            emit server_->logMessage(QString("Relay links are not accepted by the %1 backend, "
+                                             "run the central server with --backend qt")
+                                     .arg(name()));
+            closeConnection(fd);
+            return false;
+        }
+
+        const QJsonObject hello = QJsonDocument::fromJson(message).object();
+        const bool is_hello = hello["type"].toString() == "Hello";
+        QString device_id = hello["device_id"].toString();
+
+        if (connection->client_id != 0) {
+            // Без кластера клиент уже подтвержден, Hello только для журнала
+            if (is_hello && !device_id.isEmpty()) {
+                emit server_->logMessage(QString("Client %1 is device %2")
+                                         .arg(connection->client_id).arg(device_id));
+            }
+        } else {
+            if (device_id.isEmpty()) {
+                device_id = addressOf(*connection);
+            }
+            QJsonObject redirect;
+            if (!server_->routeDevice(device_id, &redirect)) {
+                connection->closing = true;
+                writeTo(fd, TcpServer::encodeMessage(redirect));
+                return false;
+            }
+            if (!confirm(fd, device_id)) {
+                return false;
+            }
+        }
+        if (is_hello) {
+            return true;
+        }
+        connection = connections_.find(fd);
+    }
+
+    if (TcpServer::isCompressRequest(message) && !connection->inflater) {
+        if (!server_->compression_) {
+            emit server_->logMessage(QString("Client %1: compression was not offered, disconnecting")
+                                     .arg(connection->client_id));
+            closeConnection(fd);
+            return false;
+        }
+        connection->inflater.reset(new StreamCodec::Inflater);
+        return true;
+    }
+
+    if (TcpServer::isPing(message)) {
+        return reply(fd, TcpServer::encodeMessage(TcpServer::pong(message)));
+    }
+
+    server_->submitFrame(connection->client_id, QDateTime::currentMSecsSinceEpoch(), message);
+    return true;
+}
+
+bool NativeBackend::confirm(int fd, const QString &device_id)
+{
+    auto connection = connections_.find(fd);
+    connection->client_id = server_->attachNativeClient(addressOf(*connection),
+                                                        connection->port, device_id);
+    fds_.insert(connection->client_id, fd);
+    return writeTo(fd, TcpServer::encodeMessage(server_->confirmation(connection->client_id)));
+}
+
+bool NativeBackend::reply(int fd, const QByteArray &data)
+{
+    // Ядро уже не принимает, а хвост вырос до предела: без объекта сокета
+    // откладывать команды негде, соединение закрывается сразу
+    const Connection &connection = *connections_.find(fd);
+    if (connection.outbound.size() > TcpServer::kMaxSendBuffer) {
+        ServerMetrics::increment(Counter::SlowConsumerEvictions);
+        emit server_->logMessage(QString("Client %1: not reading, %2 bytes pending, disconnecting")
+                                 .arg(connection.client_id).arg(connection.outbound.size()));
+        closeConnection(fd);
+        return false;
+    }
+    return writeTo(fd, data);
+}
+
+void NativeBackend::forgetConnection(int fd)
+{
+    auto connection = connections_.find(fd);
+    if (connection == connections_.end()) {
+        return;
+    }
+    const int client_id = connection->client_id;
+    connections_.erase(connection);
+
+    if (client_id != 0) {
+        fds_.remove(client_id);
+        server_->detachNativeClient(client_id);
+    }
+}
+
+void NativeBackend::forgetAll()
+{
+    connections_.clear();
+    fds_.clear();
+}
+
+QString NativeBackend::addressOf(const Connection &connection) const
+{
+    const QHostAddress address(connection.address);
+    bool is_ipv4 = false;
+    const quint32 ipv4 = address.toIPv4Address(&is_ipv4);
+    return is_ipv4 ? QHostAddress(ipv4).toString() : address.toString();
+}
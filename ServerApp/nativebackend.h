@@ -0,0 +1,93 @@
+#ifndef NATIVEBACKEND_H
+#define NATIVEBACKEND_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+
+class TcpServer;
+
+namespace StreamCodec {
+class Inflater;
+}
+
+// Base of the device listeners built on raw non-blocking sockets (Linux),
+// for very high counts of mostly idle devices.
+//
+// На соединение нет ни QObject, ни QTcpSocket: только запись в таблице
+// connections_ с дескриптором и хвостом незавершенного кадра. Здесь общая
+// часть — разбор кадров и сессия (Hello, размещение, Ping, команды,
+// журнал, конвейер) через TcpServer, та же, что у соединений Qt.
+// Наследник отвечает только за ввод-вывод: прием, чтение, отправку и
+// закрытие дескрипторов. Связи ретрансляторов не принимаются.
+class NativeBackend : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NativeBackend(TcpServer *server);
+
+    virtual QString name() const = 0;
+
+    virtual bool listen(quint16 port, QString *error) = 0;
+    virtual bool isListening() const = 0;
+    // Close the listener and drop every connection without callbacks
+    virtual void close() = 0;
+
+    // Queue a protocol line to a client; false if it is not connected here
+    bool send(int client_id, const QByteArray &data);
+
+    qint64 bufferedBytes() const;
+    virtual qint64 queuedBytes() const;
+
+protected:
+    struct Connection {
+        int client_id = 0;           // 0, пока не подтвержден (кластер)
+        quint16 port = 0;
+        bool awaiting_hello = true;
+        bool closing = false;        // Закрыть, когда отправится outbound
+        quint32 generation = 0;      // Отличает соединения с одним номером дескриптора
+        quint8 address[16] = {};     // IPv6 или IPv4, отображенный в IPv6
+        QByteArray partial;          // Незавершенный кадр
+        QByteArray outbound;         // Неотправленный хвост ответа
+        QSharedPointer<StreamCodec::Inflater> inflater;   // После Compress
+    };
+
+    // Dual-stack listening socket, as QTcpServer on QHostAddress::Any; -1 on failure
+    static int openListener(quint16 port, QString *error);
+
+    // Register an accepted descriptor; outside a cluster it is confirmed at once
+    void accepted(int fd, const quint8 *address, quint16 port, quint32 generation = 0);
+
+    // Frames of one read; false if the connection was closed meanwhile
+    bool handleFrames(int fd, const char *data, qint64 size);
+
+    // Send now or queue the rest; false if the connection was closed.
+    // Соединение с closing закрывается, как только все отправлено
+    virtual bool writeTo(int fd, const QByteArray &data) = 0;
+    // Release the descriptor, then forgetConnection()
+    virtual void closeConnection(int fd) = 0;
+
+    // Remove the connection from the tables and detach its client
+    void forgetConnection(int fd);
+    // Clear the tables without callbacks (listener shutdown)
+    void forgetAll();
+
+    TcpServer *server_;
+    QHash<int, Connection> connections_;     // По дескриптору
+    QHash<int, int> fds_;                    // client_id -> дескриптор
+
+private:
+    // Split plain bytes into frames
+    bool splitFrames(int fd, const char *data, qint64 size);
+    bool handleMessage(int fd, const QByteArray &message);
+    // writeTo unless the device has stopped reading (outbound over the
+    // limit): then the connection is evicted; false if it was closed
+    bool reply(int fd, const QByteArray &data);
+    // Register the connection as a client; false if it was closed
+    bool confirm(int fd, const QString &device_id);
+    QString addressOf(const Connection &connection) const;
+};
+
+#endif // NATIVEBACKEND_H
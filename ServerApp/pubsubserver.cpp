@@ -0,0 +1,391 @@
+#include "pubsubserver.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+
+#include "builtinsinks.h"
+#include "servermetrics.h"
+
+namespace {
+constexpr char kMessageDelimiter = '\n';
+constexpr int kMaxRequestSize = 16 * 1024;
+
+const char *kTypeNames[] = {"NetworkMetrics", "DeviceStatus", "Log"};
+
+int typeCode(const QString &type)
+{
+    for (int i = 0; i < 3; ++i) {
+        if (type == QLatin1String(kTypeNames[i])) {
+            return i;
+        }
+    }
+    return 3;
+}
+
+QByteArray encodeLine(const QJsonObject &message)
+{
+    return QJsonDocument(message).toJson(QJsonDocument::Compact) + kMessageDelimiter;
+}
+}  // namespace
+
+bool SubscriptionFilter::compile(const QJsonObject &message, SubscriptionFilter *filter,
+                                 QString *error)
+{
+    SubscriptionFilter result;
+
+    // "1-500,42"
+    const QString clients = message["clients"].toString();
+    for (const QString &part : clients.split(',', Qt::SkipEmptyParts)) {
+        bool first_ok = false;
+        const int first = part.section('-', 0, 0).trimmed().toInt(&first_ok);
+        bool last_ok = first_ok;
+        int last = first;
+        if (part.contains('-')) {
+            last = part.section('-', 1).trimmed().toInt(&last_ok);
+        }
+        if (!first_ok || !last_ok || last < first) {
+            *error = QString("invalid client range '%1'").arg(part);
+            return false;
+        }
+        result.client_ranges.append(qMakePair(first, last));
+    }
+
+    for (const QJsonValue &severity : message["severities"].toArray()) {
+        result.severities.insert(severity.toString());
+    }
+
+    const QJsonArray types = message["types"].toArray();
+    if (!types.isEmpty() || !result.severities.isEmpty()) {
+        result.types.fill(false);
+        if (types.isEmpty()) {
+            result.types[2] = true;
+        }
+        for (const QJsonValue &type : types) {
+            result.types[typeCode(type.toString())] = true;
+        }
+    }
+
+    const QString where = message["where"].toString().trimmed();
+    if (!where.isEmpty()) {
+        static const QRegularExpression kPredicate(
+            "^([A-Za-z_][A-Za-z0-9_]*)\\s*(>=|<=|==|!=|>|<)\\s*(.+)$");
+        const QRegularExpressionMatch match = kPredicate.match(where);
+        if (!match.hasMatch()) {
+            *error = QString("invalid predicate '%1'").arg(where);
+            return false;
+        }
+
+        const QString op = match.captured(2);
+        result.has_predicate = true;
+        result.field = match.captured(1);
+        result.op = op == "<" ? Op::Less : op == "<=" ? Op::LessEqual
+                  : op == ">" ? Op::Greater : op == ">=" ? Op::GreaterEqual
+                  : op == "==" ? Op::Equal : Op::NotEqual;
+
+        QString value = match.captured(3).trimmed();
+        result.number = value.toDouble(&result.numeric);
+        if (!result.numeric) {
+            if (result.op != Op::Equal && result.op != Op::NotEqual) {
+                *error = QString("operator %1 needs a number").arg(op);
+                return false;
+            }
+            if (value.size() >= 2 && value.startsWith('"') && value.endsWith('"')) {
+                value = value.mid(1, value.size() - 2);
+            }
+            result.text = value;
+        }
+    }
+
+    *filter = result;
+    return true;
+}
+
+bool SubscriptionFilter::matches(const ClientData &data) const
+{
+    if (!client_ranges.isEmpty()) {
+        bool in_range = false;
+        for (const QPair<int, int> &range : client_ranges) {
+            if (data.client_id >= range.first && data.client_id <= range.second) {
+                in_range = true;
+                break;
+            }
+        }
+        if (!in_range) {
+            return false;
+        }
+    }
+
+    if (!severities.isEmpty() && data.data_type == QLatin1String("Log")
+        && !severities.contains(data.content.value(QLatin1String("severity")).toString())) {
+        return false;
+    }
+
+    if (!has_predicate) {
+        return true;
+    }
+
+    // Записи без поля не проходят ни один предикат
+    const QJsonValue value = data.content.value(field);
+    if (value.isUndefined()) {
+        return false;
+    }
+    if (!numeric) {
+        const bool equal = value.toString() == text;
+        return op == Op::Equal ? equal : !equal;
+    }
+    if (!value.isDouble()) {
+        return false;
+    }
+
+    const double number_value = value.toDouble();
+    switch (op) {
+        case Op::Less: return number_value < number;
+        case Op::LessEqual: return number_value <= number;
+        case Op::Greater: return number_value > number;
+        case Op::GreaterEqual: return number_value >= number;
+        case Op::Equal: return number_value == number;
+        case Op::NotEqual: return number_value != number;
+    }
+    return false;
+}
+
+// Проверяет фильтры и кодирует записи в потоке приемника; готовые
+// фрагменты уходят в поток PubSubServer
+class PubSubSink : public RecordSink
+{
+public:
+    explicit PubSubSink(PubSubServer *server)
+        : server_(server)
+    {
+    }
+
+    QString name() const override
+    {
+        return "pubsub";
+    }
+
+    void writeBatch(const QVector<ClientData> &batch) override
+    {
+        const std::shared_ptr<const SubscriptionIndex> index = server_->index();
+
+        QHash<quint64, QByteArray> frames;
+        quint64 delivered = 0;
+        for (const ClientData &data : batch) {
+            const QVector<SubscriptionFilter> &candidates = index->by_type[typeCode(data.data_type)];
+            if (candidates.isEmpty()) {
+                continue;
+            }
+
+            // Кодируется один раз, только если запись кому-то нужна
+            QByteArray line;
+            for (const SubscriptionFilter &filter : candidates) {
+                if (!filter.matches(data)) {
+                    continue;
+                }
+                if (line.isEmpty()) {
+                    line = encodeRecordLine(data);
+                }
+                frames[filter.subscriber] += line;
+                ++delivered;
+            }
+        }
+
+        if (!frames.isEmpty()) {
+            ServerMetrics::increment(Counter::PubSubDelivered, delivered);
+            server_->post(frames);
+        }
+    }
+
+private:
+    PubSubServer *server_;
+};
+
+PubSubServer::PubSubServer(qint64 max_pending_bytes, QObject *parent)
+    : QObject(parent),
+      max_pending_bytes_(max_pending_bytes),
+      listener_(new QLocalServer(this)),
+      next_subscriber_id_(1),
+      index_(std::make_shared<SubscriptionIndex>())
+{
+    connect(listener_, &QLocalServer::newConnection,
+            this, &PubSubServer::onNewConnection);
+}
+
+PubSubServer::~PubSubServer()
+{
+    stopListening();
+}
+
+std::unique_ptr<RecordSink> PubSubServer::createSink()
+{
+    return std::make_unique<PubSubSink>(this);
+}
+
+bool PubSubServer::startListening(const QString &name)
+{
+    // Имя мог оставить процесс, завершившийся аварийно
+    QLocalServer::removeServer(name);
+    if (!listener_->listen(name)) {
+        emit logMessage(QString("Failed to start pub/sub endpoint: %1")
+                        .arg(listener_->errorString()));
+        return false;
+    }
+
+    emit logMessage(QString("Pub/sub endpoint listening on %1").arg(listener_->fullServerName()));
+    return true;
+}
+
+void PubSubServer::stopListening()
+{
+    listener_->close();
+
+    // abort() сразу шлет disconnected, обработчик которого удаляет
+    // подписчика из subscribers_: перебираем отдельную копию
+    QHash<quint64, Subscriber> subscribers;
+    subscribers.swap(subscribers_);
+    rebuildIndex();
+    for (const Subscriber &subscriber : std::as_const(subscribers)) {
+        subscriber.socket->abort();
+        subscriber.socket->deleteLater();
+    }
+}
+
+void PubSubServer::onNewConnection()
+{
+    while (listener_->hasPendingConnections()) {
+        QLocalSocket *socket = listener_->nextPendingConnection();
+        const quint64 id = next_subscriber_id_++;
+        subscribers_.insert(id, {socket, QByteArray(), false, SubscriptionFilter()});
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, id] { onReadyRead(id); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, id] {
+            auto it = subscribers_.find(id);
+            if (it == subscribers_.end()) {
+                return;
+            }
+            const bool subscribed = it->subscribed;
+            it->socket->deleteLater();
+            subscribers_.erase(it);
+            if (subscribed) {
+                rebuildIndex();
+            }
+        });
+    }
+}
+
+std::shared_ptr<const SubscriptionIndex> PubSubServer::index() const
+{
+    QMutexLocker locker(&index_mutex_);
+    return index_;
+}
+
+void PubSubServer::post(const QHash<quint64, QByteArray> &frames)
+{
+    QMetaObject::invokeMethod(this, [this, frames]() {
+        deliver(frames);
+    }, Qt::QueuedConnection);
+}
+
+void PubSubServer::deliver(const QHash<quint64, QByteArray> &frames)
+{
+    for (auto it = frames.cbegin(); it != frames.cend(); ++it) {
+        // Подписчик мог отключиться, пока пачка была в пути
+        auto subscriber = subscribers_.find(it.key());
+        if (subscriber == subscribers_.end()) {
+            continue;
+        }
+
+        QLocalSocket *socket = subscriber->socket;
+        if (socket->bytesToWrite() + it.value().size() > max_pending_bytes_) {
+            evict(it.key(), QString("%1 bytes pending").arg(socket->bytesToWrite()));
+            continue;
+        }
+        socket->write(it.value());
+    }
+}
+
+void PubSubServer::onReadyRead(quint64 id)
+{
+    auto subscriber = subscribers_.find(id);
+    if (subscriber == subscribers_.end()) {
+        return;
+    }
+
+    subscriber->buffer.append(subscriber->socket->readAll());
+    if (subscriber->buffer.size() > kMaxRequestSize) {
+        evict(id, "request too large");
+        return;
+    }
+
+    int delimiter_pos;
+    while ((delimiter_pos = subscriber->buffer.indexOf(kMessageDelimiter)) >= 0) {
+        const QByteArray line = subscriber->buffer.left(delimiter_pos);
+        subscriber->buffer.remove(0, delimiter_pos + 1);
+
+        const QJsonObject message = QJsonDocument::fromJson(line).object();
+        QJsonObject reply;
+        QString error;
+        SubscriptionFilter filter;
+        if (message["type"].toString() != "Subscribe") {
+            reply["type"] = "Error";
+            reply["message"] = "expected Subscribe";
+        } else if (!SubscriptionFilter::compile(message, &filter, &error)) {
+            reply["type"] = "Error";
+            reply["message"] = error;
+        } else {
+            // Повторный Subscribe заменяет фильтр
+            filter.subscriber = id;
+            subscriber->filter = filter;
+            subscriber->subscribed = true;
+            rebuildIndex();
+            reply["type"] = "Subscribed";
+            reply["id"] = static_cast<qint64>(id);
+            emit logMessage(QString("Subscriber %1: %2")
+                            .arg(id).arg(QString::fromUtf8(line)));
+        }
+        subscriber->socket->write(encodeLine(reply));
+    }
+}
+
+void PubSubServer::evict(quint64 id, const QString &reason)
+{
+    auto subscriber = subscribers_.find(id);
+    if (subscriber == subscribers_.end()) {
+        return;
+    }
+
+    QLocalSocket *socket = subscriber->socket;
+    const bool subscribed = subscriber->subscribed;
+    subscribers_.erase(subscriber);
+    socket->abort();
+    socket->deleteLater();
+    if (subscribed) {
+        rebuildIndex();
+    }
+
+    ServerMetrics::increment(Counter::PubSubEvicted);
+    emit logMessage(QString("Subscriber %1 evicted: %2").arg(id).arg(reason));
+}
+
+void PubSubServer::rebuildIndex()
+{
+    auto index = std::make_shared<SubscriptionIndex>();
+    int subscribed = 0;
+    for (const Subscriber &subscriber : std::as_const(subscribers_)) {
+        if (!subscriber.subscribed) {
+            continue;
+        }
+        ++subscribed;
+        for (int type = 0; type < 4; ++type) {
+            if (subscriber.filter.types[type]) {
+                index->by_type[type].append(subscriber.filter);
+            }
+        }
+    }
+
+    ServerMetrics::setGauge(Gauge::PubSubSubscribers, subscribed);
+
+    QMutexLocker locker(&index_mutex_);
+    index_ = std::move(index);
+}
@@ -0,0 +1,111 @@
+#ifndef PUBSUBSERVER_H
+#define PUBSUBSERVER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+
+#include <array>
+#include <memory>
+
+#include "recordsink.h"
+
+// Subscription filter compiled from a Subscribe message.
+//
+//   {"type":"Subscribe","clients":"1-500,42","types":["Log"],
+//    "severities":["ERROR"],"where":"latency > 100"}
+//
+// Все поля необязательны. severities без types означает только Log.
+// where — "поле оп значение", оп: > >= < <= == !=; строковое значение
+// допускается для == и !=.
+struct SubscriptionFilter {
+    enum class Op { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+    quint64 subscriber = 0;
+    QVector<QPair<int, int>> client_ranges;     // Пусто — все клиенты
+    QSet<QString> severities;                   // Пусто — любая
+    bool has_predicate = false;
+    QString field;
+    Op op = Op::Equal;
+    bool numeric = true;
+    double number = 0.0;
+    QString text;
+
+    // Type codes the filter selects: 0 NetworkMetrics, 1 DeviceStatus, 2 Log, 3 other
+    std::array<bool, 4> types{{true, true, true, true}};
+
+    static bool compile(const QJsonObject &message, SubscriptionFilter *filter, QString *error);
+    bool matches(const ClientData &data) const;
+};
+
+// Immutable index of all subscriptions by record type; replaced as a whole
+// when a subscriber joins or leaves
+struct SubscriptionIndex {
+    std::array<QVector<SubscriptionFilter>, 4> by_type;
+};
+
+// Live stream of parsed records to local subscribers (dashboards, scripts).
+//
+// Подписчики подключаются к QLocalServer и присылают Subscribe; в ответ
+// приходит {"type":"Subscribed"} и затем записи в формате JSON lines
+// (encodeRecordLine). Фильтры проверяются в потоке приемника pubsub по
+// индексу, разложенному по типам, а каждая запись кодируется один раз
+// независимо от числа подписчиков. Если у подписчика накопилось больше
+// max_pending_bytes неотправленных данных, он отключается.
+class PubSubServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PubSubServer(qint64 max_pending_bytes = 8 * 1024 * 1024, QObject *parent = nullptr);
+    ~PubSubServer();
+
+    // Sink feeding subscribers; register it in the server pipeline
+    std::unique_ptr<RecordSink> createSink();
+
+public slots:
+    bool startListening(const QString &name);
+    void stopListening();
+
+signals:
+    void logMessage(const QString &message);
+
+private slots:
+    void onNewConnection();
+
+private:
+    friend class PubSubSink;
+
+    struct Subscriber {
+        QLocalSocket *socket;
+        QByteArray buffer;          // Неполная строка от подписчика
+        bool subscribed;
+        SubscriptionFilter filter;
+    };
+
+    // Thread-safe snapshot of the current index
+    std::shared_ptr<const SubscriptionIndex> index() const;
+
+    // Thread-safe: queue encoded frames for subscribers
+    void post(const QHash<quint64, QByteArray> &frames);
+
+    // Run in the server thread
+    void deliver(const QHash<quint64, QByteArray> &frames);
+    void onReadyRead(quint64 id);
+    void evict(quint64 id, const QString &reason);
+    void rebuildIndex();
+
+    const qint64 max_pending_bytes_;
+    QLocalServer *listener_;
+    QHash<quint64, Subscriber> subscribers_;
+    quint64 next_subscriber_id_;
+
+    mutable QMutex index_mutex_;
+    std::shared_ptr<const SubscriptionIndex> index_;
+};
+
+#endif // PUBSUBSERVER_H
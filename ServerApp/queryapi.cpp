@@ -0,0 +1,154 @@
+#include "queryapi.h"
+
+#include <QDateTime>
+
+#include "telemetrystore.h"
+
+namespace {
+constexpr int kDefaultWindowSeconds = 3600;
+constexpr int kRowsPerChunk = 256;  // Строк в одном фрагменте ответа
+
+// Parse "1-500" or "7" into an inclusive client id range
+bool parseClientRange(const QString &text, int *first, int *last)
+{
+    bool ok_first = false;
+    bool ok_last = false;
+    int dash = text.indexOf('-');
+    if (dash < 0) {
+        *first = text.toInt(&ok_first);
+        *last = *first;
+        return ok_first;
+    }
+    *first = text.left(dash).toInt(&ok_first);
+    *last = text.mid(dash + 1).toInt(&ok_last);
+    return ok_first && ok_last && *first <= *last;
+}
+
+// Fill query from URL parameters, returns error text on failure
+QString parseQuery(const QUrlQuery &params, TelemetryQuery *query, bool *csv)
+{
+    if (!TelemetryStore::metricFromName(params.queryItemValue("metric"), &query->metric)) {
+        return "unknown or missing 'metric'";
+    }
+
+    if (params.hasQueryItem("agg")
+        && !TelemetryStore::aggregationFromName(params.queryItemValue("agg"),
+                                                &query->aggregation)) {
+        return "unknown 'agg'";
+    }
+
+    if (params.hasQueryItem("clients")
+        && !parseClientRange(params.queryItemValue("clients"),
+                             &query->first_client, &query->last_client)) {
+        return "invalid 'clients', expected e.g. 1-500";
+    }
+
+    if (params.hasQueryItem("bucket")) {
+        bool ok = false;
+        int bucket = params.queryItemValue("bucket").toInt(&ok);
+        if (!ok || bucket < 60 || bucket % 60 != 0) {
+            return "'bucket' must be a positive multiple of 60 seconds";
+        }
+        query->bucket_seconds = bucket;
+    }
+
+    const qint64 now_ms = QDateTime::currentMSecsSinceEpoch();
+    if (params.hasQueryItem("from")) {
+        bool ok_from = false;
+        bool ok_to = true;
+        query->from_ms = params.queryItemValue("from").toLongLong(&ok_from) * 1000;
+        query->to_ms = params.hasQueryItem("to")
+            ? params.queryItemValue("to").toLongLong(&ok_to) * 1000
+            : now_ms;
+        if (!ok_from || !ok_to || query->from_ms > query->to_ms) {
+            return "invalid 'from'/'to'";
+        }
+    } else {
+        bool ok = true;
+        qint64 window = params.hasQueryItem("last")
+            ? params.queryItemValue("last").toLongLong(&ok)
+            : kDefaultWindowSeconds;
+        if (!ok || window <= 0) {
+            return "invalid 'last'";
+        }
+        query->to_ms = now_ms;
+        query->from_ms = now_ms - window * 1000;
+    }
+
+    query->group_by_client = params.queryItemValue("group_by") == "client";
+
+    const QString format = params.queryItemValue("format");
+    if (!format.isEmpty() && format != "json" && format != "csv") {
+        return "unknown 'format'";
+    }
+    *csv = format == "csv";
+    return QString();
+}
+
+QByteArray formatRow(const QueryPoint &point, const TelemetryQuery &query, bool csv)
+{
+    const QByteArray value = QByteArray::number(point.value.value(query.aggregation), 'g', 10);
+    const QByteArray time = QByteArray::number(point.bucket_start_ms);
+    const QByteArray count = QByteArray::number(point.value.count);
+
+    if (csv) {
+        QByteArray row = time + ',';
+        if (query.group_by_client) {
+            row += QByteArray::number(point.client_id) + ',';
+        }
+        return row + value + ',' + count + '\n';
+    }
+
+    QByteArray row = "{\"t\":" + time;
+    if (query.group_by_client) {
+        row += ",\"client_id\":" + QByteArray::number(point.client_id);
+    }
+    return row + ",\"value\":" + value + ",\"count\":" + count + '}';
+}
+}  // namespace
+
+HttpHandler makeQueryHandler(const TelemetryStore *store)
+{
+    return [store](const HttpRequest &request, HttpResponseStream &response) {
+        TelemetryQuery query;
+        bool csv = false;
+        QString error = parseQuery(request.query, &query, &csv);
+        if (!error.isEmpty()) {
+            response.send(400, "text/plain", error.toUtf8() + '\n');
+            return;
+        }
+
+        // Выполняется в потоке пула запросов, поток приема не затрагивается
+        const QVector<QueryPoint> points = store->query(query);
+
+        QByteArray chunk;
+        if (csv) {
+            response.begin(200, "text/csv");
+            chunk = query.group_by_client ? "t,client_id,value,count\n" : "t,value,count\n";
+        } else {
+            response.begin(200, "application/json");
+            chunk = "{\"metric\":\"" + TelemetryStore::metricName(query.metric).toLatin1()
+                    + "\",\"agg\":\"" + TelemetryStore::aggregationName(query.aggregation).toLatin1()
+                    + "\",\"bucket\":" + QByteArray::number(query.bucket_seconds)
+                    + ",\"points\":[";
+        }
+
+        // Результат отдается по частям, не дожидаясь форматирования всех строк
+        for (int i = 0; i < points.size(); ++i) {
+            if (!csv && i > 0) {
+                chunk += ',';
+            }
+            chunk += formatRow(points[i], query, csv);
+            if ((i + 1) % kRowsPerChunk == 0) {
+                response.write(chunk);
+                chunk.clear();
+            }
+        }
+
+        if (!csv) {
+            chunk += "]}\n";
+        }
+        response.write(chunk);
+        response.end();
+    };
+}
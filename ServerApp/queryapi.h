@@ -0,0 +1,24 @@
+#ifndef QUERYAPI_H
+#define QUERYAPI_H
+
+#include "localhttpserver.h"
+
+class TelemetryStore;
+
+// Handler for GET /query over the telemetry store.
+//
+// Parameters:
+//   metric   - bandwidth | latency | packet_loss | uptime | cpu_usage | memory_usage
+//   agg      - avg (default) | min | max | sum | count
+//   clients  - "1-500" or a single id (default: all clients)
+//   bucket   - bucket size in seconds, multiple of 60 (default 60);
+//              multiples of 3600 use the hourly tier with longer retention
+//   last     - window ending now, in seconds (default 3600),
+//              or from/to as Unix time in seconds
+//   group_by - "client" to get a separate series per client
+//   format   - json (default) | csv
+//
+// Example: /query?metric=latency&agg=avg&clients=1-500&bucket=60&last=21600
+HttpHandler makeQueryHandler(const TelemetryStore *store);
+
+#endif // QUERYAPI_H
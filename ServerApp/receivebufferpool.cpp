@@ -0,0 +1,93 @@
+#include "receivebufferpool.h"
+
+#include <cstring>
+
+namespace {
+constexpr qint64 kSmallestClass = 4 * 1024;
+constexpr int kClassGrowth = 4;
+}  // namespace
+
+ReceiveBufferPool::ReceiveBufferPool(qint64 limit_bytes)
+    : limit_(limit_bytes),
+      granted_(0)
+{
+}
+
+void ReceiveBufferPool::setLimit(qint64 limit_bytes)
+{
+    limit_ = limit_bytes;
+}
+
+qint64 ReceiveBufferPool::limit() const
+{
+    return limit_;
+}
+
+bool ReceiveBufferPool::reserve(QByteArray *buffer, qint64 size)
+{
+    // Данные буферов пула всегда лежат с начала блока (см. settle), так что
+    // емкости хватает и для дописывания в конец
+    if (size <= buffer->capacity()) {
+        return true;
+    }
+
+    const qint64 target = classSize(size);
+    if (granted_ + target - buffer->capacity() > limit_) {
+        return false;
+    }
+
+    QByteArray grown;
+    grown.reserve(target);
+    grown.append(buffer->constData(), buffer->size());
+    granted_ += grown.capacity() - buffer->capacity();
+    buffer->swap(grown);
+    return true;
+}
+
+void ReceiveBufferPool::settle(QByteArray *buffer, qsizetype consumed)
+{
+    const qsizetype rest = buffer->size() - consumed;
+    if (rest <= 0) {
+        release(buffer);
+        return;
+    }
+
+    // Остаток помещается в класс поменьше: новый блок, копируется только
+    // хвост незавершенного кадра
+    const qint64 target = classSize(rest);
+    if (target * kClassGrowth <= buffer->capacity()) {
+        QByteArray compact;
+        compact.reserve(target);
+        compact.append(buffer->constData() + consumed, rest);
+        granted_ += compact.capacity() - buffer->capacity();
+        buffer->swap(compact);
+        return;
+    }
+
+    // Иначе блок тот же: кадр, приходящий частями, не копируется на
+    // каждой части, а хвост сдвигается к началу только после разбора
+    if (consumed > 0) {
+        std::memmove(buffer->data(), buffer->constData() + consumed, size_t(rest));
+        buffer->resize(rest);
+    }
+}
+
+void ReceiveBufferPool::release(QByteArray *buffer)
+{
+    granted_ -= buffer->capacity();
+    *buffer = QByteArray();
+}
+
+qint64 ReceiveBufferPool::grantedBytes() const
+{
+    return granted_;
+}
+
+qint64 ReceiveBufferPool::classSize(qint64 size)
+{
+    qint64 size_class = kSmallestClass;
+    while (size_class < size) {
+        size_class *= kClassGrowth;
+    }
+    return size_class;
+}
@@ -0,0 +1,41 @@
+#ifndef RECEIVEBUFFERPOOL_H
+#define RECEIVEBUFFERPOOL_H
+
+#include <QByteArray>
+
+// Receive buffers of device connections: capacity in size classes, with
+// one limit on the total.
+//
+// Буфер соединения растет ступенями (4 KB, 16 KB, 64 KB, 256 KB, 1 MB) по
+// мере надобности. После разбора кадров остаток сдвигается к началу того
+// же блока, в блок меньшего класса он переезжает, только если помещается
+// в него, а пустой буфер освобождается совсем. Простаивающее соединение
+// буфера не держит, и всплеск не оставляет за собой мегабайт емкости на
+// каждом соединении. Блоки одних и тех же размеров переиспользует malloc.
+// Используется только потоком сервера.
+class ReceiveBufferPool
+{
+public:
+    explicit ReceiveBufferPool(qint64 limit_bytes);
+
+    void setLimit(qint64 limit_bytes);
+    qint64 limit() const;
+
+    // Capacity for size bytes, content kept; false if over the total limit
+    bool reserve(QByteArray *buffer, qint64 size);
+    // After parsing: drop the consumed head in place, move what is left to
+    // a smaller class only when it fits one, free if empty
+    void settle(QByteArray *buffer, qsizetype consumed);
+    void release(QByteArray *buffer);
+
+    // Capacity held by all buffers
+    qint64 grantedBytes() const;
+
+    static qint64 classSize(qint64 size);
+
+private:
+    qint64 limit_;
+    qint64 granted_;
+};
+
+#endif // RECEIVEBUFFERPOOL_H
@@ -0,0 +1,104 @@
+#ifndef RECORDSINK_H
+#define RECORDSINK_H
+
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#include "tcpserver.h"
+
+// Поведение при переполнении очереди медленного приемника
+enum class SlowSinkPolicy {
+    Block,   // Ждать места в очереди (задерживает стадию оценки!)
+    Drop,    // Отбросить запись
+    Spill    // Записать во временный файл и дочитать, когда приемник догонит
+};
+
+// Параметры доставки записей приемнику
+struct SinkOptions {
+    int queue_capacity = 8192;
+    int max_batch_size = 512;        // Записей в одной пачке
+    int max_batch_delay_ms = 50;     // Максимальное ожидание неполной пачки
+    SlowSinkPolicy policy = SlowSinkPolicy::Drop;
+    QString spill_directory;         // Для Spill; пусто — временный каталог
+    qint64 spill_max_bytes = 256 * 1024 * 1024;  // Предел файла Spill, сверх — отбросить
+};
+
+// Consumer of parsed records (plugin interface).
+//
+// Все методы вызываются в собственном потоке приемника (см. SinkRunner),
+// поэтому реализация может выполнять блокирующий ввод-вывод и не обязана
+// быть потокобезопасной.
+class RecordSink
+{
+public:
+    virtual ~RecordSink() = default;
+
+    virtual QString name() const = 0;
+
+    // Minimum batch size the sink wants (e.g. rows per transaction), 0 — any
+    virtual int preferredBatchSize() const { return 0; }
+
+    // Called before the first batch; returning false disables the sink
+    virtual bool open(QString *error) { Q_UNUSED(error); return true; }
+
+    // Also receive device connect/disconnect markers (data_type
+    // IngestPipeline::kDeviceEventType), in order with the device's records
+    virtual bool wantsDeviceEvents() const { return false; }
+
+    // Records in arrival order (per client)
+    virtual void writeBatch(const QVector<ClientData> &batch) = 0;
+
+    // Records still waiting for the sink, reported before each batch
+    virtual void reportQueueDepth(qint64 depth) { Q_UNUSED(depth); }
+
+    // Called after the last batch
+    virtual void close() {}
+};
+
+// Sink that hands each record to a function (GUI signal, in-memory store)
+class CallbackSink : public RecordSink
+{
+public:
+    using Callback = std::function<void(const ClientData &data)>;
+
+    CallbackSink(const QString &name, Callback callback)
+        : name_(name), callback_(std::move(callback)) {}
+
+    QString name() const override { return name_; }
+
+    void writeBatch(const QVector<ClientData> &batch) override
+    {
+        for (const ClientData &data : batch) {
+            callback_(data);
+        }
+    }
+
+private:
+    QString name_;
+    Callback callback_;
+};
+
+// Sink that hands each batch to a function as a whole
+class BatchCallbackSink : public RecordSink
+{
+public:
+    using Callback = std::function<void(const QVector<ClientData> &batch)>;
+
+    BatchCallbackSink(const QString &name, Callback callback)
+        : name_(name), callback_(std::move(callback)) {}
+
+    QString name() const override { return name_; }
+
+    void writeBatch(const QVector<ClientData> &batch) override
+    {
+        callback_(batch);
+    }
+
+private:
+    QString name_;
+    Callback callback_;
+};
+
+#endif // RECORDSINK_H
@@ -0,0 +1,310 @@
+#include "relayuplink.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QPointer>
+
+#include "ingestpipeline.h"
+#include "servermetrics.h"
+
+namespace {
+constexpr char kMessageDelimiter = '\n';
+constexpr int kReconnectIntervalMs = 1000;
+
+// Не копим в буфере отправки больше этого: пачки отбрасываются, как и
+// при отсутствии соединения
+constexpr qint64 kMaxLinkBacklog = 16 * 1024 * 1024;
+
+QByteArray encodeLine(const QJsonObject &message)
+{
+    return QJsonDocument(message).toJson(QJsonDocument::Compact) + kMessageDelimiter;
+}
+
+// is_connected: подключение или отключение
+QByteArray deviceEventLine(const ClientInfo &info)
+{
+    QJsonObject event;
+    event["type"] = "RelayDevice";
+    event["device"] = info.id;
+    event["event"] = info.is_connected ? "connected" : "disconnected";
+    if (info.is_connected) {
+        event["address"] = info.ip_address;
+        event["port"] = info.port;
+    }
+    return encodeLine(event);
+}
+}  // namespace
+
+// Кодирует пачку по соединениям в потоке приемника и передает ее в
+// поток RelayUplink. События устройств приходят сюда же через конвейер,
+// после записей, принятых до них, и пишутся в поток соединения между
+// пачками кадров в том же порядке
+class RelaySink : public RecordSink
+{
+public:
+    explicit RelaySink(RelayUplink *uplink)
+        : uplink_(uplink), link_count_(uplink->linkCount())
+    {
+    }
+
+    QString name() const override
+    {
+        return "relay";
+    }
+
+    int preferredBatchSize() const override
+    {
+        return 1024;
+    }
+
+    bool wantsDeviceEvents() const override
+    {
+        return true;
+    }
+
+    void writeBatch(const QVector<ClientData> &batch) override
+    {
+        QVector<LinkOutput> outputs(link_count_);
+
+        for (const ClientData &data : batch) {
+            const int link = static_cast<unsigned>(data.client_id) % link_count_;
+            LinkOutput &output = outputs[link];
+
+            if (data.data_type == IngestPipeline::kDeviceEventType) {
+                // Кадры, принятые до события, уходят перед ним
+                closeFrames(&output);
+                const QJsonObject &event = data.content;
+                ClientInfo info;
+                info.id = data.client_id;
+                info.ip_address = event.value(QLatin1String("address")).toString();
+                info.port = static_cast<quint16>(event.value(QLatin1String("port")).toInt());
+                info.is_connected = event.value(QLatin1String("event")).toString() == "connected";
+                info.is_running = false;
+                output.data += deviceEventLine(info);
+                output.events.append(info);
+                continue;
+            }
+
+            output.frames.append(QJsonArray{data.client_id, data.timestamp.toMSecsSinceEpoch()});
+            // Исходные байты кадра (PipelineConfig::keep_frames); запись без
+            // них — восстановленная дельта или дочитанная из файла
+            // вытеснения — кодируется заново
+            if (!data.frame.isEmpty()) {
+                output.bodies += data.frame;
+            } else {
+                output.bodies += QJsonDocument(data.content).toJson(QJsonDocument::Compact);
+            }
+            output.bodies += kMessageDelimiter;
+            ++output.records;
+        }
+
+        for (int link = 0; link < link_count_; ++link) {
+            LinkOutput &output = outputs[link];
+            closeFrames(&output);
+            if (output.data.isEmpty()) {
+                continue;
+            }
+
+            QPointer<RelayUplink> uplink = uplink_;
+            QMetaObject::invokeMethod(uplink_, [uplink, link, output] {
+                if (uplink) {
+                    uplink->sendBatch(link, output.data, output.records, output.events);
+                }
+            }, Qt::QueuedConnection);
+        }
+    }
+
+private:
+    struct LinkOutput {
+        QByteArray data;                // Строки в порядке записей
+        QJsonArray frames;              // Незакрытая пачка кадров
+        QByteArray bodies;
+        int records = 0;
+        QVector<ClientInfo> events;
+    };
+
+    static void closeFrames(LinkOutput *output)
+    {
+        if (output->frames.isEmpty()) {
+            return;
+        }
+        QJsonObject header;
+        header["type"] = "RelayBatch";
+        header["frames"] = output->frames;
+        output->data += encodeLine(header);
+        output->data += output->bodies;
+        output->frames = QJsonArray();
+        output->bodies.clear();
+    }
+
+    RelayUplink *uplink_;
+    const int link_count_;
+};
+
+RelayUplink::RelayUplink(TcpServer *server, const QString &host, quint16 port, int link_count,
+                         QObject *parent)
+    : QObject(parent),
+      server_(server),
+      host_(host),
+      port_(port),
+      links_(qMax(1, link_count)),
+      reconnect_timer_(new QTimer(this))
+{
+    connect(reconnect_timer_, &QTimer::timeout,
+            this, &RelayUplink::onReconnectTimer);
+    connect(server_, &TcpServer::clientConnected,
+            this, &RelayUplink::onDeviceConnected);
+    connect(server_, &TcpServer::clientDisconnected,
+            this, &RelayUplink::onDeviceDisconnected);
+}
+
+RelayUplink::~RelayUplink()
+{
+    stop();
+}
+
+std::unique_ptr<RecordSink> RelayUplink::createSink()
+{
+    return std::make_unique<RelaySink>(this);
+}
+
+int RelayUplink::linkCount() const
+{
+    return links_.size();
+}
+
+void RelayUplink::start()
+{
+    // Сокеты создаются в потоке сервера, где и используются
+    for (int i = 0; i < links_.size(); ++i) {
+        QTcpSocket *socket = new QTcpSocket(this);
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::connected, this, [this, i] { onLinkConnected(i); });
+        connect(socket, &QTcpSocket::readyRead, this, [this, i] { onLinkReadyRead(i); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, i] {
+            emit logMessage(QString("Relay link %1 to %2:%3 lost").arg(i).arg(host_).arg(port_));
+        });
+        links_[i].socket = socket;
+        socket->connectToHost(host_, port_);
+    }
+    reconnect_timer_->start(kReconnectIntervalMs);
+}
+
+void RelayUplink::stop()
+{
+    reconnect_timer_->stop();
+    for (Link &link : links_) {
+        if (link.socket) {
+            link.socket->disconnectFromHost();
+            link.socket->deleteLater();
+            link.socket = nullptr;
+        }
+    }
+}
+
+void RelayUplink::sendBatch(int link, const QByteArray &data, int records,
+                            const QVector<ClientInfo> &events)
+{
+    // Список для переобъявления ведется в порядке потока соединения
+    for (const ClientInfo &info : events) {
+        if (info.is_connected) {
+            devices_.insert(info.id, info);
+        } else {
+            devices_.remove(info.id);
+        }
+    }
+
+    QTcpSocket *socket = links_[link].socket;
+    if (!isConnected(link)) {
+        // Устройства объявятся заново при переподключении
+        ServerMetrics::increment(Counter::SinkDropped, records);
+        return;
+    }
+    if (socket->bytesToWrite() > kMaxLinkBacklog) {
+        // Кадры отбрасываются, события — нет: иначе сервер потеряет
+        // устройство или не узнает о его отключении
+        ServerMetrics::increment(Counter::SinkDropped, records);
+        for (const ClientInfo &info : events) {
+            socket->write(deviceEventLine(info));
+        }
+        return;
+    }
+
+    socket->write(data);
+    ServerMetrics::increment(Counter::BytesOut, data.size());
+    ServerMetrics::increment(Counter::RelayForwarded, records);
+}
+
+void RelayUplink::onLinkConnected(int link)
+{
+    emit logMessage(QString("Relay link %1 connected to %2:%3").arg(link).arg(host_).arg(port_));
+
+    // Сервер узнает связь по началу первой строки, поэтому без QJsonDocument
+    // (он упорядочивает ключи)
+    links_[link].socket->write("{\"type\":\"RelayHello\"}\n");
+    links_[link].buffer.clear();
+
+    // Сервер не помнит устройства прошлого соединения: объявляем заново
+    for (const ClientInfo &info : std::as_const(devices_)) {
+        if (static_cast<unsigned>(info.id) % links_.size() == static_cast<unsigned>(link)) {
+            links_[link].socket->write(deviceEventLine(info));
+        }
+    }
+}
+
+void RelayUplink::onLinkReadyRead(int link)
+{
+    QByteArray &buffer = links_[link].buffer;
+    buffer.append(links_[link].socket->readAll());
+
+    int delimiter_pos;
+    while ((delimiter_pos = buffer.indexOf(kMessageDelimiter)) >= 0) {
+        const QByteArray line = buffer.left(delimiter_pos);
+        buffer.remove(0, delimiter_pos + 1);
+
+        const QJsonObject message = QJsonDocument::fromJson(line).object();
+        if (message["type"].toString() == "Command") {
+            handleCommand(message);
+        }
+        // ConnectionConfirm и прочие сообщения ретранслятору не нужны
+    }
+}
+
+void RelayUplink::handleCommand(const QJsonObject &command)
+{
+    const bool start = command["command"].toString() == "start";
+    if (!command.contains("device")) {
+        start ? server_->startAllClients() : server_->stopAllClients();
+        return;
+    }
+
+    const int device = command["device"].toInt();
+    start ? server_->startClient(device) : server_->stopClient(device);
+}
+
+void RelayUplink::onDeviceConnected(const ClientInfo &info)
+{
+    // Через конвейер, чтобы событие шло по соединению в одном потоке с
+    // кадрами устройства: отключение не обгонит последние кадры
+    server_->pipeline()->submitDeviceEvent(info.id, true, info.ip_address, info.port);
+}
+
+void RelayUplink::onDeviceDisconnected(int client_id)
+{
+    server_->pipeline()->submitDeviceEvent(client_id, false);
+}
+
+void RelayUplink::onReconnectTimer()
+{
+    for (Link &link : links_) {
+        if (link.socket && link.socket->state() == QAbstractSocket::UnconnectedState) {
+            link.socket->connectToHost(host_, port_);
+        }
+    }
+}
+
+bool RelayUplink::isConnected(int link) const
+{
+    return links_[link].socket
+        && links_[link].socket->state() == QAbstractSocket::ConnectedState;
+}
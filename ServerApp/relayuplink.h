@@ -0,0 +1,93 @@
+#ifndef RELAYUPLINK_H
+#define RELAYUPLINK_H
+
+#include <QHash>
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+#include "recordsink.h"
+
+// Upstream side of a relay (aggregator) node.
+//
+// Ретранслятор — обычный TcpServer со своим конвейером: он принимает
+// локальные устройства, разбирает кадры и проверяет пороги на месте, а
+// приемник relay пачками пересылает записи центральному серверу по
+// нескольким постоянным соединениям. Устройство закреплено за соединением
+// (device % links), поэтому порядок его записей сохраняется.
+//
+// Протокол соединения (строки JSON, как у устройств):
+//   -> {"type":"RelayHello"}                                  первая строка
+//   -> {"type":"RelayDevice","device":N,"event":"connected"|"disconnected",
+//       "address":...,"port":...}
+//   -> {"type":"RelayBatch","frames":[[device,received_ms],...]}
+//      и следом столько же строк — кадры устройств без изменений
+//   <- {"type":"Command","command":"start"|"stop","device":N}
+//      без "device" команда относится ко всем устройствам ретранслятора
+//
+// События устройств идут через конвейер (IngestPipeline::submitDeviceEvent)
+// и пишутся в соединение приемником в одном потоке с кадрами: отключение
+// не обгоняет последние кадры устройства. Центральный сервер отбрасывает
+// кадры необъявленных устройств.
+//
+// Объект живет в потоке TcpServer; пачки кодируются в потоке приемника и
+// передаются сюда через очередь событий.
+class RelayUplink : public QObject
+{
+    Q_OBJECT
+
+public:
+    RelayUplink(TcpServer *server, const QString &host, quint16 port, int link_count,
+                QObject *parent = nullptr);
+    ~RelayUplink();
+
+    // Sink that forwards records upstream; register it in the server pipeline
+    std::unique_ptr<RecordSink> createSink();
+
+    int linkCount() const;
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void logMessage(const QString &message);
+
+private slots:
+    void onDeviceConnected(const ClientInfo &info);
+    void onDeviceDisconnected(int client_id);
+    void onReconnectTimer();
+
+private:
+    struct Link {
+        QTcpSocket *socket = nullptr;
+        QByteArray buffer;          // Неполная строка от сервера
+    };
+
+    friend class RelaySink;
+
+    // Called from the sink thread via the event queue; events are the
+    // device announcements contained in data, in order
+    void sendBatch(int link, const QByteArray &data, int records,
+                   const QVector<ClientInfo> &events);
+
+    void onLinkConnected(int link);
+    void onLinkReadyRead(int link);
+    void handleCommand(const QJsonObject &command);
+    bool isConnected(int link) const;
+
+    TcpServer *server_;
+    const QString host_;
+    const quint16 port_;
+    QVector<Link> links_;
+    QTimer *reconnect_timer_;
+
+    // Подключенные локальные устройства по событиям, уже ушедшим в
+    // соединение; объявляются заново при переподключении
+    QHash<int, ClientInfo> devices_;
+};
+
+#endif // RELAYUPLINK_H
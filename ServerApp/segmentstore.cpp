@@ -0,0 +1,559 @@
+#include "segmentstore.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <utility>
+
+#include <zlib.h>
+
+#if defined(Q_OS_LINUX)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "builtinsinks.h"
+#include "servermetrics.h"
+
+namespace {
+const QString kOpenSuffix = QStringLiteral(".open");
+const QString kCompressedSuffix = QStringLiteral(".z");
+const QString kMergeSuffix = QStringLiteral(".merge");
+
+// Порция ввода-вывода компактора между проверками ограничения скорости
+constexpr qint64 kIoChunk = 1024 * 1024;
+constexpr qint64 kMsPerHour = 60 * 60 * 1000;
+
+QString closedSegmentName(qint64 first_ms, qint64 last_ms)
+{
+    return QString("seg-%1-%2.jsonl").arg(first_ms).arg(last_ms);
+}
+
+#if defined(Q_OS_LINUX)
+// Класс ввода-вывода idle для текущего потока (linux/ioprio.h)
+void setIdleIoPriority()
+{
+    constexpr int kIoprioWhoProcess = 1;
+    constexpr int kIoprioClassIdle = 3;
+    constexpr int kIoprioClassShift = 13;
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+}
+#endif
+}  // namespace
+
+SegmentFileSink::SegmentFileSink(const QString &name, const QString &directory,
+                                 qint64 max_segment_bytes, int max_segment_seconds)
+    : name_(name),
+      directory_(directory),
+      max_segment_bytes_(max_segment_bytes),
+      max_segment_seconds_(max_segment_seconds)
+{
+}
+
+SegmentFileSink::~SegmentFileSink()
+{
+    close();
+}
+
+QString SegmentFileSink::name() const
+{
+    return name_;
+}
+
+bool SegmentFileSink::open(QString *error)
+{
+    if (!QDir().mkpath(directory_)) {
+        *error = QString("cannot create %1").arg(directory_);
+        return false;
+    }
+
+    // Сегменты, оставшиеся открытыми после аварийного завершения,
+    // закрываются со временем последнего изменения файла
+    const QDir root(directory_);
+    for (const QString &type : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const QDir type_dir(root.filePath(type));
+        for (const QFileInfo &info : type_dir.entryInfoList({"seg-*.jsonl" + kOpenSuffix}, QDir::Files)) {
+            const qint64 first_ms = info.fileName().section('-', 1, 1).section('.', 0, 0).toLongLong();
+            const qint64 last_ms = qMax(first_ms, info.lastModified().toMSecsSinceEpoch());
+            QFile::rename(info.filePath(), type_dir.filePath(closedSegmentName(first_ms, last_ms)));
+        }
+    }
+    return true;
+}
+
+void SegmentFileSink::writeBatch(const QVector<ClientData> &batch)
+{
+    for (const ClientData &data : batch) {
+        const qint64 timestamp_ms = data.timestamp.toMSecsSinceEpoch();
+        Segment *segment = segmentFor(typeDirectory(data.data_type), timestamp_ms);
+        if (!segment) {
+            ServerMetrics::increment(Counter::SinkDropped);
+            continue;
+        }
+        segment->bytes += segment->file.write(encodeRecordLine(data));
+        segment->last_ms = qMax(segment->last_ms, timestamp_ms);
+    }
+
+    for (Segment *segment : std::as_const(segments_)) {
+        segment->file.flush();
+    }
+}
+
+void SegmentFileSink::close()
+{
+    for (Segment *segment : std::as_const(segments_)) {
+        finalize(segment);
+    }
+    qDeleteAll(segments_);
+    segments_.clear();
+}
+
+QString SegmentFileSink::typeDirectory(const QString &data_type)
+{
+    // Имя каталога не берется из данных клиента напрямую
+    if (data_type == QLatin1String("NetworkMetrics")
+        || data_type == QLatin1String("DeviceStatus")
+        || data_type == QLatin1String("Log")) {
+        return data_type;
+    }
+    return QStringLiteral("other");
+}
+
+SegmentFileSink::Segment *SegmentFileSink::segmentFor(const QString &type, qint64 timestamp_ms)
+{
+    Segment *segment = segments_.value(type);
+    if (segment && (segment->bytes >= max_segment_bytes_
+                    || segment->age.elapsed() >= max_segment_seconds_ * 1000LL)) {
+        finalize(segment);
+        delete segment;
+        segments_.remove(type);
+        segment = nullptr;
+    }
+
+    if (!segment) {
+        const QDir type_dir(QDir(directory_).filePath(type));
+        QDir().mkpath(type_dir.path());
+
+        segment = new Segment;
+        segment->first_ms = timestamp_ms;
+        segment->last_ms = timestamp_ms;
+        segment->file.setFileName(type_dir.filePath(
+            QString("seg-%1.jsonl").arg(timestamp_ms) + kOpenSuffix));
+        if (!segment->file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            delete segment;
+            return nullptr;
+        }
+        segment->age.start();
+        segments_.insert(type, segment);
+    }
+    return segment;
+}
+
+void SegmentFileSink::finalize(Segment *segment)
+{
+    if (!segment->file.isOpen()) {
+        return;
+    }
+
+    const QString open_path = segment->file.fileName();
+    segment->file.close();
+
+    const QString closed_path = QFileInfo(open_path).dir().filePath(
+        closedSegmentName(segment->first_ms, segment->last_ms));
+    QFile::rename(open_path, closed_path);
+}
+
+SegmentCompactor::SegmentCompactor(const QString &directory, const CompactionConfig &config,
+                                   QObject *parent)
+    : QObject(parent),
+      directory_(directory),
+      config_(config),
+      thread_(nullptr),
+      stopping_(false),
+      io_bytes_(0)
+{
+}
+
+SegmentCompactor::~SegmentCompactor()
+{
+    stop();
+}
+
+void SegmentCompactor::start()
+{
+    if (thread_) {
+        return;
+    }
+
+    stopping_ = false;
+    thread_ = QThread::create([this]() { run(); });
+    thread_->setObjectName("compactor");
+    // На Linux IdlePriority соответствует SCHED_IDLE
+    thread_->start(QThread::IdlePriority);
+}
+
+void SegmentCompactor::stop()
+{
+    if (!thread_) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&wait_mutex_);
+        stopping_ = true;
+        wake_.wakeAll();
+    }
+    thread_->wait();
+    delete thread_;
+    thread_ = nullptr;
+}
+
+void SegmentCompactor::run()
+{
+#if defined(Q_OS_LINUX)
+    setIdleIoPriority();
+#endif
+
+    forever {
+        {
+            QMutexLocker locker(&wait_mutex_);
+            if (!stopping_) {
+                wake_.wait(&wait_mutex_, config_.interval_seconds * 1000UL);
+            }
+        }
+        if (stopping_) {
+            return;
+        }
+        compactOnce();
+    }
+}
+
+void SegmentCompactor::compactOnce()
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+    io_clock_.start();
+    io_bytes_ = 0;
+
+    Report report;
+    const QDir root(directory_);
+    for (const QString &type : root.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        if (stopping_) {
+            break;
+        }
+        compactType(root.filePath(type), type, &report);
+    }
+
+    const qint64 elapsed_ms = elapsed.elapsed();
+    ServerMetrics::increment(Counter::CompactionRuns);
+    ServerMetrics::increment(Counter::CompactionReclaimedBytes, quint64(qMax<qint64>(0, report.bytes_reclaimed)));
+    ServerMetrics::increment(Counter::CompactionMilliseconds, quint64(elapsed_ms));
+
+    if (report.dropped + report.merged_inputs + report.compressed > 0) {
+        emit logMessage(QString("Compaction: %1 segments expired, %2 merged into %3, "
+                                "%4 compressed; %5 bytes reclaimed in %6 ms")
+                        .arg(report.dropped).arg(report.merged_inputs)
+                        .arg(report.merged_outputs).arg(report.compressed)
+                        .arg(report.bytes_reclaimed).arg(elapsed_ms));
+    }
+}
+
+void SegmentCompactor::compactType(const QString &type_directory, const QString &type,
+                                   Report *report)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 expire_before = now - config_.retention_hours.value(
+        type, config_.default_retention_hours) * kMsPerHour;
+    const qint64 cold_before = now - config_.cold_after_hours * kMsPerHour;
+
+    // 0. Склейки и сжатия, прерванные сбоем, завершаются до всего остального
+    finishMerges(type_directory);
+    finishCompressions(type_directory);
+
+    // 1. Удаление сегментов, целиком вышедших за срок хранения
+    QVector<SegmentInfo> segments;
+    for (const SegmentInfo &segment : listSegments(type_directory)) {
+        if (segment.last_ms < expire_before) {
+            if (QFile::remove(segment.path)) {
+                report->dropped++;
+                report->bytes_reclaimed += segment.size;
+            }
+        } else {
+            segments.append(segment);
+        }
+    }
+
+    // 2. Склейка подряд идущих мелких несжатых сегментов
+    QVector<SegmentInfo> group;
+    qint64 group_bytes = 0;
+    auto flushGroup = [&]() {
+        if (group.size() > 1) {
+            mergeSegments(type_directory, group, report);
+        }
+        group.clear();
+        group_bytes = 0;
+    };
+    for (const SegmentInfo &segment : std::as_const(segments)) {
+        if (stopping_) {
+            return;
+        }
+        if (segment.compressed || segment.size >= config_.small_segment_bytes) {
+            flushGroup();
+            continue;
+        }
+        if (group_bytes + segment.size > config_.merged_segment_bytes) {
+            flushGroup();
+        }
+        group.append(segment);
+        group_bytes += segment.size;
+    }
+    flushGroup();
+
+    // 3. Сжатие холодных сегментов (список перечитывается после склейки)
+    for (const SegmentInfo &segment : listSegments(type_directory)) {
+        if (stopping_) {
+            return;
+        }
+        if (!segment.compressed && segment.last_ms < cold_before) {
+            compressSegment(segment, report);
+        }
+    }
+}
+
+QVector<SegmentCompactor::SegmentInfo> SegmentCompactor::listSegments(const QString &type_directory) const
+{
+    static const QRegularExpression pattern("^seg-(\\d+)-(\\d+)\\.jsonl(\\.z)?$");
+
+    QVector<SegmentInfo> segments;
+    const QDir dir(type_directory);
+    for (const QFileInfo &info : dir.entryInfoList({"seg-*"}, QDir::Files)) {
+        const QRegularExpressionMatch match = pattern.match(info.fileName());
+        if (!match.hasMatch()) {
+            continue;  // Открытые сегменты и временные файлы не трогаем
+        }
+        segments.append({info.filePath(), match.captured(1).toLongLong(),
+                         match.captured(2).toLongLong(), info.size(),
+                         !match.captured(3).isEmpty()});
+    }
+
+    std::sort(segments.begin(), segments.end(), [](const SegmentInfo &a, const SegmentInfo &b) {
+        return a.first_ms < b.first_ms;
+    });
+    return segments;
+}
+
+void SegmentCompactor::finishMerges(const QString &type_directory)
+{
+    static const QRegularExpression input_pattern("^seg-\\d+-\\d+\\.jsonl$");
+
+    const QDir dir(type_directory);
+    for (const QFileInfo &info : dir.entryInfoList({"seg-*" + kMergeSuffix}, QDir::Files)) {
+        QFile marker(info.filePath());
+        if (!marker.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QList<QByteArray> lines = marker.readAll().split('\n');
+        marker.close();
+
+        // Результат зафиксирован, только если он есть и полного размера;
+        // иначе входы целы и склейка просто повторится
+        const QString output = info.filePath().chopped(kMergeSuffix.size());
+        const QFileInfo output_info(output);
+        if (output_info.exists() && output_info.size() == lines.first().toLongLong()) {
+            for (qsizetype i = 1; i < lines.size(); ++i) {
+                const QString input = QString::fromUtf8(lines[i]);
+                if (input_pattern.match(input).hasMatch() && input != output_info.fileName()) {
+                    dir.remove(input);
+                }
+            }
+        }
+        QFile::remove(info.filePath());
+    }
+}
+
+void SegmentCompactor::finishCompressions(const QString &type_directory)
+{
+    // Сжатый файл фиксируется целиком до удаления исходного, поэтому при
+    // наличии обоих лишний — исходный
+    const QDir dir(type_directory);
+    for (const QFileInfo &info : dir.entryInfoList({"seg-*.jsonl" + kCompressedSuffix}, QDir::Files)) {
+        const QString original = info.filePath().chopped(kCompressedSuffix.size());
+        if (QFile::exists(original)) {
+            QFile::remove(original);
+        }
+    }
+}
+
+bool SegmentCompactor::mergeSegments(const QString &type_directory,
+                                     const QVector<SegmentInfo> &group, Report *report)
+{
+    qint64 first_ms = group.first().first_ms;
+    qint64 last_ms = group.first().last_ms;
+    qint64 input_bytes = 0;
+    for (const SegmentInfo &segment : group) {
+        first_ms = qMin(first_ms, segment.first_ms);
+        last_ms = qMax(last_ms, segment.last_ms);
+        input_bytes += segment.size;
+    }
+
+    const QString output = QDir(type_directory).filePath(closedSegmentName(first_ms, last_ms));
+
+    // Размер результата и имена входов записываются до фиксации
+    // результата: если сбой случится после нее, но до удаления входов,
+    // следующий проход удалит входы (finishMerges), а не склеит те же
+    // записи еще раз
+    const QString marker_path = output + kMergeSuffix;
+    QSaveFile marker(marker_path);
+    if (!marker.open(QIODevice::WriteOnly)) {
+        emit logMessage(QString("Compaction: cannot write %1: %2")
+                        .arg(marker_path, marker.errorString()));
+        return false;
+    }
+    marker.write(QByteArray::number(input_bytes) + '\n');
+    for (const SegmentInfo &segment : group) {
+        marker.write(QFileInfo(segment.path).fileName().toUtf8() + '\n');
+    }
+    if (!marker.commit()) {
+        return false;
+    }
+
+    // Входы копируются порциями: в памяти не больше kIoChunk байт
+    QSaveFile merged(output);
+    qint64 copied = 0;
+    bool ok = openOutput(&merged);
+    for (qsizetype i = 0; ok && i < group.size(); ++i) {
+        ok = readThrottled(group[i].path, [&](const QByteArray &chunk) {
+            copied += chunk.size();
+            return writeThrottled(&merged, chunk.constData(), chunk.size());
+        });
+    }
+    // Закрытый сегмент не меняется; другой размер — его изменили извне
+    if (!ok || copied != input_bytes || !merged.commit()) {
+        QFile::remove(marker_path);
+        return false;
+    }
+
+    for (const SegmentInfo &segment : group) {
+        if (segment.path != output) {
+            QFile::remove(segment.path);
+        }
+    }
+    QFile::remove(marker_path);
+
+    report->merged_inputs += group.size();
+    report->merged_outputs++;
+    return true;
+}
+
+bool SegmentCompactor::compressSegment(const SegmentInfo &segment, Report *report)
+{
+    // Формат qCompress (4 байта исходного размера, big-endian, и поток
+    // zlib), но сжатие идет порциями по мере чтения. Сжатый файл
+    // появляется атомарно (QSaveFile) и только потом удаляется исходный;
+    // сбой между ними оставляет оба, и finishCompressions удалит исходный
+    QSaveFile output(segment.path + kCompressedSuffix);
+    if (!openOutput(&output)) {
+        return false;
+    }
+
+    z_stream stream {};
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+
+    QByteArray buffer(kIoChunk, Qt::Uninitialized);
+    qint64 compressed_bytes = 0;
+    auto deflateChunk = [&](const QByteArray &chunk, int flush) {
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(chunk.constData()));
+        stream.avail_in = uInt(chunk.size());
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+            stream.avail_out = uInt(buffer.size());
+            deflate(&stream, flush);
+            const qint64 produced = buffer.size() - qint64(stream.avail_out);
+            if (!writeThrottled(&output, buffer.constData(), produced)) {
+                return false;
+            }
+            compressed_bytes += produced;
+        } while (stream.avail_out == 0);
+        return true;
+    };
+
+    uchar header[4];
+    qToBigEndian<quint32>(quint32(segment.size), header);
+    qint64 read = 0;
+    const bool ok = writeThrottled(&output, reinterpret_cast<const char*>(header), sizeof(header))
+        && readThrottled(segment.path, [&](const QByteArray &chunk) {
+               read += chunk.size();
+               return deflateChunk(chunk, Z_NO_FLUSH);
+           })
+        && read == segment.size
+        && deflateChunk(QByteArray(), Z_FINISH);
+    deflateEnd(&stream);
+
+    if (!ok || !output.commit()) {
+        return false;
+    }
+    QFile::remove(segment.path);
+
+    report->compressed++;
+    report->bytes_reclaimed += segment.size - (compressed_bytes + qint64(sizeof(header)));
+    return true;
+}
+
+bool SegmentCompactor::readThrottled(const QString &path,
+                                     const std::function<bool(const QByteArray &chunk)> &consume)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    while (!file.atEnd()) {
+        const QByteArray chunk = file.read(kIoChunk);
+        if (chunk.isEmpty() || !throttle(chunk.size()) || !consume(chunk)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SegmentCompactor::openOutput(QSaveFile *file)
+{
+    // Результат появляется атомарно: при остановке или сбое остаются
+    // исходные сегменты
+    if (!file->open(QIODevice::WriteOnly)) {
+        emit logMessage(QString("Compaction: cannot write %1: %2")
+                        .arg(file->fileName(), file->errorString()));
+        return false;
+    }
+    return true;
+}
+
+bool SegmentCompactor::writeThrottled(QSaveFile *file, const char *data, qint64 length)
+{
+    if (length == 0) {
+        return true;
+    }
+    return file->write(data, length) == length && throttle(length);
+}
+
+bool SegmentCompactor::throttle(qint64 bytes)
+{
+    io_bytes_ += bytes;
+    if (config_.io_bytes_per_second <= 0) {
+        return !stopping_;
+    }
+
+    // Спим, пока средняя скорость прохода не опустится до лимита
+    const qint64 due_ms = io_bytes_ * 1000 / config_.io_bytes_per_second;
+    while (!stopping_ && io_clock_.elapsed() < due_ms) {
+        QThread::msleep(quint64(qMin<qint64>(due_ms - io_clock_.elapsed(), 100)));
+    }
+    return !stopping_;
+}
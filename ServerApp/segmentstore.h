@@ -0,0 +1,149 @@
+#ifndef SEGMENTSTORE_H
+#define SEGMENTSTORE_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSaveFile>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "recordsink.h"
+
+// Raw record store as time-bounded segment files, one directory per type.
+//
+//   <dir>/<type>/seg-<first_ms>.jsonl.open       — текущий сегмент
+//   <dir>/<type>/seg-<first_ms>-<last_ms>.jsonl   — закрытый сегмент
+//   <dir>/<type>/seg-<first_ms>-<last_ms>.jsonl.z — сжатый (формат qCompress)
+//   <dir>/<type>/seg-<first_ms>-<last_ms>.jsonl.merge — входы идущей склейки
+//
+// Тип — NetworkMetrics, DeviceStatus, Log или other. Строки в формате
+// JSON lines (encodeRecordLine). Сегмент закрывается по размеру или по
+// возрасту; закрытые сегменты обслуживает SegmentCompactor.
+class SegmentFileSink : public RecordSink
+{
+public:
+    SegmentFileSink(const QString &name, const QString &directory,
+                    qint64 max_segment_bytes = 64 * 1024 * 1024,
+                    int max_segment_seconds = 600);
+    ~SegmentFileSink();
+
+    QString name() const override;
+    bool open(QString *error) override;
+    void writeBatch(const QVector<ClientData> &batch) override;
+    void close() override;
+
+    // Directory name for a data type
+    static QString typeDirectory(const QString &data_type);
+
+private:
+    struct Segment {
+        QFile file;
+        qint64 first_ms = 0;
+        qint64 last_ms = 0;
+        qint64 bytes = 0;
+        QElapsedTimer age;
+    };
+
+    Segment *segmentFor(const QString &type, qint64 timestamp_ms);
+    void finalize(Segment *segment);
+
+    QString name_;
+    QString directory_;
+    const qint64 max_segment_bytes_;
+    const int max_segment_seconds_;
+    QHash<QString, Segment*> segments_;
+};
+
+// Retention and compaction settings of the segment store
+struct CompactionConfig {
+    int default_retention_hours = 7 * 24;
+    QHash<QString, int> retention_hours;        // Тип -> срок хранения, часы
+    int cold_after_hours = 24;                  // Старше — сжимается
+    qint64 small_segment_bytes = 4 * 1024 * 1024;
+    qint64 merged_segment_bytes = 64 * 1024 * 1024;
+    int interval_seconds = 300;
+    qint64 io_bytes_per_second = 8 * 1024 * 1024;   // Ограничение чтения+записи
+};
+
+// Background maintenance of a segment store.
+//
+// За один проход по каждому типу: удаляет сегменты старше срока
+// хранения, склеивает подряд идущие мелкие сегменты и сжимает холодные.
+// Поток работает с приоритетом Idle (на Linux — SCHED_IDLE и класс
+// ввода-вывода idle), а чтение и запись ограничены io_bytes_per_second,
+// поэтому компактор не конкурирует с приемом данных.
+class SegmentCompactor : public QObject
+{
+    Q_OBJECT
+
+public:
+    SegmentCompactor(const QString &directory, const CompactionConfig &config,
+                     QObject *parent = nullptr);
+    ~SegmentCompactor();
+
+    void start();
+    void stop();
+
+signals:
+    void logMessage(const QString &message);
+
+private:
+    struct SegmentInfo {
+        QString path;
+        qint64 first_ms;
+        qint64 last_ms;
+        qint64 size;
+        bool compressed;
+    };
+
+    struct Report {
+        int dropped = 0;
+        int merged_inputs = 0;
+        int merged_outputs = 0;
+        int compressed = 0;
+        qint64 bytes_reclaimed = 0;
+    };
+
+    void run();
+    void compactOnce();
+    void compactType(const QString &type_directory, const QString &type, Report *report);
+
+    QVector<SegmentInfo> listSegments(const QString &type_directory) const;
+    // Finish merges interrupted between committing the output and
+    // removing the inputs (see mergeSegments)
+    void finishMerges(const QString &type_directory);
+    bool mergeSegments(const QString &type_directory, const QVector<SegmentInfo> &group,
+                       Report *report);
+    // Remove originals left next to a committed .z (see compressSegment)
+    void finishCompressions(const QString &type_directory);
+    bool compressSegment(const SegmentInfo &segment, Report *report);
+
+    // Потоковые чтение и запись порциями kIoChunk с ограничением скорости;
+    // false при остановке или ошибке
+    bool readThrottled(const QString &path,
+                       const std::function<bool(const QByteArray &chunk)> &consume);
+    bool openOutput(QSaveFile *file);
+    bool writeThrottled(QSaveFile *file, const char *data, qint64 length);
+    bool throttle(qint64 bytes);
+
+    const QString directory_;
+    const CompactionConfig config_;
+
+    QThread *thread_;
+    std::atomic<bool> stopping_;
+    QMutex wait_mutex_;
+    QWaitCondition wake_;
+
+    // Учет скорости ввода-вывода текущего прохода
+    QElapsedTimer io_clock_;
+    qint64 io_bytes_;
+};
+
+#endif // SEGMENTSTORE_H
@@ -0,0 +1,331 @@
+#include "serverhost.h"
+
+#include <QHash>
+#include <QJsonDocument>
+
+#include <utility>
+
+#include "builtinsinks.h"
+#include "localhttpserver.h"
+#include "pubsubserver.h"
+#include "queryapi.h"
+#include "relayuplink.h"
+#include "servermetrics.h"
+#include "serversnapshot.h"
+#include "sessionrecorder.h"
+#include "sharedstate.h"
+#include "tcpserver.h"
+
+namespace {
+constexpr int kRollupExpiryIntervalMs = 60 * 1000;
+
+// Восстановление записи журнала в структуру данных клиента
+bool decodeWalRecord(const WalRecord &record, ClientData *data)
+{
+    QJsonDocument doc = QJsonDocument::fromJson(record.frame);
+    if (!doc.isObject()) {
+        return false;
+    }
+
+    data->client_id = record.client_id;
+    data->content = doc.object();
+    data->data_type = data->content["type"].toString();
+    data->timestamp = QDateTime::fromMSecsSinceEpoch(record.timestamp_ms);
+    return true;
+}
+}  // namespace
+
+ServerHost::ServerHost(const ServerOptions &options, QObject *parent)
+    : QObject(parent),
+      options_(options),
+      store_(options.rollup_minutes, options.rollup_hours),
+      expiry_timer_(new QTimer(this)),
+      server_(new TcpServer()),
+      server_thread_(new QThread(this)),
+      wal_(nullptr),
+      snapshot_(nullptr),
+      relay_(nullptr),
+      recorder_(nullptr),
+      pubsub_(nullptr),
+      pubsub_thread_(new QThread(this)),
+      shm_(nullptr),
+      http_server_(nullptr),
+      http_thread_(new QThread(this))
+{
+    // Ретранслятор пересылает исходные байты кадров, не кодируя их заново
+    PipelineConfig pipeline = options_.pipeline;
+    pipeline.keep_frames = !options_.relay_host.isEmpty();
+    server_->configurePipeline(pipeline);
+    server_->setTelemetryStore(&store_);
+    server_->setLocalName(options_.local_name);
+    server_->setRingName(options_.ring_name);
+    if (options_.backend == "uring") {
+        server_->setIngestBackend(IngestBackend::Uring);
+    } else if (options_.backend == "epoll") {
+        server_->setIngestBackend(IngestBackend::Epoll);
+    } else if (options_.backend != "qt") {
+        qWarning("Unknown backend '%s', using Qt sockets", qPrintable(options_.backend));
+    }
+    server_->setAcceptorCount(options_.acceptors);
+    server_->setCompression(options_.compression);
+    server_->setReceiveMemoryLimit(qint64(options_.receive_memory_mb) * 1024 * 1024);
+
+    if (!options_.cluster_file.isEmpty()) {
+        QString error;
+        if (cluster_.load(options_.cluster_file, options_.node_name, &error)) {
+            server_->setCluster(&cluster_);
+        } else {
+            qWarning("Cluster disabled: %s", qPrintable(error));
+        }
+    }
+
+    auto recorder = std::make_unique<SessionRecorder>();
+    recorder_ = recorder.get();
+    server_->pipeline()->addSink(std::move(recorder), options_.sink_options);
+
+    // Имя приемника — его тип; повторяющиеся типы нумеруются
+    QHash<QString, int> type_counts;
+    for (const QString &spec : std::as_const(options_.sinks)) {
+        const QString type = spec.section(':', 0, 0);
+        const int index = type_counts[type]++;
+        const QString name = index == 0 ? type : QString("%1-%2").arg(type).arg(index);
+
+        QString error;
+        std::unique_ptr<RecordSink> sink = createRecordSink(spec, name, &error);
+        if (sink) {
+            server_->pipeline()->addSink(std::move(sink), options_.sink_options);
+            if (type == "segments") {
+                SegmentCompactor *compactor = new SegmentCompactor(
+                    spec.section(':', 1), options_.compaction, this);
+                connect(compactor, &SegmentCompactor::logMessage,
+                        this, &ServerHost::logMessage);
+                compactors_.append(compactor);
+            }
+        } else {
+            qWarning("Sink ignored: %s", qPrintable(error));
+        }
+    }
+
+    if (!options_.relay_host.isEmpty()) {
+        relay_ = new RelayUplink(server_, options_.relay_host, options_.relay_port,
+                                 options_.relay_links);
+        connect(relay_, &RelayUplink::logMessage,
+                this, &ServerHost::logMessage);
+        server_->pipeline()->addSink(relay_->createSink(), options_.sink_options);
+    }
+
+    if (!options_.pubsub_name.isEmpty()) {
+        pubsub_ = new PubSubServer(options_.pubsub_max_pending_kb * qint64(1024));
+        connect(pubsub_, &PubSubServer::logMessage,
+                this, &ServerHost::logMessage);
+        server_->pipeline()->addSink(pubsub_->createSink(), options_.sink_options);
+    }
+
+    if (!options_.shm_name.isEmpty()) {
+        // Сегмент создается до запуска конвейера: приемник пишет в него сразу
+        shm_ = new SharedStatePublisher(options_.shm_name, server_, options_.port, this);
+        QString error;
+        if (shm_->open(&error)) {
+            server_->pipeline()->addSink(shm_->createSink(), options_.sink_options);
+        } else {
+            qWarning("Shared state disabled: %s", qPrintable(error));
+            delete shm_;
+            shm_ = nullptr;
+        }
+    }
+
+    if (!options_.wal.directory.isEmpty()) {
+        wal_ = new WriteAheadLog(options_.wal, this);
+        connect(wal_, &WriteAheadLog::logMessage,
+                this, &ServerHost::logMessage);
+    }
+
+    if (!options_.snapshot_path.isEmpty()) {
+        snapshot_ = new ServerSnapshot(options_.snapshot_path, server_, &store_, this);
+        connect(snapshot_, &ServerSnapshot::logMessage,
+                this, &ServerHost::logMessage);
+    }
+
+    if (options_.http_port != 0) {
+        http_server_ = new LocalHttpServer(options_.http_threads);
+        http_server_->addRoute("/query", makeQueryHandler(&store_));
+        http_server_->addRoute("/metrics", [](const HttpRequest &, HttpResponseStream &response) {
+            // Агрегация по шардам выполняется здесь, в потоке пула HTTP
+            response.send(200, "text/plain; version=0.0.4",
+                          ServerMetrics::instance().renderPrometheus());
+        });
+        connect(http_server_, &LocalHttpServer::logMessage,
+                this, &ServerHost::logMessage);
+    }
+}
+
+ServerHost::~ServerHost()
+{
+    for (SegmentCompactor *compactor : std::as_const(compactors_)) {
+        compactor->stop();
+    }
+
+    if (!server_thread_->isRunning()) {
+        // start() не вызывался: объекты живут в текущем потоке
+        delete http_server_;
+        delete relay_;
+        delete server_;
+        delete pubsub_;
+        return;
+    }
+
+    // HTTP API первым: его обработчики читают хранилище
+    if (http_server_) {
+        QMetaObject::invokeMethod(http_server_, "stopListening", Qt::BlockingQueuedConnection);
+        http_server_->deleteLater();
+        http_thread_->quit();
+        http_thread_->wait();
+    }
+
+    // Останавливаем сервер в его потоке
+    QMetaObject::invokeMethod(server_, "stopServer", Qt::BlockingQueuedConnection);
+
+    if (relay_) {
+        QMetaObject::invokeMethod(relay_, "stop", Qt::BlockingQueuedConnection);
+        relay_->deleteLater();
+    }
+
+    // Последний снимок — после остановки приема, пока сервер еще жив
+    if (snapshot_) {
+        snapshot_->stop();
+        QString error;
+        if (!snapshot_->write(&error)) {
+            qWarning("Snapshot failed: %s", qPrintable(error));
+        }
+    }
+    server_->deleteLater();
+    server_thread_->quit();
+    server_thread_->wait();
+
+    // Приемник pubsub остановлен вместе с конвейером
+    if (pubsub_) {
+        QMetaObject::invokeMethod(pubsub_, "stopListening", Qt::BlockingQueuedConnection);
+        pubsub_->deleteLater();
+        pubsub_thread_->quit();
+        pubsub_thread_->wait();
+    }
+
+    // Прием остановлен: сбрасываем остаток журнала на диск
+    if (wal_) {
+        wal_->close();
+    }
+}
+
+void ServerHost::start()
+{
+    // Снимок восстанавливает состояние на момент записи; журнал дополняет
+    // его только более поздними записями (отсчеты, принятые во время записи
+    // снимка, могут оказаться учтены дважды)
+    qint64 snapshot_ms = 0;
+    if (snapshot_) {
+        QString error;
+        snapshot_ms = snapshot_->load(&error);
+        if (snapshot_ms < 0) {
+            emit logMessage(QString("Snapshot ignored: %1").arg(error));
+            snapshot_ms = 0;
+        }
+    }
+
+    if (wal_) {
+        // Данные, принятые до аварийного завершения, возвращаются в хранилище
+        qint64 replayed = wal_->replay([this, snapshot_ms](const WalRecord &record) {
+            ClientData data;
+            if (record.timestamp_ms > snapshot_ms && decodeWalRecord(record, &data)) {
+                store_.append(data);
+            }
+        });
+        emit logMessage(QString("WAL: replayed %1 records").arg(replayed));
+
+        QString error;
+        if (wal_->open(&error)) {
+            server_->setWriteAheadLog(wal_);
+        } else {
+            emit logMessage(QString("WAL disabled: %1").arg(error));
+        }
+    }
+
+    if (!options_.record_path.isEmpty()) {
+        QString error;
+        if (recorder_->startRecording(options_.record_path, &error)) {
+            emit logMessage("Recording session to " + options_.record_path);
+        } else {
+            emit logMessage("Session recording failed: " + error);
+        }
+    }
+
+    for (SegmentCompactor *compactor : std::as_const(compactors_)) {
+        compactor->start();
+    }
+
+    if (snapshot_) {
+        snapshot_->start(options_.snapshot_interval);
+    }
+
+    // Агрегаты отключившихся клиентов и восстановленные из снимка
+    // устаревают только здесь
+    connect(expiry_timer_, &QTimer::timeout, this, [this]() {
+        store_.expire(QDateTime::currentMSecsSinceEpoch());
+    });
+    expiry_timer_->start(kRollupExpiryIntervalMs);
+
+    if (!cluster_.isEmpty()) {
+        emit logMessage(QString("Cluster node %1 of %2")
+                        .arg(cluster_.self().name).arg(cluster_.nodes().size()));
+    }
+
+    // Move server to separate thread
+    server_->moveToThread(server_thread_);
+    if (relay_) {
+        relay_->moveToThread(server_thread_);
+    }
+    server_thread_->start();
+
+    if (relay_) {
+        QMetaObject::invokeMethod(relay_, "start", Qt::QueuedConnection);
+        emit logMessage(QString("Relay mode: forwarding to %1:%2 over %3 links")
+                        .arg(options_.relay_host)
+                        .arg(options_.relay_port)
+                        .arg(relay_->linkCount()));
+    }
+
+    if (pubsub_) {
+        pubsub_->moveToThread(pubsub_thread_);
+        pubsub_thread_->start();
+        QMetaObject::invokeMethod(pubsub_, "startListening",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, options_.pubsub_name));
+    }
+
+    if (shm_) {
+        emit logMessage(QString("Publishing server state to shared memory %1")
+                        .arg(options_.shm_name));
+    }
+
+    if (http_server_) {
+        http_server_->moveToThread(http_thread_);
+        http_thread_->start();
+        QMetaObject::invokeMethod(http_server_, "startListening",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(quint16, options_.http_port));
+    }
+}
+
+TcpServer *ServerHost::server() const
+{
+    return server_;
+}
+
+SessionRecorder *ServerHost::sessionRecorder() const
+{
+    return recorder_;
+}
+
+const ServerOptions &ServerHost::options() const
+{
+    return options_;
+}
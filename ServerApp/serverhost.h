@@ -0,0 +1,111 @@
+#ifndef SERVERHOST_H
+#define SERVERHOST_H
+
+#include <QObject>
+#include <QThread>
+
+#include <QStringList>
+#include <QTimer>
+
+#include "clusterring.h"
+#include "ingestpipeline.h"
+#include "recordsink.h"
+#include "segmentstore.h"
+#include "telemetrystore.h"
+#include "writeaheadlog.h"
+
+class LocalHttpServer;
+class PubSubServer;
+class RelayUplink;
+class ServerSnapshot;
+class SessionRecorder;
+class SharedStatePublisher;
+class TcpServer;
+
+// Параметры запуска сервера (командная строка)
+struct ServerOptions {
+    quint16 port = 12345;
+    QString local_name;          // Локальный сокет для устройств на этом хосте, пусто — выключен
+    QString ring_name;           // Кольца в общей памяти для эмуляторов, пусто — выключены
+    QString backend = "qt";      // Прием устройств на порту: qt, epoll или uring (только Linux)
+    int acceptors = 1;           // Потоков приема с SO_REUSEPORT для бэкенда qt (Linux)
+    bool compression = false;    // Предлагать устройствам сжатие потока (deflate)
+    int receive_memory_mb = 256; // Предел памяти буферов приема всех соединений
+    bool headless = false;       // Без GUI, сервер запускается сразу
+    quint16 http_port = 0;       // Локальный HTTP API, 0 — выключен
+    int http_threads = 2;        // Потоки пула обработки запросов
+    WalConfig wal;               // Журнал предзаписи, пустой каталог — выключен
+    PipelineConfig pipeline;     // Потоки и очереди конвейера обработки
+    QStringList sinks;           // Дополнительные приемники: file:, sqlite:, socket:
+    SinkOptions sink_options;    // Пачки и политика для дополнительных приемников
+    QString record_path;         // Записывать сессию в файл с момента запуска
+    int rollup_minutes = 24 * 60;    // Срок хранения минутных агрегатов
+    int rollup_hours = 30 * 24;      // Срок хранения часовых агрегатов
+    CompactionConfig compaction;     // Для приемников segments:
+    QString snapshot_path;           // Снимок состояния для быстрого перезапуска
+    int snapshot_interval = 60;      // Секунды между снимками
+    QString relay_host;              // Режим ретранслятора: адрес центрального сервера
+    quint16 relay_port = 12345;
+    int relay_links = 2;             // Соединений с центральным сервером
+    QString cluster_file;            // Состав кластера, пусто — одиночный сервер
+    QString node_name;               // Имя этого узла в cluster_file
+    QString pubsub_name;             // Локальный сокет подписки на записи, пусто — выключен
+    int pubsub_max_pending_kb = 8 * 1024;   // Отставание, после которого подписчик отключается
+    QString shm_name;                // Общая память для отдельных окон (--attach), пусто — выключена
+    QString attach_name;             // Только окно: показывать состояние сервера из общей памяти
+};
+
+// Owns the server objects and their threads. Shared by the GUI and the
+// headless modes so both run the same ingest and service setup.
+class ServerHost : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ServerHost(const ServerOptions &options, QObject *parent = nullptr);
+    ~ServerHost();
+
+    // Start worker threads and auxiliary listeners
+    void start();
+
+    TcpServer *server() const;
+    SessionRecorder *sessionRecorder() const;
+    const ServerOptions &options() const;
+
+signals:
+    void logMessage(const QString &message);
+
+private:
+    ServerOptions options_;
+    TelemetryStore store_;
+    QTimer *expiry_timer_;      // Срок хранения агрегатов без новых отсчетов
+    ClusterRing cluster_;
+
+    TcpServer *server_;
+    QThread *server_thread_;
+
+    WriteAheadLog *wal_;
+    ServerSnapshot *snapshot_;
+
+    // Пересылка записей центральному серверу, живет в потоке сервера
+    RelayUplink *relay_;
+
+    // Приемник записи сессий; принадлежит конвейеру сервера
+    SessionRecorder *recorder_;
+
+    // Обслуживание каталогов приемников segments:
+    QList<SegmentCompactor*> compactors_;
+
+    // Рассылка подписчикам в своем потоке
+    PubSubServer *pubsub_;
+    QThread *pubsub_thread_;
+
+    // Состояние для окон в других процессах; живет в главном потоке
+    SharedStatePublisher *shm_;
+
+    // HTTP API работает в своем потоке, отдельно от приема данных
+    LocalHttpServer *http_server_;
+    QThread *http_thread_;
+};
+
+#endif // SERVERHOST_H
@@ -0,0 +1,198 @@
+#include "servermetrics.h"
+
+#include <QMutexLocker>
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+struct MetricDescriptor {
+    const char *name;
+    const char *labels;  // nullptr, если меток нет
+    const char *help;
+};
+
+// Порядок совпадает с enum Counter; счетчики с одинаковым именем
+// выводятся одним семейством с разными метками
+const MetricDescriptor kCounters[kCounterCount] = {
+    {"clientserver_connections_total", nullptr, "Accepted device connections."},
+    {"clientserver_messages_total", "type=\"NetworkMetrics\"", "Parsed messages by type."},
+    {"clientserver_messages_total", "type=\"DeviceStatus\"", "Parsed messages by type."},
+    {"clientserver_messages_total", "type=\"Log\"", "Parsed messages by type."},
+    {"clientserver_messages_total", "type=\"other\"", "Parsed messages by type."},
+    {"clientserver_received_bytes_total", nullptr, "Bytes read from device sockets."},
+    {"clientserver_sent_bytes_total", nullptr, "Bytes written to device sockets."},
+    {"clientserver_parse_errors_total", nullptr, "Messages rejected as invalid JSON."},
+    {"clientserver_buffer_overflows_total", nullptr, "Connections dropped on receive buffer overflow."},
+    {"clientserver_alerts_total", nullptr, "Threshold warnings raised."},
+    {"clientserver_wal_records_total", nullptr, "Records committed to the write-ahead log."},
+    {"clientserver_wal_bytes_total", nullptr, "Bytes written to the write-ahead log."},
+    {"clientserver_wal_syncs_total", nullptr, "Group commits (fdatasync calls) of the write-ahead log."},
+    {"clientserver_stage_processed_total", "stage=\"parse\"", "Records processed by pipeline stage."},
+    {"clientserver_stage_processed_total", "stage=\"evaluate\"", "Records processed by pipeline stage."},
+    {"clientserver_stage_processed_total", "stage=\"sink\"", "Records processed by pipeline stage."},
+    {"clientserver_sink_dropped_total", nullptr, "Records dropped because a sink queue was full."},
+    {"clientserver_pipeline_stalls_total", nullptr, "Retries of a push into a full pipeline queue."},
+    {"clientserver_sink_spilled_total", nullptr, "Records spilled to disk because a sink queue was full."},
+    {"clientserver_sqlite_rows_total", nullptr, "Rows inserted by the SQLite sink."},
+    {"clientserver_sqlite_transactions_total", nullptr, "Transactions committed by the SQLite sink."},
+    {"clientserver_compaction_runs_total", nullptr, "Passes of the segment compactor."},
+    {"clientserver_compaction_reclaimed_bytes_total", nullptr, "Disk bytes freed by expiry, merging and compression."},
+    {"clientserver_compaction_milliseconds_total", nullptr, "Time spent in compaction passes (throttled)."},
+    {"clientserver_snapshots_total", nullptr, "State snapshots written for fast restart."},
+    {"clientserver_snapshot_milliseconds_total", nullptr, "Time spent writing state snapshots."},
+    {"clientserver_relay_forwarded_total", nullptr, "Records forwarded upstream by a relay node."},
+    {"clientserver_redirects_total", nullptr, "Devices redirected to their owning cluster node."},
+    {"clientserver_pubsub_delivered_total", nullptr, "Records queued to pub/sub subscribers."},
+    {"clientserver_pubsub_evicted_total", nullptr, "Pub/sub subscribers disconnected as too slow."},
+    {"clientserver_ingest_syscalls_total", nullptr, "System calls made by the epoll and io_uring device listeners."},
+    {"clientserver_compressed_bytes_total", nullptr, "Bytes read from devices that negotiated stream compression."},
+    {"clientserver_inflated_bytes_total", nullptr, "Decompressed size of the compressed device bytes."},
+    {"clientserver_inflate_microseconds_total", nullptr, "Time spent decompressing device streams."},
+    {"clientserver_slow_consumer_evictions_total", nullptr, "Device connections closed for not reading their socket."},
+    {"clientserver_commands_coalesced_total", nullptr, "Start/stop commands superseded before a slow device read them."},
+    {"clientserver_send_dropped_total", nullptr, "Replies dropped because the connection's send buffer was over the limit."},
+    {"clientserver_frame_arena_blocks_total", nullptr, "Blocks allocated by the arena that carries frames to the parse stage."},
+    {"clientserver_relay_orphan_frames_total", nullptr, "Relayed frames dropped because their device was not announced."},
+    {"clientserver_wal_dropped_total", nullptr, "Frames not journaled because the write-ahead log failed."},
+    {"clientserver_sqlite_failed_rows_total", nullptr, "Rows the SQLite sink failed to insert or commit."},
+};
+
+// Порядок совпадает с enum Gauge
+const MetricDescriptor kGauges[kGaugeCount] = {
+    {"clientserver_connections_active", nullptr, "Currently connected devices."},
+    {"clientserver_receive_buffered_bytes", nullptr, "Bytes held in receive buffers."},
+    {"clientserver_send_queued_bytes", nullptr, "Bytes waiting in socket write buffers."},
+    {"clientserver_event_loop_lag_ms", nullptr, "Worst ingest event loop delay over the last second."},
+    {"clientserver_stage_queue_depth", "stage=\"parse\"", "Records waiting in pipeline queues."},
+    {"clientserver_stage_queue_depth", "stage=\"evaluate\"", "Records waiting in pipeline queues."},
+    {"clientserver_stage_queue_depth", "stage=\"sink\"", "Records waiting in pipeline queues."},
+    {"clientserver_sinks_backpressured", nullptr, "Sinks whose queue is above the high-water mark."},
+    {"clientserver_sqlite_queue_depth", nullptr, "Records waiting for the SQLite writer thread."},
+    {"clientserver_pubsub_subscribers", nullptr, "Pub/sub subscribers with an active filter."},
+    {"clientserver_memory_per_connection_bytes", nullptr, "Resident memory growth since start divided by active connections."},
+    {"clientserver_receive_buffer_capacity_bytes", nullptr, "Memory reserved by receive buffers of Qt connections."},
+    {"clientserver_receive_buffer_limit_bytes", nullptr, "Limit on receive buffer memory of all Qt connections."},
+};
+
+void appendSample(QByteArray &out, const MetricDescriptor &descriptor, const QByteArray &value)
+{
+    out += descriptor.name;
+    if (descriptor.labels) {
+        out += '{';
+        out += descriptor.labels;
+        out += '}';
+    }
+    out += ' ' + value + '\n';
+}
+
+// Заголовок семейства выводится один раз перед первой меткой
+void appendHeader(QByteArray &out, const MetricDescriptor *descriptors, int index, const char *type)
+{
+    const MetricDescriptor &descriptor = descriptors[index];
+    if (index > 0 && qstrcmp(descriptor.name, descriptors[index - 1].name) == 0) {
+        return;
+    }
+    out += QByteArray("# HELP ") + descriptor.name + ' ' + descriptor.help + '\n';
+    out += QByteArray("# TYPE ") + descriptor.name + ' ' + type + '\n';
+}
+}  // namespace
+
+class ServerMetrics::ShardHandle
+{
+public:
+    ShardHandle() { ServerMetrics::instance().registerShard(&shard); }
+    ~ShardHandle() { ServerMetrics::instance().retireShard(&shard); }
+
+    Shard shard;
+};
+
+ServerMetrics &ServerMetrics::instance()
+{
+    static ServerMetrics metrics;
+    return metrics;
+}
+
+void ServerMetrics::increment(Counter counter, quint64 delta)
+{
+    // Единственный писатель шарда — текущий поток, поэтому достаточно
+    // relaxed load/store; читатель (scrape) видит согласованное значение
+    std::atomic<quint64> &value = localShard().values[static_cast<int>(counter)];
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void ServerMetrics::setGauge(Gauge gauge, qint64 value)
+{
+    instance().gauges_[static_cast<int>(gauge)].store(value, std::memory_order_relaxed);
+}
+
+quint64 ServerMetrics::counterValue(Counter counter) const
+{
+    const int index = static_cast<int>(counter);
+
+    QMutexLocker locker(&shards_mutex_);
+    quint64 total = retired_[index];
+    for (const Shard *shard : shards_) {
+        total += shard->values[index].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+qint64 ServerMetrics::gaugeValue(Gauge gauge) const
+{
+    return gauges_[static_cast<int>(gauge)].load(std::memory_order_relaxed);
+}
+
+QByteArray ServerMetrics::renderPrometheus() const
+{
+    QByteArray out;
+
+    for (int i = 0; i < kCounterCount; ++i) {
+        appendHeader(out, kCounters, i, "counter");
+        appendSample(out, kCounters[i],
+                     QByteArray::number(counterValue(static_cast<Counter>(i))));
+    }
+
+    for (int i = 0; i < kGaugeCount; ++i) {
+        appendHeader(out, kGauges, i, "gauge");
+        appendSample(out, kGauges[i],
+                     QByteArray::number(gaugeValue(static_cast<Gauge>(i))));
+    }
+
+#if defined(Q_OS_UNIX)
+    // Стандартная метрика процесса: по ней считается CPU на сообщение
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        const double seconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        const MetricDescriptor cpu = {"process_cpu_seconds_total", nullptr,
+                                      "Total user and system CPU time spent in seconds."};
+        appendHeader(out, &cpu, 0, "counter");
+        appendSample(out, cpu, QByteArray::number(seconds, 'f', 6));
+    }
+#endif
+
+    return out;
+}
+
+ServerMetrics::Shard &ServerMetrics::localShard()
+{
+    thread_local ShardHandle handle;
+    return handle.shard;
+}
+
+void ServerMetrics::registerShard(Shard *shard)
+{
+    QMutexLocker locker(&shards_mutex_);
+    shards_.append(shard);
+}
+
+void ServerMetrics::retireShard(Shard *shard)
+{
+    QMutexLocker locker(&shards_mutex_);
+    for (int i = 0; i < kCounterCount; ++i) {
+        retired_[i] += shard->values[i].load(std::memory_order_relaxed);
+    }
+    shards_.removeOne(shard);
+}
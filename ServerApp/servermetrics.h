@@ -0,0 +1,122 @@
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QVector>
+
+#include <array>
+#include <atomic>
+
+// Монотонные счетчики (Prometheus counter)
+enum class Counter {
+    ConnectionsAccepted,
+    MessagesNetworkMetrics,
+    MessagesDeviceStatus,
+    MessagesLog,
+    MessagesOther,
+    BytesIn,
+    BytesOut,
+    ParseErrors,
+    BufferOverflows,
+    Alerts,
+    WalRecords,
+    WalBytes,
+    WalSyncs,
+    StageParsed,
+    StageEvaluated,
+    SinkDelivered,
+    SinkDropped,
+    PipelineStalls,
+    SinkSpilled,
+    SqliteRows,
+    SqliteTransactions,
+    CompactionRuns,
+    CompactionReclaimedBytes,
+    CompactionMilliseconds,
+    SnapshotsWritten,
+    SnapshotMilliseconds,
+    RelayForwarded,
+    Redirects,
+    PubSubDelivered,
+    PubSubEvicted,
+    IngestSyscalls,     // Системные вызовы бэкендов epoll и io_uring
+    CompressedBytesIn,  // Сжатые байты от устройств (см. streamcodec.h)
+    InflatedBytes,      // Те же байты после распаковки
+    InflateMicroseconds,
+    SlowConsumerEvictions,
+    CommandsCoalesced,
+    SendDropped,        // Ответы, не поставленные в переполненный буфер отправки
+    FrameArenaBlocks,   // Блоки арены кадров приема (см. framearena.h)
+    RelayOrphanFrames,  // Кадры ретранслятора для необъявленных устройств
+    WalDropped,         // Кадры, не попавшие в отказавший журнал
+    SqliteFailedRows    // Строки, которые SQLite отверг или потерял при откате
+};
+
+constexpr int kCounterCount = 41;
+
+// Мгновенные значения (Prometheus gauge)
+enum class Gauge {
+    ConnectionsActive,
+    ReceiveBufferedBytes,    // Байты в буферах приема (неполные сообщения)
+    SendQueuedBytes,         // Байты, ожидающие отправки в сокетах
+    EventLoopLagMs,          // Максимальная задержка цикла событий за период
+    ParseQueueDepth,         // Очереди конвейера: network -> parse
+    EvaluateQueueDepth,      // parse -> evaluate
+    SinkQueueDepth,          // evaluate -> sink (включая вытесненные в файл)
+    SinksBackpressured,      // Приемники с очередью выше 75%
+    SqliteQueueDepth,        // Записи, ожидающие потока записи SQLite
+    PubSubSubscribers,       // Подписчики с активным фильтром
+    MemoryPerConnection,     // Прирост резидентной памяти с запуска на соединение
+    ReceiveBufferCapacity,   // Емкость буферов приема (см. receivebufferpool.h)
+    ReceiveBufferLimit
+};
+
+constexpr int kGaugeCount = 13;
+
+// Process-wide metrics of the server internals.
+//
+// Счетчики хранятся в отдельном шарде на каждый поток: инкремент — это
+// relaxed load/store в собственной кэш-линии потока, без блокировок и
+// атомарных RMW-операций. Суммирование по шардам выполняется только при
+// опросе (scrape).
+class ServerMetrics
+{
+public:
+    static ServerMetrics &instance();
+
+    // Hot path, lock-free: add to the calling thread's shard
+    static void increment(Counter counter, quint64 delta = 1);
+
+    static void setGauge(Gauge gauge, qint64 value);
+
+    // Sum over all shards (including threads that already exited)
+    quint64 counterValue(Counter counter) const;
+    qint64 gaugeValue(Gauge gauge) const;
+
+    // Prometheus text exposition format, version 0.0.4
+    QByteArray renderPrometheus() const;
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<quint64>, kCounterCount> values{};
+    };
+
+    // Регистрирует шард потока при первом обращении и сливает его значения
+    // в retired_ при завершении потока
+    class ShardHandle;
+
+    ServerMetrics() = default;
+
+    static Shard &localShard();
+    void registerShard(Shard *shard);
+    void retireShard(Shard *shard);
+
+    mutable QMutex shards_mutex_;
+    QVector<Shard*> shards_;
+    std::array<quint64, kCounterCount> retired_{};
+
+    std::array<std::atomic<qint64>, kGaugeCount> gauges_{};
+};
+
+#endif // SERVERMETRICS_H
@@ -0,0 +1,302 @@
+#include "serversnapshot.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <cstring>
+#include <memory>
+
+#include "servermetrics.h"
+#include "tcpserver.h"
+#include "telemetrystore.h"
+
+namespace {
+const char kFileMagic[8] = {'C', 'S', 'S', 'N', 'A', 'P', '0', '1'};
+const char kTrailerMagic[8] = {'C', 'S', 'S', 'N', 'A', 'P', 'N', 'D'};
+
+constexpr int kClientRecordSize = 64;
+constexpr int kClientAddressSize = 48;
+constexpr int kRollupRecordSize = 48;
+constexpr int kTrailerSize = 80;
+
+constexpr qint64 kMsPerMinute = 60 * 1000;
+constexpr qint64 kMsPerHour = 60 * kMsPerMinute;
+
+// Размер куска при записи и при загрузке агрегатов
+constexpr int kWriteChunkBytes = 1024 * 1024;
+constexpr int kRestoreChunkRecords = 64 * 1024;
+
+template <typename T>
+void put(QByteArray &out, T value)
+{
+    const T le = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+void putDouble(QByteArray &out, double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put<quint64>(out, bits);
+}
+
+template <typename T>
+T get(const uchar *p)
+{
+    return qFromLittleEndian<T>(p);
+}
+
+double getDouble(const uchar *p)
+{
+    const quint64 bits = get<quint64>(p);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+}  // namespace
+
+ServerSnapshot::ServerSnapshot(const QString &path, TcpServer *server, TelemetryStore *store,
+                               QObject *parent)
+    : QObject(parent),
+      path_(path),
+      server_(server),
+      store_(store),
+      writing_(false)
+{
+    pool_.setMaxThreadCount(1);
+    connect(&timer_, &QTimer::timeout, this, &ServerSnapshot::writeInBackground);
+}
+
+ServerSnapshot::~ServerSnapshot()
+{
+    stop();
+}
+
+qint64 ServerSnapshot::load(QString *error)
+{
+    auto file = std::make_shared<QFile>(path_);
+    if (!file->exists()) {
+        return 0;
+    }
+    if (!file->open(QIODevice::ReadOnly)) {
+        *error = QString("cannot open %1: %2").arg(path_, file->errorString());
+        return -1;
+    }
+
+    const qint64 size = file->size();
+    if (size < qint64(sizeof(kFileMagic)) + kTrailerSize) {
+        *error = QString("%1 is truncated").arg(path_);
+        return -1;
+    }
+
+    const uchar *data = file->map(0, size);
+    if (!data) {
+        *error = QString("cannot map %1: %2").arg(path_, file->errorString());
+        return -1;
+    }
+
+    const uchar *trailer = data + size - kTrailerSize;
+    if (std::memcmp(data, kFileMagic, sizeof(kFileMagic)) != 0
+        || std::memcmp(trailer + kTrailerSize - 8, kTrailerMagic, sizeof(kTrailerMagic)) != 0) {
+        *error = QString("%1 is not a snapshot").arg(path_);
+        return -1;
+    }
+
+    const quint64 clients_offset = get<quint64>(trailer);
+    const quint64 client_count = get<quint64>(trailer + 8);
+    const quint64 rollups_offset = get<quint64>(trailer + 16);
+    const quint64 rollup_count = get<quint64>(trailer + 24);
+    const qint64 created_ms = get<qint64>(trailer + 32);
+    const int next_client_id = get<qint32>(trailer + 40);
+
+    ThresholdConfig thresholds;
+    thresholds.max_cpu_usage = get<qint32>(trailer + 44);
+    thresholds.max_latency = getDouble(trailer + 48);
+    thresholds.max_packet_loss = getDouble(trailer + 56);
+    thresholds.max_memory_usage = get<qint32>(trailer + 64);
+
+    const quint64 body_end = quint64(size - kTrailerSize);
+    if (clients_offset + client_count * kClientRecordSize > body_end
+        || rollups_offset + rollup_count * kRollupRecordSize > body_end) {
+        *error = QString("%1 has an invalid trailer").arg(path_);
+        return -1;
+    }
+
+    // Реестр и пороги нужны до приема первого соединения
+    QVector<ClientRecord> clients;
+    clients.reserve(int(client_count));
+    for (quint64 i = 0; i < client_count; ++i) {
+        const uchar *p = data + clients_offset + i * kClientRecordSize;
+        const int ip_length = qMin<int>(get<quint16>(p + 6), kClientAddressSize);
+        clients.append({get<qint32>(p), QString::fromUtf8(reinterpret_cast<const char*>(p + 16),
+                                                           ip_length),
+                        get<quint16>(p + 4), get<qint64>(p + 8)});
+    }
+    server_->restoreRegistry(next_client_id, clients);
+    server_->setThresholds(thresholds);
+
+    // Агрегаты загружаются в фоне, пока сервер уже принимает данные:
+    // слияние корзин коммутативно, порядок с новыми отсчетами не важен
+    pool_.start([this, file, data, rollups_offset, rollup_count] {
+        QElapsedTimer timer;
+        timer.start();
+
+        // Корзины за пределами текущих сроков хранения не восстанавливаются
+        const qint64 now_ms = QDateTime::currentMSecsSinceEpoch();
+        const qint64 oldest_minute = now_ms / kMsPerMinute - store_->retentionMinutes();
+        const qint64 oldest_hour = now_ms / kMsPerHour - store_->retentionHours();
+
+        QVector<RollupRecord> chunk;
+        chunk.reserve(kRestoreChunkRecords);
+        qint64 restored = 0;
+        for (quint64 i = 0; i < rollup_count; ++i) {
+            const uchar *p = data + rollups_offset + i * kRollupRecordSize;
+            const int metric = p[4];
+            const bool hourly = p[5] != 0;
+            const qint64 key = get<qint64>(p + 8);
+            if (metric >= kTelemetryMetricCount
+                || key < (hourly ? oldest_hour : oldest_minute)) {
+                continue;
+            }
+
+            RollupRecord record{get<qint32>(p), static_cast<TelemetryMetric>(metric),
+                                hourly, key, {}};
+            record.value.count = get<qint64>(p + 16);
+            record.value.sum = getDouble(p + 24);
+            record.value.min = getDouble(p + 32);
+            record.value.max = getDouble(p + 40);
+            chunk.append(record);
+
+            if (chunk.size() >= kRestoreChunkRecords) {
+                store_->restoreRollups(chunk);
+                restored += chunk.size();
+                chunk.clear();
+            }
+        }
+        store_->restoreRollups(chunk);
+        restored += chunk.size();
+
+        file->unmap(const_cast<uchar*>(data));
+        emit logMessage(QString("Snapshot: restored %1 rollup buckets in %2 ms")
+                        .arg(restored).arg(timer.elapsed()));
+    });
+
+    emit logMessage(QString("Snapshot: restored %1 clients, next id %2")
+                    .arg(client_count).arg(next_client_id));
+    return created_ms;
+}
+
+void ServerSnapshot::start(int interval_seconds)
+{
+    timer_.start(qMax(1, interval_seconds) * 1000);
+}
+
+void ServerSnapshot::stop()
+{
+    timer_.stop();
+    pool_.waitForDone();
+}
+
+bool ServerSnapshot::write(QString *error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QSaveFile file(path_);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *error = QString("cannot create %1: %2").arg(path_, file.errorString());
+        return false;
+    }
+
+    // Состояние сервера читается до агрегатов: next_client_id не меньше
+    // любого id, встречающегося в хранилище
+    const qint64 created_ms = QDateTime::currentMSecsSinceEpoch();
+    const int next_client_id = server_->nextClientId();
+    const ThresholdConfig thresholds = server_->getThresholds();
+    const QVector<ClientRecord> clients = server_->clientRegistry();
+
+    QByteArray chunk;
+    chunk.reserve(kWriteChunkBytes + kRollupRecordSize);
+    quint64 written = 0;
+    auto flush = [&] {
+        file.write(chunk);
+        written += quint64(chunk.size());
+        chunk.clear();
+    };
+
+    chunk.append(kFileMagic, sizeof(kFileMagic));
+
+    const quint64 clients_offset = sizeof(kFileMagic);
+    for (const ClientRecord &client : clients) {
+        const QByteArray address = client.ip_address.toUtf8().left(kClientAddressSize);
+        put<qint32>(chunk, client.id);
+        put<quint16>(chunk, client.port);
+        put<quint16>(chunk, quint16(address.size()));
+        put<qint64>(chunk, client.last_seen_ms);
+        chunk.append(address);
+        chunk.append(QByteArray(kClientAddressSize - address.size(), '\0'));
+        if (chunk.size() >= kWriteChunkBytes) {
+            flush();
+        }
+    }
+
+    const quint64 rollups_offset = written + quint64(chunk.size());
+    quint64 rollup_count = 0;
+    store_->exportRollups([&](const RollupRecord &record) {
+        put<qint32>(chunk, record.client_id);
+        chunk.append(char(record.metric));
+        chunk.append(char(record.hourly ? 1 : 0));
+        put<quint16>(chunk, 0);
+        put<qint64>(chunk, record.key);
+        put<qint64>(chunk, record.value.count);
+        putDouble(chunk, record.value.sum);
+        putDouble(chunk, record.value.min);
+        putDouble(chunk, record.value.max);
+        ++rollup_count;
+        if (chunk.size() >= kWriteChunkBytes) {
+            flush();
+        }
+    });
+
+    put<quint64>(chunk, clients_offset);
+    put<quint64>(chunk, quint64(clients.size()));
+    put<quint64>(chunk, rollups_offset);
+    put<quint64>(chunk, rollup_count);
+    put<qint64>(chunk, created_ms);
+    put<qint32>(chunk, next_client_id);
+    put<qint32>(chunk, thresholds.max_cpu_usage);
+    putDouble(chunk, thresholds.max_latency);
+    putDouble(chunk, thresholds.max_packet_loss);
+    put<qint32>(chunk, thresholds.max_memory_usage);
+    put<quint32>(chunk, 0);
+    chunk.append(kTrailerMagic, sizeof(kTrailerMagic));
+    flush();
+
+    if (!file.commit()) {
+        *error = QString("cannot write %1: %2").arg(path_, file.errorString());
+        return false;
+    }
+
+    ServerMetrics::increment(Counter::SnapshotsWritten);
+    ServerMetrics::increment(Counter::SnapshotMilliseconds, quint64(timer.elapsed()));
+    return true;
+}
+
+void ServerSnapshot::writeInBackground()
+{
+    // Предыдущий снимок еще пишется — пропускаем тик
+    if (writing_.exchange(true)) {
+        return;
+    }
+
+    pool_.start([this] {
+        QString error;
+        if (!write(&error)) {
+            emit logMessage("Snapshot failed: " + error);
+        }
+        writing_ = false;
+    });
+}
@@ -0,0 +1,65 @@
+#ifndef SERVERSNAPSHOT_H
+#define SERVERSNAPSHOT_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
+
+class TcpServer;
+class TelemetryStore;
+
+// Periodic snapshot of the server state for fast restart.
+//
+// В снимок входят следующий client_id, реестр клиентов, пороги
+// предупреждений и агрегаты хранилища. Формат — записи фиксированного
+// размера, которые читаются прямо из отображенного в память файла:
+//
+//   "CSSNAP01"
+//   клиенты:  64 байта — i32 id, u16 port, u16 ip_len, i64 last_seen_ms, ip[48]
+//   агрегаты: 48 байт  — i32 client_id, u8 metric, u8 hourly, u16 0, i64 key,
+//                        i64 count, f64 sum, f64 min, f64 max
+//   трейлер:  смещения и число записей, время снимка, next_client_id,
+//             пороги, "CSSNAPND"
+//
+// Запись выполняется в отдельном потоке и не блокирует прием: хранилище
+// копируется по шардам неглубоко. Файл заменяется атомарно (QSaveFile).
+class ServerSnapshot : public QObject
+{
+    Q_OBJECT
+
+public:
+    ServerSnapshot(const QString &path, TcpServer *server, TelemetryStore *store,
+                   QObject *parent = nullptr);
+    ~ServerSnapshot();
+
+    // Restore state before the server starts. Реестр и пороги применяются
+    // сразу, агрегаты загружаются в фоне. Returns the snapshot time (ms since
+    // epoch), 0 if there is no snapshot, -1 on error.
+    qint64 load(QString *error);
+
+    // Periodic snapshots in the background
+    void start(int interval_seconds);
+    void stop();
+
+    // Write a snapshot now, in the calling thread
+    bool write(QString *error);
+
+signals:
+    void logMessage(const QString &message);
+
+private:
+    void writeInBackground();
+
+    const QString path_;
+    TcpServer *server_;
+    TelemetryStore *store_;
+
+    QTimer timer_;
+    // Один поток: запись снимков и фоновая загрузка агрегатов не пересекаются
+    QThreadPool pool_;
+    std::atomic<bool> writing_;
+};
+
+#endif // SERVERSNAPSHOT_H
@@ -2,53 +2,70 @@
 #include "ui_serverwindow.h"
 
 #include <QDateTime>
+#include <QFileDialog>
 #include <QInputDialog>
 #include <QJsonDocument>
 #include <QMessageBox>
 
+#include "sessionrecorder.h"
+#include "sessionviewer.h"
+#include "sharedstate.h"
+
 namespace {
 constexpr int kMaxDataTableRows = 1000;  // Limit data table rows
+constexpr int kAttachRefreshMs = 100;    // Частота опроса общей памяти
 }  // namespace
 
-ServerWindow::ServerWindow(QWidget *parent)
+ServerWindow::ServerWindow(ServerHost *host, QWidget *parent)
     : QMainWindow(parent),
       ui(new Ui::ServerWindow),
-      server_(new TcpServer()),
-      server_thread_(new QThread(this))
+      host_(host),
+      server_(host->server())
 {
     ui->setupUi(this);
-
-    // Move server to separate thread
-    server_->moveToThread(server_thread_);
-    server_thread_->start();
-
-    // Configure table behavior
-    ui->tableClients->horizontalHeader()->setStretchLastSection(true);
-    ui->tableData->horizontalHeader()->setStretchLastSection(true);
-
+    setupTables();
     setupConnections();
     updateButtonStates();
 
     appendLog("Server application started");
 }
 
-ServerWindow::~ServerWindow()
+ServerWindow::ServerWindow(SharedStateReader *reader, QWidget *parent)
+    : QMainWindow(parent),
+      ui(new Ui::ServerWindow),
+      host_(nullptr),
+      server_(nullptr),
+      reader_(reader),
+      attach_timer_(new QTimer(this))
 {
-    // Останавливаем сервер в его потоке
-    if (server_running_) {
-        QMetaObject::invokeMethod(server_, "stopServer", Qt::BlockingQueuedConnection);
-    }
+    ui->setupUi(this);
+    setupTables();
+    setWindowTitle(windowTitle() + " — " + reader_->name());
 
-    // Запланировать удаление сервера в его потоке
-    server_->deleteLater();
+    // Управление сервером недоступно: окно только читает общую память
+    connect(ui->btnOpenSession, &QPushButton::clicked,
+            this, &ServerWindow::onOpenSessionClicked);
+    connect(attach_timer_, &QTimer::timeout,
+            this, &ServerWindow::onAttachTimer);
+    attach_timer_->start(kAttachRefreshMs);
 
-    // Завершить поток
-    server_thread_->quit();
-    server_thread_->wait();
+    updateButtonStates();
+    appendLog("Attached to " + reader_->name());
+}
 
+ServerWindow::~ServerWindow()
+{
+    // Сервер и его поток принадлежат ServerHost
     delete ui;
 }
 
+void ServerWindow::setupTables()
+{
+    // Configure table behavior
+    ui->tableClients->horizontalHeader()->setStretchLastSection(true);
+    ui->tableData->horizontalHeader()->setStretchLastSection(true);
+}
+
 void ServerWindow::setupConnections()
 {
     // UI button connections
@@ -62,6 +79,10 @@ void ServerWindow::setupConnections()
             this, &ServerWindow::onStopClientsClicked);
     connect(ui->btnSettings, &QPushButton::clicked,
             this, &ServerWindow::onSettingsClicked);
+    connect(ui->btnRecordSession, &QPushButton::clicked,
+            this, &ServerWindow::onRecordSessionClicked);
+    connect(ui->btnOpenSession, &QPushButton::clicked,
+            this, &ServerWindow::onOpenSessionClicked);
 
     // Server event connections (cross-thread, use queued)
     connect(server_, &TcpServer::clientConnected,
@@ -78,6 +99,8 @@ void ServerWindow::setupConnections()
             this, &ServerWindow::onServerStarted, Qt::QueuedConnection);
     connect(server_, &TcpServer::serverStopped,
             this, &ServerWindow::onServerStopped, Qt::QueuedConnection);
+    connect(host_, &ServerHost::logMessage,
+            this, &ServerWindow::onLogMessage, Qt::QueuedConnection);
 }
 
 void ServerWindow::onStartServerClicked()
@@ -85,7 +108,7 @@ void ServerWindow::onStartServerClicked()
     // Start server on its thread
     QMetaObject::invokeMethod(server_, "startServer",
                               Qt::QueuedConnection,
-                              Q_ARG(quint16, 12345));
+                              Q_ARG(quint16, host_->options().port));
 }
 
 void ServerWindow::onStopServerClicked()
@@ -136,6 +159,58 @@ void ServerWindow::onSettingsClicked()
               .arg(latency).arg(packet_loss).arg(cpu).arg(memory));
 }
 
+void ServerWindow::onRecordSessionClicked()
+{
+    SessionRecorder *recorder = host_->sessionRecorder();
+
+    if (recorder->isRecording()) {
+        QString error;
+        const qint64 records = recorder->stopRecording(&error);
+        if (records < 0) {
+            QMessageBox::warning(this, "Session", "Failed to finish session file: " + error);
+        } else {
+            appendLog(QString("Session recording stopped, %1 records saved").arg(records));
+        }
+        updateButtonStates();
+        return;
+    }
+
+    const QString path = QFileDialog::getSaveFileName(this, "Record Session",
+        QString("session-%1.cssession").arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")),
+        "Capture sessions (*.cssession)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QString error;
+    if (!recorder->startRecording(path, &error)) {
+        QMessageBox::warning(this, "Session", error);
+        return;
+    }
+    appendLog("Recording session to " + path);
+    updateButtonStates();
+}
+
+void ServerWindow::onOpenSessionClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, "Open Session", QString(),
+        "Capture sessions (*.cssession);;All files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
+
+    SessionViewer *viewer = new SessionViewer(this);
+    viewer->setAttribute(Qt::WA_DeleteOnClose);
+
+    QString error;
+    if (!viewer->openSession(path, &error)) {
+        delete viewer;
+        QMessageBox::warning(this, "Session", error);
+        return;
+    }
+    viewer->show();
+}
+
 void ServerWindow::onClientConnected(const ClientInfo &info)
 {
     clients_[info.id] = info;
@@ -158,9 +233,11 @@ void ServerWindow::onClientStatusChanged(int client_id, bool is_running)
     }
 }
 
-void ServerWindow::onDataReceived(const ClientData &data)
+void ServerWindow::onDataReceived(const QVector<ClientData> &batch)
 {
-    addDataToTable(data);
+    for (const ClientData &data : batch) {
+        addDataToTable(data);
+    }
 }
 
 void ServerWindow::onLogMessage(const QString &message)
@@ -172,11 +249,12 @@ void ServerWindow::onServerStarted()
 {
     server_running_ = true;
     updateButtonStates();
-    ui->statusbar->showMessage("Server running on port 12345");
+    ui->statusbar->showMessage(QString("Server running on port %1").arg(host_->options().port));
 }
 
 void ServerWindow::onServerStopped()
 {
+    // Остановка конвейера закрывает приемники, в том числе запись сессии
     server_running_ = false;
     clients_.clear();
     updateClientTable();
@@ -184,6 +262,74 @@ void ServerWindow::onServerStopped()
     ui->statusbar->showMessage("Server stopped");
 }
 
+void ServerWindow::onAttachTimer()
+{
+    // Только что подключенное окно начинает с последних состояний: от
+    // редко пишущих клиентов в кольце записей может ничего не оказаться
+    if (!states_loaded_) {
+        states_loaded_ = true;
+        const QVector<ClientData> states = reader_->readStates();
+        for (const ClientData &data : states) {
+            addDataToTable(data);
+        }
+    }
+
+    // Новые записи — не больше, чем помещается в таблицу
+    const QVector<ClientData> records = reader_->readRecords(&record_cursor_, kMaxDataTableRows);
+    if (!records.isEmpty()) {
+        ui->tableData->setUpdatesEnabled(false);
+        for (const ClientData &data : records) {
+            addDataToTable(data);
+        }
+        ui->tableData->setUpdatesEnabled(true);
+    }
+
+    QVector<ClientInfo> clients;
+    if (reader_->readClients(&clients)) {
+        bool changed = clients.size() != clients_.size();
+        for (int i = 0; !changed && i < clients.size(); ++i) {
+            const ClientInfo &known = clients_.value(clients[i].id, clients[i]);
+            changed = !clients_.contains(clients[i].id) || known.is_running != clients[i].is_running;
+        }
+        if (changed) {
+            clients_.clear();
+            for (const ClientInfo &info : std::as_const(clients)) {
+                clients_.insert(info.id, info);
+            }
+            updateClientTable();
+        }
+    }
+
+    SharedStats stats;
+    if (reader_->readStats(&stats)) {
+        using namespace SharedState;
+        const bool alive = QDateTime::currentMSecsSinceEpoch() - stats.values[UpdatedMs]
+                           < kStaleMs;
+        if (!alive) {
+            ui->statusbar->showMessage("Server is not publishing (stopped or not responding)");
+        } else if (stats.values[Running] == 0) {
+            ui->statusbar->showMessage("Server stopped");
+        } else {
+            ui->statusbar->showMessage(
+                QString("Server running on port %1 | clients: %2 | messages: %3 | "
+                        "in: %4 KB | alerts: %5 | dropped: %6 | "
+                        "rx buffers: %7 KB / %8 MB | tx queued: %9 KB")
+                    .arg(stats.values[Port])
+                    .arg(stats.values[Connections])
+                    .arg(stats.values[Messages])
+                    .arg(stats.values[BytesIn] / 1024)
+                    .arg(stats.values[Alerts])
+                    .arg(stats.values[SinkDropped])
+                    .arg(stats.values[ReceiveBuffers] / 1024)
+                    .arg(stats.values[ReceiveLimit] / (1024 * 1024))
+                    .arg(stats.values[SendQueued] / 1024)
+                + (stats.values[ClientsOmitted] > 0
+                       ? QString(" | clients not shown: %1").arg(stats.values[ClientsOmitted])
+                       : QString()));
+        }
+    }
+}
+
 void ServerWindow::updateClientTable()
 {
     ui->tableClients->setRowCount(0);
@@ -251,6 +397,16 @@ void ServerWindow::appendLog(const QString &message)
 
 void ServerWindow::updateButtonStates()
 {
+    if (reader_) {
+        ui->btnStartServer->setEnabled(false);
+        ui->btnStopServer->setEnabled(false);
+        ui->btnStartClients->setEnabled(false);
+        ui->btnStopClients->setEnabled(false);
+        ui->btnSettings->setEnabled(false);
+        ui->btnRecordSession->setEnabled(false);
+        return;
+    }
+
     // Используем локальную копию состояния (потокобезопасно)
     bool has_clients = !clients_.isEmpty();
 
@@ -258,4 +414,6 @@ void ServerWindow::updateButtonStates()
     ui->btnStopServer->setEnabled(server_running_);
     ui->btnStartClients->setEnabled(server_running_ && has_clients);
     ui->btnStopClients->setEnabled(server_running_ && has_clients);
+    ui->btnRecordSession->setText(host_->sessionRecorder()->isRecording()
+                                  ? "Stop Recording" : "Record Session");
 }
@@ -2,10 +2,13 @@
 #define SERVERWINDOW_H
 
 #include <QMainWindow>
-#include <QThread>
+#include <QTimer>
 
+#include "serverhost.h"
 #include "tcpserver.h"
 
+class SharedStateReader;
+
 namespace Ui {
 class ServerWindow;
 }
@@ -15,9 +18,15 @@ class ServerWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    explicit ServerWindow(QWidget *parent = nullptr);
+    explicit ServerWindow(ServerHost *host, QWidget *parent = nullptr);
+    // Detached window: read-only view of a server publishing its state
+    // in shared memory (see SharedStatePublisher)
+    explicit ServerWindow(SharedStateReader *reader, QWidget *parent = nullptr);
     ~ServerWindow();
 
+    // Format JSON content for display based on data type
+    static QString formatDataContent(const QString &type, const QJsonObject &content);
+
 private slots:
     // UI button handlers
     void onStartServerClicked();
@@ -25,29 +34,38 @@ private slots:
     void onStartClientsClicked();
     void onStopClientsClicked();
     void onSettingsClicked();
+    void onRecordSessionClicked();
+    void onOpenSessionClicked();
 
     // Server event handlers
     void onClientConnected(const ClientInfo &info);
     void onClientDisconnected(int client_id);
     void onClientStatusChanged(int client_id, bool is_running);
-    void onDataReceived(const ClientData &data);
+    void onDataReceived(const QVector<ClientData> &batch);
     void onLogMessage(const QString &message);
     void onServerStarted();
     void onServerStopped();
 
+    // Detached mode: poll the shared state at the window's own pace
+    void onAttachTimer();
+
 private:
+    void setupTables();
     void setupConnections();
     void updateClientTable();
     void addDataToTable(const ClientData &data);
     void appendLog(const QString &message);
     void updateButtonStates();
 
-    // Format JSON content for display based on data type
-    QString formatDataContent(const QString &type, const QJsonObject &content);
-
     Ui::ServerWindow *ui;
+    ServerHost *host_;
     TcpServer *server_;
-    QThread *server_thread_;
+
+    // Только в отдельном процессе окна
+    SharedStateReader *reader_ = nullptr;
+    QTimer *attach_timer_ = nullptr;
+    quint64 record_cursor_ = 0;
+    bool states_loaded_ = false;
 
     // Локальная копия состояния сервера (для потокобезопасности)
     bool server_running_ = false;
@@ -0,0 +1,456 @@
+#include "sessionfile.h"
+
+#include <QJsonDocument>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+const char kFileMagic[8] = {'C', 'S', 'S', 'E', 'S', 'S', '0', '1'};
+const char kTrailerMagic[8] = {'C', 'S', 'S', 'E', 'S', 'E', 'N', 'D'};
+
+constexpr int kPageHeaderSize = 16;
+constexpr int kBytesPerRecord = 13;     // client_id + time_offset + payload_end + type
+constexpr int kDirectoryEntrySize = 40;
+constexpr int kClientEntrySize = 16;
+constexpr int kTrailerSize = 48;
+
+template <typename T>
+void put(QByteArray &out, T value)
+{
+    const T le = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+// Чтение без требований к выравниванию
+template <typename T>
+T get(const uchar *p)
+{
+    return qFromLittleEndian<T>(p);
+}
+
+SessionRecordType typeCode(const QString &type)
+{
+    if (type == QLatin1String("NetworkMetrics")) {
+        return SessionRecordType::NetworkMetrics;
+    }
+    if (type == QLatin1String("DeviceStatus")) {
+        return SessionRecordType::DeviceStatus;
+    }
+    if (type == QLatin1String("Log")) {
+        return SessionRecordType::Log;
+    }
+    return SessionRecordType::Other;
+}
+}  // namespace
+
+SessionWriter::~SessionWriter()
+{
+    close();
+}
+
+bool SessionWriter::open(const QString &path, QString *error)
+{
+    close();
+
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = QString("cannot create %1: %2").arg(path, file_.errorString());
+        return false;
+    }
+
+    file_.write(kFileMagic, sizeof(kFileMagic));
+    record_count_ = 0;
+    clients_.reserve(kSessionPageRecords);
+    timestamps_.reserve(kSessionPageRecords);
+    payload_ends_.reserve(kSessionPageRecords);
+    return true;
+}
+
+void SessionWriter::append(const ClientData &data)
+{
+    clients_.append(data.client_id);
+    timestamps_.append(data.timestamp.toMSecsSinceEpoch());
+    types_.append(char(typeCode(data.data_type)));
+    blob_ += QJsonDocument(data.content).toJson(QJsonDocument::Compact);
+    payload_ends_.append(quint32(blob_.size()));
+
+    client_index_[data.client_id].records++;
+    ++record_count_;
+
+    if (clients_.size() >= kSessionPageRecords) {
+        flushPage();
+    }
+}
+
+bool SessionWriter::close(QString *error)
+{
+    if (!file_.isOpen()) {
+        return true;
+    }
+
+    flushPage();
+
+    QByteArray footer;
+    const quint64 directory_offset = quint64(file_.pos());
+    for (const PageEntry &page : std::as_const(pages_)) {
+        put<quint64>(footer, page.offset);
+        put<quint32>(footer, page.records);
+        put<quint32>(footer, page.size);
+        put<qint64>(footer, page.min_ms);
+        put<qint64>(footer, page.max_ms);
+        put<quint64>(footer, page.first_record);
+    }
+
+    const quint64 clients_offset = directory_offset + quint64(footer.size());
+    QByteArray page_refs;
+    quint32 ref_count = 0;
+    for (auto it = client_index_.cbegin(); it != client_index_.cend(); ++it) {
+        put<qint32>(footer, it.key());
+        put<quint32>(footer, ref_count);
+        put<quint32>(footer, quint32(it->pages.size()));
+        put<quint32>(footer, it->records);
+        for (quint32 page : it->pages) {
+            put<quint32>(page_refs, page);
+        }
+        ref_count += quint32(it->pages.size());
+    }
+
+    const quint64 page_refs_offset = directory_offset + quint64(footer.size());
+    footer += page_refs;
+
+    put<quint64>(footer, directory_offset);
+    put<quint64>(footer, clients_offset);
+    put<quint64>(footer, page_refs_offset);
+    put<quint64>(footer, quint64(record_count_));
+    put<quint32>(footer, quint32(pages_.size()));
+    put<quint32>(footer, quint32(client_index_.size()));
+    footer.append(kTrailerMagic, sizeof(kTrailerMagic));
+
+    file_.write(footer);
+    const bool ok = file_.flush() && file_.error() == QFileDevice::NoError;
+    if (!ok && error) {
+        *error = file_.errorString();
+    }
+    file_.close();
+
+    pages_.clear();
+    client_index_.clear();
+    return ok;
+}
+
+bool SessionWriter::isOpen() const
+{
+    return file_.isOpen();
+}
+
+qint64 SessionWriter::recordCount() const
+{
+    return record_count_;
+}
+
+void SessionWriter::flushPage()
+{
+    const int count = clients_.size();
+    if (count == 0) {
+        return;
+    }
+
+    const auto [min_it, max_it] = std::minmax_element(timestamps_.cbegin(), timestamps_.cend());
+    const qint64 min_ms = *min_it;
+    const qint64 max_ms = *max_it;
+
+    QByteArray page;
+    page.reserve(kPageHeaderSize + count * kBytesPerRecord + blob_.size() + 8);
+    put<quint32>(page, quint32(count));
+    put<quint32>(page, quint32(blob_.size()));
+    put<qint64>(page, min_ms);
+    for (qint32 client_id : std::as_const(clients_)) {
+        put<qint32>(page, client_id);
+    }
+    for (qint64 timestamp : std::as_const(timestamps_)) {
+        put<quint32>(page, quint32(qMin<qint64>(timestamp - min_ms,
+                                                std::numeric_limits<quint32>::max())));
+    }
+    for (quint32 end : std::as_const(payload_ends_)) {
+        put<quint32>(page, end);
+    }
+    page += types_;
+    page += blob_;
+    page.append((8 - page.size() % 8) % 8, '\0');
+
+    const quint32 page_index = quint32(pages_.size());
+    pages_.append({quint64(file_.pos()), quint32(count), quint32(page.size()),
+                   min_ms, max_ms, quint64(record_count_ - count)});
+    file_.write(page);
+
+    // Страница попадает в индекс каждого клиента, чьи записи в ней есть
+    for (qint32 client_id : std::as_const(clients_)) {
+        QVector<quint32> &pages = client_index_[client_id].pages;
+        if (pages.isEmpty() || pages.last() != page_index) {
+            pages.append(page_index);
+        }
+    }
+
+    clients_.clear();
+    timestamps_.clear();
+    payload_ends_.clear();
+    types_.clear();
+    blob_.clear();
+}
+
+QString SessionRecord::typeName() const
+{
+    switch (type) {
+    case SessionRecordType::NetworkMetrics:
+        return QStringLiteral("NetworkMetrics");
+    case SessionRecordType::DeviceStatus:
+        return QStringLiteral("DeviceStatus");
+    case SessionRecordType::Log:
+        return QStringLiteral("Log");
+    case SessionRecordType::Other:
+        break;
+    }
+    return QJsonDocument::fromJson(payload).object()["type"].toString();
+}
+
+ClientData SessionRecord::toClientData() const
+{
+    ClientData data;
+    data.client_id = client_id;
+    data.content = QJsonDocument::fromJson(payload).object();
+    data.data_type = type == SessionRecordType::Other
+        ? data.content["type"].toString() : typeName();
+    data.timestamp = QDateTime::fromMSecsSinceEpoch(timestamp_ms);
+    return data;
+}
+
+SessionFile::SessionFile()
+    : data_(nullptr), size_(0), record_count_(0), page_refs_(nullptr)
+{
+}
+
+SessionFile::~SessionFile()
+{
+    close();
+}
+
+bool SessionFile::open(const QString &path, QString *error)
+{
+    close();
+
+    auto fail = [this, error](const QString &message) {
+        *error = message;
+        close();
+        return false;
+    };
+
+    file_.setFileName(path);
+    if (!file_.open(QIODevice::ReadOnly)) {
+        return fail(QString("cannot open %1: %2").arg(path, file_.errorString()));
+    }
+
+    size_ = file_.size();
+    if (size_ < qint64(sizeof(kFileMagic)) + kTrailerSize) {
+        return fail("not a session file");
+    }
+
+    data_ = file_.map(0, size_);
+    if (!data_) {
+        return fail(QString("cannot map %1: %2").arg(path, file_.errorString()));
+    }
+    if (std::memcmp(data_, kFileMagic, sizeof(kFileMagic)) != 0) {
+        return fail("not a session file");
+    }
+
+    const uchar *trailer = data_ + size_ - kTrailerSize;
+    if (std::memcmp(trailer + 40, kTrailerMagic, sizeof(kTrailerMagic)) != 0) {
+        return fail("session file has no index (recording was not stopped cleanly)");
+    }
+
+    const quint64 directory_offset = get<quint64>(trailer);
+    const quint64 clients_offset = get<quint64>(trailer + 8);
+    const quint64 page_refs_offset = get<quint64>(trailer + 16);
+    const quint64 record_count = get<quint64>(trailer + 24);
+    const quint32 page_count = get<quint32>(trailer + 32);
+    const quint32 client_count = get<quint32>(trailer + 36);
+    const quint64 footer_end = quint64(size_ - kTrailerSize);
+
+    if (directory_offset + quint64(page_count) * kDirectoryEntrySize != clients_offset
+        || clients_offset + quint64(client_count) * kClientEntrySize != page_refs_offset
+        || page_refs_offset > footer_end) {
+        return fail("corrupted session index");
+    }
+
+    // Читается только footer: страницы с данными не затрагиваются
+    pages_.reserve(page_count);
+    for (quint32 i = 0; i < page_count; ++i) {
+        const uchar *p = data_ + directory_offset + quint64(i) * kDirectoryEntrySize;
+        PageEntry page;
+        page.offset = get<quint64>(p);
+        page.records = get<quint32>(p + 8);
+        page.size = get<quint32>(p + 12);
+        page.min_ms = get<qint64>(p + 16);
+        page.max_ms = get<qint64>(p + 24);
+        page.first_record = get<quint64>(p + 32);
+        if (page.offset + page.size > directory_offset) {
+            return fail("corrupted session index");
+        }
+        pages_.append(page);
+    }
+
+    const quint64 page_ref_total = (footer_end - page_refs_offset) / sizeof(quint32);
+    for (quint32 i = 0; i < client_count; ++i) {
+        const uchar *p = data_ + clients_offset + quint64(i) * kClientEntrySize;
+        ClientEntry client;
+        client.first_page_ref = get<quint32>(p + 4);
+        client.page_ref_count = get<quint32>(p + 8);
+        client.records = get<quint32>(p + 12);
+        if (quint64(client.first_page_ref) + client.page_ref_count > page_ref_total) {
+            return fail("corrupted session index");
+        }
+        clients_.insert(get<qint32>(p), client);
+    }
+
+    page_refs_ = data_ + page_refs_offset;
+    record_count_ = qint64(record_count);
+    return true;
+}
+
+void SessionFile::close()
+{
+    if (data_) {
+        file_.unmap(const_cast<uchar*>(data_));
+    }
+    file_.close();
+
+    data_ = nullptr;
+    size_ = 0;
+    record_count_ = 0;
+    pages_.clear();
+    clients_.clear();
+    page_refs_ = nullptr;
+}
+
+qint64 SessionFile::recordCount() const
+{
+    return record_count_;
+}
+
+qint64 SessionFile::startTime() const
+{
+    return pages_.isEmpty() ? 0 : pages_.first().min_ms;
+}
+
+qint64 SessionFile::endTime() const
+{
+    return pages_.isEmpty() ? 0 : pages_.last().max_ms;
+}
+
+QList<int> SessionFile::clientIds() const
+{
+    return clients_.keys();
+}
+
+SessionRecord SessionFile::record(qint64 index) const
+{
+    SessionRecord record;
+    const int page = pageForRecord(index);
+    if (page < 0) {
+        return record;
+    }
+
+    const PageView view = pageView(page);
+    const quint64 i = quint64(index) - pages_[page].first_record;
+    if (i >= view.records) {
+        return record;
+    }
+
+    record.client_id = get<qint32>(view.clients + i * 4);
+    record.timestamp_ms = view.base_ms + get<quint32>(view.time_offsets + i * 4);
+    record.type = static_cast<SessionRecordType>(qMin<quint8>(view.types[i], 3));
+
+    const quint32 begin = i == 0 ? 0 : get<quint32>(view.payload_ends + (i - 1) * 4);
+    const quint32 end = get<quint32>(view.payload_ends + i * 4);
+    if (begin <= end && end <= view.blob_size) {
+        record.payload = QByteArray::fromRawData(
+            reinterpret_cast<const char*>(view.blob + begin), int(end - begin));
+    }
+    return record;
+}
+
+QVector<qint64> SessionFile::recordsForClient(int client_id) const
+{
+    QVector<qint64> records;
+    const auto client = clients_.constFind(client_id);
+    if (client == clients_.cend()) {
+        return records;
+    }
+
+    records.reserve(client->records);
+    for (quint32 r = 0; r < client->page_ref_count; ++r) {
+        const quint32 page = get<quint32>(page_refs_ + quint64(client->first_page_ref + r) * 4);
+        if (page >= quint32(pages_.size())) {
+            continue;
+        }
+
+        const PageView view = pageView(int(page));
+        const qint64 first = qint64(pages_[page].first_record);
+        for (quint32 i = 0; i < view.records; ++i) {
+            if (get<qint32>(view.clients + i * 4) == client_id) {
+                records.append(first + i);
+            }
+        }
+    }
+    return records;
+}
+
+qint64 SessionFile::findRecordAt(qint64 timestamp_ms) const
+{
+    // Время приема монотонно, поэтому max_ms страниц упорядочены
+    const auto it = std::lower_bound(pages_.cbegin(), pages_.cend(), timestamp_ms,
+                                     [](const PageEntry &page, qint64 value) {
+        return page.max_ms < value;
+    });
+    return it == pages_.cend() ? record_count_ : qint64(it->first_record);
+}
+
+int SessionFile::pageForRecord(qint64 index) const
+{
+    if (index < 0 || index >= record_count_) {
+        return -1;
+    }
+
+    const auto it = std::upper_bound(pages_.cbegin(), pages_.cend(), quint64(index),
+                                     [](quint64 value, const PageEntry &page) {
+        return value < page.first_record;
+    });
+    return int(it - pages_.cbegin()) - 1;
+}
+
+SessionFile::PageView SessionFile::pageView(int page) const
+{
+    PageView view;
+    const PageEntry &entry = pages_[page];
+    const uchar *p = data_ + entry.offset;
+
+    const quint32 records = get<quint32>(p);
+    const quint32 blob_size = get<quint32>(p + 4);
+    const quint64 required = kPageHeaderSize + quint64(records) * kBytesPerRecord + blob_size;
+    if (records != entry.records || required > entry.size) {
+        return view;  // Поврежденная страница читается как пустая
+    }
+
+    view.records = records;
+    view.base_ms = get<qint64>(p + 8);
+    view.clients = p + kPageHeaderSize;
+    view.time_offsets = view.clients + records * 4;
+    view.payload_ends = view.time_offsets + records * 4;
+    view.types = view.payload_ends + records * 4;
+    view.blob = view.types + records;
+    view.blob_size = blob_size;
+    return view;
+}
@@ -0,0 +1,167 @@
+#ifndef SESSIONFILE_H
+#define SESSIONFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+#include "tcpserver.h"
+
+// Capture session file: columnar pages plus a footer index.
+//
+// Записи хранятся страницами по kSessionPageRecords в порядке приема.
+// Внутри страницы каждое поле — отдельный столбец, поэтому для прокрутки
+// и фильтрации читаются только нужные столбцы, а JSON сообщения
+// разбирается лишь для видимых строк. Все числа little-endian.
+//
+//   "CSSESS01"
+//   page*:  { u32 records, u32 blob_size, i64 base_ms }
+//           i32 client_id[n], u32 time_offset_ms[n], u32 payload_end[n],
+//           u8 type[n], blob (компактный JSON), выравнивание до 8 байт
+//   footer: page directory  { u64 offset, u32 records, u32 size,
+//                             i64 min_ms, i64 max_ms, u64 first_record }
+//           client index    { i32 client_id, u32 first_page_ref,
+//                             u32 page_ref_count, u32 records }
+//           page refs       u32[] — номера страниц клиента
+//           trailer         { u64 directory_offset, u64 clients_offset,
+//                             u64 page_refs_offset, u64 records,
+//                             u32 pages, u32 clients, "CSSESEND" }
+
+constexpr int kSessionPageRecords = 4096;
+
+// Типы сообщений хранятся кодом; прочие типы восстанавливаются из JSON
+enum class SessionRecordType : quint8 {
+    NetworkMetrics = 0,
+    DeviceStatus = 1,
+    Log = 2,
+    Other = 3
+};
+
+// Streams records into a session file. Not thread-safe.
+class SessionWriter
+{
+public:
+    ~SessionWriter();
+
+    bool open(const QString &path, QString *error);
+    void append(const ClientData &data);
+    // Flush the last page and write the footer
+    bool close(QString *error = nullptr);
+
+    bool isOpen() const;
+    qint64 recordCount() const;
+
+private:
+    struct PageEntry {
+        quint64 offset;
+        quint32 records;
+        quint32 size;
+        qint64 min_ms;
+        qint64 max_ms;
+        quint64 first_record;
+    };
+
+    struct ClientEntry {
+        QVector<quint32> pages;
+        quint32 records = 0;
+    };
+
+    void flushPage();
+
+    QFile file_;
+    qint64 record_count_ = 0;
+
+    // Столбцы текущей страницы
+    QVector<qint32> clients_;
+    QVector<qint64> timestamps_;
+    QVector<quint32> payload_ends_;
+    QByteArray types_;
+    QByteArray blob_;
+
+    QVector<PageEntry> pages_;
+    QMap<int, ClientEntry> client_index_;
+};
+
+// One record as stored; payload points into the mapped file
+struct SessionRecord {
+    int client_id = 0;
+    qint64 timestamp_ms = 0;
+    SessionRecordType type = SessionRecordType::Other;
+    QByteArray payload;   // Без копирования (QByteArray::fromRawData)
+
+    QString typeName() const;
+    // Decodes the JSON payload into the form used by the live view
+    ClientData toClientData() const;
+};
+
+// Read-only view of a session file mapped into memory.
+//
+// Открытие читает только footer, поэтому время не зависит от размера
+// файла; страницы подгружаются ОС при первом обращении.
+class SessionFile
+{
+public:
+    SessionFile();
+    ~SessionFile();
+
+    bool open(const QString &path, QString *error);
+    void close();
+
+    qint64 recordCount() const;
+    qint64 startTime() const;
+    qint64 endTime() const;
+    QList<int> clientIds() const;
+
+    SessionRecord record(qint64 index) const;
+
+    // Indexes of the client's records; reads only the client_id column of
+    // pages listed for the client in the footer
+    QVector<qint64> recordsForClient(int client_id) const;
+
+    // First record of the first page that may hold timestamp_ms or later
+    qint64 findRecordAt(qint64 timestamp_ms) const;
+
+private:
+    struct PageEntry {
+        quint64 offset;
+        quint32 records;
+        quint32 size;
+        quint64 first_record;
+        qint64 min_ms;
+        qint64 max_ms;
+    };
+
+    struct ClientEntry {
+        quint32 first_page_ref;
+        quint32 page_ref_count;
+        quint32 records;
+    };
+
+    // Pointers to the columns of one page
+    struct PageView {
+        quint32 records = 0;
+        qint64 base_ms = 0;
+        const uchar *clients = nullptr;
+        const uchar *time_offsets = nullptr;
+        const uchar *payload_ends = nullptr;
+        const uchar *types = nullptr;
+        const uchar *blob = nullptr;
+        quint32 blob_size = 0;
+    };
+
+    int pageForRecord(qint64 index) const;
+    PageView pageView(int page) const;
+
+    QFile file_;
+    const uchar *data_;
+    qint64 size_;
+    qint64 record_count_;
+
+    QVector<PageEntry> pages_;
+    QMap<int, ClientEntry> clients_;
+    const uchar *page_refs_;
+};
+
+#endif // SESSIONFILE_H
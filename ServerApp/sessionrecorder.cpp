@@ -0,0 +1,48 @@
+#include "sessionrecorder.h"
+
+#include <QMutexLocker>
+
+QString SessionRecorder::name() const
+{
+    return QStringLiteral("session");
+}
+
+void SessionRecorder::writeBatch(const QVector<ClientData> &batch)
+{
+    QMutexLocker locker(&mutex_);
+    if (!writer_.isOpen()) {
+        return;
+    }
+
+    for (const ClientData &data : batch) {
+        writer_.append(data);
+    }
+}
+
+void SessionRecorder::close()
+{
+    stopRecording();
+}
+
+bool SessionRecorder::startRecording(const QString &path, QString *error)
+{
+    QMutexLocker locker(&mutex_);
+    return writer_.open(path, error);
+}
+
+qint64 SessionRecorder::stopRecording(QString *error)
+{
+    QMutexLocker locker(&mutex_);
+    if (!writer_.isOpen()) {
+        return 0;
+    }
+
+    const qint64 records = writer_.recordCount();
+    return writer_.close(error) ? records : -1;
+}
+
+bool SessionRecorder::isRecording() const
+{
+    QMutexLocker locker(&mutex_);
+    return writer_.isOpen();
+}
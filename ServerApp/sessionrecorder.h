@@ -0,0 +1,32 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QMutex>
+
+#include "recordsink.h"
+#include "sessionfile.h"
+
+// Sink that records received data into a session file on demand.
+//
+// Приемник зарегистрирован всегда, запись включается и выключается из
+// GUI во время работы. Страницы пишет поток приемника; при остановке
+// последняя страница и индекс дописываются в потоке вызывающего.
+class SessionRecorder : public RecordSink
+{
+public:
+    QString name() const override;
+    void writeBatch(const QVector<ClientData> &batch) override;
+    void close() override;
+
+    // Потокобезопасные методы управления записью
+    bool startRecording(const QString &path, QString *error);
+    // Returns the number of records written, -1 on error
+    qint64 stopRecording(QString *error = nullptr);
+    bool isRecording() const;
+
+private:
+    mutable QMutex mutex_;
+    SessionWriter writer_;
+};
+
+#endif // SESSIONRECORDER_H
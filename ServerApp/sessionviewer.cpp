@@ -0,0 +1,213 @@
+#include "sessionviewer.h"
+
+#include <QApplication>
+#include <QComboBox>
+#include <QDateTimeEdit>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTableView>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <limits>
+
+#include "serverwindow.h"
+
+namespace {
+// Сколько отформатированных ячеек Data держать в кэше
+constexpr int kFormattedCacheSize = 8192;
+
+enum Column { ColumnClient, ColumnType, ColumnData, ColumnTime, ColumnCount };
+}  // namespace
+
+SessionTableModel::SessionTableModel(const SessionFile *session, QObject *parent)
+    : QAbstractTableModel(parent),
+      session_(session),
+      filtered_(false),
+      formatted_(kFormattedCacheSize)
+{
+}
+
+void SessionTableModel::setFilter(const QVector<qint64> &records, bool enabled)
+{
+    beginResetModel();
+    formatted_.clear();
+    filter_ = records;
+    filtered_ = enabled;
+    endResetModel();
+}
+
+int SessionTableModel::rowForRecord(qint64 record) const
+{
+    if (!filtered_) {
+        return int(qMin<qint64>(record, rowCount() - 1));
+    }
+    const auto it = std::lower_bound(filter_.cbegin(), filter_.cend(), record);
+    return int(qMin<qint64>(it - filter_.cbegin(), rowCount() - 1));
+}
+
+int SessionTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    const qint64 rows = filtered_ ? filter_.size() : session_->recordCount();
+    return int(qMin<qint64>(rows, std::numeric_limits<int>::max()));
+}
+
+int SessionTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant SessionTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    const qint64 record_index = recordForRow(index.row());
+    const SessionRecord record = session_->record(record_index);
+
+    switch (index.column()) {
+    case ColumnClient:
+        return record.client_id;
+    case ColumnType:
+        return record.typeName();
+    case ColumnData:
+        if (const QString *cached = formatted_.object(record_index)) {
+            return *cached;
+        }
+        {
+            const ClientData data = record.toClientData();
+            QString *text = new QString(ServerWindow::formatDataContent(data.data_type, data.content));
+            formatted_.insert(record_index, text);
+            return *text;
+        }
+    case ColumnTime:
+        return QDateTime::fromMSecsSinceEpoch(record.timestamp_ms).toString("yyyy-MM-dd hh:mm:ss.zzz");
+    default:
+        return QVariant();
+    }
+}
+
+QVariant SessionTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case ColumnClient:
+        return "Client ID";
+    case ColumnType:
+        return "Type";
+    case ColumnData:
+        return "Data";
+    case ColumnTime:
+        return "Time";
+    default:
+        return QVariant();
+    }
+}
+
+qint64 SessionTableModel::recordForRow(int row) const
+{
+    return filtered_ ? filter_.value(row, -1) : row;
+}
+
+SessionViewer::SessionViewer(QWidget *parent)
+    : QDialog(parent),
+      session_(std::make_unique<SessionFile>()),
+      model_(new SessionTableModel(session_.get(), this)),
+      table_(new QTableView(this)),
+      client_filter_(new QComboBox(this)),
+      time_edit_(new QDateTimeEdit(this)),
+      summary_(new QLabel(this))
+{
+    resize(1000, 700);
+
+    table_->setModel(model_);
+    table_->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table_->horizontalHeader()->setStretchLastSection(false);
+    table_->horizontalHeader()->setSectionResizeMode(ColumnData, QHeaderView::Stretch);
+    // Высота строк фиксирована: представление не измеряет миллионы строк
+    table_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table_->verticalHeader()->hide();
+
+    time_edit_->setDisplayFormat("yyyy-MM-dd hh:mm:ss");
+    time_edit_->setCalendarPopup(true);
+    QPushButton *go_button = new QPushButton("Go", this);
+
+    QHBoxLayout *controls = new QHBoxLayout();
+    controls->addWidget(new QLabel("Client:", this));
+    controls->addWidget(client_filter_);
+    controls->addSpacing(20);
+    controls->addWidget(new QLabel("Time:", this));
+    controls->addWidget(time_edit_);
+    controls->addWidget(go_button);
+    controls->addStretch();
+    controls->addWidget(summary_);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(controls);
+    layout->addWidget(table_);
+
+    connect(client_filter_, &QComboBox::currentIndexChanged,
+            this, &SessionViewer::onClientFilterChanged);
+    connect(go_button, &QPushButton::clicked,
+            this, &SessionViewer::onGoToTime);
+}
+
+bool SessionViewer::openSession(const QString &path, QString *error)
+{
+    if (!session_->open(path, error)) {
+        return false;
+    }
+    model_->setFilter({}, false);
+
+    setWindowTitle(QString("Session - %1").arg(QFileInfo(path).fileName()));
+
+    const QDateTime start = QDateTime::fromMSecsSinceEpoch(session_->startTime());
+    const QDateTime end = QDateTime::fromMSecsSinceEpoch(session_->endTime());
+    time_edit_->setDateTimeRange(start, end);
+    time_edit_->setDateTime(start);
+    summary_->setText(QString("%1 records, %2 - %3")
+                      .arg(session_->recordCount())
+                      .arg(start.toString("yyyy-MM-dd hh:mm:ss"), end.toString("hh:mm:ss")));
+
+    QSignalBlocker blocker(client_filter_);
+    client_filter_->clear();
+    client_filter_->addItem("All", -1);
+    for (int client_id : session_->clientIds()) {
+        client_filter_->addItem(QString::number(client_id), client_id);
+    }
+    return true;
+}
+
+void SessionViewer::onClientFilterChanged(int index)
+{
+    const int client_id = client_filter_->itemData(index).toInt();
+    if (client_id < 0) {
+        model_->setFilter({}, false);
+        return;
+    }
+
+    // Читаются только столбцы client_id страниц из индекса клиента
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    model_->setFilter(session_->recordsForClient(client_id), true);
+    QApplication::restoreOverrideCursor();
+}
+
+void SessionViewer::onGoToTime()
+{
+    const qint64 record = session_->findRecordAt(time_edit_->dateTime().toMSecsSinceEpoch());
+    const int row = model_->rowForRecord(record);
+    if (row >= 0) {
+        table_->scrollTo(model_->index(row, 0), QAbstractItemView::PositionAtTop);
+        table_->selectRow(row);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef SESSIONVIEWER_H
+#define SESSIONVIEWER_H
+
+#include <QAbstractTableModel>
+#include <QCache>
+#include <QDialog>
+
+#include <memory>
+
+#include "sessionfile.h"
+
+class QComboBox;
+class QDateTimeEdit;
+class QLabel;
+class QTableView;
+
+// Table model over a mapped session file.
+//
+// Строки не копируются: ячейки читаются из столбцов страницы по запросу
+// представления, а JSON разбирается только для видимых строк (с кэшем).
+class SessionTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit SessionTableModel(const SessionFile *session, QObject *parent = nullptr);
+
+    // Show only the given records (indexes into the file), empty - all
+    void setFilter(const QVector<qint64> &records, bool enabled);
+    // Row of the first shown record with index >= record
+    int rowForRecord(qint64 record) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+private:
+    qint64 recordForRow(int row) const;
+
+    const SessionFile *session_;
+    QVector<qint64> filter_;
+    bool filtered_;
+
+    mutable QCache<qint64, QString> formatted_;
+};
+
+// Window for browsing a recorded session
+class SessionViewer : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SessionViewer(QWidget *parent = nullptr);
+
+    bool openSession(const QString &path, QString *error);
+
+private slots:
+    void onClientFilterChanged(int index);
+    void onGoToTime();
+
+private:
+    std::unique_ptr<SessionFile> session_;
+    SessionTableModel *model_;
+
+    QTableView *table_;
+    QComboBox *client_filter_;
+    QDateTimeEdit *time_edit_;
+    QLabel *summary_;
+};
+
+#endif // SESSIONVIEWER_H
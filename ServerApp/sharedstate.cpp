@@ -0,0 +1,568 @@
+#include "sharedstate.h"
+
+#include <QDateTime>
+#include <QJsonDocument>
+
+#include <atomic>
+#include <cstring>
+
+#include "builtinsinks.h"
+#include "ingestpipeline.h"
+#include "servermetrics.h"
+
+using namespace SharedState;
+
+namespace {
+constexpr int kHeaderSize = 256;
+constexpr int kClientSlotSize = 64;
+constexpr int kClientAddressSize = 56;
+constexpr int kReadRetries = 8;
+
+struct Header {
+    quint32 magic;
+    quint32 version;
+    quint32 record_slots;
+    quint32 client_slots;
+    std::atomic<quint64> record_head;       // Число опубликованных записей
+    std::atomic<quint32> stats_seq;
+    quint32 reserved;
+    qint64 stats[StatCount];
+    std::atomic<quint32> clients_seq;
+    quint32 client_count;
+    quint32 state_slots;
+    std::atomic<quint32> state_count;       // Слотов состояний в работе (с начала)
+};
+
+struct RecordSlot {
+    std::atomic<quint32> seq;
+    quint32 length;
+    quint64 index;                          // Номер записи, занимающей слот
+    char payload[kRecordSlotSize - 16];     // encodeRecordLine без '\n'
+};
+
+struct StateSlot {
+    std::atomic<quint32> seq;
+    quint32 length;                         // 0 — слот свободен
+    qint32 client_id;
+    quint32 reserved;
+    char payload[kRecordSlotSize - 16];
+};
+
+struct ClientSlot {
+    qint32 id;
+    quint16 port;
+    quint8 running;
+    quint8 address_length;
+    char address[kClientAddressSize];
+};
+
+static_assert(sizeof(Header) <= kHeaderSize, "header does not fit");
+static_assert(sizeof(RecordSlot) == kRecordSlotSize, "unexpected record slot size");
+static_assert(sizeof(StateSlot) == kRecordSlotSize, "unexpected state slot size");
+static_assert(sizeof(ClientSlot) == kClientSlotSize, "unexpected client slot size");
+static_assert(std::atomic<quint64>::is_always_lock_free,
+              "shared-memory atomics must be lock-free");
+
+constexpr qint64 kRecordsOffset = kHeaderSize;
+constexpr qint64 kClientsOffset = kRecordsOffset + qint64(kRecordSlots) * kRecordSlotSize;
+constexpr qint64 kStatesOffset = kClientsOffset + qint64(kClientSlots) * kClientSlotSize;
+constexpr qint64 kSegmentSize = kStatesOffset + qint64(kStateSlots) * kRecordSlotSize;
+constexpr int kPayloadSize = int(sizeof(RecordSlot::payload));
+
+// Строка записи для слота (без '\n'); окну достаточно заголовка записи,
+// если она целиком не помещается
+QByteArray slotPayload(const ClientData &data)
+{
+    QByteArray line = encodeRecordLine(data);
+    line.chop(1);
+    if (line.size() > kPayloadSize) {
+        ClientData truncated = data;
+        truncated.content = QJsonObject{{"type", data.data_type}, {"truncated", true}};
+        line = encodeRecordLine(truncated);
+        line.chop(1);
+    }
+    return line;
+}
+
+ClientData decodeSlotPayload(const char *payload, quint32 length)
+{
+    const QJsonObject record = QJsonDocument::fromJson(QByteArray(payload, int(length))).object();
+    ClientData data;
+    data.client_id = record["client_id"].toInt();
+    data.data_type = record["type"].toString();
+    data.content = record["data"].toObject();
+    data.timestamp = QDateTime::fromMSecsSinceEpoch(
+        static_cast<qint64>(record["timestamp"].toDouble()));
+    return data;
+}
+
+// Запись под seqlock: счетчик нечетный, пока данные меняются
+void writeBegin(std::atomic<quint32> &seq)
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void writeEnd(std::atomic<quint32> &seq)
+{
+    seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Чтение под seqlock: read копирует данные, затем проверяется, что
+// писатель за это время их не трогал
+template <typename ReadFn>
+bool readConsistent(const std::atomic<quint32> &seq, ReadFn read)
+{
+    for (int attempt = 0; attempt < kReadRetries; ++attempt) {
+        const quint32 before = seq.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        read();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace
+
+// Пишет записи в кольцо из потока приемника (единственный писатель кольца)
+class SharedStateSink : public RecordSink
+{
+public:
+    explicit SharedStateSink(SharedStatePublisher *publisher)
+        : publisher_(publisher)
+    {
+    }
+
+    QString name() const override
+    {
+        return "shm";
+    }
+
+    // Отключение клиента освобождает его слоты состояний
+    bool wantsDeviceEvents() const override
+    {
+        return true;
+    }
+
+    void writeBatch(const QVector<ClientData> &batch) override
+    {
+        for (const ClientData &data : batch) {
+            if (data.data_type == IngestPipeline::kDeviceEventType) {
+                if (data.content.value(QLatin1String("event")).toString() == "disconnected") {
+                    publisher_->clearStates(data.client_id);
+                }
+                continue;
+            }
+            publisher_->publishRecord(data);
+            publisher_->publishState(data);
+        }
+    }
+
+private:
+    SharedStatePublisher *publisher_;
+};
+
+SharedStatePublisher::SharedStatePublisher(const QString &name, TcpServer *server, quint16 port,
+                                           QObject *parent)
+    : QObject(parent),
+      memory_(name),
+      server_(server),
+      port_(port),
+      base_(nullptr),
+      timer_(new QTimer(this)),
+      clients_dirty_(true),
+      running_(false),
+      clients_omitted_(0),
+      state_slots_used_(0),
+      states_omitted_(0)
+{
+    connect(server_, &TcpServer::clientConnected,
+            this, &SharedStatePublisher::onClientConnected);
+    connect(server_, &TcpServer::clientDisconnected,
+            this, &SharedStatePublisher::onClientDisconnected);
+    connect(server_, &TcpServer::clientStatusChanged,
+            this, &SharedStatePublisher::onClientStatusChanged);
+    connect(server_, &TcpServer::serverStarted,
+            this, &SharedStatePublisher::onServerStarted);
+    connect(server_, &TcpServer::serverStopped,
+            this, &SharedStatePublisher::onServerStopped);
+    connect(timer_, &QTimer::timeout,
+            this, &SharedStatePublisher::publish);
+}
+
+SharedStatePublisher::~SharedStatePublisher()
+{
+    if (base_) {
+        // Окна увидят, что сервер больше не публикует состояние
+        running_ = false;
+        publishStats();
+        memory_.detach();
+    }
+}
+
+bool SharedStatePublisher::open(QString *error)
+{
+    // После аварийного завершения сегмент мог остаться: используем его
+    if (!memory_.create(kSegmentSize)) {
+        if (memory_.error() != QSharedMemory::AlreadyExists || !memory_.attach()) {
+            *error = QString("cannot create shared memory %1: %2")
+                         .arg(memory_.key(), memory_.errorString());
+            return false;
+        }
+        if (memory_.size() < kSegmentSize) {
+            *error = QString("shared memory %1 is in use with another layout").arg(memory_.key());
+            memory_.detach();
+            return false;
+        }
+        // Забираем только брошенный сегмент: живой сервер с тем же именем
+        // обновляет статистику каждые kPublishIntervalMs
+        const Header *existing = static_cast<const Header*>(memory_.constData());
+        if (existing->magic == kMagic) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const qint64 updated_ms = existing->stats[UpdatedMs];
+            if (QDateTime::currentMSecsSinceEpoch() - updated_ms < kStaleMs) {
+                *error = QString("shared memory %1 is in use by a running server")
+                             .arg(memory_.key());
+                memory_.detach();
+                return false;
+            }
+        }
+    }
+
+    base_ = static_cast<uchar*>(memory_.data());
+    std::memset(base_, 0, kSegmentSize);
+
+    Header *header = reinterpret_cast<Header*>(base_);
+    header->record_slots = kRecordSlots;
+    header->client_slots = kClientSlots;
+    header->state_slots = kStateSlots;
+    header->version = kVersion;
+    // magic последним: читатель проверяет его при подключении
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kMagic;
+
+    timer_->start(kPublishIntervalMs);
+    publish();
+    return true;
+}
+
+std::unique_ptr<RecordSink> SharedStatePublisher::createSink()
+{
+    return std::make_unique<SharedStateSink>(this);
+}
+
+void SharedStatePublisher::onClientConnected(const ClientInfo &info)
+{
+    clients_[info.id] = info;
+    clients_dirty_ = true;
+}
+
+void SharedStatePublisher::onClientDisconnected(int client_id)
+{
+    clients_.remove(client_id);
+    clients_dirty_ = true;
+}
+
+void SharedStatePublisher::onClientStatusChanged(int client_id, bool is_running)
+{
+    if (clients_.contains(client_id)) {
+        clients_[client_id].is_running = is_running;
+        clients_dirty_ = true;
+    }
+}
+
+void SharedStatePublisher::onServerStarted()
+{
+    running_ = true;
+}
+
+void SharedStatePublisher::onServerStopped()
+{
+    running_ = false;
+    clients_.clear();
+    clients_dirty_ = true;
+}
+
+void SharedStatePublisher::publish()
+{
+    if (!base_) {
+        return;
+    }
+    if (clients_dirty_) {
+        publishClients();
+        clients_dirty_ = false;
+    }
+    publishStats();
+}
+
+void SharedStatePublisher::publishRecord(const ClientData &data)
+{
+    if (!base_) {
+        return;
+    }
+
+    const QByteArray line = slotPayload(data);
+
+    Header *header = reinterpret_cast<Header*>(base_);
+    const quint64 index = header->record_head.load(std::memory_order_relaxed);
+    RecordSlot *slot = reinterpret_cast<RecordSlot*>(base_ + kRecordsOffset)
+                       + index % kRecordSlots;
+
+    writeBegin(slot->seq);
+    slot->index = index;
+    slot->length = quint32(line.size());
+    std::memcpy(slot->payload, line.constData(), size_t(line.size()));
+    writeEnd(slot->seq);
+
+    header->record_head.store(index + 1, std::memory_order_release);
+}
+
+void SharedStatePublisher::publishState(const ClientData &data)
+{
+    // Журнал — поток событий, а не состояние
+    if (!base_ || data.data_type == "Log") {
+        return;
+    }
+
+    Header *header = reinterpret_cast<Header*>(base_);
+    QHash<QString, int> &types = state_slots_[data.client_id];
+    auto it = types.find(data.data_type);
+    if (it == types.end()) {
+        int index;
+        if (!free_state_slots_.isEmpty()) {
+            index = free_state_slots_.takeLast();
+        } else if (state_slots_used_ < kStateSlots) {
+            index = state_slots_used_++;
+        } else {
+            states_omitted_.fetch_add(1, std::memory_order_relaxed);
+            if (types.isEmpty()) {
+                state_slots_.remove(data.client_id);
+            }
+            return;
+        }
+        it = types.insert(data.data_type, index);
+    }
+
+    const QByteArray line = slotPayload(data);
+    StateSlot *slot = reinterpret_cast<StateSlot*>(base_ + kStatesOffset) + it.value();
+    writeBegin(slot->seq);
+    slot->client_id = data.client_id;
+    slot->length = quint32(line.size());
+    std::memcpy(slot->payload, line.constData(), size_t(line.size()));
+    writeEnd(slot->seq);
+
+    // Читатель видит слот только после того, как он заполнен
+    if (quint32(state_slots_used_) > header->state_count.load(std::memory_order_relaxed)) {
+        header->state_count.store(quint32(state_slots_used_), std::memory_order_release);
+    }
+}
+
+void SharedStatePublisher::clearStates(int client_id)
+{
+    auto client = state_slots_.find(client_id);
+    if (!base_ || client == state_slots_.end()) {
+        return;
+    }
+
+    StateSlot *slots = reinterpret_cast<StateSlot*>(base_ + kStatesOffset);
+    for (const int index : std::as_const(client.value())) {
+        writeBegin(slots[index].seq);
+        slots[index].client_id = 0;
+        slots[index].length = 0;
+        writeEnd(slots[index].seq);
+        free_state_slots_.append(index);
+    }
+    state_slots_.erase(client);
+}
+
+void SharedStatePublisher::publishClients()
+{
+    Header *header = reinterpret_cast<Header*>(base_);
+    ClientSlot *slots = reinterpret_cast<ClientSlot*>(base_ + kClientsOffset);
+
+    writeBegin(header->clients_seq);
+    int count = 0;
+    for (auto it = clients_.cbegin(); it != clients_.cend() && count < kClientSlots; ++it) {
+        const QByteArray address = it->ip_address.toUtf8().left(kClientAddressSize);
+        ClientSlot &slot = slots[count++];
+        slot.id = it->id;
+        slot.port = it->port;
+        slot.running = it->is_running ? 1 : 0;
+        slot.address_length = quint8(address.size());
+        std::memcpy(slot.address, address.constData(), size_t(address.size()));
+    }
+    header->client_count = quint32(count);
+    writeEnd(header->clients_seq);
+
+    // Окно показывает не всех: сообщаем один раз на каждое переполнение
+    const qint64 omitted = clients_.size() - count;
+    if (omitted > 0 && clients_omitted_ == 0) {
+        qWarning("Shared state %s: %d clients do not fit the table, %lld not published",
+                 qPrintable(memory_.key()), int(clients_.size()), omitted);
+    }
+    clients_omitted_ = omitted;
+}
+
+void SharedStatePublisher::publishStats()
+{
+    const ServerMetrics &metrics = ServerMetrics::instance();
+    SharedStats stats;
+    stats.values[UpdatedMs] = QDateTime::currentMSecsSinceEpoch();
+    stats.values[Running] = running_ ? 1 : 0;
+    stats.values[Port] = port_;
+    stats.values[Connections] = metrics.gaugeValue(Gauge::ConnectionsActive);
+    stats.values[Messages] = qint64(metrics.counterValue(Counter::MessagesNetworkMetrics)
+                                    + metrics.counterValue(Counter::MessagesDeviceStatus)
+                                    + metrics.counterValue(Counter::MessagesLog)
+                                    + metrics.counterValue(Counter::MessagesOther));
+    stats.values[BytesIn] = qint64(metrics.counterValue(Counter::BytesIn));
+    stats.values[BytesOut] = qint64(metrics.counterValue(Counter::BytesOut));
+    stats.values[Alerts] = qint64(metrics.counterValue(Counter::Alerts));
+    stats.values[SinkDropped] = qint64(metrics.counterValue(Counter::SinkDropped));
+    stats.values[ReceiveBuffers] = metrics.gaugeValue(Gauge::ReceiveBufferCapacity);
+    stats.values[ReceiveLimit] = metrics.gaugeValue(Gauge::ReceiveBufferLimit);
+    stats.values[SendQueued] = metrics.gaugeValue(Gauge::SendQueuedBytes);
+    stats.values[ClientsOmitted] = clients_omitted_;
+    stats.values[StatesOmitted] = states_omitted_.load(std::memory_order_relaxed);
+
+    Header *header = reinterpret_cast<Header*>(base_);
+    writeBegin(header->stats_seq);
+    std::memcpy(header->stats, stats.values, sizeof(stats.values));
+    writeEnd(header->stats_seq);
+}
+
+SharedStateReader::SharedStateReader(const QString &name)
+    : memory_(name),
+      base_(nullptr)
+{
+}
+
+SharedStateReader::~SharedStateReader()
+{
+    memory_.detach();
+}
+
+bool SharedStateReader::attach(QString *error)
+{
+    if (!memory_.attach(QSharedMemory::ReadOnly)) {
+        *error = QString("cannot attach to %1: %2").arg(memory_.key(), memory_.errorString());
+        return false;
+    }
+
+    const Header *header = static_cast<const Header*>(memory_.constData());
+    if (memory_.size() < kSegmentSize || header->magic != kMagic
+        || header->version != kVersion) {
+        *error = QString("%1 is not a server state segment").arg(memory_.key());
+        memory_.detach();
+        return false;
+    }
+
+    base_ = static_cast<const uchar*>(memory_.constData());
+    return true;
+}
+
+QString SharedStateReader::name() const
+{
+    return memory_.key();
+}
+
+QVector<ClientData> SharedStateReader::readRecords(quint64 *cursor, int max_records) const
+{
+    const Header *header = reinterpret_cast<const Header*>(base_);
+    const quint64 head = header->record_head.load(std::memory_order_acquire);
+
+    // Сервер перезапущен (кольцо начато заново) или окно отстало больше,
+    // чем на кольцо: берем только то, что еще можно прочитать
+    quint64 first = *cursor <= head ? *cursor : 0;
+    first = qMax(first, head > quint64(kRecordSlots) ? head - kRecordSlots : 0);
+    first = qMax(first, head > quint64(max_records) ? head - max_records : 0);
+    *cursor = head;
+
+    QVector<ClientData> records;
+    records.reserve(int(head - first));
+    const RecordSlot *slots = reinterpret_cast<const RecordSlot*>(base_ + kRecordsOffset);
+    char payload[kPayloadSize];
+
+    for (quint64 index = first; index < head; ++index) {
+        const RecordSlot &slot = slots[index % kRecordSlots];
+        quint64 slot_index = 0;
+        quint32 length = 0;
+        const bool consistent = readConsistent(slot.seq, [&] {
+            slot_index = slot.index;
+            length = qMin<quint32>(slot.length, sizeof(payload));
+            std::memcpy(payload, slot.payload, length);
+        });
+        if (!consistent || slot_index != index) {
+            continue;   // Перезаписана писателем
+        }
+
+        records.append(decodeSlotPayload(payload, length));
+    }
+    return records;
+}
+
+QVector<ClientData> SharedStateReader::readStates() const
+{
+    const Header *header = reinterpret_cast<const Header*>(base_);
+    const int count = qMin<int>(int(header->state_count.load(std::memory_order_acquire)),
+                                kStateSlots);
+    const StateSlot *slots = reinterpret_cast<const StateSlot*>(base_ + kStatesOffset);
+    char payload[kPayloadSize];
+
+    QVector<ClientData> states;
+    for (int index = 0; index < count; ++index) {
+        const StateSlot &slot = slots[index];
+        quint32 length = 0;
+        const bool consistent = readConsistent(slot.seq, [&] {
+            length = qMin<quint32>(slot.length, sizeof(payload));
+            std::memcpy(payload, slot.payload, length);
+        });
+        // Занятый писателем слот пропускается: состояние придет записью
+        if (consistent && length > 0) {
+            states.append(decodeSlotPayload(payload, length));
+        }
+    }
+    return states;
+}
+
+bool SharedStateReader::readClients(QVector<ClientInfo> *clients) const
+{
+    const Header *header = reinterpret_cast<const Header*>(base_);
+    const ClientSlot *slots = reinterpret_cast<const ClientSlot*>(base_ + kClientsOffset);
+
+    QVector<ClientSlot> copy;
+    const bool consistent = readConsistent(header->clients_seq, [&] {
+        const int count = qMin<int>(int(header->client_count), kClientSlots);
+        copy.resize(count);
+        std::memcpy(copy.data(), slots, size_t(count) * sizeof(ClientSlot));
+    });
+    if (!consistent) {
+        return false;
+    }
+
+    clients->clear();
+    clients->reserve(copy.size());
+    for (const ClientSlot &slot : std::as_const(copy)) {
+        ClientInfo info;
+        info.id = slot.id;
+        info.ip_address = QString::fromUtf8(slot.address,
+                                            qMin<int>(slot.address_length, kClientAddressSize));
+        info.port = slot.port;
+        info.is_connected = true;
+        info.is_running = slot.running != 0;
+        clients->append(info);
+    }
+    return true;
+}
+
+bool SharedStateReader::readStats(SharedStats *stats) const
+{
+    const Header *header = reinterpret_cast<const Header*>(base_);
+    return readConsistent(header->stats_seq, [&] {
+        std::memcpy(stats->values, header->stats, sizeof(stats->values));
+    });
+}
@@ -0,0 +1,143 @@
+#ifndef SHAREDSTATE_H
+#define SHAREDSTATE_H
+
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QSharedMemory>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+
+#include "recordsink.h"
+
+// Server state published in shared memory for detached GUI processes.
+//
+// Сегмент состоит из заголовка, кольца последних записей, таблицы
+// клиентов и последних состояний (последняя запись каждого типа, кроме
+// Log, от каждого клиента). Каждая область пишется одним потоком и защищена seqlock:
+// писатель делает счетчик нечетным, копирует данные и делает его четным,
+// а читатель повторяет чтение, если счетчик был нечетным или изменился.
+// Читатели ничего не пишут в сегмент и не блокируют писателя, поэтому
+// любое число окон не добавляет нагрузки на прием.
+//
+//   записи   — поток приемника shm, кольцо kRecordSlots слотов
+//   состояния — поток приемника shm, слот на пару клиент/тип; слоты
+//               отключенного клиента освобождаются по событию устройства
+//   клиенты  — главный поток, вся таблица целиком, не чаще kPublishIntervalMs
+//   статистика — главный поток, по таймеру
+//
+// Клиенты и состояния сверх своих таблиц не публикуются; их число видно
+// в статистике (ClientsOmitted, StatesOmitted).
+namespace SharedState {
+constexpr quint32 kMagic = 0x48535343;      // "CSSH"
+constexpr quint32 kVersion = 3;
+constexpr int kRecordSlots = 4096;
+constexpr int kRecordSlotSize = 512;
+constexpr int kClientSlots = 4096;
+constexpr int kStateSlots = 8192;
+constexpr int kPublishIntervalMs = 200;
+constexpr qint64 kStaleMs = 2000;           // Нет публикаций дольше — сервер не работает
+
+// Поля блока статистики
+enum Stat {
+    UpdatedMs,      // Время последней публикации; по нему читатель видит, жив ли сервер
+    Running,
+    Port,
+    Connections,
+    Messages,
+    BytesIn,
+    BytesOut,
+    Alerts,
+    SinkDropped,
+    ReceiveBuffers, // Емкость буферов приема, байты
+    ReceiveLimit,
+    SendQueued,
+    ClientsOmitted, // Не поместились в таблицу клиентов
+    StatesOmitted,  // Записи, для которых не нашлось слота состояния
+    StatCount
+};
+}  // namespace SharedState
+
+// Snapshot of the statistics block
+struct SharedStats {
+    qint64 values[SharedState::StatCount] = {};
+};
+
+// Writer side, lives in the server process (main thread)
+class SharedStatePublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    SharedStatePublisher(const QString &name, TcpServer *server, quint16 port,
+                         QObject *parent = nullptr);
+    ~SharedStatePublisher();
+
+    bool open(QString *error);
+
+    // Sink writing records into the ring; register it in the server pipeline
+    std::unique_ptr<RecordSink> createSink();
+
+private slots:
+    void onClientConnected(const ClientInfo &info);
+    void onClientDisconnected(int client_id);
+    void onClientStatusChanged(int client_id, bool is_running);
+    void onServerStarted();
+    void onServerStopped();
+    void publish();
+
+private:
+    friend class SharedStateSink;
+
+    void publishRecord(const ClientData &data);
+    void publishState(const ClientData &data);
+    void clearStates(int client_id);
+    void publishClients();
+    void publishStats();
+
+    QSharedMemory memory_;
+    TcpServer *server_;
+    const quint16 port_;
+    uchar *base_;
+    QTimer *timer_;
+
+    QMap<int, ClientInfo> clients_;
+    bool clients_dirty_;
+    bool running_;
+    qint64 clients_omitted_;
+
+    // Слоты состояний, ведет поток приемника
+    QHash<int, QHash<QString, int>> state_slots_;   // Клиент -> тип -> слот
+    QVector<int> free_state_slots_;
+    int state_slots_used_;
+    std::atomic<qint64> states_omitted_;
+};
+
+// Read-only attachment used by a detached ServerWindow
+class SharedStateReader
+{
+public:
+    explicit SharedStateReader(const QString &name);
+    ~SharedStateReader();
+
+    bool attach(QString *error);
+    QString name() const;
+
+    // Records published after *cursor (at most max_records, newest kept);
+    // advances *cursor. Перезаписанные до чтения записи пропускаются.
+    QVector<ClientData> readRecords(quint64 *cursor, int max_records) const;
+
+    // Consistent copy of the client table; false if the writer kept it busy
+    bool readClients(QVector<ClientInfo> *clients) const;
+    // Latest record of each type (except Log) per connected client
+    QVector<ClientData> readStates() const;
+    bool readStats(SharedStats *stats) const;
+
+private:
+    QSharedMemory memory_;
+    const uchar *base_;
+};
+
+#endif // SHAREDSTATE_H
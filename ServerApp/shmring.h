@@ -0,0 +1,169 @@
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// Byte ring in shared memory from one device process to the server.
+//
+// Формат общий для ServerApp и ClientApp (ClientApp подключает этот
+// заголовок напрямую). Поток байтов тот же, что и по TCP: кадры JSON,
+// разделенные '\n'. Сегмент создает сервер, устройство только пишет.
+//
+// Будильник: потребитель, опустошив кольцо, выставляет consumer_waiting
+// и перепроверяет head; производитель, опубликовав head, проверяет флаг
+// и, если потребитель ждет, сбрасывает его и «звонит» (байт в управляющий
+// локальный сокет). Пока потребитель успевает, звонков нет совсем.
+namespace ShmRing {
+constexpr std::uint32_t kMagic = 0x52534343;    // "CCSR"
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kHeaderSize = 256;
+
+struct Header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t capacity;                         // Степень двойки
+    std::uint32_t reserved;
+    alignas(64) std::atomic<std::uint64_t> head;    // Пишет только производитель
+    alignas(64) std::atomic<std::uint64_t> tail;    // Пишет только потребитель
+    alignas(64) std::atomic<std::uint32_t> consumer_waiting;
+};
+
+static_assert(sizeof(Header) <= kHeaderSize, "ring header does not fit");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "shared-memory atomics must be lock-free");
+
+inline std::uint64_t segmentSize(std::uint32_t capacity)
+{
+    return kHeaderSize + std::uint64_t(capacity);
+}
+
+// Server side: lays out a fresh segment
+inline void initialize(void *base, std::uint32_t capacity)
+{
+    std::memset(base, 0, kHeaderSize);
+    Header *header = static_cast<Header*>(base);
+    header->version = kVersion;
+    header->capacity = capacity;
+    // Первая запись производителя сразу будит потребителя
+    header->consumer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kMagic;
+}
+
+// Device side
+class Producer
+{
+public:
+    // False if the segment is not a ring of this version
+    bool attach(void *base, std::uint64_t size)
+    {
+        Header *header = static_cast<Header*>(base);
+        if (size < kHeaderSize || header->magic != kMagic || header->version != kVersion
+            || segmentSize(header->capacity) > size) {
+            return false;
+        }
+        header_ = header;
+        data_ = static_cast<char*>(base) + kHeaderSize;
+        mask_ = header->capacity - 1;
+        head_ = header->head.load(std::memory_order_relaxed);
+        cached_tail_ = header->tail.load(std::memory_order_acquire);
+        return true;
+    }
+
+    // Copies as much as fits; returns the number of bytes written.
+    // *wake is set when the consumer is waiting and has to be woken up
+    std::uint64_t write(const char *data, std::uint64_t length, bool *wake)
+    {
+        *wake = false;
+        std::uint64_t space = mask_ + 1 - (head_ - cached_tail_);
+        if (space < length) {
+            cached_tail_ = header_->tail.load(std::memory_order_acquire);
+            space = mask_ + 1 - (head_ - cached_tail_);
+        }
+        const std::uint64_t count = length < space ? length : space;
+        if (count == 0) {
+            return 0;
+        }
+
+        const std::uint64_t offset = head_ & mask_;
+        const std::uint64_t first = count < mask_ + 1 - offset ? count : mask_ + 1 - offset;
+        std::memcpy(data_ + offset, data, first);
+        std::memcpy(data_, data + first, count - first);
+        head_ += count;
+        header_->head.store(head_, std::memory_order_seq_cst);
+
+        // seq_cst в паре с consumer_waiting: либо потребитель увидит head,
+        // либо производитель увидит флаг
+        if (header_->consumer_waiting.load(std::memory_order_seq_cst) != 0) {
+            *wake = header_->consumer_waiting.exchange(0, std::memory_order_acq_rel) != 0;
+        }
+        return count;
+    }
+
+private:
+    Header *header_ = nullptr;
+    char *data_ = nullptr;
+    std::uint64_t mask_ = 0;
+    std::uint64_t head_ = 0;
+    std::uint64_t cached_tail_ = 0;
+};
+
+// Server side
+class Consumer
+{
+public:
+    void attach(void *base)
+    {
+        header_ = static_cast<Header*>(base);
+        data_ = static_cast<const char*>(base) + kHeaderSize;
+        mask_ = header_->capacity - 1;
+        tail_ = header_->tail.load(std::memory_order_relaxed);
+        cached_head_ = header_->head.load(std::memory_order_acquire);
+    }
+
+    std::uint64_t available()
+    {
+        cached_head_ = header_->head.load(std::memory_order_acquire);
+        return cached_head_ - tail_;
+    }
+
+    std::uint64_t read(char *data, std::uint64_t max_length)
+    {
+        std::uint64_t ready = cached_head_ - tail_;
+        if (ready < max_length) {
+            ready = available();
+        }
+        const std::uint64_t count = ready < max_length ? ready : max_length;
+        if (count == 0) {
+            return 0;
+        }
+
+        const std::uint64_t offset = tail_ & mask_;
+        const std::uint64_t first = count < mask_ + 1 - offset ? count : mask_ + 1 - offset;
+        std::memcpy(data, data_ + offset, first);
+        std::memcpy(data + first, data_, count - first);
+        tail_ += count;
+        header_->tail.store(tail_, std::memory_order_release);
+        return count;
+    }
+
+    // Ask for a wake-up before going idle; false if data arrived meanwhile
+    // (then keep reading, the flag may cause one spurious wake-up)
+    bool prepareWait()
+    {
+        header_->consumer_waiting.store(1, std::memory_order_seq_cst);
+        return header_->head.load(std::memory_order_seq_cst) == tail_;
+    }
+
+private:
+    Header *header_ = nullptr;
+    const char *data_ = nullptr;
+    std::uint64_t mask_ = 0;
+    std::uint64_t tail_ = 0;
+    std::uint64_t cached_head_ = 0;
+};
+}  // namespace ShmRing
+
+#endif // SHMRING_H
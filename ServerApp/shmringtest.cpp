@@ -0,0 +1,101 @@
+// Two batches over the shared-memory ring with an idle gap between them.
+//
+// Сервер читает соединение так же, как TcpServer — ровно bytesAvailable(),
+// без чтения до нуля. Второй пакет приходит, когда кольцо уже пусто и
+// потребитель ждет: он должен разбудить сервер звонком.
+//
+// Exit code 0 on success; registered with ctest.
+
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QEventLoop>
+#include <QIODevice>
+
+#include <cstdio>
+#include <functional>
+
+#include "devicetransport.h"
+#include "shmringsocket.h"
+
+namespace {
+constexpr quint32 kRingCapacity = 64 * 1024;
+constexpr int kTimeoutMs = 5000;
+constexpr int kIdleMs = 50;
+
+bool waitFor(const std::function<bool()> &condition)
+{
+    const QDeadlineTimer deadline(kTimeoutMs);
+    while (!condition()) {
+        if (deadline.hasExpired()) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return true;
+}
+
+bool fail(const char *message)
+{
+    std::fprintf(stderr, "FAIL: %s\n", message);
+    return false;
+}
+
+bool run()
+{
+    ShmTransport transport(kRingCapacity);
+    const QString name = QString("shmringtest-%1").arg(QCoreApplication::applicationPid());
+    if (!transport.listen(name)) {
+        return fail("cannot listen");
+    }
+
+    QIODevice *connection = nullptr;
+    QByteArray received;
+    QObject::connect(&transport, &DeviceTransport::newConnection,
+                     [&connection, &received](QIODevice *accepted) {
+        connection = accepted;
+        QObject::connect(accepted, &QIODevice::readyRead, [accepted, &received]() {
+            const qint64 incoming = accepted->bytesAvailable();
+            const qsizetype offset = received.size();
+            received.resize(offset + incoming);
+            const qint64 read = accepted->read(received.data() + offset, incoming);
+            received.resize(offset + qMax<qint64>(0, read));
+        });
+    });
+
+    ShmRingSocket device;
+    device.connectToServer(name);
+    if (!waitFor([&]() { return device.state() == QLocalSocket::ConnectedState
+                                && connection != nullptr; })) {
+        return fail("device did not attach to the ring");
+    }
+
+    const QByteArray first = "{\"type\":\"Ping\",\"seq\":1}\n";
+    device.write(first);
+    if (!waitFor([&]() { return received == first; })) {
+        return fail("first batch was not delivered");
+    }
+
+    // Сервер простаивает: кольцо пусто, следующий пакет — только по звонку
+    const QDeadlineTimer idle(kIdleMs);
+    waitFor([&]() { return idle.hasExpired(); });
+
+    const QByteArray second = "{\"type\":\"Ping\",\"seq\":2}\n";
+    device.write(second);
+    if (!waitFor([&]() { return received == first + second; })) {
+        return fail("second batch was not delivered after an idle ring");
+    }
+
+    device.disconnectFromServer();
+    return true;
+}
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    if (!run()) {
+        return 1;
+    }
+    std::printf("PASS: two batches delivered over the ring\n");
+    return 0;
+}
@@ -0,0 +1,348 @@
+#include "sinkrunner.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QMutexLocker>
+
+#include "servermetrics.h"
+
+namespace {
+constexpr std::chrono::milliseconds kIdleWait(5);
+
+// Пачка не меньше предпочтительной для приемника, очередь вмещает
+// несколько пачек
+SinkOptions adjustedOptions(const SinkOptions &options, const RecordSink &sink)
+{
+    SinkOptions adjusted = options;
+    adjusted.max_batch_size = qMax(options.max_batch_size, sink.preferredBatchSize());
+    adjusted.queue_capacity = qMax(options.queue_capacity, adjusted.max_batch_size * 4);
+    return adjusted;
+}
+}  // namespace
+
+SinkRunner::SinkRunner(std::unique_ptr<RecordSink> sink, const SinkOptions &options,
+                       QObject *parent)
+    : QObject(parent),
+      sink_(std::move(sink)),
+      options_(adjustedOptions(options, *sink_)),
+      queue_(options_.queue_capacity),
+      thread_(nullptr),
+      stopping_(false),
+      backpressured_(false),
+      opened_(false),
+      spill_records_(0),
+      spill_bytes_(0),
+      spill_full_(false),
+      spill_pending_(0)
+{
+}
+
+SinkRunner::~SinkRunner()
+{
+    stop();
+}
+
+QString SinkRunner::name() const
+{
+    return sink_->name();
+}
+
+bool SinkRunner::wantsDeviceEvents() const
+{
+    return sink_->wantsDeviceEvents();
+}
+
+void SinkRunner::start(std::function<void()> thread_init)
+{
+    if (thread_) {
+        return;
+    }
+
+    stopping_ = false;
+    thread_ = QThread::create([this, thread_init]() { run(thread_init); });
+    thread_->setObjectName("sink-" + name());
+    thread_->start();
+}
+
+void SinkRunner::stop()
+{
+    if (!thread_) {
+        return;
+    }
+
+    stopping_ = true;
+    waiter_.notify();
+    thread_->wait();
+    delete thread_;
+    thread_ = nullptr;
+}
+
+void SinkRunner::offer(ClientData &&data)
+{
+    updateBackpressure();
+
+    if (options_.policy == SlowSinkPolicy::Spill) {
+        offerWithSpill(std::move(data));
+        return;
+    }
+
+    if (queue_.tryPush(std::move(data))) {
+        waiter_.notify();
+        return;
+    }
+
+    if (options_.policy == SlowSinkPolicy::Drop) {
+        ServerMetrics::increment(Counter::SinkDropped);
+        return;
+    }
+
+    // Block: явно выбранная политика, задерживает стадию оценки
+    do {
+        ServerMetrics::increment(Counter::PipelineStalls);
+        QThread::yieldCurrentThread();
+    } while (!queue_.tryPush(std::move(data)));
+    waiter_.notify();
+}
+
+bool SinkRunner::isBackpressured() const
+{
+    return backpressured_.load(std::memory_order_relaxed);
+}
+
+qint64 SinkRunner::queueDepth() const
+{
+    return static_cast<qint64>(queue_.sizeApprox()) + spill_pending_.load(std::memory_order_relaxed);
+}
+
+void SinkRunner::run(const std::function<void()> &thread_init)
+{
+    if (thread_init) {
+        thread_init();
+    }
+
+    QString error;
+    opened_ = sink_->open(&error);
+    if (!opened_) {
+        // Очередь продолжает разбираться, чтобы не блокировать конвейер
+        emit logMessage(QString("Sink %1 disabled: %2").arg(name(), error));
+    }
+
+    QVector<ClientData> batch;
+    batch.reserve(options_.max_batch_size);
+    QElapsedTimer batch_age;
+
+    forever {
+        // Флаг читается до разбора очереди: после него новых записей нет
+        const bool stopping = stopping_.load();
+
+        fillBatch(&batch);
+        // Снятие давления видно только здесь: после остановки трафика
+        // offer() больше не вызывается
+        updateBackpressure();
+        if (!batch.isEmpty() && !batch_age.isValid()) {
+            batch_age.start();
+        }
+
+        const bool due = !batch.isEmpty()
+            && (batch.size() >= options_.max_batch_size
+                || stopping
+                || batch_age.elapsed() >= options_.max_batch_delay_ms);
+        if (due) {
+            deliver(batch);
+            batch.clear();
+            batch_age.invalidate();
+            continue;
+        }
+
+        if (stopping && batch.isEmpty()) {
+            break;
+        }
+
+        // Неполная пачка ждет не дольше max_batch_delay_ms
+        std::chrono::milliseconds timeout = kIdleWait;
+        if (batch_age.isValid()) {
+            timeout = std::chrono::milliseconds(
+                qMax<qint64>(1, options_.max_batch_delay_ms - batch_age.elapsed()));
+        }
+        waiter_.wait([this]() {
+            return !queue_.emptyApprox() || stopping_.load();
+        }, timeout);
+    }
+
+    if (opened_) {
+        sink_->close();
+    }
+}
+
+void SinkRunner::fillBatch(QVector<ClientData> *batch)
+{
+    ClientData data;
+    while (batch->size() < options_.max_batch_size && queue_.tryPop(data)) {
+        batch->append(std::move(data));
+    }
+
+    // Буфер вытеснения переносится в файл, даже если пачка уже полна:
+    // иначе он переполнится, пока приемник занят
+    if (spill_pending_.load() > 0) {
+        flushOverflow();
+    }
+
+    // Вытесненные записи новее всего, что было в очереди до них
+    if (batch->size() < options_.max_batch_size && spill_records_ > 0) {
+        readSpill(batch, options_.max_batch_size - batch->size());
+    }
+}
+
+void SinkRunner::deliver(const QVector<ClientData> &batch)
+{
+    if (opened_) {
+        sink_->reportQueueDepth(queueDepth());
+        sink_->writeBatch(batch);
+    }
+    ServerMetrics::increment(Counter::SinkDelivered, batch.size());
+}
+
+void SinkRunner::updateBackpressure()
+{
+    const size_t depth = queue_.sizeApprox();
+    const size_t capacity = queue_.capacity();
+    const bool active = backpressured_.load(std::memory_order_relaxed);
+    const bool change = active ? depth * 4 <= capacity : depth * 4 >= capacity * 3;
+    if (!change) {
+        return;
+    }
+
+    // Вызывается из обоих потоков: переход и сигнал под мьютексом, чтобы
+    // сигналы не разошлись по порядку и не повторились
+    QMutexLocker locker(&backpressure_mutex_);
+    if (backpressured_.load(std::memory_order_relaxed) == active) {
+        backpressured_.store(!active, std::memory_order_relaxed);
+        emit backpressureChanged(name(), !active);
+    }
+}
+
+void SinkRunner::offerWithSpill(ClientData &&data)
+{
+    if (spill_pending_.load(std::memory_order_acquire) == 0 && queue_.tryPush(std::move(data))) {
+        waiter_.notify();
+        return;
+    }
+
+    QMutexLocker locker(&overflow_mutex_);
+
+    // Повторная проверка под мьютексом: приемник мог дочитать вытесненное
+    if (spill_pending_.load() == 0 && queue_.tryPush(std::move(data))) {
+        waiter_.notify();
+        return;
+    }
+
+    // Поток приемника не успевает переносить буфер в файл
+    if (overflow_.size() >= options_.queue_capacity) {
+        ServerMetrics::increment(Counter::SinkDropped);
+        return;
+    }
+    overflow_.append(std::move(data));
+    spill_pending_.fetch_add(1);
+}
+
+void SinkRunner::flushOverflow()
+{
+    {
+        QMutexLocker locker(&overflow_mutex_);
+        overflow_spare_.swap(overflow_);
+    }
+    if (overflow_spare_.isEmpty()) {
+        return;
+    }
+
+    qint64 dropped = 0;
+    if (!spill_writer_.isOpen() && !openSpill()) {
+        dropped = overflow_spare_.size();
+    } else {
+        for (const ClientData &data : std::as_const(overflow_spare_)) {
+            if (spill_bytes_ >= options_.spill_max_bytes) {
+                ++dropped;
+                continue;
+            }
+            // Строка: client_id, время приема (мс), JSON сообщения
+            const QByteArray line = QByteArray::number(data.client_id) + ' '
+                + QByteArray::number(data.timestamp.toMSecsSinceEpoch()) + ' '
+                + QJsonDocument(data.content).toJson(QJsonDocument::Compact) + '\n';
+            if (spill_writer_.write(line) != line.size()) {
+                ++dropped;
+                continue;
+            }
+            spill_bytes_ += line.size();
+            ++spill_records_;
+        }
+        spill_writer_.flush();
+    }
+
+    ServerMetrics::increment(Counter::SinkSpilled, quint64(overflow_spare_.size() - dropped));
+    if (dropped > 0) {
+        spill_pending_.fetch_sub(dropped);
+        ServerMetrics::increment(Counter::SinkDropped, quint64(dropped));
+        if (!spill_full_) {
+            spill_full_ = true;
+            emit logMessage(QString("Sink %1: spill file is full (%2 MB), dropping records")
+                            .arg(name()).arg(options_.spill_max_bytes / (1024 * 1024)));
+        }
+    }
+    overflow_spare_.clear();
+}
+
+bool SinkRunner::openSpill()
+{
+    const QString directory = options_.spill_directory.isEmpty()
+        ? QDir::tempPath() : options_.spill_directory;
+    QDir().mkpath(directory);
+    const QString path = QDir(directory).filePath(
+        QString("%1-%2.spill").arg(name()).arg(QCoreApplication::applicationPid()));
+
+    spill_writer_.setFileName(path);
+    spill_reader_.setFileName(path);
+    if (!spill_writer_.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || !spill_reader_.open(QIODevice::ReadOnly)) {
+        emit logMessage(QString("Sink %1: cannot open spill file %2").arg(name(), path));
+        spill_writer_.close();
+        spill_reader_.close();
+        return false;
+    }
+    return true;
+}
+
+void SinkRunner::readSpill(QVector<ClientData> *batch, int max_records)
+{
+    while (max_records-- > 0 && spill_records_ > 0) {
+        const QByteArray line = spill_reader_.readLine();
+        if (line.isEmpty()) {
+            break;
+        }
+        --spill_records_;
+        spill_pending_.fetch_sub(1);
+
+        const QList<QByteArray> parts = line.trimmed().split(' ');
+        if (parts.size() < 3) {
+            continue;
+        }
+
+        ClientData data;
+        data.client_id = parts[0].toInt();
+        data.timestamp = QDateTime::fromMSecsSinceEpoch(parts[1].toLongLong());
+        data.content = QJsonDocument::fromJson(
+            line.mid(parts[0].size() + parts[1].size() + 2)).object();
+        data.data_type = data.content["type"].toString();
+        batch->append(std::move(data));
+    }
+
+    // Файл дочитан: начинаем его заново, чтобы он не рос бесконечно
+    if (spill_records_ == 0 && spill_bytes_ > 0) {
+        spill_writer_.resize(0);
+        spill_writer_.seek(0);
+        spill_reader_.seek(0);
+        spill_bytes_ = 0;
+        spill_full_ = false;
+    }
+}
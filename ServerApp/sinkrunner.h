@@ -0,0 +1,91 @@
+#ifndef SINKRUNNER_H
+#define SINKRUNNER_H
+
+#include <QFile>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "recordsink.h"
+#include "spscqueue.h"
+
+// Runs one RecordSink on its own thread.
+//
+// Стадия оценки передает записи через offer() в SPSC-очередь приемника;
+// поток приемника собирает их в пачки (по размеру или по времени) и
+// вызывает writeBatch(). При заполнении очереди действует SlowSinkPolicy.
+// Для Spill записи, не поместившиеся в очередь, стадия оценки складывает
+// в ограниченный буфер в памяти, а в файл их переносит поток приемника —
+// ввода-вывода на стадии оценки нет. Пока вытесненное не дочитано, новые
+// записи тоже идут в буфер — порядок сохраняется. Сверх емкости буфера и
+// spill_max_bytes файла записи отбрасываются (SinkDropped).
+//
+// Заполнение очереди выше 3/4 сообщается сигналом backpressureChanged,
+// снятие — при опустошении ниже 1/4. Начало замечает offer(), снятие —
+// поток приемника после каждого разбора очереди.
+class SinkRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    SinkRunner(std::unique_ptr<RecordSink> sink, const SinkOptions &options,
+               QObject *parent = nullptr);
+    ~SinkRunner();
+
+    QString name() const;
+    bool wantsDeviceEvents() const;
+
+    // thread_init runs first in the sink thread (CPU pinning)
+    void start(std::function<void()> thread_init = {});
+    // Deliver everything queued or spilled, then close the sink
+    void stop();
+
+    // Producer side: only the evaluate stage thread may call it
+    void offer(ClientData &&data);
+
+    bool isBackpressured() const;
+    qint64 queueDepth() const;
+
+signals:
+    void backpressureChanged(const QString &sink, bool active);
+    void logMessage(const QString &message);
+
+private:
+    void run(const std::function<void()> &thread_init);
+    void fillBatch(QVector<ClientData> *batch);
+    void deliver(const QVector<ClientData> &batch);
+    void updateBackpressure();
+
+    // Вытеснение (политика Spill)
+    void offerWithSpill(ClientData &&data);
+    void flushOverflow();
+    bool openSpill();
+    void readSpill(QVector<ClientData> *batch, int max_records);
+
+    std::unique_ptr<RecordSink> sink_;
+    const SinkOptions options_;
+
+    SpscQueue<ClientData> queue_;
+    StageWaiter waiter_;
+    QThread *thread_;
+    std::atomic<bool> stopping_;
+    std::atomic<bool> backpressured_;
+    QMutex backpressure_mutex_;
+    bool opened_;
+
+    QMutex overflow_mutex_;
+    QVector<ClientData> overflow_;       // Под overflow_mutex_
+    QVector<ClientData> overflow_spare_; // Далее — только поток приемника
+    QFile spill_writer_;
+    QFile spill_reader_;
+    qint64 spill_records_;               // В файле, еще не прочитано
+    qint64 spill_bytes_;
+    bool spill_full_;                    // Предел файла достигнут (сообщено)
+    std::atomic<qint64> spill_pending_;  // В буфере и в файле, еще не доставлено
+};
+
+#endif // SINKRUNNER_H
@@ -0,0 +1,131 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// Bounded lock-free single-producer/single-consumer ring queue.
+//
+// Индексы производителя и потребителя лежат в разных кэш-линиях; каждая
+// сторона хранит кэшированную копию чужого индекса и перечитывает ее
+// только когда очередь кажется полной/пустой, поэтому в установившемся
+// режиме push/pop не вызывают обмена кэш-линиями между ядрами.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity)
+        : mask_(roundUpToPowerOfTwo(capacity) - 1),
+          slots_(new T[mask_ + 1])
+    {
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side. The value is moved from only on success.
+    bool tryPush(T &&value)
+    {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ > mask_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ > mask_) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool tryPop(T &value)
+    {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        value = std::move(slots_[head & mask_]);
+        slots_[head & mask_] = T();  // Освобождаем разделяемые данные сразу
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate, safe to call from any thread (metrics)
+    std::size_t sizeApprox() const
+    {
+        const std::size_t tail = tail_.load(std::memory_order_acquire);
+        const std::size_t head = head_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    bool emptyApprox() const { return sizeApprox() == 0; }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    static std::size_t roundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 2;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const std::size_t mask_;
+    const std::unique_ptr<T[]> slots_;
+
+    alignas(64) std::atomic<std::size_t> head_{0};  // Пишет только потребитель
+    std::size_t cached_tail_ = 0;
+
+    alignas(64) std::atomic<std::size_t> tail_{0};  // Пишет только производитель
+    std::size_t cached_head_ = 0;
+};
+
+// Sleep/wake-up for a stage consumer waiting on lock-free queues.
+//
+// Производитель берет мьютекс только если потребитель действительно спит,
+// поэтому под нагрузкой уведомление стоит одну атомарную загрузку.
+class StageWaiter
+{
+public:
+    // Producer side, after a successful push
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_one();
+        }
+    }
+
+    // Consumer side: sleep unless has_data() turns true; timeout bounds the
+    // latency of a missed wake-up and of stop requests
+    template <typename Predicate>
+    void wait(Predicate has_data, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_data()) {
+            wake_.wait_for(lock, timeout);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> sleeping_{false};
+};
+
+#endif // SPSCQUEUE_H
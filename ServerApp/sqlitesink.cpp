@@ -0,0 +1,213 @@
+#include "sqlitesink.h"
+
+#include <QJsonDocument>
+#include <QSqlDatabase>
+#include <QSqlError>
+
+#include "servermetrics.h"
+
+namespace {
+// Строк в транзакции: при меньших пачках время уходит на коммиты
+constexpr int kPreferredBatchSize = 4096;
+
+const char *const kSchema[] = {
+    "CREATE TABLE IF NOT EXISTS network_metrics ("
+    "client_id INTEGER NOT NULL, timestamp INTEGER NOT NULL, "
+    "bandwidth REAL, latency REAL, packet_loss REAL)",
+    "CREATE INDEX IF NOT EXISTS network_metrics_client_time "
+    "ON network_metrics (client_id, timestamp)",
+
+    "CREATE TABLE IF NOT EXISTS device_status ("
+    "client_id INTEGER NOT NULL, timestamp INTEGER NOT NULL, "
+    "uptime INTEGER, cpu_usage INTEGER, memory_usage INTEGER)",
+    "CREATE INDEX IF NOT EXISTS device_status_client_time "
+    "ON device_status (client_id, timestamp)",
+
+    "CREATE TABLE IF NOT EXISTS logs ("
+    "client_id INTEGER NOT NULL, timestamp INTEGER NOT NULL, "
+    "severity TEXT, message TEXT)",
+    "CREATE INDEX IF NOT EXISTS logs_client_time "
+    "ON logs (client_id, timestamp)",
+
+    "CREATE TABLE IF NOT EXISTS records ("
+    "client_id INTEGER NOT NULL, timestamp INTEGER NOT NULL, "
+    "type TEXT NOT NULL, content TEXT NOT NULL)",
+    "CREATE INDEX IF NOT EXISTS records_client_time "
+    "ON records (client_id, timestamp)",
+};
+
+const char *const kPragmas[] = {
+    "PRAGMA journal_mode=WAL",
+    "PRAGMA synchronous=NORMAL",
+    "PRAGMA temp_store=MEMORY",
+    "PRAGMA cache_size=-16384",   // 16 МБ
+};
+
+// Отсутствующее поле сохраняется как NULL
+QVariant field(const QJsonObject &content, const char *key)
+{
+    const QJsonValue value = content.value(QLatin1String(key));
+    return value.isUndefined() || value.isNull() ? QVariant() : value.toVariant();
+}
+
+std::unique_ptr<QSqlQuery> prepare(const QSqlDatabase &db, const QString &sql, QString *error)
+{
+    auto query = std::make_unique<QSqlQuery>(db);
+    if (!query->prepare(sql)) {
+        *error = query->lastError().text();
+        return nullptr;
+    }
+    return query;
+}
+}  // namespace
+
+SqliteSink::SqliteSink(const QString &name, const QString &path)
+    : name_(name), path_(path), connection_name_("sink-" + name)
+{
+}
+
+QString SqliteSink::name() const
+{
+    return name_;
+}
+
+int SqliteSink::preferredBatchSize() const
+{
+    return kPreferredBatchSize;
+}
+
+bool SqliteSink::open(QString *error)
+{
+    if (!openDatabase(error)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SqliteSink::openDatabase(QString *error)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection_name_);
+    db.setDatabaseName(path_);
+    if (!db.open()) {
+        *error = db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    for (const char *pragma : kPragmas) {
+        query.exec(pragma);
+    }
+    for (const char *statement : kSchema) {
+        if (!query.exec(statement)) {
+            *error = query.lastError().text();
+            return false;
+        }
+    }
+
+    insert_network_ = prepare(db, "INSERT INTO network_metrics "
+                                  "(client_id, timestamp, bandwidth, latency, packet_loss) "
+                                  "VALUES (?, ?, ?, ?, ?)", error);
+    insert_status_ = prepare(db, "INSERT INTO device_status "
+                                 "(client_id, timestamp, uptime, cpu_usage, memory_usage) "
+                                 "VALUES (?, ?, ?, ?, ?)", error);
+    insert_log_ = prepare(db, "INSERT INTO logs (client_id, timestamp, severity, message) "
+                              "VALUES (?, ?, ?, ?)", error);
+    insert_other_ = prepare(db, "INSERT INTO records (client_id, timestamp, type, content) "
+                                "VALUES (?, ?, ?, ?)", error);
+
+    return insert_network_ && insert_status_ && insert_log_ && insert_other_;
+}
+
+void SqliteSink::writeBatch(const QVector<ClientData> &batch)
+{
+    QSqlDatabase db = QSqlDatabase::database(connection_name_, false);
+
+    db.transaction();
+    quint64 written = 0;
+    QString error;
+    for (const ClientData &data : batch) {
+        written += insert(data, error.isEmpty() ? &error : nullptr) ? 1 : 0;
+    }
+
+    // Одна строка лога на пачку: при сломанной схеме отказывает каждая строка
+    const quint64 failed = quint64(batch.size()) - written;
+    if (failed > 0) {
+        ServerMetrics::increment(Counter::SqliteFailedRows, failed);
+        qWarning("SQLite sink %s: %llu of %lld rows not inserted: %s",
+                 qPrintable(name_), failed, qint64(batch.size()), qPrintable(error));
+    }
+
+    if (db.commit()) {
+        ServerMetrics::increment(Counter::SqliteRows, written);
+        ServerMetrics::increment(Counter::SqliteTransactions);
+    } else {
+        const QString commit_error = db.lastError().text();
+        db.rollback();
+        ServerMetrics::increment(Counter::SqliteFailedRows, written);
+        qWarning("SQLite sink %s: commit failed, %llu rows lost: %s",
+                 qPrintable(name_), written, qPrintable(commit_error));
+    }
+}
+
+void SqliteSink::reportQueueDepth(qint64 depth)
+{
+    ServerMetrics::setGauge(Gauge::SqliteQueueDepth, depth);
+}
+
+void SqliteSink::close()
+{
+    if (!QSqlDatabase::contains(connection_name_)) {
+        return;
+    }
+
+    // Запросы и копии QSqlDatabase должны быть уничтожены до removeDatabase()
+    insert_network_.reset();
+    insert_status_.reset();
+    insert_log_.reset();
+    insert_other_.reset();
+    {
+        QSqlDatabase db = QSqlDatabase::database(connection_name_, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connection_name_);
+    ServerMetrics::setGauge(Gauge::SqliteQueueDepth, 0);
+}
+
+bool SqliteSink::insert(const ClientData &data, QString *error)
+{
+    const QJsonObject &content = data.content;
+    const qint64 timestamp = data.timestamp.toMSecsSinceEpoch();
+
+    QSqlQuery *query;
+    if (data.data_type == QLatin1String("NetworkMetrics")) {
+        query = insert_network_.get();
+        query->bindValue(2, field(content, "bandwidth"));
+        query->bindValue(3, field(content, "latency"));
+        query->bindValue(4, field(content, "packet_loss"));
+    } else if (data.data_type == QLatin1String("DeviceStatus")) {
+        query = insert_status_.get();
+        query->bindValue(2, field(content, "uptime"));
+        query->bindValue(3, field(content, "cpu_usage"));
+        query->bindValue(4, field(content, "memory_usage"));
+    } else if (data.data_type == QLatin1String("Log")) {
+        query = insert_log_.get();
+        query->bindValue(2, field(content, "severity"));
+        query->bindValue(3, field(content, "message"));
+    } else {
+        query = insert_other_.get();
+        // Тип без поля "type" — null QString, а столбец NOT NULL
+        query->bindValue(2, data.data_type.isNull() ? QString(QLatin1String("")) : data.data_type);
+        query->bindValue(3, QString::fromUtf8(QJsonDocument(content).toJson(QJsonDocument::Compact)));
+    }
+
+    query->bindValue(0, data.client_id);
+    query->bindValue(1, timestamp);
+    if (!query->exec()) {
+        if (error) {
+            *error = query->lastError().text();
+        }
+        return false;
+    }
+    return true;
+}
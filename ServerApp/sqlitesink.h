@@ -0,0 +1,53 @@
+#ifndef SQLITESINK_H
+#define SQLITESINK_H
+
+#include <QSqlQuery>
+
+#include <memory>
+
+#include "recordsink.h"
+
+// Stores records in a SQLite database for querying with standard tools.
+//
+// Каждый тип данных пишется в свою таблицу с отдельными столбцами:
+//   network_metrics (client_id, timestamp, bandwidth, latency, packet_loss)
+//   device_status   (client_id, timestamp, uptime, cpu_usage, memory_usage)
+//   logs            (client_id, timestamp, severity, message)
+//   records         (client_id, timestamp, type, content) — прочие типы
+// timestamp — время приема в мс от эпохи Unix; у записи без поля "type"
+// type — пустая строка. Отвергнутые строки считаются в SqliteFailedRows,
+// первая ошибка пачки попадает в лог.
+//
+// База открывается в режиме журнала WAL с synchronous=NORMAL: коммит не
+// ждет fsync, а сбой питания может потерять только последние транзакции.
+// Одна пачка приемника — одна транзакция; INSERT-запросы подготавливаются
+// один раз при открытии. Соединение QSqlDatabase создается и используется
+// только в потоке приемника (требование QtSql).
+class SqliteSink : public RecordSink
+{
+public:
+    SqliteSink(const QString &name, const QString &path);
+
+    QString name() const override;
+    int preferredBatchSize() const override;
+    bool open(QString *error) override;
+    void writeBatch(const QVector<ClientData> &batch) override;
+    void reportQueueDepth(qint64 depth) override;
+    void close() override;
+
+private:
+    bool openDatabase(QString *error);
+    bool insert(const ClientData &data, QString *error);
+
+    QString name_;
+    QString path_;
+    QString connection_name_;
+
+    // Подготовленные запросы, переиспользуются для каждой строки
+    std::unique_ptr<QSqlQuery> insert_network_;
+    std::unique_ptr<QSqlQuery> insert_status_;
+    std::unique_ptr<QSqlQuery> insert_log_;
+    std::unique_ptr<QSqlQuery> insert_other_;
+};
+
+#endif // SQLITESINK_H
@@ -0,0 +1,145 @@
+#ifndef STREAMCODEC_H
+#define STREAMCODEC_H
+
+#include <QByteArray>
+
+#include <zlib.h>
+
+// Per-connection stream compression of the device uplink (zlib deflate).
+//
+// Формат общий для ServerApp и ClientApp (ClientApp подключает этот
+// заголовок напрямую). Сервер предлагает сжатие полем "compression" в
+// ConnectionConfirm; устройство, согласное сжимать, отвечает строкой
+// {"type":"Compress","codec":"deflate"}, и все следующие байты от него —
+// один поток raw deflate. Каждая пачка кадров завершается Z_SYNC_FLUSH,
+// поэтому сервер разжимает ее целиком, не дожидаясь следующей, а окно
+// (повторяющиеся ключи JSON, шаблоны журналов) общее для всего соединения.
+// Ответы сервера не сжимаются.
+namespace StreamCodec {
+constexpr char kDeflate[] = "deflate";
+constexpr char kCompressPrefix[] = "{\"type\":\"Compress\"";
+
+// Device side
+class Deflater
+{
+public:
+    explicit Deflater(int level = Z_DEFAULT_COMPRESSION)
+    {
+        // Отрицательные биты окна — raw deflate без заголовка zlib
+        ok_ = deflateInit2(&stream_, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~Deflater()
+    {
+        if (ok_) {
+            deflateEnd(&stream_);
+        }
+    }
+
+    Deflater(const Deflater &) = delete;
+    Deflater &operator=(const Deflater &) = delete;
+
+    bool isValid() const
+    {
+        return ok_;
+    }
+
+    // Compressed bytes of a batch, ending on a byte boundary (sync flush)
+    QByteArray compress(const QByteArray &data)
+    {
+        QByteArray out;
+        if (!ok_) {
+            return out;
+        }
+        out.resize(int(deflateBound(&stream_, uLong(data.size()))) + 16);
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+        stream_.avail_in = uInt(data.size());
+        int written = 0;
+        do {
+            if (written == out.size()) {
+                out.resize(out.size() * 2);
+            }
+            stream_.next_out = reinterpret_cast<Bytef*>(out.data() + written);
+            stream_.avail_out = uInt(out.size() - written);
+            deflate(&stream_, Z_SYNC_FLUSH);
+            written = out.size() - int(stream_.avail_out);
+        } while (stream_.avail_out == 0);
+        out.truncate(written);
+        return out;
+    }
+
+private:
+    z_stream stream_ {};
+    bool ok_ = false;
+};
+
+// Server side
+class Inflater
+{
+public:
+    enum Status {
+        Ok,
+        Corrupt,
+        TooLarge    // Выход превысил предел; остаток не разжат
+    };
+
+    Inflater()
+    {
+        ok_ = inflateInit2(&stream_, -15) == Z_OK;
+    }
+
+    ~Inflater()
+    {
+        if (ok_) {
+            inflateEnd(&stream_);
+        }
+    }
+
+    Inflater(const Inflater &) = delete;
+    Inflater &operator=(const Inflater &) = delete;
+
+    // Append the decompressed bytes of data to out, stopping once out
+    // would grow past max_size
+    Status decompress(const char *data, qint64 size, QByteArray *out, qint64 max_size)
+    {
+        if (!ok_) {
+            return Corrupt;
+        }
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream_.avail_in = uInt(size);
+        // Заполненный до конца выход значит, что в zlib могли остаться
+        // данные: без еще одного вызова хвост кадра ждал бы следующей пачки
+        stream_.avail_out = 0;
+        while (stream_.avail_in > 0 || stream_.avail_out == 0) {
+            const int offset = out->size();
+            if (offset > max_size) {
+                return TooLarge;
+            }
+            // Кадры JSON сжимаются в несколько раз; запас на типичный случай,
+            // но не больше предела (лишний байт — признак превышения):
+            // поток, сжатый в тысячу раз, не должен занять память целиком
+            const qint64 allowed = max_size - offset + 1;
+            const int room = int(qMin(qMin<qint64>(qMax<qint64>(4 * qint64(stream_.avail_in), 4096),
+                                                   1024 * 1024), allowed));
+            out->resize(offset + room);
+            stream_.next_out = reinterpret_cast<Bytef*>(out->data() + offset);
+            stream_.avail_out = uInt(room);
+            const int status = inflate(&stream_, Z_SYNC_FLUSH);
+            out->truncate(out->size() - int(stream_.avail_out));
+            if (status == Z_BUF_ERROR && stream_.avail_out > 0) {
+                break;      // Вход исчерпан посреди блока
+            }
+            if (status != Z_OK && status != Z_BUF_ERROR) {
+                return Corrupt;     // Z_STREAM_END тоже: устройство не завершает поток
+            }
+        }
+        return out->size() > max_size ? TooLarge : Ok;
+    }
+
+private:
+    z_stream stream_ {};
+    bool ok_ = false;
+};
+}  // namespace StreamCodec
+
+#endif // STREAMCODEC_H
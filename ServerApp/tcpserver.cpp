@@ -1,26 +1,105 @@
 #include "tcpserver.h"
 
+#include <QElapsedTimer>
+#include <QFile>
 #include <QJsonDocument>
 #include <QJsonArray>
-#include <QMutexLocker>
+
+#include <utility>
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+#include "acceptorpool.h"
+#include "clusterring.h"
+#include "deltacodec.h"
+#include "devicetransport.h"
+#include "epollbackend.h"
+#include "framebuilder.h"
+#include "ingestpipeline.h"
+#include "servermetrics.h"
+#include "streamcodec.h"
+#include "telemetrystore.h"
+#include "uringbackend.h"
+#include "writeaheadlog.h"
 
 namespace {
 // Разделитель сообщений для TCP потока (протокол на основе переноса строки)
 constexpr char kMessageDelimiter = '\n';
+
+// Период проверки задержки цикла событий; gauge публикуется раз в секунду
+constexpr int kHealthIntervalMs = 100;
+constexpr int kHealthTicksPerPublish = 10;
+
+// Первая строка подключения ретранслятора (см. relayuplink.h)
+constexpr char kRelayHelloPrefix[] = "{\"type\":\"RelayHello\"";
+
+// Кольцо одного устройства в общей памяти (см. shmring.h)
+constexpr quint32 kShmRingCapacity = 4 * 1024 * 1024;
+
+// Ping клиента (замер задержки); ответ Pong отправляется из потока приема
+constexpr char kPingPrefix[] = "{\"type\":\"Ping\"";
+
+// Резидентная память процесса, 0 если недоступна
+qint64 residentBytes()
+{
+#if defined(Q_OS_LINUX)
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
 }  // namespace
 
 TcpServer::TcpServer(QObject *parent)
     : QObject(parent),
-      server_(new QTcpServer(this)),
-      next_client_id_(1)
+      tcp_(new TcpTransport(this)),
+      local_(new LocalTransport(this)),
+      ring_(new ShmTransport(kShmRingCapacity, this)),
+      next_client_id_(1),
+      receive_pool_(kDefaultReceiveMemory),
+      compression_(false),
+      cluster_(nullptr),
+      acceptors_(nullptr),
+      native_(nullptr),
+      baseline_resident_bytes_(0),
+      pipeline_(new IngestPipeline(this)),
+      wal_(nullptr),
+      health_timer_(new QTimer(this)),
+      max_loop_lag_ms_(0),
+      health_ticks_(0)
 {
     // Регистрация метатипов для передачи через сигналы между потоками
     qRegisterMetaType<ClientInfo>("ClientInfo");
     qRegisterMetaType<ClientData>("ClientData");
+    qRegisterMetaType<QVector<ClientData>>("QVector<ClientData>");
     qRegisterMetaType<ThresholdConfig>("ThresholdConfig");
 
-    connect(server_, &QTcpServer::newConnection,
-            this, &TcpServer::onNewConnection);
+    watchTransport(tcp_);
+    watchTransport(local_);
+    watchTransport(ring_);
+
+    health_timer_->setTimerType(Qt::PreciseTimer);
+    connect(health_timer_, &QTimer::timeout,
+            this, &TcpServer::onHealthTimer);
+
+    // Сообщения стадий пересылаются напрямую из их потоков, минуя цикл
+    // событий потока приема
+    connect(pipeline_, &IngestPipeline::logMessage,
+            this, &TcpServer::logMessage, Qt::DirectConnection);
+
+    // Приемник GUI: сигнал уходит в поток окна через очередь событий,
+    // одно событие на пачку, а не на запись
+    pipeline_->addSink(std::make_unique<BatchCallbackSink>("gui",
+                                                           [this](const QVector<ClientData> &batch) {
+        emit dataReceived(batch);
+    }));
 }
 
 TcpServer::~TcpServer()
@@ -30,36 +109,111 @@ TcpServer::~TcpServer()
 
 bool TcpServer::startServer(quint16 port)
 {
-    if (server_->isListening()) {
+    if (isRunning()) {
         emit logMessage("Server is already running");
         return true;
     }
 
-    if (!server_->listen(QHostAddress::Any, port)) {
+    if (native_) {
+        if (acceptors_) {
+            emit logMessage("Acceptor threads apply to the Qt backend only, ignored");
+        }
+        QString error;
+        if (!native_->listen(port, &error)) {
+            emit logMessage(QString("Failed to start server: %1").arg(error));
+            return false;
+        }
+    } else if (acceptors_) {
+        QString error;
+        if (!acceptors_->listen(port, &error)) {
+            emit logMessage(QString("Failed to start server: %1").arg(error));
+            return false;
+        }
+    } else if (!tcp_->listen(port)) {
         emit logMessage(QString("Failed to start server: %1")
-                        .arg(server_->errorString()));
+                        .arg(tcp_->errorString()));
         return false;
     }
+    baseline_resident_bytes_ = residentBytes();
 
-    emit logMessage(QString("Server started on port %1").arg(port));
+    // Локальный сокет необязателен: без него сервер работает по TCP
+    if (!local_name_.isEmpty()) {
+        if (local_->listen(local_name_)) {
+            emit logMessage(QString("Local socket listening on %1")
+                            .arg(local_->fullServerName()));
+        } else {
+            emit logMessage(QString("Failed to start local socket: %1")
+                            .arg(local_->errorString()));
+        }
+    }
+    if (!ring_name_.isEmpty()) {
+        if (ring_->listen(ring_name_)) {
+            emit logMessage(QString("Shared-memory rings offered on %1")
+                            .arg(ring_->fullServerName()));
+        } else {
+            emit logMessage(QString("Failed to start shared-memory transport: %1")
+                            .arg(ring_->errorString()));
+        }
+    }
+
+    pipeline_->pinCurrentThread("network");
+    pipeline_->start();
+
+    health_clock_.start();
+    health_timer_->start(kHealthIntervalMs);
+
+    QString mode;
+    if (native_) {
+        mode = QString(" (%1 backend)").arg(native_->name());
+    } else if (acceptors_) {
+        mode = QString(" (%1 acceptors)").arg(acceptors_->size());
+    }
+    emit logMessage(QString("Server started on port %1%2").arg(port).arg(mode));
     emit serverStarted();
     return true;
 }
 
 void TcpServer::stopServer()
 {
-    // Отключаем всех клиентов (abort для немедленного закрытия)
-    for (auto it = clients_.begin(); it != clients_.end(); ++it) {
-        QTcpSocket *socket = it.key();
-        socket->abort();
+    // Отключаем всех клиентов (abort для немедленного закрытия), в том
+    // числе еще не подтвержденных
+    const QList<QIODevice*> sockets = receive_buffers_.keys();
+    for (QByteArray &buffer : receive_buffers_) {
+        receive_pool_.release(&buffer);
+    }
+    receive_buffers_.clear();
+    inflaters_.clear();
+    delta_decoders_.clear();
+    deferred_commands_.clear();
+    over_limit_since_ms_.clear();
+    for (QIODevice *socket : sockets) {
+        DeviceTransport::of(socket)->abortConnection(socket);
         socket->deleteLater();
     }
+    awaiting_hello_.clear();
     clients_.clear();
     client_sockets_.clear();
-    receive_buffers_.clear();
+    relay_links_.clear();
+    relayed_clients_.clear();
+    native_clients_.clear();
+    const bool was_running = isRunning();
+    if (native_) {
+        native_->close();
+    }
+    if (acceptors_) {
+        acceptors_->close();
+    }
+    health_timer_->stop();
+
+    // Дожидаемся обработки уже принятых сообщений
+    pipeline_->stop();
+    ServerMetrics::setGauge(Gauge::ConnectionsActive, 0);
+    publishBufferGauges();
 
-    if (server_->isListening()) {
-        server_->close();
+    local_->close();
+    ring_->close();
+    if (was_running) {
+        tcp_->close();
         emit logMessage("Server stopped");
         emit serverStopped();
     }
@@ -67,16 +221,32 @@ void TcpServer::stopServer()
 
 bool TcpServer::isRunning() const
 {
-    return server_->isListening();
+    return tcp_->isListening() || (native_ && native_->isListening())
+        || (acceptors_ && acceptors_->isListening());
 }
 
 void TcpServer::startAllClients()
 {
     for (auto it = clients_.begin(); it != clients_.end(); ++it) {
-        if (it.value().is_connected && !it.value().is_running) {
+        if (it.value().is_connected && !it.value().is_running
+            && !relay_links_.contains(it.key())) {
             startClient(it.value().id);
         }
     }
+
+    const QList<int> relayed = relayed_clients_.keys();
+    for (int client_id : relayed) {
+        if (!relayed_clients_[client_id].is_running) {
+            startClient(client_id);
+        }
+    }
+
+    const QList<int> native = native_clients_.keys();
+    for (int client_id : native) {
+        if (!native_clients_[client_id]) {
+            startClient(client_id);
+        }
+    }
 }
 
 void TcpServer::stopAllClients()
@@ -86,172 +256,649 @@ void TcpServer::stopAllClients()
             stopClient(it.value().id);
         }
     }
+
+    const QList<int> relayed = relayed_clients_.keys();
+    for (int client_id : relayed) {
+        if (relayed_clients_[client_id].is_running) {
+            stopClient(client_id);
+        }
+    }
+
+    const QList<int> native = native_clients_.keys();
+    for (int client_id : native) {
+        if (native_clients_[client_id]) {
+            stopClient(client_id);
+        }
+    }
 }
 
 void TcpServer::startClient(int client_id)
 {
-    if (!client_sockets_.contains(client_id)) {
+    if (!setClientRunning(client_id, true)) {
         emit logMessage(QString("Client %1 not found").arg(client_id));
         return;
     }
 
-    QTcpSocket *socket = client_sockets_[client_id];
-    clients_[socket].is_running = true;
-
-    // Отправляем команду start клиенту
-    QJsonObject command;
-    command["type"] = "Command";
-    command["command"] = "start";
-    sendToClient(socket, command);
-
     emit clientStatusChanged(client_id, true);
     emit logMessage(QString("Started client %1").arg(client_id));
 }
 
 void TcpServer::stopClient(int client_id)
 {
-    if (!client_sockets_.contains(client_id)) {
+    if (!setClientRunning(client_id, false)) {
         emit logMessage(QString("Client %1 not found").arg(client_id));
         return;
     }
 
-    QTcpSocket *socket = client_sockets_[client_id];
-    clients_[socket].is_running = false;
+    emit clientStatusChanged(client_id, false);
+    emit logMessage(QString("Stopped client %1").arg(client_id));
+}
 
-    // Отправляем команду stop клиенту
+bool TcpServer::setClientRunning(int client_id, bool running)
+{
+    // Отправляем команду start/stop клиенту
     QJsonObject command;
     command["type"] = "Command";
-    command["command"] = "stop";
-    sendToClient(socket, command);
+    command["command"] = running ? "start" : "stop";
 
-    emit clientStatusChanged(client_id, false);
-    emit logMessage(QString("Stopped client %1").arg(client_id));
+    if (client_sockets_.contains(client_id)) {
+        QIODevice *socket = client_sockets_[client_id];
+        clients_[socket].is_running = running;
+        sendCommand(socket, "run", command);
+        return true;
+    }
+
+    // Устройство за ретранслятором: команда уходит в его подключение
+    auto relayed = relayed_clients_.find(client_id);
+    if (relayed != relayed_clients_.end()) {
+        relayed->is_running = running;
+        command["device"] = relayed->device;
+        sendCommand(relayed->link, QString("run:%1").arg(relayed->device), command);
+        return true;
+    }
+
+    auto native = native_clients_.find(client_id);
+    if (native != native_clients_.end()) {
+        *native = running;
+        native_->send(client_id, encodeMessage(command));
+        return true;
+    }
+    return false;
 }
 
 void TcpServer::setThresholds(const ThresholdConfig &config)
 {
-    QMutexLocker locker(&thresholds_mutex_);
-    thresholds_ = config;
+    pipeline_->setThresholds(config);
 }
 
 ThresholdConfig TcpServer::getThresholds() const
 {
-    QMutexLocker locker(&thresholds_mutex_);
-    return thresholds_;
+    return pipeline_->thresholds();
+}
+
+void TcpServer::setTelemetryStore(TelemetryStore *store)
+{
+    pipeline_->addSink(std::make_unique<CallbackSink>("storage", [store](const ClientData &data) {
+        store->append(data);
+    }));
+}
+
+void TcpServer::configurePipeline(const PipelineConfig &config)
+{
+    pipeline_->setConfig(config);
+}
+
+IngestPipeline *TcpServer::pipeline() const
+{
+    return pipeline_;
+}
+
+void TcpServer::setWriteAheadLog(WriteAheadLog *wal)
+{
+    wal_ = wal;
+}
+
+void TcpServer::setCluster(const ClusterRing *cluster)
+{
+    cluster_ = cluster;
+}
+
+void TcpServer::setLocalName(const QString &name)
+{
+    local_name_ = name;
 }
 
-void TcpServer::onNewConnection()
+void TcpServer::setRingName(const QString &name)
 {
-    while (server_->hasPendingConnections()) {
-        QTcpSocket *socket = server_->nextPendingConnection();
+    ring_name_ = name;
+}
 
-        // Set up signal connections
-        connect(socket, &QTcpSocket::disconnected,
-                this, &TcpServer::onClientDisconnected);
-        connect(socket, &QTcpSocket::readyRead,
-                this, &TcpServer::onReadyRead);
-        connect(socket, &QTcpSocket::errorOccurred,
-                this, &TcpServer::onSocketError);
+void TcpServer::setIngestBackend(IngestBackend backend)
+{
+    if (backend == IngestBackend::Uring && !UringBackend::isSupported()) {
+        qWarning("io_uring backend is not supported by this kernel, falling back to epoll");
+        backend = IngestBackend::Epoll;
+    }
+    if (backend == IngestBackend::Epoll && !EpollBackend::isSupported()) {
+        qWarning("epoll backend is not available on this platform, using Qt sockets");
+        backend = IngestBackend::Qt;
+    }
+
+    delete native_;
+    native_ = nullptr;
+    if (backend == IngestBackend::Uring) {
+        native_ = new UringBackend(this);
+    } else if (backend == IngestBackend::Epoll) {
+        native_ = new EpollBackend(this);
+    }
+}
+
+void TcpServer::setCompression(bool offer)
+{
+    compression_ = offer;
+}
+
+void TcpServer::setReceiveMemoryLimit(qint64 bytes)
+{
+    receive_pool_.setLimit(bytes);
+}
+
+void TcpServer::setAcceptorCount(int acceptors)
+{
+    if (acceptors > 1 && !AcceptorPool::isSupported()) {
+        qWarning("SO_REUSEPORT acceptors are not available on this platform, using one listener");
+        acceptors = 1;
+    }
+
+    delete acceptors_;
+    acceptors_ = nullptr;
+    if (acceptors > 1) {
+        acceptors_ = new AcceptorPool(this, acceptors);
+        connect(acceptors_, &AcceptorPool::accepted,
+                this, &TcpServer::onAccepted);
+    }
+}
+
+QVector<ClientRecord> TcpServer::clientRegistry() const
+{
+    QMutexLocker locker(&registry_mutex_);
+    return registry_.values().toVector();
+}
+
+int TcpServer::nextClientId() const
+{
+    return next_client_id_.load();
+}
+
+void TcpServer::restoreRegistry(int next_client_id, const QVector<ClientRecord> &clients)
+{
+    // Идентификаторы не переиспользуются: агрегаты в хранилище
+    // привязаны к client_id
+    next_client_id_ = qMax(next_client_id_.load(), next_client_id);
+
+    QMutexLocker locker(&registry_mutex_);
+    for (const ClientRecord &record : clients) {
+        registry_.insert(record.id, record);
+    }
+}
 
-        // Create client info
-        ClientInfo info;
-        info.id = generateClientId();
-        info.ip_address = socket->peerAddress().toString();
-        info.port = socket->peerPort();
-        info.is_connected = true;
-        info.is_running = false;
+void TcpServer::watchTransport(DeviceTransport *transport)
+{
+    connect(transport, &DeviceTransport::newConnection,
+            this, &TcpServer::onNewConnection);
+    connect(transport, &DeviceTransport::connectionClosed,
+            this, &TcpServer::onClientDisconnected);
+    connect(transport, &DeviceTransport::connectionError,
+            this, &TcpServer::onSocketError);
+}
 
-        // Store client
-        clients_[socket] = info;
-        client_sockets_[info.id] = socket;
-        receive_buffers_[socket] = QByteArray();
+void TcpServer::onNewConnection(QIODevice *socket)
+{
+    connect(socket, &QIODevice::readyRead,
+            this, &TcpServer::onReadyRead);
 
-        // Send connection confirmation
-        QJsonObject confirmation;
-        confirmation["type"] = "ConnectionConfirm";
-        confirmation["client_id"] = info.id;
-        confirmation["status"] = "connected";
-        sendToClient(socket, confirmation);
+    receive_buffers_[socket] = QByteArray();
+    awaiting_hello_.insert(socket);
 
-        emit clientConnected(info);
-        emit logMessage(QString("Client %1 connected from %2:%3")
-                        .arg(info.id)
-                        .arg(info.ip_address)
-                        .arg(info.port));
+    // В кластере клиент подтверждается только после Hello, когда
+    // известно, какому узлу принадлежит устройство
+    if (!cluster_) {
+        confirmClient(socket, QString());
     }
 }
 
-void TcpServer::onClientDisconnected()
+void TcpServer::onAccepted(qintptr descriptor, const ClientInfo &info)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket || !clients_.contains(socket)) {
+    // Сервер мог остановиться, пока соединение шло из потока-приемщика
+    QIODevice *socket = isRunning() ? tcp_->adoptConnection(descriptor) : nullptr;
+    if (!socket) {
+        AcceptorPool::closeDescriptor(descriptor);
+        return;
+    }
+
+    connect(socket, &QIODevice::readyRead,
+            this, &TcpServer::onReadyRead);
+
+    receive_buffers_[socket] = QByteArray();
+    awaiting_hello_.insert(socket);
+
+    // Подтверждение уже отправлено приемщиком; в кластере ждем Hello
+    if (info.id != 0) {
+        registerClient(socket, info, QString());
+    }
+}
+
+ClientInfo TcpServer::createClient(const QString &address, quint16 port)
+{
+    ClientInfo info;
+    info.id = generateClientId();
+    info.ip_address = address;
+    info.port = port;
+    info.is_connected = true;
+    info.is_running = false;
+
+    {
+        QMutexLocker locker(&registry_mutex_);
+        registry_.insert(info.id, {info.id, info.ip_address, info.port,
+                                   QDateTime::currentMSecsSinceEpoch()});
+    }
+    ServerMetrics::increment(Counter::ConnectionsAccepted);
+    return info;
+}
+
+void TcpServer::touchRegistry(int client_id)
+{
+    QMutexLocker locker(&registry_mutex_);
+    auto it = registry_.find(client_id);
+    if (it != registry_.end()) {
+        it->last_seen_ms = QDateTime::currentMSecsSinceEpoch();
+    }
+}
+
+QJsonObject TcpServer::confirmation(int client_id) const
+{
+    QJsonObject confirmation;
+    confirmation["type"] = "ConnectionConfirm";
+    confirmation["client_id"] = client_id;
+    confirmation["status"] = "connected";
+    confirmation["delta"] = true;
+    if (compression_) {
+        confirmation["compression"] = StreamCodec::kDeflate;
+    }
+    return confirmation;
+}
+
+void TcpServer::confirmClient(QIODevice *socket, const QString &device_id)
+{
+    DeviceTransport *transport = DeviceTransport::of(socket);
+    const ClientInfo info = createClient(transport->peerAddress(socket),
+                                         transport->peerPort(socket));
+
+    // Send connection confirmation
+    sendToClient(socket, confirmation(info.id));
+
+    registerClient(socket, info, device_id);
+}
+
+void TcpServer::registerClient(QIODevice *socket, const ClientInfo &info, const QString &device_id)
+{
+    // Store client
+    clients_[socket] = info;
+    client_sockets_[info.id] = socket;
+    updateConnectionGauge();
+
+    emit clientConnected(info);
+    emit logMessage(QString("Client %1 connected from %2:%3%4")
+                    .arg(info.id)
+                    .arg(info.ip_address)
+                    .arg(info.port)
+                    .arg(device_id.isEmpty() ? QString() : " as " + device_id));
+}
+
+bool TcpServer::handleHello(QIODevice *socket, const QByteArray &message)
+{
+    awaiting_hello_.remove(socket);
+
+    const QJsonObject hello = QJsonDocument::fromJson(message).object();
+    const bool is_hello = hello["type"].toString() == "Hello";
+    QString device_id = hello["device_id"].toString();
+
+    if (clients_.contains(socket)) {
+        // Без кластера клиент уже подтвержден, Hello только для журнала
+        if (is_hello && !device_id.isEmpty()) {
+            emit logMessage(QString("Client %1 is device %2")
+                            .arg(clients_[socket].id).arg(device_id));
+        }
+        return is_hello;
+    }
+
+    // Ретрансляторы размещаются не по кольцу: связь принимает любой узел
+    if (message.startsWith(kRelayHelloPrefix)) {
+        confirmClient(socket, QString());
+        return false;
+    }
+
+    // Клиент без Hello размещается по адресу
+    if (device_id.isEmpty()) {
+        device_id = DeviceTransport::of(socket)->peerAddress(socket);
+    }
+
+    QJsonObject redirect;
+    if (routeDevice(device_id, &redirect)) {
+        confirmClient(socket, device_id);
+        return is_hello;
+    }
+
+    sendToClient(socket, redirect);
+    DeviceTransport::of(socket)->disconnectConnection(socket);   // После отправки буфера
+    return true;
+}
+
+bool TcpServer::routeDevice(const QString &device_id, QJsonObject *redirect)
+{
+    if (cluster_->isLocal(device_id)) {
+        return true;
+    }
+
+    const ClusterRing::Node &owner = cluster_->owner(device_id);
+    (*redirect)["type"] = "ConnectionConfirm";
+    (*redirect)["status"] = "redirect";
+    (*redirect)["node"] = owner.name;
+    (*redirect)["host"] = owner.host;
+    (*redirect)["port"] = owner.port;
+
+    ServerMetrics::increment(Counter::Redirects);
+    emit logMessage(QString("Device %1 redirected to %2 (%3:%4)")
+                    .arg(device_id, owner.name, owner.host).arg(owner.port));
+    return false;
+}
+
+void TcpServer::onClientDisconnected(QIODevice *socket)
+{
+    awaiting_hello_.remove(socket);
+    inflaters_.remove(socket);
+    deferred_commands_.remove(socket);
+    over_limit_since_ms_.remove(socket);
+    if (!clients_.contains(socket)) {
+        // Не дождался Hello или перенаправлен на другой узел
+        auto buffer = receive_buffers_.find(socket);
+        if (buffer != receive_buffers_.end()) {
+            receive_pool_.release(&buffer.value());
+            receive_buffers_.erase(buffer);
+            socket->deleteLater();
+        }
         return;
     }
 
     int client_id = clients_[socket].id;
-    emit clientDisconnected(client_id);
-    emit logMessage(QString("Client %1 disconnected").arg(client_id));
+
+    auto link = relay_links_.find(socket);
+    if (link != relay_links_.end()) {
+        // Устройства ретранслятора отключаются вместе с ним; сама связь
+        // была скрыта из списка клиентов при подключении
+        const QList<int> devices = link->devices.values();
+        for (int device_client_id : devices) {
+            unregisterRelayedDevice(device_client_id);
+        }
+        relay_links_.erase(link);
+        emit logMessage(QString("Relay link %1 disconnected (%2 devices)")
+                        .arg(client_id).arg(devices.size()));
+    } else {
+        emit clientDisconnected(client_id);
+        emit logMessage(QString("Client %1 disconnected").arg(client_id));
+    }
+
+    touchRegistry(client_id);
 
     // Clean up
     client_sockets_.remove(client_id);
+    delta_decoders_.remove(client_id);
     clients_.remove(socket);
+    receive_pool_.release(&receive_buffers_[socket]);
     receive_buffers_.remove(socket);
     socket->deleteLater();
+    updateConnectionGauge();
 }
 
 void TcpServer::onReadyRead()
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket || !clients_.contains(socket)) {
+    QIODevice *socket = qobject_cast<QIODevice*>(sender());
+    if (!socket || !receive_buffers_.contains(socket)) {
         return;
     }
 
-    int client_id = clients_[socket].id;
+    // 0, пока клиент не подтвержден (ожидание Hello в кластере)
+    int client_id = clients_.contains(socket) ? clients_[socket].id : 0;
 
-    // Добавляем данные в буфер
-    receive_buffers_[socket].append(socket->readAll());
+    // Сжатый поток разжимается во временный буфер, несжатый читается
+    // прямо в буфер приема
+    const auto inflater = inflaters_.constFind(socket);
+    QByteArray &buffer = receive_buffers_[socket];
+    QByteArray inflated;
+    if (inflater != inflaters_.constEnd()) {
+        const QByteArray received = socket->readAll();
+        ServerMetrics::increment(Counter::BytesIn, received.size());
+        // Разжатое ограничено еще до выделения памяти: сжатие бывает
+        // тысячекратным
+        const StreamCodec::Inflater::Status status =
+            inflate(inflater->data(), received.constData(), received.size(), &inflated,
+                    kMaxBufferSize - buffer.size());
+        if (status != StreamCodec::Inflater::Ok) {
+            emit logMessage(QString(status == StreamCodec::Inflater::TooLarge
+                                        ? "Client %1: buffer overflow, disconnecting"
+                                        : "Client %1: corrupt compressed stream, disconnecting")
+                            .arg(client_id));
+            DeviceTransport::of(socket)->abortConnection(socket);
+            return;
+        }
+    }
+    const qint64 incoming = inflater != inflaters_.constEnd() ? inflated.size()
+                                                               : socket->bytesAvailable();
 
     // Защита от переполнения буфера
-    if (receive_buffers_[socket].size() > kMaxBufferSize) {
+    if (buffer.size() + incoming > kMaxBufferSize) {
+        ServerMetrics::increment(Counter::BufferOverflows);
         emit logMessage(QString("Client %1: buffer overflow, disconnecting").arg(client_id));
-        socket->abort();
+        DeviceTransport::of(socket)->abortConnection(socket);
         return;
     }
+    // Общий предел памяти буферов приема всех соединений
+    if (!receive_pool_.reserve(&buffer, buffer.size() + incoming)) {
+        ServerMetrics::increment(Counter::BufferOverflows);
+        emit logMessage(QString("Client %1: receive memory limit (%2 MB) reached, disconnecting")
+                        .arg(client_id).arg(receive_pool_.limit() / (1024 * 1024)));
+        DeviceTransport::of(socket)->abortConnection(socket);
+        return;
+    }
+
+    if (inflater != inflaters_.constEnd()) {
+        buffer.append(inflated.constData(), inflated.size());
+    } else {
+        const int offset = buffer.size();
+        buffer.resize(offset + int(incoming));
+        const qint64 read = socket->read(buffer.data() + offset, incoming);
+        buffer.resize(offset + int(qMax<qint64>(0, read)));
+        ServerMetrics::increment(Counter::BytesIn, quint64(qMax<qint64>(0, read)));
+    }
+
+    // Обрабатываем полные сообщения (разделенные переносом строки).
+    // Кадры читаются на месте, разобранное начало буфера отбрасывает
+    // settle() один раз за чтение
+    qsizetype consumed = 0;
+    forever {
+        const QByteArray &pending = receive_buffers_[socket];
+        const qsizetype delimiter_pos = pending.indexOf(kMessageDelimiter, consumed);
+        if (delimiter_pos < 0) {
+            break;
+        }
+        // Без копии; действителен, пока буфер приема не изменен
+        const QByteArray frame = QByteArray::fromRawData(pending.constData() + consumed,
+                                                         delimiter_pos - consumed);
+        consumed = delimiter_pos + 1;
+
+        if (frame.isEmpty()) {
+            continue;
+        }
+
+        // Первая строка соединения может быть Hello. Служебные строки
+        // редки и обрабатываются на своей копии: их обработка может
+        // закрыть соединение вместе с буфером
+        if (awaiting_hello_.contains(socket)) {
+            const QByteArray message(frame.constData(), frame.size());
+            const bool consumed_hello = handleHello(socket, message);
+            if (!clients_.contains(socket)) {
+                break;      // Перенаправлен на другой узел
+            }
+            client_id = clients_[socket].id;
+            if (consumed_hello) {
+                continue;
+            }
+        }
 
-    // Обрабатываем полные сообщения (разделенные переносом строки)
-    while (receive_buffers_[socket].contains(kMessageDelimiter)) {
-        int delimiter_pos = receive_buffers_[socket].indexOf(kMessageDelimiter);
-        QByteArray message = receive_buffers_[socket].left(delimiter_pos);
-        receive_buffers_[socket].remove(0, delimiter_pos + 1);
+        if (relay_links_.contains(socket) || frame.startsWith(kRelayHelloPrefix)) {
+            handleRelayMessage(socket, QByteArray(frame.constData(), frame.size()));
+            continue;
+        }
 
-        if (!message.isEmpty()) {
-            processClientData(client_id, message);
+        // Остаток буфера — уже начало сжатого потока
+        if (isCompressRequest(frame) && !inflaters_.contains(socket)) {
+            if (!compression_) {
+                emit logMessage(QString("Client %1: compression was not offered, disconnecting")
+                                .arg(client_id));
+                DeviceTransport::of(socket)->abortConnection(socket);
+                return;
+            }
+            QSharedPointer<StreamCodec::Inflater> stream(new StreamCodec::Inflater);
+            QByteArray &compressed = receive_buffers_[socket];
+            QByteArray plain;
+            const StreamCodec::Inflater::Status inflated_rest =
+                inflate(stream.data(), compressed.constData() + consumed,
+                        compressed.size() - consumed, &plain, kMaxBufferSize);
+            receive_pool_.release(&compressed);
+            consumed = 0;
+            if (inflated_rest != StreamCodec::Inflater::Ok
+                || !receive_pool_.reserve(&compressed, plain.size())) {
+                emit logMessage(QString("Client %1: corrupt compressed stream, disconnecting")
+                                .arg(client_id));
+                DeviceTransport::of(socket)->abortConnection(socket);
+                return;
+            }
+            compressed.append(plain.constData(), plain.size());
+            inflaters_.insert(socket, stream);
+            continue;
         }
+
+        if (isPing(frame)) {
+            sendToClient(socket, pong(frame));
+            continue;
+        }
+
+        submitFrame(client_id, QDateTime::currentMSecsSinceEpoch(), frame);
+    }
+
+    // Остаток — незавершенный кадр или ничего
+    auto rest = receive_buffers_.find(socket);
+    if (rest != receive_buffers_.end()) {
+        receive_pool_.settle(&rest.value(), consumed);
     }
 }
 
-void TcpServer::onSocketError(QAbstractSocket::SocketError error)
+void TcpServer::submitFrame(int client_id, qint64 received_ms, const QByteArray &message)
 {
-    Q_UNUSED(error);
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket) {
+    // Журнал и конвейер видят только полные кадры: восстановление зависит
+    // от порядка кадров клиента и поэтому делается здесь, в потоке приема
+    if (message.startsWith(DeltaCodec::kPrefix)) {
+        auto decoder = delta_decoders_.find(client_id);
+        if (decoder == delta_decoders_.end()) {
+            decoder = delta_decoders_.insert(client_id, QSharedPointer<DeltaCodec::Decoder>::create());
+        }
+        const QJsonObject sample = (*decoder)->decode(QJsonDocument::fromJson(message).object());
+        if (sample.isEmpty()) {
+            ServerMetrics::increment(Counter::ParseErrors);
+            return;
+        }
+        // Конвейер получает готовый объект, без повторного разбора; байты
+        // нужны только журналу, и то лишь когда он включен
+        if (wal_) {
+            wal_->append(client_id, received_ms, QJsonDocument(sample).toJson(QJsonDocument::Compact));
+        }
+        pipeline_->submitDecoded(client_id, received_ms, sample);
         return;
     }
 
-    emit logMessage(QString("Socket error: %1").arg(socket->errorString()));
+    // Кадр попадает в журнал до разбора, чтобы пережить сбой. Кадр может
+    // ссылаться на буфер приема, а журнал хранит его до записи — нужна копия.
+    // Отказавший журнал (append() == false) прием не останавливает: кадр
+    // идет в конвейер, потеря видна по WalDropped и в логе
+    if (wal_) {
+        wal_->append(client_id, received_ms, QByteArray(message.constData(), message.size()));
+    }
+    pipeline_->submit(client_id, received_ms, message);
+}
+
+bool TcpServer::isPing(const QByteArray &message)
+{
+    return message.startsWith(kPingPrefix);
+}
+
+bool TcpServer::isCompressRequest(const QByteArray &message)
+{
+    return message.startsWith(StreamCodec::kCompressPrefix);
+}
+
+StreamCodec::Inflater::Status TcpServer::inflate(StreamCodec::Inflater *inflater, const char *data,
+                                                 qint64 size, QByteArray *out, qint64 max_size)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 before = out->size();
+    const StreamCodec::Inflater::Status status = inflater->decompress(data, size, out, max_size);
+    ServerMetrics::increment(Counter::InflateMicroseconds, quint64(timer.nsecsElapsed() / 1000));
+    ServerMetrics::increment(Counter::CompressedBytesIn, quint64(size));
+    ServerMetrics::increment(Counter::InflatedBytes, quint64(out->size() - before));
+    if (status == StreamCodec::Inflater::TooLarge) {
+        ServerMetrics::increment(Counter::BufferOverflows);
+    }
+    return status;
+}
+
+bool TcpServer::isRelayHello(const QByteArray &message)
+{
+    return message.startsWith(kRelayHelloPrefix);
 }
 
-void TcpServer::sendToClient(QTcpSocket *socket, const QJsonObject &message)
+QJsonObject TcpServer::pong(const QByteArray &ping)
 {
-    if (!socket || socket->state() != QAbstractSocket::ConnectedState) {
+    // Ответ минует конвейер: задержка — только транспорт и разбиение
+    QJsonObject pong = QJsonDocument::fromJson(ping).object();
+    pong["type"] = "Pong";
+    return pong;
+}
+
+void TcpServer::onSocketError(QIODevice *socket, const QString &message)
+{
+    Q_UNUSED(socket);
+    emit logMessage(QString("Socket error: %1").arg(message));
+}
+
+void TcpServer::sendToClient(QIODevice *socket, const QJsonObject &message)
+{
+    if (!socket || !DeviceTransport::of(socket)->isConnected(socket)) {
         return;
     }
 
-    QJsonDocument doc(message);
-    QByteArray data = doc.toJson(QJsonDocument::Compact);
-    data.append(kMessageDelimiter);
+    // Устройство давно не читает: память сервера на него ограничена,
+    // а соединение закроет checkSlowConsumers()
+    if (socket->bytesToWrite() > kMaxSendBuffer) {
+        ServerMetrics::increment(Counter::SendDropped);
+        return;
+    }
 
+    const QByteArray data = encodeMessage(message);
     qint64 bytes_written = socket->write(data);
+    if (bytes_written > 0) {
+        ServerMetrics::increment(Counter::BytesOut, bytes_written);
+    }
     if (bytes_written == -1) {
         emit logMessage(QString("Write error: %1").arg(socket->errorString()));
     } else if (bytes_written != data.size()) {
@@ -259,84 +906,241 @@ void TcpServer::sendToClient(QTcpSocket *socket, const QJsonObject &message)
     }
 }
 
-void TcpServer::processClientData(int client_id, const QByteArray &data)
+void TcpServer::sendCommand(QIODevice *socket, const QString &key, const QJsonObject &command)
 {
-    QJsonParseError parse_error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &parse_error);
-
-    if (parse_error.error != QJsonParseError::NoError) {
-        emit logMessage(QString("JSON parse error from client %1: %2")
-                        .arg(client_id)
-                        .arg(parse_error.errorString()));
-        return;
+    // Пока есть отложенные команды, новые встают за ними
+    auto deferred = deferred_commands_.find(socket);
+    if (deferred == deferred_commands_.end()) {
+        if (socket->bytesToWrite() < kSendHighWater) {
+            sendToClient(socket, command);
+            return;
+        }
+        deferred = deferred_commands_.insert(socket, QMap<QString, QJsonObject>());
     }
-
-    if (!doc.isObject()) {
-        emit logMessage(QString("Invalid JSON from client %1: not an object")
-                        .arg(client_id));
-        return;
+    if (deferred->contains(key)) {
+        ServerMetrics::increment(Counter::CommandsCoalesced);
     }
+    deferred->insert(key, command);
+}
 
-    QJsonObject obj = doc.object();
-    QString type = obj["type"].toString();
-
-    // Create data structure
-    ClientData client_data;
-    client_data.client_id = client_id;
-    client_data.data_type = type;
-    client_data.content = obj;
-    client_data.timestamp = QDateTime::currentDateTime();
+void TcpServer::checkSlowConsumers()
+{
+    for (auto it = deferred_commands_.begin(); it != deferred_commands_.end();) {
+        QIODevice *socket = it.key();
+        if (socket->bytesToWrite() >= kSendHighWater) {
+            ++it;
+            continue;
+        }
+        const QMap<QString, QJsonObject> commands = it.value();
+        it = deferred_commands_.erase(it);
+        for (const QJsonObject &command : commands) {
+            sendToClient(socket, command);
+        }
+    }
 
-    emit dataReceived(client_data);
+    const qint64 now_ms = QDateTime::currentMSecsSinceEpoch();
+    QList<QIODevice*> evicted;
+    for (auto it = clients_.cbegin(); it != clients_.cend(); ++it) {
+        QIODevice *socket = it.key();
+        if (socket->bytesToWrite() <= kMaxSendBuffer) {
+            over_limit_since_ms_.remove(socket);
+            continue;
+        }
+        const qint64 since_ms = over_limit_since_ms_.value(socket, now_ms);
+        over_limit_since_ms_.insert(socket, since_ms);
+        if (now_ms - since_ms >= kSlowConsumerGraceMs) {
+            evicted.append(socket);
+        }
+    }
 
-    // Check thresholds for warnings
-    checkThresholds(client_id, obj);
+    // Закрытие синхронно вызывает onClientDisconnected, который меняет clients_
+    for (QIODevice *socket : std::as_const(evicted)) {
+        ServerMetrics::increment(Counter::SlowConsumerEvictions);
+        emit logMessage(QString("Client %1: not reading, %2 bytes pending, disconnecting")
+                        .arg(clients_.value(socket).id).arg(socket->bytesToWrite()));
+        DeviceTransport::of(socket)->abortConnection(socket);
+    }
 }
 
-void TcpServer::checkThresholds(int client_id, const QJsonObject &data)
+QByteArray TcpServer::encodeMessage(const QJsonObject &message)
 {
-    // Получаем копию настроек потокобезопасно
-    ThresholdConfig config = getThresholds();
+    // Кодируют поток сервера, приемщики и бэкенды — у каждого свой буфер
+    static thread_local FrameBuilder builder(kMessageDelimiter);
+    return builder.build(message);
+}
 
-    QString type = data["type"].toString();
-    QStringList warnings;
+void TcpServer::handleRelayMessage(QIODevice *socket, const QByteArray &message)
+{
+    auto link = relay_links_.find(socket);
+    if (link == relay_links_.end()) {
+        // RelayHello: подключение становится связью ретранслятора и
+        // пропадает из списка клиентов, вместо него появятся устройства
+        relay_links_.insert(socket, RelayLink());
+        clients_[socket].is_running = false;
+        emit clientDisconnected(clients_[socket].id);
+        emit logMessage(QString("Client %1 is a relay link").arg(clients_[socket].id));
+        return;
+    }
 
-    if (type == "NetworkMetrics") {
-        if (data.contains("latency")) {
-            double latency = data["latency"].toDouble();
-            if (latency > config.max_latency) {
-                warnings << QString("High latency: %1ms").arg(latency);
-            }
-        }
-        if (data.contains("packet_loss")) {
-            double packet_loss = data["packet_loss"].toDouble();
-            if (packet_loss > config.max_packet_loss) {
-                warnings << QString("High packet loss: %1%").arg(packet_loss);
-            }
+    // Кадры пачки идут без изменений, как от самих устройств
+    if (link->next_frame < link->frames.size()) {
+        const QPair<int, qint64> frame = link->frames[link->next_frame++];
+        const int client_id = link->devices.value(frame.first);
+        if (client_id == 0) {
+            // Устройство не объявлено или уже отключено: новый клиент без
+            // адреса некому было бы удалить
+            ServerMetrics::increment(Counter::RelayOrphanFrames);
+            return;
         }
-    } else if (type == "DeviceStatus") {
-        if (data.contains("cpu_usage")) {
-            int cpu_usage = data["cpu_usage"].toInt();
-            if (cpu_usage > config.max_cpu_usage) {
-                warnings << QString("High CPU usage: %1%").arg(cpu_usage);
-            }
+        submitFrame(client_id, frame.second, message);
+        return;
+    }
+
+    const QJsonObject header = QJsonDocument::fromJson(message).object();
+    const QString type = header["type"].toString();
+    if (type == "RelayBatch") {
+        const QJsonArray frames = header["frames"].toArray();
+        link->frames.clear();
+        link->frames.reserve(frames.size());
+        for (const QJsonValue &frame : frames) {
+            const QJsonArray pair = frame.toArray();
+            link->frames.append(qMakePair(pair.at(0).toInt(),
+                                          static_cast<qint64>(pair.at(1).toDouble())));
         }
-        if (data.contains("memory_usage")) {
-            int memory_usage = data["memory_usage"].toInt();
-            if (memory_usage > config.max_memory_usage) {
-                warnings << QString("High memory usage: %1%").arg(memory_usage);
+        link->next_frame = 0;
+    } else if (type == "RelayDevice") {
+        const int device = header["device"].toInt();
+        if (header["event"].toString() == "connected") {
+            if (!link->devices.contains(device)) {
+                registerRelayedDevice(socket, device, header["address"].toString(),
+                                      static_cast<quint16>(header["port"].toInt()));
             }
+        } else if (link->devices.contains(device)) {
+            unregisterRelayedDevice(link->devices.value(device));
         }
+    } else {
+        ServerMetrics::increment(Counter::ParseErrors);
+        emit logMessage(QString("Relay link %1: unexpected message").arg(clients_[socket].id));
     }
+}
+
+int TcpServer::registerRelayedDevice(QIODevice *socket, int device,
+                                     const QString &address, quint16 port)
+{
+    const ClientInfo info = createClient(
+        address.isEmpty() ? DeviceTransport::of(socket)->peerAddress(socket) : address, port);
+
+    relay_links_[socket].devices.insert(device, info.id);
+    relayed_clients_.insert(info.id, {socket, device, false});
+    updateConnectionGauge();
+
+    emit clientConnected(info);
+    emit logMessage(QString("Client %1 connected via relay %2 (device %3)")
+                    .arg(info.id)
+                    .arg(clients_[socket].id)
+                    .arg(device));
+    return info.id;
+}
 
-    // Логируем предупреждения
-    for (const QString &warning : warnings) {
-        emit logMessage(QString("WARNING [Client %1]: %2")
-                        .arg(client_id).arg(warning));
+void TcpServer::unregisterRelayedDevice(int client_id)
+{
+    auto relayed = relayed_clients_.find(client_id);
+    if (relayed == relayed_clients_.end()) {
+        return;
     }
+
+    relay_links_[relayed->link].devices.remove(relayed->device);
+    relayed_clients_.erase(relayed);
+    touchRegistry(client_id);
+    updateConnectionGauge();
+
+    emit clientDisconnected(client_id);
+    emit logMessage(QString("Client %1 disconnected").arg(client_id));
+}
+
+int TcpServer::attachNativeClient(const QString &address, quint16 port, const QString &device_id)
+{
+    const ClientInfo info = createClient(address, port);
+    native_clients_.insert(info.id, false);
+    updateConnectionGauge();
+
+    emit clientConnected(info);
+    emit logMessage(QString("Client %1 connected from %2:%3%4")
+                    .arg(info.id)
+                    .arg(info.ip_address)
+                    .arg(info.port)
+                    .arg(device_id.isEmpty() ? QString() : " as " + device_id));
+    return info.id;
+}
+
+void TcpServer::detachNativeClient(int client_id)
+{
+    native_clients_.remove(client_id);
+    delta_decoders_.remove(client_id);
+    touchRegistry(client_id);
+    updateConnectionGauge();
+
+    emit clientDisconnected(client_id);
+    emit logMessage(QString("Client %1 disconnected").arg(client_id));
+}
+
+void TcpServer::updateConnectionGauge()
+{
+    // Связи ретрансляторов не считаются, их устройства — считаются
+    ServerMetrics::setGauge(Gauge::ConnectionsActive,
+                            clients_.size() - relay_links_.size() + relayed_clients_.size()
+                            + native_clients_.size());
 }
 
 int TcpServer::generateClientId()
 {
     return next_client_id_++;
 }
+
+void TcpServer::onHealthTimer()
+{
+    // Задержка срабатывания таймера — время, которое поток был занят
+    qint64 lag_ms = health_clock_.restart() - kHealthIntervalMs;
+    max_loop_lag_ms_ = qMax(max_loop_lag_ms_, lag_ms);
+
+    if (++health_ticks_ < kHealthTicksPerPublish) {
+        return;
+    }
+
+    ServerMetrics::setGauge(Gauge::EventLoopLagMs, max_loop_lag_ms_);
+    checkSlowConsumers();
+    publishBufferGauges();
+    max_loop_lag_ms_ = 0;
+    health_ticks_ = 0;
+}
+
+void TcpServer::publishBufferGauges()
+{
+    qint64 buffered = 0;
+    for (const QByteArray &buffer : std::as_const(receive_buffers_)) {
+        buffered += buffer.size();
+    }
+
+    qint64 queued = 0;
+    for (auto it = clients_.cbegin(); it != clients_.cend(); ++it) {
+        queued += it.key()->bytesToWrite();
+    }
+
+    if (native_) {
+        buffered += native_->bufferedBytes();
+        queued += native_->queuedBytes();
+    }
+
+    // Прирост памяти процесса с запуска приема на одно соединение: для
+    // простаивающих устройств это и есть стоимость соединения в бэкенде
+    const qint64 connections = ServerMetrics::instance().gaugeValue(Gauge::ConnectionsActive);
+    const qint64 grown = qMax<qint64>(0, residentBytes() - baseline_resident_bytes_);
+    ServerMetrics::setGauge(Gauge::MemoryPerConnection,
+                            connections > 0 && baseline_resident_bytes_ > 0 ? grown / connections : 0);
+
+    ServerMetrics::setGauge(Gauge::ReceiveBufferedBytes, buffered);
+    ServerMetrics::setGauge(Gauge::ReceiveBufferCapacity, receive_pool_.grantedBytes());
+    ServerMetrics::setGauge(Gauge::ReceiveBufferLimit, receive_pool_.limit());
+    ServerMetrics::setGauge(Gauge::SendQueuedBytes, queued);
+    pipeline_->publishGauges();
+}
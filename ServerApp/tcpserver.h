@@ -2,12 +2,38 @@
 #define TCPSERVER_H
 
 #include <QObject>
-#include <QTcpServer>
-#include <QTcpSocket>
+#include <QIODevice>
 #include <QMap>
 #include <QDateTime>
 #include <QJsonObject>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVector>
+
+#include <atomic>
+
+#include "receivebufferpool.h"
+#include "streamcodec.h"
+
+class AcceptorPool;
+class ClusterRing;
+class DeviceTransport;
+class IngestPipeline;
+class LocalTransport;
+class NativeBackend;
+class ShmTransport;
+struct PipelineConfig;
+class TcpTransport;
+class TelemetryStore;
+class WriteAheadLog;
+
+namespace DeltaCodec {
+class Decoder;
+}
 
 // Structure to hold client information
 struct ClientInfo {
@@ -24,6 +50,15 @@ struct ClientData {
     QString data_type;  // "NetworkMetrics", "DeviceStatus", "Log"
     QJsonObject content;
     QDateTime timestamp;
+    QByteArray frame;   // Исходный кадр, только с PipelineConfig::keep_frames
+};
+
+// Entry of the client registry kept across restarts (snapshot)
+struct ClientRecord {
+    int id;
+    QString ip_address;
+    quint16 port;
+    qint64 last_seen_ms;
 };
 
 // Структура настроек пороговых значений
@@ -34,6 +69,13 @@ struct ThresholdConfig {
     int max_memory_usage = 90;
 };
 
+// Реализация приема TCP-подключений устройств
+enum class IngestBackend {
+    Qt,      // QTcpServer/QTcpSocket
+    Epoll,   // Неблокирующие сокеты и epoll без объекта на соединение (Linux)
+    Uring    // io_uring: multishot accept/recv, пул буферов (Linux 6.0+, экспериментально)
+};
+
 // Регистрация метатипов для передачи через сигналы между потоками
 Q_DECLARE_METATYPE(ClientInfo)
 Q_DECLARE_METATYPE(ClientData)
@@ -53,6 +95,48 @@ public:
     void setThresholds(const ThresholdConfig &config);
     ThresholdConfig getThresholds() const;
 
+    // Хранилище агрегатов для запросов (не владеет), задается до запуска потока
+    void setTelemetryStore(TelemetryStore *store);
+
+    // Параметры конвейера обработки, задаются до запуска сервера
+    void configurePipeline(const PipelineConfig &config);
+    IngestPipeline *pipeline() const;
+
+    // Журнал предзаписи принятых кадров (не владеет), задается до запуска потока
+    void setWriteAheadLog(WriteAheadLog *wal);
+
+    // Членство в кластере (не владеет), задается до запуска потока.
+    // Клиент подтверждается после Hello с device_id или перенаправляется
+    // на узел-владелец устройства
+    void setCluster(const ClusterRing *cluster);
+
+    // Дополнительный локальный сокет (QLocalServer) для эмуляторов и агентов
+    // на том же хосте; протокол тот же, что и по TCP. Задается до запуска
+    void setLocalName(const QString &name);
+    // Кольца в общей памяти для высокочастотных эмуляторов на этом хосте
+    // (подключение через локальный сокет NAME). Задается до запуска
+    void setRingName(const QString &name);
+
+    // Прием TCP через Qt (по умолчанию), epoll или io_uring; задается до
+    // запуска. Если ядро не поддерживает выбранный, берется следующий:
+    // io_uring -> epoll -> Qt
+    void setIngestBackend(IngestBackend backend);
+    // Число сокетов SO_REUSEPORT с приемом в отдельных потоках (Qt, Linux);
+    // 1 — один QTcpServer в потоке сервера. Задается до запуска
+    void setAcceptorCount(int acceptors);
+    // Предлагать устройствам сжатие потока (deflate) в ConnectionConfirm;
+    // задается до запуска
+    void setCompression(bool offer);
+    // Общий предел памяти буферов приема всех соединений Qt; соединение,
+    // которому не хватило, закрывается как при переполнении
+    void setReceiveMemoryLimit(qint64 bytes);
+
+    // Реестр клиентов для снимка состояния (потокобезопасно)
+    QVector<ClientRecord> clientRegistry() const;
+    int nextClientId() const;
+    // Восстановление из снимка, до запуска сервера
+    void restoreRegistry(int next_client_id, const QVector<ClientRecord> &clients);
+
 public slots:
     // Server control
     bool startServer(quint16 port = 12345);
@@ -74,8 +158,8 @@ signals:
     // Emitted when client status changes (start/stop)
     void clientStatusChanged(int client_id, bool is_running);
 
-    // Emitted when data is received from a client
-    void dataReceived(const ClientData &data);
+    // Emitted for each batch of records received from clients
+    void dataReceived(const QVector<ClientData> &batch);
 
     // Emitted for log messages
     void logMessage(const QString &message);
@@ -85,36 +169,150 @@ signals:
     void serverStopped();
 
 private slots:
-    void onNewConnection();
-    void onClientDisconnected();
+    void onNewConnection(QIODevice *socket);
+    void onClientDisconnected(QIODevice *socket);
     void onReadyRead();
-    void onSocketError(QAbstractSocket::SocketError error);
+    void onSocketError(QIODevice *socket, const QString &message);
+    void onHealthTimer();
+    void onAccepted(qintptr descriptor, const ClientInfo &info);
 
 private:
-    // Send JSON message to a specific client
-    void sendToClient(QTcpSocket *socket, const QJsonObject &message);
+    // New client id with its registry entry (any transport or backend)
+    ClientInfo createClient(const QString &address, quint16 port);
+    // Remember when a client was last connected
+    void touchRegistry(int client_id);
+    QJsonObject confirmation(int client_id) const;
+
+    // Accept a connection as a client of this node
+    void confirmClient(QIODevice *socket, const QString &device_id);
+    // Store a confirmed client and announce it
+    void registerClient(QIODevice *socket, const ClientInfo &info, const QString &device_id);
+    // Cluster placement of a device; false if it belongs to another node
+    // (redirect is filled with the ConnectionConfirm to send)
+    bool routeDevice(const QString &device_id, QJsonObject *redirect);
+    // Write-ahead log, then the processing pipeline; delta frames are
+    // expanded to full samples first. message may be a view of a receive
+    // buffer, it is copied where kept
+    void submitFrame(int client_id, qint64 received_ms, const QByteArray &message);
+    static bool isPing(const QByteArray &message);
+    static bool isRelayHello(const QByteArray &message);
+    static QJsonObject pong(const QByteArray &ping);
+    static bool isCompressRequest(const QByteArray &message);
+    // Decompress a chunk of a compressed stream into at most max_size bytes
+    // of out, with metrics
+    static StreamCodec::Inflater::Status inflate(StreamCodec::Inflater *inflater, const char *data,
+                                                 qint64 size, QByteArray *out, qint64 max_size);
+    // First line of a connection; true if it was Hello and is consumed
+    bool handleHello(QIODevice *socket, const QByteArray &message);
+
+    // Подключение ретранслятора (relay): устройства за ним видны серверу
+    // как обычные клиенты со своими client_id
+    struct RelayLink {
+        QHash<int, int> devices;             // Локальный id устройства -> client_id
+        QVector<QPair<int, qint64>> frames;  // Устройство и время кадров текущей пачки
+        int next_frame = 0;
+    };
 
-    // Process received JSON data
-    void processClientData(int client_id, const QByteArray &data);
+    struct RelayedClient {
+        QIODevice *link;
+        int device;
+        bool is_running;
+    };
 
-    // Check if data exceeds thresholds and generate warning
-    void checkThresholds(int client_id, const QJsonObject &data);
+    // Служебные строки и кадры пачек подключения ретранслятора
+    void handleRelayMessage(QIODevice *socket, const QByteArray &message);
+    int registerRelayedDevice(QIODevice *socket, int device,
+                              const QString &address, quint16 port);
+    void unregisterRelayedDevice(int client_id);
+    // Command start/stop to a direct or relayed client; false if unknown
+    bool setClientRunning(int client_id, bool running);
+    void updateConnectionGauge();
+
+    // Клиенты бэкендов epoll и io_uring: соединения вне Qt, сессия общая
+    friend class NativeBackend;
+    int attachNativeClient(const QString &address, quint16 port, const QString &device_id);
+    void detachNativeClient(int client_id);
+
+    // Send JSON message to a specific client; dropped if its send buffer
+    // is over kMaxSendBuffer
+    void sendToClient(QIODevice *socket, const QJsonObject &message);
+    // Idempotent command: above kSendHighWater only the latest one per key
+    // is kept until the device reads its socket again
+    void sendCommand(QIODevice *socket, const QString &key, const QJsonObject &command);
+    // Flush deferred commands, evict connections stuck over the limit
+    void checkSlowConsumers();
+    // Frame with the delimiter; shares a per-thread buffer (see framebuilder.h)
+    static QByteArray encodeMessage(const QJsonObject &message);
 
     // Generate unique client ID
     int generateClientId();
 
-    QTcpServer *server_;
-    QMap<QTcpSocket*, ClientInfo> clients_;
-    QMap<int, QTcpSocket*> client_sockets_;  // Reverse lookup by ID
-    int next_client_id_;
-    QMap<QTcpSocket*, QByteArray> receive_buffers_;  // Buffer for incomplete messages
+    // Update buffer gauges of ServerMetrics
+    void publishBufferGauges();
+
+    // Потоки-приемщики создают клиентов и отправляют подтверждение сами
+    friend class AcceptorPool;
+
+    // Слушатели устройств; соединения любого транспорта обрабатываются одинаково
+    void watchTransport(DeviceTransport *transport);
+
+    TcpTransport *tcp_;
+    LocalTransport *local_;
+    QString local_name_;
+    ShmTransport *ring_;
+    QString ring_name_;
+    QMap<QIODevice*, ClientInfo> clients_;
+    QMap<int, QIODevice*> client_sockets_;  // Reverse lookup by ID
+    std::atomic<int> next_client_id_;   // Читается потоком снимков
+
+    // Все известные клиенты, включая отключившихся
+    mutable QMutex registry_mutex_;
+    QHash<int, ClientRecord> registry_;
+    QMap<QIODevice*, QByteArray> receive_buffers_;  // Buffer for incomplete messages
+    ReceiveBufferPool receive_pool_;                 // Емкость receive_buffers_
+
+    // Соединения, первая строка которых еще не получена
+    QSet<QIODevice*> awaiting_hello_;
+    // Соединения, перешедшие на сжатый поток
+    QHash<QIODevice*, QSharedPointer<StreamCodec::Inflater>> inflaters_;
+    bool compression_;
+    // Восстановление кадров разностей, по client_id (см. deltacodec.h)
+    QHash<int, QSharedPointer<DeltaCodec::Decoder>> delta_decoders_;
+    const ClusterRing *cluster_;
+
+    QHash<QIODevice*, RelayLink> relay_links_;
+    QHash<int, RelayedClient> relayed_clients_;
+
+    AcceptorPool *acceptors_;
+    NativeBackend *native_;
+    QHash<int, bool> native_clients_;   // client_id -> is_running
+    qint64 baseline_resident_bytes_;    // Память процесса при запуске приема
+
+    // Разбор, проверка порогов и доставка приемникам выполняются в
+    // потоках конвейера; в потоке приема остаются только чтение и разбиение
+    IngestPipeline *pipeline_;
+    WriteAheadLog *wal_;
+
+    // Измерение задержки цикла событий потока приема
+    QTimer *health_timer_;
+    QElapsedTimer health_clock_;
+    qint64 max_loop_lag_ms_;
+    int health_ticks_;
 
-    // Потокобезопасный доступ к настройкам
-    mutable QMutex thresholds_mutex_;
-    ThresholdConfig thresholds_;
+    // Устройства, которые не читают свой сокет: команды ждут здесь
+    // (ключ -> последняя команда), а не в буфере сокета
+    QHash<QIODevice*, QMap<QString, QJsonObject>> deferred_commands_;
+    QHash<QIODevice*, qint64> over_limit_since_ms_;
 
     // Максимальный размер буфера приема (защита от переполнения)
     static constexpr int kMaxBufferSize = 1024 * 1024;  // 1 MB
+    static constexpr qint64 kDefaultReceiveMemory = 256 * 1024 * 1024;
+    // Буфер отправки соединения: выше порога команды откладываются,
+    // выше предела ответы отбрасываются, а соединение, не опустившееся
+    // ниже предела за kSlowConsumerGraceMs, закрывается
+    static constexpr qint64 kSendHighWater = 64 * 1024;
+    static constexpr qint64 kMaxSendBuffer = 1024 * 1024;
+    static constexpr qint64 kSlowConsumerGraceMs = 10000;
 };
 
 #endif // TCPSERVER_H
@@ -0,0 +1,290 @@
+#include "telemetrystore.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <iterator>
+
+#include "tcpserver.h"
+
+namespace {
+constexpr qint64 kMsPerMinute = 60 * 1000;
+constexpr qint64 kMsPerHour = 60 * kMsPerMinute;
+
+// Описание метрики: имя (ключ JSON) и тип сообщения, в котором она приходит
+struct MetricDescriptor {
+    TelemetryMetric metric;
+    const char *name;
+    const char *data_type;
+};
+
+const MetricDescriptor kMetrics[kTelemetryMetricCount] = {
+    {TelemetryMetric::Bandwidth, "bandwidth", "NetworkMetrics"},
+    {TelemetryMetric::Latency, "latency", "NetworkMetrics"},
+    {TelemetryMetric::PacketLoss, "packet_loss", "NetworkMetrics"},
+    {TelemetryMetric::Uptime, "uptime", "DeviceStatus"},
+    {TelemetryMetric::CpuUsage, "cpu_usage", "DeviceStatus"},
+    {TelemetryMetric::MemoryUsage, "memory_usage", "DeviceStatus"},
+};
+
+const char *kAggregationNames[] = {"avg", "min", "max", "sum", "count"};
+
+// Отсчет, скопированный из хранилища для агрегации вне блокировки
+struct CopiedBucket {
+    int client_id;
+    qint64 key;
+    RollupBucket value;
+};
+}  // namespace
+
+void RollupBucket::add(double value)
+{
+    if (count == 0) {
+        min = value;
+        max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    sum += value;
+    ++count;
+}
+
+void RollupBucket::merge(const RollupBucket &other)
+{
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+}
+
+double RollupBucket::value(Aggregation aggregation) const
+{
+    switch (aggregation) {
+        case Aggregation::Avg:
+            return count > 0 ? sum / count : 0.0;
+        case Aggregation::Min:
+            return min;
+        case Aggregation::Max:
+            return max;
+        case Aggregation::Sum:
+            return sum;
+        case Aggregation::Count:
+            return static_cast<double>(count);
+    }
+    return 0.0;
+}
+
+TelemetryStore::TelemetryStore(int retention_minutes, int retention_hours)
+    : retention_minutes_(retention_minutes),
+      retention_hours_(retention_hours)
+{
+}
+
+void TelemetryStore::append(const ClientData &data)
+{
+    const qint64 timestamp_ms = data.timestamp.toMSecsSinceEpoch();
+    const qint64 minute = timestamp_ms / kMsPerMinute;
+    const qint64 hour = timestamp_ms / kMsPerHour;
+
+    Shard &shard = shardFor(data.client_id);
+    QMutexLocker locker(&shard.mutex);
+    ClientSeries *series = nullptr;
+
+    for (const MetricDescriptor &descriptor : kMetrics) {
+        if (data.data_type != QLatin1String(descriptor.data_type)) {
+            continue;
+        }
+        const QJsonValue value = data.content.value(QLatin1String(descriptor.name));
+        if (!value.isDouble()) {
+            continue;
+        }
+        if (!series) {
+            series = &shard.clients[data.client_id];
+        }
+        const int metric = static_cast<int>(descriptor.metric);
+        addSample(series->minutes[metric], minute, value.toDouble(), retention_minutes_);
+        addSample(series->hours[metric], hour, value.toDouble(), retention_hours_);
+    }
+}
+
+QVector<QueryPoint> TelemetryStore::query(const TelemetryQuery &query) const
+{
+    // Корзины, кратные часу, собираются из часового уровня
+    const bool hourly = query.bucket_seconds % 3600 == 0;
+    const qint64 unit_ms = hourly ? kMsPerHour : kMsPerMinute;
+    const qint64 from_key = query.from_ms / unit_ms;
+    const qint64 to_key = query.to_ms / unit_ms;
+    const int metric_index = static_cast<int>(query.metric);
+
+    // Копируем нужный диапазон по одному шарду, удерживая его мьютекс
+    // только на время копирования
+    QVector<CopiedBucket> copied;
+    for (const Shard &shard : shards_) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto client = shard.clients.cbegin(); client != shard.clients.cend(); ++client) {
+            if (client.key() < query.first_client || client.key() > query.last_client) {
+                continue;
+            }
+            const ClientSeries &client_series = client.value();
+            const Series &series = hourly ? client_series.hours[metric_index]
+                                          : client_series.minutes[metric_index];
+            for (auto it = series.lowerBound(from_key);
+                 it != series.cend() && it.key() <= to_key; ++it) {
+                copied.append({client.key(), it.key(), it.value()});
+            }
+        }
+    }
+
+    // Агрегация по корзинам запроса (и, при необходимости, по клиентам)
+    const qint64 bucket_units = std::max<qint64>(1, query.bucket_seconds * 1000LL / unit_ms);
+    QMap<QPair<qint64, int>, RollupBucket> buckets;
+    for (const CopiedBucket &bucket : copied) {
+        const qint64 bucket_key = bucket.key - bucket.key % bucket_units;
+        const int client_id = query.group_by_client ? bucket.client_id : -1;
+        buckets[qMakePair(bucket_key, client_id)].merge(bucket.value);
+    }
+
+    QVector<QueryPoint> result;
+    result.reserve(buckets.size());
+    for (auto it = buckets.cbegin(); it != buckets.cend(); ++it) {
+        result.append({it.key().first * unit_ms, it.key().second, it.value()});
+    }
+    return result;
+}
+
+void TelemetryStore::exportRollups(const std::function<void(const RollupRecord &)> &visitor) const
+{
+    for (const Shard &shard : shards_) {
+        QHash<int, ClientSeries> clients;
+        {
+            QMutexLocker locker(&shard.mutex);
+            clients = shard.clients;
+        }
+
+        for (auto client = clients.cbegin(); client != clients.cend(); ++client) {
+            for (int metric = 0; metric < kTelemetryMetricCount; ++metric) {
+                auto visitSeries = [&](bool hourly, const Series &series) {
+                    for (auto it = series.cbegin(); it != series.cend(); ++it) {
+                        visitor({client.key(), static_cast<TelemetryMetric>(metric),
+                                 hourly, it.key(), it.value()});
+                    }
+                };
+                visitSeries(false, client->minutes[metric]);
+                visitSeries(true, client->hours[metric]);
+            }
+        }
+    }
+}
+
+void TelemetryStore::restoreRollups(const QVector<RollupRecord> &records)
+{
+    // Раскладываем по шардам, чтобы брать каждый мьютекс один раз
+    std::array<QVector<const RollupRecord*>, kShardCount> by_shard;
+    for (const RollupRecord &record : records) {
+        by_shard[static_cast<unsigned>(record.client_id) % kShardCount].append(&record);
+    }
+
+    for (int i = 0; i < kShardCount; ++i) {
+        if (by_shard[i].isEmpty()) {
+            continue;
+        }
+        Shard &shard = shards_[i];
+        QMutexLocker locker(&shard.mutex);
+        for (const RollupRecord *record : std::as_const(by_shard[i])) {
+            ClientSeries &series = shard.clients[record->client_id];
+            const int metric = static_cast<int>(record->metric);
+            Series &target = record->hourly ? series.hours[metric] : series.minutes[metric];
+            target[record->key].merge(record->value);
+        }
+    }
+}
+
+void TelemetryStore::expire(qint64 now_ms)
+{
+    const qint64 oldest_minute = now_ms / kMsPerMinute - retention_minutes_;
+    const qint64 oldest_hour = now_ms / kMsPerHour - retention_hours_;
+
+    // Шард блокируется только на время своего обхода
+    for (Shard &shard : shards_) {
+        QMutexLocker locker(&shard.mutex);
+        for (auto client = shard.clients.begin(); client != shard.clients.end();) {
+            bool empty = true;
+            for (int metric = 0; metric < kTelemetryMetricCount; ++metric) {
+                dropBefore(client->minutes[metric], oldest_minute);
+                dropBefore(client->hours[metric], oldest_hour);
+                empty = empty && client->minutes[metric].isEmpty() && client->hours[metric].isEmpty();
+            }
+            client = empty ? shard.clients.erase(client) : std::next(client);
+        }
+    }
+}
+
+int TelemetryStore::retentionMinutes() const
+{
+    return retention_minutes_;
+}
+
+int TelemetryStore::retentionHours() const
+{
+    return retention_hours_;
+}
+
+QString TelemetryStore::metricName(TelemetryMetric metric)
+{
+    return QString::fromLatin1(kMetrics[static_cast<int>(metric)].name);
+}
+
+bool TelemetryStore::metricFromName(const QString &name, TelemetryMetric *metric)
+{
+    for (const MetricDescriptor &descriptor : kMetrics) {
+        if (name == QLatin1String(descriptor.name)) {
+            *metric = descriptor.metric;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString TelemetryStore::aggregationName(Aggregation aggregation)
+{
+    return QString::fromLatin1(kAggregationNames[static_cast<int>(aggregation)]);
+}
+
+bool TelemetryStore::aggregationFromName(const QString &name, Aggregation *aggregation)
+{
+    for (int i = 0; i < static_cast<int>(std::size(kAggregationNames)); ++i) {
+        if (name == QLatin1String(kAggregationNames[i])) {
+            *aggregation = static_cast<Aggregation>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+TelemetryStore::Shard &TelemetryStore::shardFor(int client_id)
+{
+    return shards_[static_cast<unsigned>(client_id) % kShardCount];
+}
+
+void TelemetryStore::addSample(Series &series, qint64 key, double value, int retention)
+{
+    series[key].add(value);
+
+    // Удаляем корзины, вышедшие за окно хранения уровня
+    dropBefore(series, key - retention);
+}
+
+void TelemetryStore::dropBefore(Series &series, qint64 oldest_key)
+{
+    while (!series.isEmpty() && series.firstKey() < oldest_key) {
+        series.erase(series.begin());
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef TELEMETRYSTORE_H
+#define TELEMETRYSTORE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <array>
+#include <climits>
+#include <functional>
+
+struct ClientData;
+
+// Числовые поля телеметрии, по которым ведутся агрегаты
+enum class TelemetryMetric {
+    Bandwidth,
+    Latency,
+    PacketLoss,
+    Uptime,
+    CpuUsage,
+    MemoryUsage
+};
+
+constexpr int kTelemetryMetricCount = 6;
+
+// Агрегирующие функции, доступные в запросах
+enum class Aggregation {
+    Avg,
+    Min,
+    Max,
+    Sum,
+    Count
+};
+
+// Aggregate of all samples of one metric within one time bucket
+struct RollupBucket {
+    qint64 count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+
+    void add(double value);
+    void merge(const RollupBucket &other);
+    double value(Aggregation aggregation) const;
+};
+
+// One stored bucket, as exported to and restored from a snapshot
+struct RollupRecord {
+    int client_id;
+    TelemetryMetric metric;
+    bool hourly;                    // Уровень: часовой или минутный
+    qint64 key;                     // Номер минуты (часа) от эпохи
+    RollupBucket value;
+};
+
+// Query over stored rollups, e.g. "avg latency for clients 1-500,
+// 1-minute buckets, last 6h"
+struct TelemetryQuery {
+    TelemetryMetric metric = TelemetryMetric::Latency;
+    Aggregation aggregation = Aggregation::Avg;
+    int first_client = 1;
+    int last_client = INT_MAX;
+    qint64 from_ms = 0;
+    qint64 to_ms = 0;
+    int bucket_seconds = 60;        // Кратно минуте; кратные часу читаются из часового уровня
+    bool group_by_client = false;   // Отдельная серия на каждого клиента
+};
+
+// One row of a query result
+struct QueryPoint {
+    qint64 bucket_start_ms;
+    int client_id;                  // -1, если группировки по клиентам нет
+    RollupBucket value;
+};
+
+// In-memory store of rollups for every client and metric.
+//
+// Агрегаты ведутся на двух уровнях: минутном и часовом, у каждого свой
+// срок хранения. Запрос с корзиной, кратной часу, читается из часового
+// уровня и поэтому охватывает более длинный период.
+//
+// Данные разбиты на шарды по client_id, каждый со своим мьютексом: поток
+// приема блокирует только один шард на время добавления отсчета, а запрос
+// держит блокировку шарда лишь пока копирует нужный диапазон — агрегация
+// выполняется уже без блокировок, в потоке пула запросов.
+class TelemetryStore
+{
+public:
+    explicit TelemetryStore(int retention_minutes = 24 * 60, int retention_hours = 30 * 24);
+
+    // Add numeric fields of a received record to the rollups (thread-safe)
+    void append(const ClientData &data);
+
+    // Execute query (thread-safe, never holds a lock while aggregating)
+    QVector<QueryPoint> query(const TelemetryQuery &query) const;
+
+    // Visit every stored bucket (thread-safe). Шард блокируется только на
+    // время неглубокого копирования (implicit sharing), обход — без блокировок
+    void exportRollups(const std::function<void(const RollupRecord &)> &visitor) const;
+
+    // Merge buckets into the store (thread-safe), e.g. from a snapshot
+    void restoreRollups(const QVector<RollupRecord> &records);
+
+    // Drop buckets past retention and clients left without any
+    // (thread-safe). Иначе срок хранения соблюдается только при новом
+    // отсчете той же серии, а номера клиентов не переиспользуются
+    void expire(qint64 now_ms);
+
+    int retentionMinutes() const;
+    int retentionHours() const;
+
+    // Имена метрик совпадают с ключами JSON, которые присылают клиенты
+    static QString metricName(TelemetryMetric metric);
+    static bool metricFromName(const QString &name, TelemetryMetric *metric);
+    static QString aggregationName(Aggregation aggregation);
+    static bool aggregationFromName(const QString &name, Aggregation *aggregation);
+
+private:
+    // Агрегаты одной метрики, ключ — номер минуты (часа) от эпохи
+    using Series = QMap<qint64, RollupBucket>;
+
+    struct ClientSeries {
+        std::array<Series, kTelemetryMetricCount> minutes;
+        std::array<Series, kTelemetryMetricCount> hours;
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        QHash<int, ClientSeries> clients;
+    };
+
+    static constexpr int kShardCount = 16;
+
+    Shard &shardFor(int client_id);
+    static void addSample(Series &series, qint64 key, double value, int retention);
+    static void dropBefore(Series &series, qint64 oldest_key);
+
+    const int retention_minutes_;
+    const int retention_hours_;
+    std::array<Shard, kShardCount> shards_;
+};
+
+#endif // TELEMETRYSTORE_H
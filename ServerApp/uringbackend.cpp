@@ -0,0 +1,726 @@
+#include "uringbackend.h"
+
+#include <QSocketNotifier>
+#include <QSysInfo>
+#include <QTimer>
+#include <QVersionNumber>
+
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(IORING_RECV_MULTISHOT)
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#endif
+
+#include "servermetrics.h"
+#include "tcpserver.h"
+
+#if defined(IORING_RECV_MULTISHOT)
+
+namespace {
+constexpr unsigned kRingEntries = 4096;     // SQ; CQ вчетверо больше
+constexpr unsigned kBufferCount = 2048;     // Степень двойки
+constexpr unsigned kBufferSize = 4096;
+constexpr quint16 kBufferGroup = 0;
+constexpr int kAcceptRetryMs = 100;
+
+// user_data операции: тип, поколение соединения и дескриптор
+enum Op : quint64 {
+    OpInternal,     // cancel и close, завершаются без CQE при успехе
+    OpAccept,
+    OpRecv,
+    OpSend
+};
+
+constexpr quint32 kGenerationMask = 0xffffff;
+
+quint64 tag(Op op, quint32 generation, int fd)
+{
+    return (quint64(op) << 56) | (quint64(generation & kGenerationMask) << 32) | quint32(fd);
+}
+}  // namespace
+
+// Кольцо io_uring на прямых системных вызовах (без liburing)
+class UringBackend::Ring
+{
+public:
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring &operator=(const Ring&) = delete;
+
+    ~Ring()
+    {
+        if (buffer_ring_) {
+            io_uring_buf_reg reg {};
+            reg.bgid = kBufferGroup;
+            syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            munmap(buffer_ring_, buffer_ring_size_);
+        }
+        if (buffers_) {
+            munmap(buffers_, size_t(kBufferCount) * kBufferSize);
+        }
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+            munmap(cq_ptr_, cq_size_);
+        }
+        if (sq_ptr_) {
+            munmap(sq_ptr_, sq_size_);
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    // 0 или errno
+    int setup(unsigned entries)
+    {
+        io_uring_params params {};
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+        params.cq_entries = entries * 4;
+        fd_ = int(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            return errno;
+        }
+        // Без NODROP переполненное кольцо CQ теряет завершения
+        if (!(params.features & IORING_FEAT_NODROP)) {
+            return EOPNOTSUPP;
+        }
+
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        }
+
+        sq_ptr_ = mapRing(sq_size_, IORING_OFF_SQ_RING);
+        if (!sq_ptr_) {
+            return errno;
+        }
+        cq_ptr_ = single_mmap ? sq_ptr_ : mapRing(cq_size_, IORING_OFF_CQ_RING);
+        if (!cq_ptr_) {
+            return errno;
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mapRing(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) {
+            return errno;
+        }
+
+        char *sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_flags_ = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        // Индексы SQE совпадают с позициями в кольце
+        unsigned *array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i) {
+            array[i] = i;
+        }
+        sqe_tail_ = *sq_tail_;
+
+        char *cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return 0;
+    }
+
+    // 0 или errno; true в *supported, если ядро знает все нужные операции
+    int probe(bool *supported)
+    {
+        std::vector<char> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        io_uring_probe *probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            return errno;
+        }
+        *supported = true;
+        for (int op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+                       IORING_OP_ASYNC_CANCEL, IORING_OP_CLOSE}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                *supported = false;
+            }
+        }
+        return 0;
+    }
+
+    // Общий пул буферов приема: ядро само берет буфер на каждое
+    // завершение recv, память не закреплена за соединениями
+    int setupBuffers()
+    {
+        void *buffers = mmap(nullptr, size_t(kBufferCount) * kBufferSize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers == MAP_FAILED) {
+            return errno;
+        }
+        buffers_ = static_cast<char*>(buffers);
+
+        buffer_ring_size_ = kBufferCount * sizeof(io_uring_buf);
+        void *ring = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) {
+            return errno;
+        }
+
+        io_uring_buf_reg reg {};
+        reg.ring_addr = reinterpret_cast<quint64>(ring);
+        reg.ring_entries = kBufferCount;
+        reg.bgid = kBufferGroup;
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            const int error = errno;
+            munmap(ring, buffer_ring_size_);
+            return error;
+        }
+        buffer_ring_ = static_cast<io_uring_buf_ring*>(ring);
+
+        for (unsigned bid = 0; bid < kBufferCount; ++bid) {
+            recycleBuffer(quint16(bid));
+        }
+        publishBuffers();
+        return 0;
+    }
+
+    int registerEventfd(int event_fd)
+    {
+        return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0
+            ? errno : 0;
+    }
+
+    const char *buffer(quint16 bid) const
+    {
+        return buffers_ + size_t(bid) * kBufferSize;
+    }
+
+    // Буфер возвращается в пул; ядро увидит его после publishBuffers()
+    void recycleBuffer(quint16 bid)
+    {
+        // Не через bufs[]: в C++ __DECLARE_FLEX_ARRAY старых заголовков
+        // сдвигает массив, а по ABI записи начинаются с начала кольца
+        io_uring_buf &entry =
+            reinterpret_cast<io_uring_buf*>(buffer_ring_)[buffer_tail_ & (kBufferCount - 1)];
+        entry.addr = reinterpret_cast<quint64>(buffer(bid));
+        entry.len = kBufferSize;
+        entry.bid = bid;
+        ++buffer_tail_;
+    }
+
+    void publishBuffers()
+    {
+        __atomic_store_n(&buffer_ring_->tail, buffer_tail_, __ATOMIC_RELEASE);
+    }
+
+    // Свободный SQE; при заполненном кольце накопленное уходит в ядро
+    io_uring_sqe *nextSqe()
+    {
+        if (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            submit();
+        }
+        io_uring_sqe *sqe = &sqes_[sqe_tail_ & sq_mask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        ++sqe_tail_;
+        return sqe;
+    }
+
+    bool hasPending() const
+    {
+        return sqe_tail_ != *sq_tail_;
+    }
+
+    // Один io_uring_enter на все накопленные SQE; flush также переносит в
+    // кольцо CQ завершения, не поместившиеся в него раньше
+    void submit(bool flush = false)
+    {
+        const unsigned pending = sqe_tail_ - *sq_tail_;
+        __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+        if (pending == 0 && !flush) {
+            return;
+        }
+        while (syscall(__NR_io_uring_enter, fd_, pending, 0,
+                       flush ? IORING_ENTER_GETEVENTS : 0, nullptr, 0) < 0
+               && errno == EINTR) {
+        }
+        ServerMetrics::increment(Counter::IngestSyscalls);
+    }
+
+    bool cqOverflow() const
+    {
+        return __atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW;
+    }
+
+    // Обрабатывает все готовые завершения
+    template <typename Handler>
+    void reap(Handler handler)
+    {
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            // Копия: обработчик добавляет SQE и может вызвать submit()
+            const io_uring_cqe cqe = cqes_[head & cq_mask_];
+            handler(cqe);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    void *mapRing(size_t size, off_t offset)
+    {
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    int fd_ = -1;
+    void *sq_ptr_ = nullptr;
+    void *cq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_flags_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sqe_tail_ = 0;     // Заполненные SQE, включая неопубликованные
+
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+
+    char *buffers_ = nullptr;
+    io_uring_buf_ring *buffer_ring_ = nullptr;
+    size_t buffer_ring_size_ = 0;
+    quint16 buffer_tail_ = 0;
+};
+
+UringBackend::UringBackend(TcpServer *server)
+    : NativeBackend(server),
+      listen_fd_(-1),
+      event_fd_(-1),
+      notifier_(nullptr),
+      next_generation_(0),
+      dispatching_(false)
+{
+}
+
+UringBackend::~UringBackend()
+{
+    close();
+}
+
+bool UringBackend::isSupported()
+{
+    static const bool supported = [] {
+        // Multishot recv появился в 6.0; по probe его не отличить
+        if (QVersionNumber::fromString(QSysInfo::kernelVersion()) < QVersionNumber(6, 0)) {
+            return false;
+        }
+        Ring ring;
+        bool operations = false;
+        return ring.setup(8) == 0 && ring.probe(&operations) == 0 && operations
+            && ring.setupBuffers() == 0;
+    }();
+    return supported;
+}
+
+QString UringBackend::name() const
+{
+    return "io_uring";
+}
+
+bool UringBackend::listen(quint16 port, QString *error)
+{
+    ring_ = std::make_unique<Ring>();
+    int code = ring_->setup(kRingEntries);
+    if (code == 0) {
+        code = ring_->setupBuffers();
+    }
+    if (code != 0) {
+        *error = QString("io_uring: %1").arg(strerror(code));
+        ring_.reset();
+        return false;
+    }
+
+    listen_fd_ = openListener(port, error);
+    if (listen_fd_ < 0) {
+        ring_.reset();
+        return false;
+    }
+
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    code = event_fd_ < 0 ? errno : ring_->registerEventfd(event_fd_);
+    if (code != 0) {
+        *error = QString("io_uring eventfd: %1").arg(strerror(code));
+        close();
+        return false;
+    }
+
+    notifier_ = new QSocketNotifier(event_fd_, QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated,
+            this, &UringBackend::onActivated);
+
+    armAccept();
+    ring_->submit();
+    return true;
+}
+
+bool UringBackend::isListening() const
+{
+    return listen_fd_ >= 0;
+}
+
+void UringBackend::close()
+{
+    delete notifier_;
+    notifier_ = nullptr;
+
+    // Незавершенные send отменяются вместе с кольцом; shutdown не дает им
+    // дочитать ответы, память которых освобождается ниже
+    for (auto it = connections_.cbegin(); it != connections_.cend(); ++it) {
+        ::shutdown(it.key(), SHUT_RDWR);
+        ::close(it.key());
+    }
+    ring_.reset();
+    forgetAll();
+    sending_.clear();
+
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (event_fd_ >= 0) {
+        ::close(event_fd_);
+        event_fd_ = -1;
+    }
+}
+
+qint64 UringBackend::queuedBytes() const
+{
+    qint64 bytes = NativeBackend::queuedBytes();
+    for (const PendingSend &send : sending_) {
+        bytes += send.data.size() - send.offset;
+    }
+    return bytes;
+}
+
+void UringBackend::onActivated()
+{
+    quint64 wakeups;
+    if (::read(event_fd_, &wakeups, sizeof(wakeups)) < 0 && errno != EAGAIN) {
+        return;
+    }
+    ServerMetrics::increment(Counter::IngestSyscalls);
+
+    // Ответы на всю пачку завершений уходят в ядро одним вызовом
+    dispatching_ = true;
+    for (;;) {
+        ring_->reap([this](const io_uring_cqe &cqe) {
+            const int fd = int(quint32(cqe.user_data));
+            const quint32 generation = quint32(cqe.user_data >> 32) & kGenerationMask;
+            switch (cqe.user_data >> 56) {
+                case OpAccept:
+                    onAccepted(cqe.res, cqe.flags & IORING_CQE_F_MORE);
+                    break;
+                case OpRecv:
+                    onReceived(fd, generation, cqe.res, cqe.flags);
+                    break;
+                case OpSend:
+                    onSent(cqe.user_data, fd, cqe.res);
+                    break;
+                default:
+                    break;
+            }
+        });
+        ring_->publishBuffers();
+
+        const bool overflow = ring_->cqOverflow();
+        if (!ring_->hasPending() && !overflow) {
+            break;
+        }
+        ring_->submit(overflow);
+    }
+    dispatching_ = false;
+}
+
+void UringBackend::armAccept()
+{
+    io_uring_sqe *sqe = ring_->nextSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    // Блокирующие сокеты: ожиданием готовности занимается io_uring
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = tag(OpAccept, 0, listen_fd_);
+}
+
+void UringBackend::armRecv(int fd, quint32 generation)
+{
+    io_uring_sqe *sqe = ring_->nextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = tag(OpRecv, generation, fd);
+}
+
+void UringBackend::startSend(int fd, quint64 send_tag, PendingSend send)
+{
+    // Данные живут в sending_ до завершения операции
+    const PendingSend &pending = sending_[send_tag] = std::move(send);
+
+    io_uring_sqe *sqe = ring_->nextSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<quint64>(pending.data.constData() + pending.offset);
+    sqe->len = quint32(pending.data.size() - pending.offset);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = send_tag;
+    submitIfIdle();
+}
+
+void UringBackend::submitIfIdle()
+{
+    if (!dispatching_) {
+        ring_->submit();
+    }
+}
+
+void UringBackend::onAccepted(int result, bool more)
+{
+    if (result < 0) {
+        if (result == -ECANCELED) {
+            return;
+        }
+        emit server_->logMessage(QString("Accept failed: %1").arg(strerror(-result)));
+        // Ошибка снимает multishot accept; при нехватке дескрипторов
+        // немедленный повтор крутился бы в цикле, поэтому с паузой
+        if (!more) {
+            QTimer::singleShot(kAcceptRetryMs, this, [this]() {
+                if (isListening()) {
+                    armAccept();
+                    submitIfIdle();
+                }
+            });
+        }
+        return;
+    }
+    // Переполнение CQ тоже снимает multishot accept
+    if (!more) {
+        armAccept();
+    }
+
+    const int fd = result;
+    sockaddr_in6 peer {};
+    socklen_t length = sizeof(peer);
+    getpeername(fd, reinterpret_cast<sockaddr*>(&peer), &length);
+    ServerMetrics::increment(Counter::IngestSyscalls);
+
+    const quint32 generation = ++next_generation_ & kGenerationMask;
+    armRecv(fd, generation);
+    accepted(fd, peer.sin6_addr.s6_addr, ntohs(peer.sin6_port), generation);
+}
+
+void UringBackend::onReceived(int fd, quint32 generation, int result, quint32 flags)
+{
+    const bool has_buffer = flags & IORING_CQE_F_BUFFER;
+    const quint16 bid = quint16(flags >> IORING_CQE_BUFFER_SHIFT);
+
+    // Завершение для уже закрытого соединения (или прежнего владельца номера)
+    auto connection = connections_.find(fd);
+    if (connection == connections_.end() || connection->generation != generation) {
+        if (has_buffer) {
+            ring_->recycleBuffer(bid);
+        }
+        return;
+    }
+
+    if (result > 0) {
+        ServerMetrics::increment(Counter::BytesIn, quint64(result));
+        const bool open = handleFrames(fd, ring_->buffer(bid), result);
+        ring_->recycleBuffer(bid);
+        if (open && !(flags & IORING_CQE_F_MORE)) {
+            armRecv(fd, generation);
+        }
+        return;
+    }
+
+    if (has_buffer) {
+        ring_->recycleBuffer(bid);
+    }
+    // Пул кончился: чтение снято, повторяем после возврата буферов
+    if (result == -ENOBUFS) {
+        armRecv(fd, generation);
+        return;
+    }
+    // 0 — собеседник закрыл соединение, иначе ошибка
+    closeConnection(fd);
+}
+
+void UringBackend::onSent(quint64 send_tag, int fd, int result)
+{
+    auto pending = sending_.find(send_tag);
+    if (pending == sending_.end()) {
+        return;
+    }
+
+    auto connection = connections_.find(fd);
+    const bool alive = connection != connections_.end()
+        && tag(OpSend, connection->generation, fd) == send_tag;
+    if (result <= 0) {
+        sending_.erase(pending);
+        if (alive) {
+            closeConnection(fd);
+        }
+        return;
+    }
+
+    ServerMetrics::increment(Counter::BytesOut, quint64(result));
+    PendingSend send = std::move(*pending);
+    sending_.erase(pending);
+    if (!alive) {
+        return;
+    }
+
+    send.offset += result;
+    if (send.offset < send.data.size()) {
+        startSend(fd, send_tag, std::move(send));
+    } else if (!connection->outbound.isEmpty()) {
+        // Накопленное за время отправки уходит одной операцией
+        PendingSend next;
+        next.data.swap(connection->outbound);
+        startSend(fd, send_tag, std::move(next));
+    } else if (connection->closing) {
+        closeConnection(fd);
+    }
+}
+
+bool UringBackend::writeTo(int fd, const QByteArray &data)
+{
+    auto connection = connections_.find(fd);
+    if (connection == connections_.end()) {
+        return false;
+    }
+
+    // Одна отправка в полете на соединение, остальное ждет за ней
+    const quint64 send_tag = tag(OpSend, connection->generation, fd);
+    if (sending_.contains(send_tag)) {
+        connection->outbound.append(data);
+        return true;
+    }
+
+    PendingSend send;
+    send.data = data;
+    startSend(fd, send_tag, std::move(send));
+    return true;
+}
+
+void UringBackend::closeConnection(int fd)
+{
+    auto connection = connections_.find(fd);
+    if (connection == connections_.end()) {
+        return;
+    }
+
+    io_uring_sqe *cancel = ring_->nextSqe();
+    cancel->opcode = IORING_OP_ASYNC_CANCEL;
+    cancel->addr = tag(OpRecv, connection->generation, fd);
+    cancel->flags = IOSQE_CQE_SKIP_SUCCESS;
+    cancel->user_data = tag(OpInternal, 0, fd);
+
+    // Отправка в полете держит свою ссылку на сокет и завершится сама
+    io_uring_sqe *close = ring_->nextSqe();
+    close->opcode = IORING_OP_CLOSE;
+    close->fd = fd;
+    close->flags = IOSQE_CQE_SKIP_SUCCESS;
+    close->user_data = tag(OpInternal, 0, fd);
+
+    forgetConnection(fd);
+    submitIfIdle();
+}
+
+#else
+
+class UringBackend::Ring
+{
+};
+
+UringBackend::UringBackend(TcpServer *server)
+    : NativeBackend(server),
+      listen_fd_(-1),
+      event_fd_(-1),
+      notifier_(nullptr),
+      next_generation_(0),
+      dispatching_(false)
+{
+}
+
+UringBackend::~UringBackend()
+{
+}
+
+bool UringBackend::isSupported()
+{
+    return false;
+}
+
+QString UringBackend::name() const
+{
+    return "io_uring";
+}
+
+bool UringBackend::listen(quint16 port, QString *error)
+{
+    Q_UNUSED(port);
+    *error = "io_uring is not available in this build";
+    return false;
+}
+
+bool UringBackend::isListening() const
+{
+    return false;
+}
+
+void UringBackend::close()
+{
+}
+
+qint64 UringBackend::queuedBytes() const
+{
+    return 0;
+}
+
+void UringBackend::onActivated()
+{
+}
+
+bool UringBackend::writeTo(int fd, const QByteArray &data)
+{
+    Q_UNUSED(fd);
+    Q_UNUSED(data);
+    return false;
+}
+
+void UringBackend::closeConnection(int fd)
+{
+    Q_UNUSED(fd);
+}
+
+#endif
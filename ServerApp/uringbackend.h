@@ -0,0 +1,70 @@
+#ifndef URINGBACKEND_H
+#define URINGBACKEND_H
+
+#include <memory>
+
+#include "nativebackend.h"
+
+class QSocketNotifier;
+
+// Experimental device listener on io_uring (Linux 6.0+).
+//
+// Прием — один multishot accept, чтение — multishot recv на соединение с
+// буферами из общего пула, который ядро выбирает само (provided buffer
+// ring). Запросы копятся в кольце SQ и уходят в ядро одним io_uring_enter
+// на пачку завершений, поэтому под нагрузкой системных вызовов на
+// сообщение почти нет. Завершения будят цикл событий через eventfd.
+class UringBackend : public NativeBackend
+{
+    Q_OBJECT
+
+public:
+    explicit UringBackend(TcpServer *server);
+    ~UringBackend();
+
+    // Kernel check: io_uring enabled, required operations and buffer rings
+    static bool isSupported();
+
+    QString name() const override;
+    bool listen(quint16 port, QString *error) override;
+    bool isListening() const override;
+    void close() override;
+
+    qint64 queuedBytes() const override;
+
+protected:
+    bool writeTo(int fd, const QByteArray &data) override;
+    void closeConnection(int fd) override;
+
+private slots:
+    void onActivated();
+
+private:
+    class Ring;
+
+    // Ответ, отданный ядру; живет до завершения операции
+    struct PendingSend {
+        QByteArray data;
+        int offset = 0;
+    };
+
+    void armAccept();
+    void armRecv(int fd, quint32 generation);
+    void startSend(int fd, quint64 tag, PendingSend send);
+    void submitIfIdle();
+
+    void onAccepted(int result, bool more);
+    void onReceived(int fd, quint32 generation, int result, quint32 flags);
+    void onSent(quint64 tag, int fd, int result);
+
+    std::unique_ptr<Ring> ring_;
+    int listen_fd_;
+    int event_fd_;
+    QSocketNotifier *notifier_;
+    quint32 next_generation_;
+    bool dispatching_;          // Внутри onActivated: SQE уйдут одной пачкой в конце
+
+    QHash<quint64, PendingSend> sending_;    // По тегу операции send
+};
+
+#endif // URINGBACKEND_H
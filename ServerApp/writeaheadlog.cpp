@@ -0,0 +1,420 @@
+#include "writeaheadlog.h"
+
+#include <QDeadlineTimer>
+#include <QDir>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <algorithm>
+#include <array>
+
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+#include "servermetrics.h"
+
+namespace {
+const QByteArray kSegmentMagic = "CSWAL001";
+constexpr int kSegmentHeaderSize = 16;  // magic + u64 sequence
+constexpr int kRecordHeaderSize = 20;   // length + crc + client_id + timestamp
+constexpr int kOpenAttempts = 3;        // Открытие следующего сегмента
+constexpr int kOpenRetryDelayMs = 100;
+
+struct SegmentInfo {
+    quint64 sequence;
+    QString path;
+};
+
+// CRC-32 (IEEE 802.3), допускает продолжение: crc32(crc32(0, a), b) == crc32(0, a + b)
+quint32 crc32Update(quint32 crc, const char *data, qint64 size)
+{
+    static const std::array<quint32, 256> table = [] {
+        std::array<quint32, 256> result{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uchar>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// CRC записи: номер сегмента + client_id + timestamp + payload
+quint32 recordCrc(quint64 sequence, const char *header, const char *payload, qint64 size)
+{
+    char sequence_le[8];
+    qToLittleEndian<quint64>(sequence, sequence_le);
+    quint32 crc = crc32Update(0, sequence_le, sizeof(sequence_le));
+    crc = crc32Update(crc, header + 8, kRecordHeaderSize - 8);
+    return crc32Update(crc, payload, size);
+}
+
+void encodeRecord(QByteArray &out, quint64 sequence, const WalRecord &record)
+{
+    char header[kRecordHeaderSize];
+    qToLittleEndian<quint32>(record.frame.size(), header);
+    qToLittleEndian<qint32>(record.client_id, header + 8);
+    qToLittleEndian<qint64>(record.timestamp_ms, header + 12);
+    qToLittleEndian<quint32>(recordCrc(sequence, header, record.frame.constData(),
+                                       record.frame.size()),
+                             header + 4);
+    out.append(header, kRecordHeaderSize);
+    out.append(record.frame);
+}
+
+// Сегменты с корректным заголовком, по возрастанию номера
+QVector<SegmentInfo> scanSegments(const WalConfig &config)
+{
+    QVector<SegmentInfo> segments;
+    for (int slot = 0; slot < config.segment_count; ++slot) {
+        QFile file(QDir(config.directory).filePath(QString("wal-%1.log").arg(slot)));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QByteArray header = file.read(kSegmentHeaderSize);
+        if (header.size() != kSegmentHeaderSize || !header.startsWith(kSegmentMagic)) {
+            continue;
+        }
+        segments.append({qFromLittleEndian<quint64>(header.constData() + 8), file.fileName()});
+    }
+
+    std::sort(segments.begin(), segments.end(),
+              [](const SegmentInfo &a, const SegmentInfo &b) { return a.sequence < b.sequence; });
+    return segments;
+}
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const WalConfig &config, QObject *parent)
+    : QObject(parent),
+      config_(config),
+      pending_bytes_(0),
+      stopping_(false),
+      writer_(nullptr),
+      sequence_(0),
+      write_offset_(0),
+      failed_(false)
+{
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    close();
+}
+
+qint64 WriteAheadLog::replay(const std::function<void(const WalRecord &)> &callback)
+{
+    qint64 replayed = 0;
+
+    for (const SegmentInfo &segment : scanSegments(config_)) {
+        QFile file(segment.path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+
+        const qint64 size = file.size();
+        const char *data = reinterpret_cast<const char*>(file.map(0, size));
+        if (!data) {
+            emit logMessage(QString("WAL: cannot map %1: %2").arg(segment.path, file.errorString()));
+            continue;
+        }
+
+        // Записи читаются до первой неполной или поврежденной: это хвост,
+        // не попавший на диск, или остаток предыдущего круга кольца
+        qint64 offset = kSegmentHeaderSize;
+        while (offset + kRecordHeaderSize <= size) {
+            const char *header = data + offset;
+            const qint64 length = qFromLittleEndian<quint32>(header);
+            if (length == 0 || offset + kRecordHeaderSize + length > size) {
+                break;
+            }
+            const char *payload = header + kRecordHeaderSize;
+            if (qFromLittleEndian<quint32>(header + 4)
+                != recordCrc(segment.sequence, header, payload, length)) {
+                break;
+            }
+
+            WalRecord record;
+            record.client_id = qFromLittleEndian<qint32>(header + 8);
+            record.timestamp_ms = qFromLittleEndian<qint64>(header + 12);
+            record.frame = QByteArray(payload, length);
+            callback(record);
+
+            ++replayed;
+            offset += kRecordHeaderSize + length;
+        }
+
+        file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(data)));
+    }
+
+    return replayed;
+}
+
+bool WriteAheadLog::open(QString *error)
+{
+    if (writer_) {
+        return true;
+    }
+
+    if (!QDir().mkpath(config_.directory)) {
+        *error = QString("cannot create %1").arg(config_.directory);
+        return false;
+    }
+
+    // Новый сегмент идет после последнего существующего, чтобы не затереть
+    // еще не воспроизведенные данные
+    QVector<SegmentInfo> segments = scanSegments(config_);
+    if (!openSegment(segments.isEmpty() ? 1 : segments.last().sequence + 1, error)) {
+        return false;
+    }
+
+    stopping_ = false;
+    writer_ = QThread::create([this]() { writerLoop(); });
+    writer_->setObjectName("wal-writer");
+    writer_->start();
+
+    emit logMessage(QString("WAL: writing to %1, %2 x %3 MB segments, sync every %4 ms / %5 KB")
+                    .arg(config_.directory)
+                    .arg(config_.segment_count)
+                    .arg(config_.segment_size / (1024 * 1024))
+                    .arg(config_.sync_interval_ms)
+                    .arg(config_.sync_bytes / 1024));
+    return true;
+}
+
+void WriteAheadLog::close()
+{
+    if (!writer_) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&mutex_);
+        stopping_ = true;
+        writer_wake_.wakeAll();
+        space_available_.wakeAll();
+    }
+
+    // Поток записи сбрасывает остаток очереди перед завершением
+    writer_->wait();
+    delete writer_;
+    writer_ = nullptr;
+    segment_.close();
+}
+
+bool WriteAheadLog::append(int client_id, qint64 timestamp_ms, const QByteArray &frame)
+{
+    if (failed_.load(std::memory_order_relaxed)) {
+        ServerMetrics::increment(Counter::WalDropped);
+        return false;
+    }
+
+    QMutexLocker locker(&mutex_);
+    if (!writer_ || stopping_) {
+        return false;
+    }
+
+    // Запись отстает слишком сильно: ждем, а не теряем данные
+    while (pending_bytes_ >= kMaxPendingBytes && !stopping_) {
+        space_available_.wait(&mutex_);
+    }
+
+    pending_.append({client_id, timestamp_ms, frame});
+    pending_bytes_ += kRecordHeaderSize + frame.size();
+
+    // Будим поток записи на первой записи пачки (запуск таймера группы)
+    // и при достижении порога по объему
+    if (pending_.size() == 1 || pending_bytes_ >= config_.sync_bytes) {
+        writer_wake_.wakeOne();
+    }
+    return true;
+}
+
+bool WriteAheadLog::hasFailed() const
+{
+    return failed_.load(std::memory_order_relaxed);
+}
+
+void WriteAheadLog::writerLoop()
+{
+    forever {
+        QVector<WalRecord> batch;
+        {
+            QMutexLocker locker(&mutex_);
+            while (!stopping_ && pending_.isEmpty()) {
+                writer_wake_.wait(&mutex_);
+            }
+
+            // Групповой коммит: копим записи до истечения интервала
+            // или до порога по объему
+            QDeadlineTimer deadline(config_.sync_interval_ms);
+            while (!stopping_ && pending_bytes_ < config_.sync_bytes && !deadline.hasExpired()) {
+                writer_wake_.wait(&mutex_, deadline);
+            }
+
+            batch.swap(pending_);
+            pending_bytes_ = 0;
+            space_available_.wakeAll();
+
+            if (batch.isEmpty() && stopping_) {
+                return;
+            }
+        }
+
+        writeBatch(batch);
+    }
+}
+
+void WriteAheadLog::writeBatch(const QVector<WalRecord> &batch)
+{
+    // Журнал уже отказал: пачка собрана до того, как append() это увидел
+    if (failed_.load()) {
+        ServerMetrics::increment(Counter::WalDropped, batch.size());
+        return;
+    }
+
+    qint64 buffered = 0;    // Записей в write_buffer_
+    qint64 written = 0;
+    qint64 skipped = 0;
+    auto flushBuffer = [this, &buffered, &written]() {
+        if (write_buffer_.isEmpty()) {
+            return true;
+        }
+        if (!segment_.seek(write_offset_) || segment_.write(write_buffer_) != write_buffer_.size()) {
+            return false;
+        }
+        ServerMetrics::increment(Counter::WalBytes, write_buffer_.size());
+        write_offset_ += write_buffer_.size();
+        write_buffer_.clear();
+        written += buffered;
+        buffered = 0;
+        return true;
+    };
+
+    for (const WalRecord &record : batch) {
+        const qint64 record_size = kRecordHeaderSize + record.frame.size();
+        if (kSegmentHeaderSize + record_size > config_.segment_size) {
+            emit logMessage(QString("WAL: %1-byte frame from client %2 exceeds segment size, skipped")
+                            .arg(record.frame.size()).arg(record.client_id));
+            ServerMetrics::increment(Counter::WalDropped);
+            ++skipped;
+            continue;
+        }
+
+        // Запись не помещается в сегмент: закрываем его и переходим
+        // к следующему файлу кольца
+        if (write_offset_ + write_buffer_.size() + record_size > config_.segment_size) {
+            if (!flushBuffer()) {
+                break;
+            }
+            syncSegment();
+            if (!openNextSegment()) {
+                write_buffer_.clear();
+                fail(QString(), batch.size() - written - skipped);
+                return;
+            }
+        }
+
+        encodeRecord(write_buffer_, sequence_, record);
+        ++buffered;
+    }
+
+    if (!flushBuffer()) {
+        const QString error = QString("write to %1 failed: %2")
+                                  .arg(segment_.fileName(), segment_.errorString());
+        write_buffer_.clear();
+        fail(error, batch.size() - written - skipped);
+        return;
+    }
+    syncSegment();
+    ServerMetrics::increment(Counter::WalRecords, written);
+}
+
+bool WriteAheadLog::openNextSegment()
+{
+    // Сбой может быть временным (нехватка дескрипторов, занятый файл)
+    QString error;
+    for (int attempt = 1; attempt <= kOpenAttempts; ++attempt) {
+        if (openSegment(sequence_ + 1, &error)) {
+            return true;
+        }
+        emit logMessage(QString("WAL: %1 (attempt %2 of %3)").arg(error).arg(attempt).arg(kOpenAttempts));
+        if (attempt < kOpenAttempts) {
+            QThread::msleep(kOpenRetryDelayMs * attempt);
+        }
+    }
+    return false;
+}
+
+void WriteAheadLog::fail(const QString &error, qint64 dropped)
+{
+    failed_.store(true);
+    ServerMetrics::increment(Counter::WalDropped, quint64(dropped));
+    emit logMessage(QString("WAL: %1journaling stopped, %2 frame(s) of the batch lost; "
+                            "further frames are not journaled")
+                    .arg(error.isEmpty() ? QString() : error + "; ")
+                    .arg(dropped));
+}
+
+bool WriteAheadLog::openSegment(quint64 sequence, QString *error)
+{
+    segment_.close();
+    segment_.setFileName(segmentPath(static_cast<int>(sequence % config_.segment_count)));
+    if (!segment_.open(QIODevice::ReadWrite)) {
+        *error = QString("cannot open %1: %2").arg(segment_.fileName(), segment_.errorString());
+        return false;
+    }
+
+    // Файл выделяется целиком заранее, чтобы запись не меняла метаданные
+    // файла и fdatasync не приходилось сбрасывать размер
+    if (segment_.size() < config_.segment_size) {
+#if defined(Q_OS_LINUX)
+        if (posix_fallocate(segment_.handle(), 0, config_.segment_size) != 0) {
+            segment_.resize(config_.segment_size);
+        }
+#else
+        segment_.resize(config_.segment_size);
+#endif
+    }
+
+    QByteArray header = kSegmentMagic;
+    header.resize(kSegmentHeaderSize);
+    qToLittleEndian<quint64>(sequence, header.data() + 8);
+    if (!segment_.seek(0) || segment_.write(header) != header.size()) {
+        *error = QString("cannot write %1: %2").arg(segment_.fileName(), segment_.errorString());
+        return false;
+    }
+
+    sequence_ = sequence;
+    write_offset_ = kSegmentHeaderSize;
+    return true;
+}
+
+void WriteAheadLog::syncSegment()
+{
+    segment_.flush();
+#if defined(Q_OS_LINUX)
+    ::fdatasync(segment_.handle());
+#elif defined(Q_OS_UNIX)
+    ::fsync(segment_.handle());
+#elif defined(Q_OS_WIN)
+    ::_commit(segment_.handle());
+#endif
+    ServerMetrics::increment(Counter::WalSyncs);
+}
+
+QString WriteAheadLog::segmentPath(int slot) const
+{
+    return QDir(config_.directory).filePath(QString("wal-%1.log").arg(slot));
+}
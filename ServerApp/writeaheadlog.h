@@ -0,0 +1,112 @@
+#ifndef WRITEAHEADLOG_H
+#define WRITEAHEADLOG_H
+
+#include <QFile>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+
+// Параметры журнала предзаписи
+struct WalConfig {
+    QString directory;
+    int segment_count = 8;                       // Размер кольца сегментов
+    qint64 segment_size = 64 * 1024 * 1024;      // Предвыделяемый размер файла
+    int sync_interval_ms = 10;                   // fsync не реже, чем раз в N мс
+    qint64 sync_bytes = 1024 * 1024;             // ... или при накоплении N байт
+};
+
+// One framed message as received from a device
+struct WalRecord {
+    int client_id;
+    qint64 timestamp_ms;
+    QByteArray frame;
+};
+
+// Write-ahead log of raw frames with group commit.
+//
+// Поток приема только добавляет кадр в очередь под коротким мьютексом;
+// отдельный поток записи забирает накопленную пачку, пишет ее одним
+// вызовом write() и выполняет один fdatasync на всю пачку. Сегменты
+// образуют кольцо предвыделенных файлов wal-<slot>.log, которые
+// переиспользуются по кругу. Каждая запись защищена CRC32, в которую
+// подмешан номер сегмента, поэтому остатки предыдущего круга в
+// переиспользованном файле при воспроизведении отбрасываются.
+//
+// Формат сегмента: "CSWAL001", u64 sequence, затем записи
+// { u32 length, u32 crc, i32 client_id, i64 timestamp_ms, payload }
+// (little endian).
+//
+// Накладные расходы оцениваются по метрикам clientserver_wal_*: число
+// fsync в секунду и байт на fsync при заданной нагрузке показывают
+// эффективность группировки. Если запись отстает больше чем на
+// kMaxPendingBytes, append() блокирует поток приема — журнал не теряет
+// принятые данные молча.
+//
+// Если сегмент не открывается и после повторных попыток или запись в
+// файл не удалась, журнал переходит в состояние отказа: недописанные
+// записи и все последующие отбрасываются со счетчиком WalDropped, а
+// append() возвращает false.
+class WriteAheadLog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WriteAheadLog(const WalConfig &config, QObject *parent = nullptr);
+    ~WriteAheadLog();
+
+    // Feed valid records of all segments, oldest first, to callback.
+    // Must be called before open(); returns number of replayed records.
+    qint64 replay(const std::function<void(const WalRecord &)> &callback);
+
+    // Start a new segment after the replayed ones and the writer thread
+    bool open(QString *error);
+
+    // Flush pending records and stop the writer thread
+    void close();
+
+    // Thread-safe, called from the ingest thread; false if the frame was
+    // not accepted because the log is closed or has failed
+    bool append(int client_id, qint64 timestamp_ms, const QByteArray &frame);
+
+    // Writing stopped after an I/O error (see logMessage)
+    bool hasFailed() const;
+
+signals:
+    void logMessage(const QString &message);
+
+private:
+    void writerLoop();
+    void writeBatch(const QVector<WalRecord> &batch);
+    bool openSegment(quint64 sequence, QString *error);
+    bool openNextSegment();
+    void fail(const QString &error, qint64 dropped);
+    void syncSegment();
+    QString segmentPath(int slot) const;
+
+    const WalConfig config_;
+
+    // Очередь группового коммита
+    QMutex mutex_;
+    QWaitCondition writer_wake_;
+    QWaitCondition space_available_;
+    QVector<WalRecord> pending_;
+    qint64 pending_bytes_;
+    bool stopping_;
+
+    // Состояние потока записи
+    QThread *writer_;
+    QFile segment_;
+    quint64 sequence_;
+    qint64 write_offset_;
+    QByteArray write_buffer_;
+    std::atomic<bool> failed_;
+
+    static constexpr qint64 kMaxPendingBytes = 64 * 1024 * 1024;
+};
+
+#endif // WRITEAHEADLOG_H